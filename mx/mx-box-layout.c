@@ -111,8 +111,39 @@ struct _MxBoxLayoutPrivate
   MxOrientation orientation;
 
   MxFocusable *last_focus;
+
+  /* the extent of each visible child along the orientation, as last
+   * allocated, so that the children in view can be found without looking
+   * at every child */
+  GArray      *child_index;
+  guint        child_index_valid : 1;
+
+  /* the visible children, their layout properties and their sizes along
+   * the orientation for children_for_size across it, kept until a relayout
+   * is queued */
+  GArray      *children;
+  gfloat       children_for_size;
+  gint         n_expand_children;
+  guint        children_valid : 1;
 };
 
+typedef struct
+{
+  ClutterActor *child;
+  gfloat        start;
+  gfloat        end;
+} MxBoxLayoutChildExtent;
+
+typedef struct
+{
+  ClutterActor     *child;
+  MxBoxLayoutChild *meta;
+  gfloat            pref_size;
+  gfloat            min_size;
+  ClutterActorBox   box;
+  gboolean          skip;
+} MxBoxLayoutChildInfo;
+
 void _mx_box_layout_finish_animation (MxBoxLayout *box);
 
 void
@@ -274,6 +305,19 @@ scrollable_get_adjustments (MxScrollable  *scrollable,
 
 
 
+/* Returns the adjustments that have been set, without creating them as
+ * mx_scrollable_get_adjustments() does */
+void
+_mx_box_layout_get_adjustments (MxBoxLayout   *box,
+                                MxAdjustment **hadjustment,
+                                MxAdjustment **vadjustment)
+{
+  if (hadjustment)
+    *hadjustment = box->priv->hadjustment;
+  if (vadjustment)
+    *vadjustment = box->priv->vadjustment;
+}
+
 static void
 mx_box_scrollable_interface_init (MxScrollableIface *iface)
 {
@@ -301,6 +345,9 @@ mx_box_container_actor_added (ClutterContainer *container,
 {
   MxBoxLayoutPrivate *priv = MX_BOX_LAYOUT (container)->priv;
 
+  priv->child_index_valid = FALSE;
+  priv->children_valid = FALSE;
+
   if (priv->enable_animations)
     {
       _mx_box_layout_start_animation (MX_BOX_LAYOUT (container));
@@ -323,6 +370,9 @@ mx_box_container_actor_removed (ClutterContainer *container,
 
   g_object_ref (actor);
 
+  priv->child_index_valid = FALSE;
+  priv->children_valid = FALSE;
+
   if ((ClutterActor *)priv->last_focus == actor)
     priv->last_focus = NULL;
 
@@ -693,9 +743,58 @@ mx_box_layout_finalize (GObject *object)
       priv->start_allocations = NULL;
     }
 
+  g_array_free (priv->child_index, TRUE);
+  g_array_free (priv->children, TRUE);
+
   G_OBJECT_CLASS (mx_box_layout_parent_class)->finalize (object);
 }
 
+/* Measures the visible children along the orientation, for @for_size
+ * across it, and keeps the sizes until a relayout is queued or the
+ * children are measured for another size */
+static void
+mx_box_layout_measure_children (MxBoxLayout *box,
+                                gfloat       for_size)
+{
+  MxBoxLayoutPrivate *priv = box->priv;
+  ClutterActorIter iter;
+  ClutterActor *child;
+
+  if (priv->children_valid && priv->children_for_size == for_size)
+    return;
+
+  g_array_set_size (priv->children, 0);
+  priv->n_expand_children = 0;
+
+  clutter_actor_iter_init (&iter, CLUTTER_ACTOR (box));
+  while (clutter_actor_iter_next (&iter, &child))
+    {
+      MxBoxLayoutChildInfo info = { 0, };
+
+      if (!CLUTTER_ACTOR_IS_VISIBLE (child))
+        continue;
+
+      info.child = child;
+      info.meta = (MxBoxLayoutChild *)
+        clutter_container_get_child_meta ((ClutterContainer *) box, child);
+
+      if (priv->orientation == MX_ORIENTATION_VERTICAL)
+        clutter_actor_get_preferred_height (child, for_size,
+                                            &info.min_size, &info.pref_size);
+      else
+        clutter_actor_get_preferred_width (child, for_size,
+                                           &info.min_size, &info.pref_size);
+
+      if (info.meta->expand)
+        priv->n_expand_children++;
+
+      g_array_append_val (priv->children, info);
+    }
+
+  priv->children_for_size = for_size;
+  priv->children_valid = TRUE;
+}
+
 static void
 mx_box_layout_get_preferred_width (ClutterActor *actor,
                                    gfloat        for_height,
@@ -719,43 +818,44 @@ mx_box_layout_get_preferred_width (ClutterActor *actor,
   if (for_height > 0)
     for_height = MAX (0, for_height - padding.top - padding.bottom);
 
-  clutter_actor_iter_init (&iter, actor);
-  while (clutter_actor_iter_next (&iter, &child))
+  if (priv->orientation == MX_ORIENTATION_HORIZONTAL)
     {
-      gfloat child_min = 0, child_nat = 0;
-      gfloat child_for_height;
+      guint i;
 
-      if (!CLUTTER_ACTOR_IS_VISIBLE (child))
-        continue;
-
-      n_children++;
-
-      if (priv->orientation == MX_ORIENTATION_HORIZONTAL)
-        child_for_height = for_height;
-      else
-        child_for_height = -1;
+      /* along the orientation, the sizes are kept for allocate */
+      mx_box_layout_measure_children (MX_BOX_LAYOUT (actor), for_height);
+      n_children = priv->children->len;
 
-      clutter_actor_get_preferred_width (child,
-                                         child_for_height,
-                                         &child_min,
-                                         &child_nat);
-
-      if (priv->orientation == MX_ORIENTATION_VERTICAL)
+      for (i = 0; i < priv->children->len; i++)
         {
+          MxBoxLayoutChildInfo *info =
+            &g_array_index (priv->children, MxBoxLayoutChildInfo, i);
+
           if (min_width_p)
-            *min_width_p = MAX (child_min, *min_width_p);
+            *min_width_p += info->min_size;
 
           if (natural_width_p)
-            *natural_width_p = MAX (child_nat, *natural_width_p);
+            *natural_width_p += info->pref_size;
         }
-      else
+    }
+  else
+    {
+      clutter_actor_iter_init (&iter, actor);
+      while (clutter_actor_iter_next (&iter, &child))
         {
+          gfloat child_min = 0, child_nat = 0;
+
+          if (!CLUTTER_ACTOR_IS_VISIBLE (child))
+            continue;
+
+          clutter_actor_get_preferred_width (child, -1,
+                                             &child_min, &child_nat);
+
           if (min_width_p)
-            *min_width_p += child_min;
+            *min_width_p = MAX (child_min, *min_width_p);
 
           if (natural_width_p)
-            *natural_width_p += child_nat;
-
+            *natural_width_p = MAX (child_nat, *natural_width_p);
         }
     }
 
@@ -800,43 +900,44 @@ mx_box_layout_get_preferred_height (ClutterActor *actor,
   if (for_width > 0)
     for_width = MAX (0, for_width - padding.left - padding.right);
 
-
-  clutter_actor_iter_init (&iter, actor);
-  while (clutter_actor_iter_next (&iter, &child))
+  if (priv->orientation == MX_ORIENTATION_VERTICAL)
     {
-      gfloat child_min = 0, child_nat = 0;
-      gfloat child_for_width;
-
-      if (!CLUTTER_ACTOR_IS_VISIBLE (child))
-        continue;
-
-      n_children++;
+      guint i;
 
-      if (priv->orientation == MX_ORIENTATION_VERTICAL)
-        child_for_width = for_width;
-      else
-        child_for_width = -1;
+      /* along the orientation, the sizes are kept for allocate */
+      mx_box_layout_measure_children (MX_BOX_LAYOUT (actor), for_width);
+      n_children = priv->children->len;
 
-      clutter_actor_get_preferred_height (child,
-                                          child_for_width,
-                                          &child_min,
-                                          &child_nat);
-
-      if (priv->orientation == MX_ORIENTATION_HORIZONTAL)
+      for (i = 0; i < priv->children->len; i++)
         {
+          MxBoxLayoutChildInfo *info =
+            &g_array_index (priv->children, MxBoxLayoutChildInfo, i);
+
           if (min_height_p)
-            *min_height_p = MAX (child_min, *min_height_p);
+            *min_height_p += info->min_size;
 
           if (natural_height_p)
-            *natural_height_p = MAX (child_nat, *natural_height_p);
+            *natural_height_p += info->pref_size;
         }
-      else
+    }
+  else
+    {
+      clutter_actor_iter_init (&iter, actor);
+      while (clutter_actor_iter_next (&iter, &child))
         {
+          gfloat child_min = 0, child_nat = 0;
+
+          if (!CLUTTER_ACTOR_IS_VISIBLE (child))
+            continue;
+
+          clutter_actor_get_preferred_height (child, -1,
+                                              &child_min, &child_nat);
+
           if (min_height_p)
-            *min_height_p += child_min;
+            *min_height_p = MAX (child_min, *min_height_p);
 
           if (natural_height_p)
-            *natural_height_p += child_nat;
+            *natural_height_p = MAX (child_nat, *natural_height_p);
         }
     }
 
@@ -935,42 +1036,6 @@ mx_box_layout_update_adjustments (ClutterActor *actor,
 }
 
 
-typedef struct
-{
-  ClutterActor *child;
-  gfloat pref_size;
-  gfloat min_size;
-  ClutterActorBox *box;
-  gboolean skip;
-} MxBoxLayoutChildInfo;
-
-
-static void
-mx_box_layout_child_info_free (MxBoxLayoutChildInfo *info)
-{
-  clutter_actor_box_free (info->box);
-  g_slice_free (MxBoxLayoutChildInfo, info);
-}
-
-static MxBoxLayoutChildInfo*
-mx_box_layout_child_info_new (ClutterActor          *child,
-                              gfloat                 pref_size,
-                              gfloat                 min_size,
-                              const ClutterActorBox *box)
-{
-  MxBoxLayoutChildInfo *info;
-
-  info = g_slice_new (MxBoxLayoutChildInfo);
-
-  info->child = child;
-  info->pref_size = pref_size;
-  info->min_size = min_size;
-  info->box = clutter_actor_box_copy (box);
-  info->skip = FALSE;
-
-  return info;
-}
-
 static void
 mx_box_layout_allocate (ClutterActor          *actor,
                         const ClutterActorBox *box,
@@ -983,40 +1048,16 @@ mx_box_layout_allocate (ClutterActor          *actor,
   gfloat extra_space = 0;
   gfloat position = 0;
   gfloat actual_size = 0;
-  ClutterActor *child;
-  ClutterActorIter iter;
   gint n_expand_children, n_children;
-  GList *boxes = NULL, *l;
+  guint i;
 
   CLUTTER_ACTOR_CLASS (mx_box_layout_parent_class)->allocate (actor, box,
                                                               flags);
 
-  if (clutter_actor_get_n_children (actor) == 0)
-    return;
-
-  /* count the number of children with expand set to TRUE and the
-   * amount of visible children.
-   */
-  n_children = n_expand_children = 0;
-  clutter_actor_iter_init (&iter, actor);
-  while (clutter_actor_iter_next (&iter, &child))
-    {
-      if (CLUTTER_ACTOR_IS_VISIBLE (child))
-        {
-          MxBoxLayoutChild *meta;
-
-          meta = (MxBoxLayoutChild*)
-            clutter_container_get_child_meta ((ClutterContainer *) actor,
-                                              child);
-          n_children++;
+  priv->child_index_valid = FALSE;
+  g_array_set_size (priv->child_index, 0);
 
-          if (meta->expand)
-            n_expand_children++;
-        }
-    }
-
-  /* We have no visible children, so bail out */
-  if (n_children == 0)
+  if (clutter_actor_get_n_children (actor) == 0)
     return;
 
   mx_widget_get_padding (MX_WIDGET (actor), &padding);
@@ -1026,6 +1067,8 @@ mx_box_layout_allocate (ClutterActor          *actor,
   avail_width  = box->x2 - box->x1;
   avail_height = box->y2 - box->y1;
 
+  /* this measures the visible children along the orientation, for the
+   * size they are allocated across it */
   if (priv->orientation == MX_ORIENTATION_VERTICAL)
     {
       gfloat min_height;
@@ -1059,6 +1102,13 @@ mx_box_layout_allocate (ClutterActor          *actor,
         allocate_pref = TRUE;
     }
 
+  n_children = priv->children->len;
+  n_expand_children = priv->n_expand_children;
+
+  /* We have no visible children, so bail out */
+  if (n_children == 0)
+    return;
+
   /* remove the padding values from the available and preferred sizes so we
    * can use them for allocating the children */
   avail_width -= padding.left + padding.right;
@@ -1092,24 +1142,17 @@ mx_box_layout_allocate (ClutterActor          *actor,
   else
     position = padding.left;
 
-  clutter_actor_iter_init (&iter, actor);
-  while (clutter_actor_iter_next (&iter, &child))
+  for (i = 0; i < priv->children->len; i++)
     {
+      MxBoxLayoutChildInfo *info =
+        &g_array_index (priv->children, MxBoxLayoutChildInfo, i);
       ClutterActorBox child_box, old_child_box;
-      gfloat child_nat, child_min;
-      MxBoxLayoutChild *meta;
-
-      if (!CLUTTER_ACTOR_IS_VISIBLE (child))
-        continue;
-
-      meta = (MxBoxLayoutChild*)
-        clutter_container_get_child_meta ((ClutterContainer *) actor, child);
+      MxBoxLayoutChild *meta = info->meta;
+      ClutterActor *child = info->child;
+      gfloat child_nat = info->pref_size;
 
       if (priv->orientation == MX_ORIENTATION_VERTICAL)
         {
-          clutter_actor_get_preferred_height (child, avail_width,
-                                              &child_min, &child_nat);
-
           child_box.y1 = position;
 
           if (allocate_pref && meta->expand)
@@ -1122,9 +1165,6 @@ mx_box_layout_allocate (ClutterActor          *actor,
         }
       else
         {
-          clutter_actor_get_preferred_width (child, avail_height,
-                                             &child_min, &child_nat);
-
           child_box.x1 = position;
 
           if (allocate_pref && meta->expand)
@@ -1144,67 +1184,63 @@ mx_box_layout_allocate (ClutterActor          *actor,
       mx_allocate_align_fill (child, &child_box, meta->x_align, meta->y_align,
                               meta->x_fill, meta->y_fill);
 
+      info->box = child_box;
+      info->skip = FALSE;
+
       if (priv->is_animating)
         {
-          ClutterActorBox *start, *end, now;
+          ClutterActorBox *start, *end;
           gdouble alpha;
 
           start = g_hash_table_lookup (priv->start_allocations, child);
           end = &child_box;
           alpha = clutter_timeline_get_progress (priv->timeline);
 
-          if (!start)
+          /* if it isn't known where this actor was from (possibly recently
+           * added), just allocate the end co-ordinates */
+          if (start)
             {
-              /* don't know where this actor was from (possibly recently
-               * added), so just allocate the end co-ordinates */
-              boxes = g_list_prepend (boxes,
-                                      mx_box_layout_child_info_new (child,
-                                                                    child_nat,
-                                                                    child_min,
-                                                                    end));
-              goto next;
+              info->box.x1 = (int) (start->x1 + (end->x1 - start->x1) * alpha);
+              info->box.x2 = (int) (start->x2 + (end->x2 - start->x2) * alpha);
+              info->box.y1 = (int) (start->y1 + (end->y1 - start->y1) * alpha);
+              info->box.y2 = (int) (start->y2 + (end->y2 - start->y2) * alpha);
             }
-
-          now.x1 = (int) (start->x1 + (end->x1 - start->x1) * alpha);
-          now.x2 = (int) (start->x2 + (end->x2 - start->x2) * alpha);
-          now.y1 = (int) (start->y1 + (end->y1 - start->y1) * alpha);
-          now.y2 = (int) (start->y2 + (end->y2 - start->y2) * alpha);
-
-          boxes = g_list_prepend (boxes,
-                                  mx_box_layout_child_info_new (child,
-                                                                child_nat,
-                                                                child_min,
-                                                                &now));
         }
-      else
+      else if (priv->enable_animations)
         {
           /* store the allocations in case an animation is needed soon */
-          ClutterActorBox *copy;
+          g_hash_table_insert (priv->start_allocations, child,
+                               g_boxed_copy (CLUTTER_TYPE_ACTOR_BOX,
+                                             &child_box));
+        }
 
-          /* update the value in the hash table */
-          if (priv->enable_animations)
+      /* the children are placed in order, in slots that don't overlap */
+      if (allocate_pref && !priv->is_animating)
+        {
+          MxBoxLayoutChildExtent extent;
+
+          extent.child = child;
+          if (priv->orientation == MX_ORIENTATION_VERTICAL)
             {
-              copy = g_boxed_copy (CLUTTER_TYPE_ACTOR_BOX, &child_box);
-              g_hash_table_insert (priv->start_allocations, child, copy);
+              extent.start = old_child_box.y1;
+              extent.end = old_child_box.y2;
             }
           else
             {
-              copy = &child_box;
+              extent.start = old_child_box.x1;
+              extent.end = old_child_box.x2;
             }
-
-          boxes = g_list_prepend (boxes,
-                                  mx_box_layout_child_info_new (child,
-                                                                child_nat,
-                                                                child_min,
-                                                                copy));
+          g_array_append_val (priv->child_index, extent);
         }
-next:
+
       if (priv->orientation == MX_ORIENTATION_VERTICAL)
         position += (old_child_box.y2 - old_child_box.y1) + priv->spacing;
       else
         position += (old_child_box.x2 - old_child_box.x1) + priv->spacing;
     }
 
+  priv->child_index_valid = allocate_pref && !priv->is_animating;
+
   actual_size += priv->spacing * (n_children - 1);
 
   /* reduce the child boxes */
@@ -1212,10 +1248,6 @@ next:
     {
       gint n_children_remaining;
 
-      /* elements in the boxes list are prepended when added, so the last item
-       * is the first child */
-      GList *start_at = g_list_last (boxes);
-
       /* target is avail_size, current size is actual_size */
       gfloat avail_size;
 
@@ -1226,7 +1258,7 @@ next:
 
 
       /* the number of children that are still able to be reduced in size */
-      n_children_remaining = g_list_length (boxes);
+      n_children_remaining = n_children;
 
 
       while (actual_size > avail_size && n_children_remaining > 0)
@@ -1235,14 +1267,15 @@ next:
 
           /* iterate over the children, reducing the size of those that can be
            * reduced and repositions the next actor to accommodate */
-          for (l = start_at; l; l = g_list_previous (l))
+          for (i = 0; i < priv->children->len; i++)
             {
-              MxBoxLayoutChildInfo *info = l->data;
+              MxBoxLayoutChildInfo *info =
+                &g_array_index (priv->children, MxBoxLayoutChildInfo, i);
 
               if (priv->orientation == MX_ORIENTATION_HORIZONTAL)
                 {
-                  info->box->x2 += new_pos;
-                  info->box->x1 += new_pos;
+                  info->box.x2 += new_pos;
+                  info->box.x1 += new_pos;
 
                   if (info->skip)
                     continue;
@@ -1253,10 +1286,10 @@ next:
                   if (actual_size <= avail_size)
                     continue;
 
-                  if (info->box->x2 - info->box->x1 > info->min_size)
+                  if (info->box.x2 - info->box.x1 > info->min_size)
                     {
                       actual_size--;
-                      info->box->x2--;
+                      info->box.x2--;
                       new_pos--;
                     }
                   else
@@ -1267,8 +1300,8 @@ next:
                 }
               else /* orientation == MX_ORIENTATION_VERTICAL */
                 {
-                  info->box->y2 += new_pos;
-                  info->box->y1 += new_pos;
+                  info->box.y2 += new_pos;
+                  info->box.y1 += new_pos;
 
                   if (info->skip)
                     continue;
@@ -1279,10 +1312,10 @@ next:
                   if (actual_size <= avail_size)
                     continue;
 
-                  if (info->box->y2 - info->box->y1 > info->min_size)
+                  if (info->box.y2 - info->box.y1 > info->min_size)
                     {
                       actual_size--;
-                      info->box->y2--;
+                      info->box.y2--;
                       new_pos--;
                     }
                   else
@@ -1295,15 +1328,39 @@ next:
         }
     }
 
-  /* finally, allocate the children */
-  for (l = boxes; l; l = g_list_next (l))
+  /* finally, allocate the children. Those that keep their box and don't
+   * need an allocation of their own are left alone, so that changing the
+   * size of one child only allocates the children it moves */
+  for (i = 0; i < priv->children->len; i++)
     {
-      MxBoxLayoutChildInfo *info = l->data;
+      MxBoxLayoutChildInfo *info =
+        &g_array_index (priv->children, MxBoxLayoutChildInfo, i);
+
+      if (!(flags & CLUTTER_ABSOLUTE_ORIGIN_CHANGED) &&
+          !clutter_actor_needs_allocation (info->child))
+        {
+          ClutterActorBox old_box;
 
-      clutter_actor_allocate (info->child, info->box, flags);
+          clutter_actor_get_allocation_box (info->child, &old_box);
+          if (clutter_actor_box_equal (&old_box, &info->box))
+            continue;
+        }
+
+      clutter_actor_allocate (info->child, &info->box, flags);
     }
+}
 
-  g_list_free_full (boxes, (GDestroyNotify) mx_box_layout_child_info_free);
+/* Forgets the measured children whenever a relayout is queued, as one is
+ * when a child changes size, is added, removed, shown or hidden, or one of
+ * its layout properties is set */
+static void
+mx_box_layout_queue_relayout (ClutterActor *actor)
+{
+  MxBoxLayoutPrivate *priv = MX_BOX_LAYOUT (actor)->priv;
+
+  priv->children_valid = FALSE;
+
+  CLUTTER_ACTOR_CLASS (mx_box_layout_parent_class)->queue_relayout (actor);
 }
 
 static void
@@ -1351,18 +1408,34 @@ mx_box_layout_get_paint_volume (ClutterActor       *actor,
   return TRUE;
 }
 
+static gboolean
+mx_box_layout_child_in_view (ClutterActor          *child,
+                             const ClutterActorBox *box_b)
+{
+  ClutterActorBox child_b;
+
+  if (!CLUTTER_ACTOR_IS_VISIBLE (child))
+    return FALSE;
+
+  clutter_actor_get_allocation_box (child, &child_b);
+
+  return ((child_b.x1 < box_b->x2) &&
+          (child_b.x2 > box_b->x1) &&
+          (child_b.y1 < box_b->y2) &&
+          (child_b.y2 > box_b->y1));
+}
+
+/* Paints the children that are in view, which is also how they are
+ * picked */
 static void
-mx_box_layout_paint (ClutterActor *actor)
+mx_box_layout_paint_children (ClutterActor *actor)
 {
   MxBoxLayoutPrivate *priv = MX_BOX_LAYOUT (actor)->priv;
   gdouble x, y;
-  ClutterActorBox child_b;
   ClutterActorBox box_b;
   ClutterActor *child;
   ClutterActorIter iter;
 
-  CLUTTER_ACTOR_CLASS (mx_box_layout_parent_class)->paint (actor);
-
   if (clutter_actor_get_n_children (actor) == 0)
     return;
 
@@ -1382,72 +1455,75 @@ mx_box_layout_paint (ClutterActor *actor)
   box_b.y2 = (box_b.y2 - box_b.y1) + y;
   box_b.y1 = y;
 
-  clutter_actor_iter_init (&iter, actor);
-  while (clutter_actor_iter_next (&iter, &child))
+  if (priv->child_index_valid)
     {
-      if (!CLUTTER_ACTOR_IS_VISIBLE (child))
-        continue;
-
-      clutter_actor_get_allocation_box (child, &child_b);
+      GArray *extents = priv->child_index;
+      gfloat view_start, view_end;
+      guint low, high;
 
-      if ((child_b.x1 < box_b.x2) &&
-          (child_b.x2 > box_b.x1) &&
-          (child_b.y1 < box_b.y2) &&
-          (child_b.y2 > box_b.y1))
+      if (priv->orientation == MX_ORIENTATION_VERTICAL)
         {
-          clutter_actor_paint (child);
+          view_start = box_b.y1;
+          view_end = box_b.y2;
+        }
+      else
+        {
+          view_start = box_b.x1;
+          view_end = box_b.x2;
         }
-    }
-}
 
-static void
-mx_box_layout_pick (ClutterActor       *actor,
-                    const ClutterColor *color)
-{
-  MxBoxLayoutPrivate *priv = MX_BOX_LAYOUT (actor)->priv;
-  ClutterActor *child;
-  ClutterActorIter iter;
-  gdouble x, y;
-  ClutterActorBox child_b;
-  ClutterActorBox box_b;
+      /* find the first child that ends after the start of the view */
+      low = 0;
+      high = extents->len;
+      while (low < high)
+        {
+          guint mid = (low + high) / 2;
 
-  CLUTTER_ACTOR_CLASS (mx_box_layout_parent_class)->pick (actor, color);
+          if (g_array_index (extents, MxBoxLayoutChildExtent, mid).end <=
+              view_start)
+            low = mid + 1;
+          else
+            high = mid;
+        }
 
-  if (clutter_actor_get_n_children (actor) == 0)
-    return;
+      for (; low < extents->len; low++)
+        {
+          MxBoxLayoutChildExtent *extent =
+            &g_array_index (extents, MxBoxLayoutChildExtent, low);
 
-  if (priv->hadjustment)
-    x = mx_adjustment_get_value (priv->hadjustment);
-  else
-    x = 0;
+          if (extent->start >= view_end)
+            break;
 
-  if (priv->vadjustment)
-    y = mx_adjustment_get_value (priv->vadjustment);
-  else
-    y = 0;
+          if (mx_box_layout_child_in_view (extent->child, &box_b))
+            clutter_actor_paint (extent->child);
+        }
 
-  clutter_actor_get_allocation_box (actor, &box_b);
-  box_b.x2 = (box_b.x2 - box_b.x1) + x;
-  box_b.x1 = x;
-  box_b.y2 = (box_b.y2 - box_b.y1) + y;
-  box_b.y1 = y;
+      return;
+    }
 
   clutter_actor_iter_init (&iter, actor);
   while (clutter_actor_iter_next (&iter, &child))
     {
-      if (!CLUTTER_ACTOR_IS_VISIBLE (child))
-        continue;
+      if (mx_box_layout_child_in_view (child, &box_b))
+        clutter_actor_paint (child);
+    }
+}
 
-      clutter_actor_get_allocation_box (child, &child_b);
+static void
+mx_box_layout_paint (ClutterActor *actor)
+{
+  CLUTTER_ACTOR_CLASS (mx_box_layout_parent_class)->paint (actor);
 
-      if ((child_b.x1 < box_b.x2)
-          && (child_b.x2 > box_b.x1)
-          && (child_b.y1 < box_b.y2)
-          && (child_b.y2 > box_b.y1))
-        {
-          clutter_actor_paint (child);
-        }
-    }
+  mx_box_layout_paint_children (actor);
+}
+
+static void
+mx_box_layout_pick (ClutterActor       *actor,
+                    const ClutterColor *color)
+{
+  CLUTTER_ACTOR_CLASS (mx_box_layout_parent_class)->pick (actor, color);
+
+  mx_box_layout_paint_children (actor);
 }
 
 static void
@@ -1468,6 +1544,7 @@ mx_box_layout_class_init (MxBoxLayoutClass *klass)
   actor_class->get_preferred_width = mx_box_layout_get_preferred_width;
   actor_class->get_preferred_height = mx_box_layout_get_preferred_height;
   actor_class->apply_transform = mx_box_layout_apply_transform;
+  actor_class->queue_relayout = mx_box_layout_queue_relayout;
   actor_class->get_paint_volume = mx_box_layout_get_paint_volume;
 
   actor_class->paint = mx_box_layout_paint;
@@ -1546,6 +1623,10 @@ mx_box_layout_init (MxBoxLayout *self)
 {
   self->priv = BOX_LAYOUT_PRIVATE (self);
 
+  self->priv->child_index = g_array_new (FALSE, FALSE,
+                                         sizeof (MxBoxLayoutChildExtent));
+  self->priv->children = g_array_new (FALSE, FALSE,
+                                      sizeof (MxBoxLayoutChildInfo));
 
   self->priv->start_allocations = g_hash_table_new_full (g_direct_hash,
                                                          g_direct_equal,
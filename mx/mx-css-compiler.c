@@ -0,0 +1,101 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*- */
+/*
+ * Copyright 2012 Intel Corporation.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU Lesser General Public License,
+ * version 2.1, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+ * Boston, MA 02111-1307, USA.
+ *
+ */
+
+/*
+ * Compiles a CSS style sheet into the binary format that MxStyle maps
+ * instead of parsing the CSS. By default the output is written next to the
+ * style sheet, where mx_style_load_from_file() looks for it; install it
+ * after the style sheet. The compiled style sheet is only used while the
+ * CSS it was compiled from is unchanged.
+ *
+ * Usage: mx-css-compiler STYLE-SHEET [OUTPUT]
+ *
+ * The compiler is linked against mx-css.c rather than libmx, as it compiles
+ * the default style sheet that libmx embeds. Compiling does not match
+ * selectors against actors, so the few libmx functions mx-css.c uses for
+ * that are provided here.
+ */
+
+#include "mx-css.h"
+#include <stdlib.h>
+
+gboolean
+_mx_debug (gint debug)
+{
+  return FALSE;
+}
+
+GType
+mx_stylable_get_type (void)
+{
+  g_assert_not_reached ();
+  return G_TYPE_INVALID;
+}
+
+const MxStylableQuarks *
+_mx_stylable_get_quarks (MxStylable *stylable)
+{
+  g_assert_not_reached ();
+  return NULL;
+}
+
+const gchar *
+mx_stylable_get_style_class (MxStylable *stylable)
+{
+  g_assert_not_reached ();
+  return NULL;
+}
+
+const gchar *
+mx_stylable_get_style_pseudo_class (MxStylable *stylable)
+{
+  g_assert_not_reached ();
+  return NULL;
+}
+
+int
+main (int argc, char **argv)
+{
+  GError *error = NULL;
+  gchar *output;
+
+  if (argc < 2 || argc > 3)
+    {
+      g_printerr ("Usage: %s STYLE-SHEET [OUTPUT]\n", argv[0]);
+      return EXIT_FAILURE;
+    }
+
+  if (argc > 2)
+    output = g_strdup (argv[2]);
+  else
+    output = g_strconcat (argv[1], MX_STYLE_SHEET_COMPILED_SUFFIX, NULL);
+
+  if (!mx_style_sheet_compile (argv[1], output, &error))
+    {
+      g_printerr ("Unable to compile '%s': %s\n", argv[1], error->message);
+      g_error_free (error);
+      g_free (output);
+      return EXIT_FAILURE;
+    }
+
+  g_free (output);
+
+  return EXIT_SUCCESS;
+}
@@ -19,10 +19,14 @@
  */
 #include "mx-css.h"
 #include <clutter/clutter.h>
+#include <stdlib.h>
 #include <string.h>
 
+#include <errno.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <glib/gstdio.h>
+#include <gio/gio.h>
 
 #include "mx-private.h"
 
@@ -30,6 +34,23 @@ struct _MxStyleSheet
 {
   GList *selectors;
   GList *filenames;
+
+  /* Index of the selectors, bucketed by the most specific part of their
+   * rightmost simple selector. Each selector appears in exactly one bucket.
+   */
+  GHashTable *id_index;
+  GHashTable *class_index;
+  GHashTable *type_index;
+  GPtrArray  *universal;
+
+  /* Set of the ids, classes and pseudo-classes referenced by selectors that
+   * match a parent or ancestor. Changes to any other state of a stylable
+   * cannot change which selectors match its descendants.
+   */
+  GHashTable *ancestor_quarks;
+
+  /* compiled style sheets the selectors of which point into, by id */
+  GHashTable *compiled;
 };
 
 typedef struct _MxSelector MxSelector;
@@ -39,6 +60,14 @@ struct _MxSelector
   gchar *id;
   gchar *class;
   gchar *pseudo_class;
+
+  /* compiled form of the above, used for matching */
+  GType   type_id; /* resolved on first use, as the type may not exist yet */
+  GQuark  id_quark;
+  GQuark  class_quark;
+  GQuark *pseudo_classes; /* sorted */
+  guint   n_pseudo_classes;
+
   MxSelector *parent;
   MxSelector *ancestor;
   GHashTable *style;
@@ -46,6 +75,9 @@ struct _MxSelector
   guint line;
   guint position;
   gint priority;
+
+  /* whether the strings are owned by a compiled style sheet */
+  gboolean compiled;
 };
 
 
@@ -217,6 +249,34 @@ css_parse_style (GScanner *scanner, GHashTable *table)
 }
 
 
+static void
+css_compile_simple_selector (MxSelector *selector)
+{
+  if (selector->id)
+    selector->id_quark = g_quark_from_string (selector->id);
+
+  if (selector->class)
+    selector->class_quark = g_quark_from_string (selector->class);
+
+  if (selector->pseudo_class)
+    {
+      gchar **list;
+      guint i, n;
+
+      list = g_strsplit (selector->pseudo_class, ":", -1);
+      n = g_strv_length (list);
+
+      selector->pseudo_classes = g_new (GQuark, n);
+      for (i = 0; i < n; i++)
+        selector->pseudo_classes[i] = g_quark_from_string (list[i]);
+      selector->n_pseudo_classes = n;
+
+      g_strfreev (list);
+
+      qsort (selector->pseudo_classes, n, sizeof (GQuark), _mx_quark_compare);
+    }
+}
+
 static GTokenType
 css_parse_simple_selector (GScanner      *scanner,
                            MxSelector    *selector)
@@ -284,11 +344,15 @@ css_parse_simple_selector (GScanner      *scanner,
 
           /* unhandled */
         default:
+          css_compile_simple_selector (selector);
           return G_TOKEN_NONE;
           break;
         }
       token = g_scanner_peek_next_token (scanner);
     }
+
+  css_compile_simple_selector (selector);
+
   return G_TOKEN_NONE;
 }
 
@@ -373,10 +437,14 @@ mx_selector_free (MxSelector *selector)
   if (!selector)
     return;
 
-  g_free (selector->type);
-  g_free (selector->id);
-  g_free (selector->class);
-  g_free (selector->pseudo_class);
+  if (!selector->compiled)
+    {
+      g_free (selector->type);
+      g_free (selector->id);
+      g_free (selector->class);
+      g_free (selector->pseudo_class);
+    }
+  g_free (selector->pseudo_classes);
 
   g_hash_table_unref (selector->style);
 
@@ -518,6 +586,90 @@ css_parse_block (GScanner *scanner, GList **selectors)
 }
 
 
+static void
+mx_style_sheet_index_ancestor_selector (MxStyleSheet *sheet,
+                                        MxSelector   *selector)
+{
+  guint i;
+
+  if (!selector)
+    return;
+
+  if (selector->id_quark)
+    g_hash_table_add (sheet->ancestor_quarks,
+                      GUINT_TO_POINTER (selector->id_quark));
+
+  if (selector->class_quark)
+    g_hash_table_add (sheet->ancestor_quarks,
+                      GUINT_TO_POINTER (selector->class_quark));
+
+  for (i = 0; i < selector->n_pseudo_classes; i++)
+    g_hash_table_add (sheet->ancestor_quarks,
+                      GUINT_TO_POINTER (selector->pseudo_classes[i]));
+
+  mx_style_sheet_index_ancestor_selector (sheet, selector->parent);
+  mx_style_sheet_index_ancestor_selector (sheet, selector->ancestor);
+}
+
+static void
+mx_style_sheet_index_selector (MxStyleSheet *sheet,
+                               MxSelector   *selector)
+{
+  GHashTable *index;
+  GPtrArray *bucket;
+  gconstpointer key;
+
+  mx_style_sheet_index_ancestor_selector (sheet, selector->parent);
+  mx_style_sheet_index_ancestor_selector (sheet, selector->ancestor);
+
+  /* pick the bucket that will be the smallest for this selector; the type
+   * name is owned by the selector, which outlives its index entry */
+  if (selector->id_quark)
+    {
+      index = sheet->id_index;
+      key = GUINT_TO_POINTER (selector->id_quark);
+    }
+  else if (selector->class_quark)
+    {
+      index = sheet->class_index;
+      key = GUINT_TO_POINTER (selector->class_quark);
+    }
+  else if (selector->type && selector->type[0] != '*')
+    {
+      index = sheet->type_index;
+      key = selector->type;
+    }
+  else
+    {
+      g_ptr_array_add (sheet->universal, selector);
+      return;
+    }
+
+  bucket = g_hash_table_lookup (index, key);
+  if (!bucket)
+    {
+      bucket = g_ptr_array_new ();
+      g_hash_table_insert (index, (gpointer) key, bucket);
+    }
+
+  g_ptr_array_add (bucket, selector);
+}
+
+static void
+mx_style_sheet_rebuild_index (MxStyleSheet *sheet)
+{
+  GList *l;
+
+  g_hash_table_remove_all (sheet->id_index);
+  g_hash_table_remove_all (sheet->class_index);
+  g_hash_table_remove_all (sheet->type_index);
+  g_ptr_array_set_size (sheet->universal, 0);
+  g_hash_table_remove_all (sheet->ancestor_quarks);
+
+  for (l = sheet->selectors; l; l = l->next)
+    mx_style_sheet_index_selector (sheet, l->data);
+}
+
 static gboolean
 css_parse_file (MxStyleSheet *sheet,
                 gchar        *filename,
@@ -527,6 +679,7 @@ css_parse_file (MxStyleSheet *sheet,
   GScanner *scanner;
   int fd;
   GTokenType token;
+  GList *l, *last;
 
   if (!data)
     {
@@ -555,6 +708,8 @@ css_parse_file (MxStyleSheet *sheet,
 
 
 
+  last = g_list_last (sheet->selectors);
+
   token = g_scanner_peek_next_token (scanner);
   while (token != G_TOKEN_EOF)
     {
@@ -565,6 +720,11 @@ css_parse_file (MxStyleSheet *sheet,
       token = g_scanner_peek_next_token (scanner);
     }
 
+  /* add the newly parsed selectors to the index, including those parsed
+   * before any error, since they are kept in the list too */
+  for (l = last ? last->next : sheet->selectors; l; l = l->next)
+    mx_style_sheet_index_selector (sheet, l->data);
+
   if (token != G_TOKEN_EOF)
     g_scanner_unexp_token (scanner, token, NULL, NULL, NULL, "Error",
                            TRUE);
@@ -579,45 +739,6 @@ css_parse_file (MxStyleSheet *sheet,
     return FALSE;
 }
 
-static gboolean
-list_contains (const gchar *needle,
-               gint         needle_len,
-               const gchar *haystack,
-               gchar        seperator)
-{
-  const gchar *start;
-
-  for (start = haystack; start; start = strchr (start, seperator))
-    {
-      gint len;
-      gchar *next_seperator;
-
-      /* move to the character after the separator */
-      if (start[0] == seperator)
-        start = start + 1;
-
-      /* find the end of this haystack item */
-      next_seperator = strchr (start, seperator);
-      if (!next_seperator)
-        len = strlen (start);
-      else
-        len = next_seperator - start;
-
-      /* if the item in the haystack is not the same length as the separator,
-       * then it is not a match */
-      if (len != needle_len)
-        continue;
-
-      if (!strncmp (needle, start, needle_len))
-        return TRUE;
-      else
-        continue;
-    }
-
-  /* needle not found */
-  return FALSE;
-}
-
 static gint
 css_node_matches_selector (MxSelector *selector,
                            MxStylable *stylable)
@@ -625,9 +746,7 @@ css_node_matches_selector (MxSelector *selector,
   gint score;
   gint a, b, c;
 
-  const gchar *type = "*";
-  const gchar *class, *pseudo_class;
-  const gchar *id;
+  const MxStylableQuarks *quarks;
   ClutterActor *actor;
   MxStylable *parent;
 
@@ -635,10 +754,8 @@ css_node_matches_selector (MxSelector *selector,
   b = 0;
   c = 0;
 
-  /* get properties for this stylable */
-  id = clutter_actor_get_name (CLUTTER_ACTOR (stylable));
-  class = mx_stylable_get_style_class (stylable);
-  pseudo_class = mx_stylable_get_style_pseudo_class (stylable);
+  /* get the interned properties for this stylable */
+  quarks = _mx_stylable_get_quarks (stylable);
 
   /* check type */
   if (selector->type == NULL || selector->type[0] == '*')
@@ -648,94 +765,72 @@ css_node_matches_selector (MxSelector *selector,
   else
     {
       GType type_id;
-      gint matched;
       gint depth;
 
-      type_id = G_OBJECT_CLASS_TYPE (G_OBJECT_GET_CLASS (stylable));
-      type = g_type_name (type_id);
-      matched = FALSE;
+      /* if the type does not exist yet, no stylable can be an instance of
+       * it */
+      if (G_UNLIKELY (!selector->type_id))
+        {
+          selector->type_id = g_type_from_name (selector->type);
+          if (!selector->type_id)
+            return -1;
+        }
 
       depth = 10;
-      while (type)
+      for (type_id = G_OBJECT_TYPE (stylable); type_id;
+           type_id = g_type_parent (type_id))
         {
-          if (!strcmp (selector->type, type))
-            {
-              matched = depth;
-              break;
-            }
-          else
-            {
-              type_id = g_type_parent (type_id);
-              type = g_type_name (type_id);
-              if (depth > 1)
-                depth--;
-            }
+          if (type_id == selector->type_id)
+            break;
+
+          if (depth > 1)
+            depth--;
         }
 
-      if (!matched)
+      if (!type_id)
         return -1;
       else
         c += depth;
     }
 
   /* check id */
-  if (selector->id)
+  if (selector->id_quark)
     {
-      if (!id || strcmp (selector->id, id))
+      if (selector->id_quark != quarks->id)
         return -1;
       else
         a += 10;
     }
 
   /* check pseudo_class */
-  if (selector->pseudo_class)
+  if (selector->n_pseudo_classes)
     {
-      gchar *needle;
-      gint n_matches;
-
-      /* if no pseudo class is supplied on the node, return instantly */
-      if (!pseudo_class)
-        return -1;
+      guint i, j;
 
       /* check that each pseudo-class from the selector appears in the
        * pseudo-classes from the node, i.e. the selector pseudo-class list
-       * is a subset of the node's pseudo-class list */
-      n_matches = 0;
-      for (needle = selector->pseudo_class;
-           needle; needle = strchr (needle, ':'))
+       * is a subset of the node's pseudo-class list. Both lists are sorted,
+       * so they can be walked in step. */
+      for (i = 0, j = 0; i < selector->n_pseudo_classes; i++)
         {
-          gint needle_len;
-          gchar *next;
-
-          /* move beyond ':' */
-          if (needle[0] == ':')
-            needle++;
-
-          /* calculate the length of this needle */
-          next = strchr (needle, ':');
-          if (next)
-            needle_len = next - needle;
-          else
-            needle_len = strlen (needle);
+          while (j < quarks->n_pseudo_classes &&
+                 quarks->pseudo_classes[j] < selector->pseudo_classes[i])
+            j++;
 
-          /* if the pseudo-class from the selector does not appear in the
-           * list of pseudo-classes from the node, then this is not a
-           * match */
-          if (!list_contains (needle, needle_len, pseudo_class, ':'))
+          if (j == quarks->n_pseudo_classes ||
+              quarks->pseudo_classes[j] != selector->pseudo_classes[i])
             return -1;
-          else
-            n_matches++;
         }
 
       /* increase the 'b' score by the number of pseudo-classes in the
        * selector */
-      b = b + (10 * n_matches);
+      b = b + (10 * selector->n_pseudo_classes);
     }
 
   /* check class */
-  if (selector->class)
+  if (selector->class_quark)
     {
-      if (!class || strcmp (selector->class, class))
+      if (selector->class_quark != quarks->style_class)
         return -1;
       else
         b += 10;
@@ -862,14 +957,45 @@ free_selector_match (SelectorMatch *data)
   g_slice_free (SelectorMatch, data);
 }
 
+static GList *
+css_match_bucket (GPtrArray  *bucket,
+                  MxStylable *node,
+                  GList      *matching_selectors)
+{
+  guint i;
+
+  if (!bucket)
+    return matching_selectors;
+
+  for (i = 0; i < bucket->len; i++)
+    {
+      MxSelector *selector = g_ptr_array_index (bucket, i);
+      gint score;
+
+      score = css_node_matches_selector (selector, node);
+
+      if (score >= 0)
+        {
+          SelectorMatch *selector_match = g_slice_new (SelectorMatch);
+          selector_match->selector = selector;
+          selector_match->score = score;
+          matching_selectors = g_list_prepend (matching_selectors,
+                                               selector_match);
+        }
+    }
+
+  return matching_selectors;
+}
+
 GHashTable *
 mx_style_sheet_get_properties (MxStyleSheet *sheet,
                                MxStylable   *node)
 {
   GTimer *timer = NULL;
   GList *l, *matching_selectors = NULL;
-  SelectorMatch *selector_match = NULL;
   GHashTable *result;
+  const MxStylableQuarks *quarks;
+  GType type_id;
 
   if (_mx_debug (MX_DEBUG_CSS))
     {
@@ -891,22 +1017,30 @@ mx_style_sheet_get_properties (MxStyleSheet *sheet,
       g_print ("\x1b[22m");
     }
 
-  /* find matching selectors */
-  for (l = sheet->selectors; l; l = l->next)
-    {
-      gint score;
+  /* find matching selectors, only testing the buckets that could match */
+  quarks = _mx_stylable_get_quarks (node);
 
-      score = css_node_matches_selector (l->data, node);
+  if (quarks->id)
+    matching_selectors =
+      css_match_bucket (g_hash_table_lookup (sheet->id_index,
+                                             GUINT_TO_POINTER (quarks->id)),
+                        node, matching_selectors);
 
-      if (score >= 0)
-        {
-          selector_match = g_slice_new (SelectorMatch);
-          selector_match->selector = l->data;
-          selector_match->score = score;
-          matching_selectors = g_list_prepend (matching_selectors,
-                                               selector_match);
-        }
-    }
+  if (quarks->style_class)
+    matching_selectors =
+      css_match_bucket (g_hash_table_lookup (sheet->class_index,
+                                             GUINT_TO_POINTER (quarks->style_class)),
+                        node, matching_selectors);
+
+  for (type_id = G_OBJECT_TYPE (node); type_id;
+       type_id = g_type_parent (type_id))
+    matching_selectors =
+      css_match_bucket (g_hash_table_lookup (sheet->type_index,
+                                             g_type_name (type_id)),
+                        node, matching_selectors);
+
+  matching_selectors = css_match_bucket (sheet->universal, node,
+                                         matching_selectors);
 
   /* score the selectors by their score */
   matching_selectors = g_list_sort (matching_selectors,
@@ -946,18 +1080,719 @@ mx_style_sheet_get_properties (MxStyleSheet *sheet,
   return result;
 }
 
+static gboolean
+mx_style_sheet_quark_changed (MxStyleSheet *sheet,
+                              GQuark        old_quark,
+                              GQuark        new_quark)
+{
+  if (old_quark == new_quark)
+    return FALSE;
+
+  return ((old_quark &&
+           g_hash_table_contains (sheet->ancestor_quarks,
+                                  GUINT_TO_POINTER (old_quark))) ||
+          (new_quark &&
+           g_hash_table_contains (sheet->ancestor_quarks,
+                                  GUINT_TO_POINTER (new_quark))));
+}
+
+/* Checks whether a stylable changing from @old_state to @new_state can
+ * change the selectors that match any of its descendants.
+ */
+gboolean
+mx_style_sheet_affects_descendants (MxStyleSheet           *sheet,
+                                    const MxStylableQuarks *old_state,
+                                    const MxStylableQuarks *new_state)
+{
+  guint i, j;
+
+  if (mx_style_sheet_quark_changed (sheet, old_state->id, new_state->id) ||
+      mx_style_sheet_quark_changed (sheet, old_state->style_class,
+                                    new_state->style_class))
+    return TRUE;
+
+  /* walk both sorted pseudo-class lists in step, checking the ones that
+   * were added or removed */
+  i = j = 0;
+  while (i < old_state->n_pseudo_classes || j < new_state->n_pseudo_classes)
+    {
+      GQuark old_quark, new_quark;
+
+      old_quark = (i < old_state->n_pseudo_classes)
+        ? old_state->pseudo_classes[i] : G_MAXUINT32;
+      new_quark = (j < new_state->n_pseudo_classes)
+        ? new_state->pseudo_classes[j] : G_MAXUINT32;
+
+      if (old_quark == new_quark)
+        {
+          i++;
+          j++;
+        }
+      else if (old_quark < new_quark)
+        {
+          if (mx_style_sheet_quark_changed (sheet, old_quark, 0))
+            return TRUE;
+          i++;
+        }
+      else
+        {
+          if (mx_style_sheet_quark_changed (sheet, 0, new_quark))
+            return TRUE;
+          j++;
+        }
+    }
+
+  return FALSE;
+}
+
+/* the values point at the strings of the selector they were copied from,
+ * so values from the same rule compare equal by pointer */
+static gboolean
+mx_style_sheet_value_equal (const MxStyleSheetValue *a,
+                            const MxStyleSheetValue *b)
+{
+  return (a && b && a->string == b->string && a->source == b->source);
+}
+
+/* Returns the set of names of the properties that differ between @a and
+ * @b, two sets of properties returned by mx_style_sheet_get_properties(),
+ * or NULL if none do. The names are owned by @a and @b.
+ */
+GHashTable *
+mx_style_sheet_properties_diff (GHashTable *a,
+                                GHashTable *b)
+{
+  GHashTable *changed = NULL;
+  GHashTableIter iter;
+  gpointer key, value;
+
+  if (a == b)
+    return NULL;
+
+  g_hash_table_iter_init (&iter, a);
+  while (g_hash_table_iter_next (&iter, &key, &value))
+    if (!mx_style_sheet_value_equal (value, g_hash_table_lookup (b, key)))
+      {
+        if (!changed)
+          changed = g_hash_table_new (g_str_hash, g_str_equal);
+        g_hash_table_add (changed, key);
+      }
+
+  /* properties that were only set in @b */
+  g_hash_table_iter_init (&iter, b);
+  while (g_hash_table_iter_next (&iter, &key, NULL))
+    if (!g_hash_table_contains (a, key))
+      {
+        if (!changed)
+          changed = g_hash_table_new (g_str_hash, g_str_equal);
+        g_hash_table_add (changed, key);
+      }
+
+  return changed;
+}
+
+/* Compiled style sheets
+ *
+ * mx-css-compiler writes the selectors and declarations of a style sheet
+ * into a binary blob that can be mapped and turned into selectors without
+ * tokenising the CSS. All strings are stored once in a string pool at the
+ * end of the blob, and the selectors and declaration tables point straight
+ * into it.
+ *
+ * The blob records the size, modification time and a hash of the CSS it was
+ * compiled from, so that a stale blob can be detected and the CSS parsed
+ * instead. The CSS is only hashed when its size and modification time do
+ * not already show it to be current. The blob is written in host byte
+ * order; a blob with a different byte order or version is treated as stale.
+ *
+ * The selector index is not stored. It is keyed on quarks, which differ
+ * between processes, and on type names; so a stored index would still
+ * need a quark lookup and a table insertion per entry when it is loaded,
+ * which is all that indexing the roots as they are created costs.
+ */
+
+#define MX_COMPILED_MAGIC   "MXCSSBIN"
+#define MX_COMPILED_VERSION 1
+#define MX_COMPILED_BOM     0x01020304
+#define MX_COMPILED_NONE    G_MAXUINT32
+
+typedef struct
+{
+  gchar   magic[8];
+  guint32 version;
+  guint32 byte_order;
+
+  guint64 source_mtime;
+  guint32 source_size;
+  guint32 source_hash;
+
+  guint32 n_selectors;   /* all simple selectors */
+  guint32 n_roots;       /* rightmost simple selectors, in style sheet order */
+  guint32 n_styles;
+  guint32 n_properties;
+  guint32 strings_size;
+  guint32 padding;
+} MxCompiledHeader;
+
+/* Indices into the selector or style arrays, or offsets into the string
+ * pool, MX_COMPILED_NONE when not set */
+typedef struct
+{
+  guint32 type;
+  guint32 id;
+  guint32 class;
+  guint32 pseudo_class;
+
+  guint32 parent;
+  guint32 ancestor;
+  guint32 style;
+
+  guint32 line;
+  guint32 position;
+} MxCompiledSelector;
+
+typedef struct
+{
+  guint32 first_property;
+  guint32 n_properties;
+} MxCompiledStyle;
+
+typedef struct
+{
+  guint32 name;
+  guint32 value;
+} MxCompiledProperty;
+
+static guint32
+mx_compiled_hash (const gchar *data,
+                  gsize        size)
+{
+  guint32 hash = 5381;
+  gsize i;
+
+  for (i = 0; i < size; i++)
+    hash = hash * 33 + (guchar) data[i];
+
+  return hash;
+}
+
+typedef struct
+{
+  GHashTable *style_indices;
+  GHashTable *string_offsets;
+
+  GArray     *selectors;
+  GArray     *styles;
+  GArray     *properties;
+  GString    *strings;
+} MxCompiledWriter;
+
+static guint32
+mx_compiled_writer_add_string (MxCompiledWriter *writer,
+                               const gchar      *string)
+{
+  gpointer offset;
+
+  if (!string)
+    return MX_COMPILED_NONE;
+
+  if (g_hash_table_lookup_extended (writer->string_offsets, string,
+                                    NULL, &offset))
+    return GPOINTER_TO_UINT (offset);
+
+  offset = GUINT_TO_POINTER (writer->strings->len);
+  g_string_append_len (writer->strings, string, strlen (string) + 1);
+  g_hash_table_insert (writer->string_offsets, (gpointer) string, offset);
+
+  return GPOINTER_TO_UINT (offset);
+}
+
+static guint32
+mx_compiled_writer_add_style (MxCompiledWriter *writer,
+                              GHashTable       *style)
+{
+  MxCompiledStyle compiled_style;
+  GHashTableIter iter;
+  gpointer key, value, index;
+
+  if (!style)
+    return MX_COMPILED_NONE;
+
+  /* declaration blocks are shared by the selectors in a selector group */
+  if (g_hash_table_lookup_extended (writer->style_indices, style,
+                                    NULL, &index))
+    return GPOINTER_TO_UINT (index);
+
+  compiled_style.first_property = writer->properties->len;
+  compiled_style.n_properties = g_hash_table_size (style);
+
+  g_hash_table_iter_init (&iter, style);
+  while (g_hash_table_iter_next (&iter, &key, &value))
+    {
+      MxCompiledProperty property;
+
+      property.name = mx_compiled_writer_add_string (writer, key);
+      property.value = mx_compiled_writer_add_string (writer, value);
+      g_array_append_val (writer->properties, property);
+    }
+
+  index = GUINT_TO_POINTER (writer->styles->len);
+  g_array_append_val (writer->styles, compiled_style);
+  g_hash_table_insert (writer->style_indices, style, index);
+
+  return GPOINTER_TO_UINT (index);
+}
+
+static guint32
+mx_compiled_writer_add_selector (MxCompiledWriter *writer,
+                                 MxSelector       *selector)
+{
+  MxCompiledSelector compiled_selector;
+  guint32 index;
+
+  if (!selector)
+    return MX_COMPILED_NONE;
+
+  compiled_selector.type =
+    mx_compiled_writer_add_string (writer, selector->type);
+  compiled_selector.id =
+    mx_compiled_writer_add_string (writer, selector->id);
+  compiled_selector.class =
+    mx_compiled_writer_add_string (writer, selector->class);
+  compiled_selector.pseudo_class =
+    mx_compiled_writer_add_string (writer, selector->pseudo_class);
+  compiled_selector.parent =
+    mx_compiled_writer_add_selector (writer, selector->parent);
+  compiled_selector.ancestor =
+    mx_compiled_writer_add_selector (writer, selector->ancestor);
+  compiled_selector.style =
+    mx_compiled_writer_add_style (writer, selector->style);
+  compiled_selector.line = selector->line;
+  compiled_selector.position = selector->position;
+
+  index = writer->selectors->len;
+  g_array_append_val (writer->selectors, compiled_selector);
+
+  return index;
+}
+
+/* Compiles the style sheet in @filename into @output. The compiled style
+ * sheet is picked up by mx_style_sheet_add_from_compiled_file() when it is
+ * installed next to @filename with the suffix MX_STYLE_SHEET_COMPILED_SUFFIX.
+ */
+gboolean
+mx_style_sheet_compile (const gchar  *filename,
+                        const gchar  *output,
+                        GError      **error)
+{
+  MxCompiledWriter writer;
+  MxCompiledHeader header;
+  MxStyleSheet *sheet;
+  GArray *roots;
+  GString *blob;
+  GStatBuf st;
+  gchar *contents, *input_name;
+  gsize length;
+  gboolean result;
+  GList *l;
+
+  g_return_val_if_fail (filename != NULL, FALSE);
+  g_return_val_if_fail (output != NULL, FALSE);
+
+  if (!g_file_get_contents (filename, &contents, &length, error))
+    return FALSE;
+
+  if (g_stat (filename, &st) != 0)
+    {
+      g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (errno),
+                   "Could not stat '%s'", filename);
+      g_free (contents);
+      return FALSE;
+    }
+
+  sheet = mx_style_sheet_new ();
+  input_name = g_strdup (filename);
+  sheet->filenames = g_list_prepend (sheet->filenames, input_name);
+
+  if (!css_parse_file (sheet, input_name, contents, 0))
+    {
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                   "Could not parse '%s'", filename);
+      mx_style_sheet_destroy (sheet);
+      g_free (contents);
+      return FALSE;
+    }
+
+  writer.style_indices = g_hash_table_new (NULL, NULL);
+  writer.string_offsets = g_hash_table_new (g_str_hash, g_str_equal);
+  writer.selectors = g_array_new (FALSE, FALSE, sizeof (MxCompiledSelector));
+  writer.styles = g_array_new (FALSE, FALSE, sizeof (MxCompiledStyle));
+  writer.properties = g_array_new (FALSE, FALSE, sizeof (MxCompiledProperty));
+  writer.strings = g_string_new (NULL);
+  roots = g_array_new (FALSE, FALSE, sizeof (guint32));
+
+  for (l = sheet->selectors; l; l = l->next)
+    {
+      guint32 index = mx_compiled_writer_add_selector (&writer, l->data);
+      g_array_append_val (roots, index);
+    }
+
+  memset (&header, 0, sizeof (header));
+  memcpy (header.magic, MX_COMPILED_MAGIC, sizeof (header.magic));
+  header.version = MX_COMPILED_VERSION;
+  header.byte_order = MX_COMPILED_BOM;
+  header.source_mtime = st.st_mtime;
+  header.source_size = length;
+  header.source_hash = mx_compiled_hash (contents, length);
+  header.n_selectors = writer.selectors->len;
+  header.n_roots = roots->len;
+  header.n_styles = writer.styles->len;
+  header.n_properties = writer.properties->len;
+  header.strings_size = writer.strings->len;
+
+  blob = g_string_new_len ((const gchar *) &header, sizeof (header));
+  g_string_append_len (blob, writer.selectors->data,
+                       writer.selectors->len * sizeof (MxCompiledSelector));
+  g_string_append_len (blob, roots->data, roots->len * sizeof (guint32));
+  g_string_append_len (blob, writer.styles->data,
+                       writer.styles->len * sizeof (MxCompiledStyle));
+  g_string_append_len (blob, writer.properties->data,
+                       writer.properties->len * sizeof (MxCompiledProperty));
+  g_string_append_len (blob, writer.strings->str, writer.strings->len);
+
+  result = g_file_set_contents (output, blob->str, blob->len, error);
+
+  g_string_free (blob, TRUE);
+  g_array_free (roots, TRUE);
+  g_string_free (writer.strings, TRUE);
+  g_array_free (writer.properties, TRUE);
+  g_array_free (writer.styles, TRUE);
+  g_array_free (writer.selectors, TRUE);
+  g_hash_table_unref (writer.string_offsets);
+  g_hash_table_unref (writer.style_indices);
+
+  mx_style_sheet_destroy (sheet);
+  g_free (contents);
+
+  return result;
+}
+
+static gboolean
+mx_style_sheet_add_compiled (MxStyleSheet *sheet,
+                             const gchar  *id,
+                             GBytes       *bytes)
+{
+  const MxCompiledHeader *header;
+  const MxCompiledSelector *compiled_selectors;
+  const MxCompiledStyle *compiled_styles;
+  const MxCompiledProperty *compiled_properties;
+  const guint32 *roots;
+  const gchar *data, *strings;
+  GHashTable **styles;
+  MxSelector **selectors;
+  GPtrArray *blobs;
+  GList *roots_list;
+  gchar *input_name;
+  gsize size, expected_size;
+  gint priority;
+  guint i;
+
+  data = g_bytes_get_data (bytes, &size);
+  header = (const MxCompiledHeader *) data;
+
+  expected_size = sizeof (MxCompiledHeader)
+    + header->n_selectors * sizeof (MxCompiledSelector)
+    + header->n_roots * sizeof (guint32)
+    + header->n_styles * sizeof (MxCompiledStyle)
+    + header->n_properties * sizeof (MxCompiledProperty)
+    + header->strings_size;
+
+  if (size != expected_size ||
+      (header->strings_size && data[size - 1] != '\0'))
+    return FALSE;
+
+  compiled_selectors = (const MxCompiledSelector *) (header + 1);
+  roots = (const guint32 *) (compiled_selectors + header->n_selectors);
+  compiled_styles = (const MxCompiledStyle *) (roots + header->n_roots);
+  compiled_properties =
+    (const MxCompiledProperty *) (compiled_styles + header->n_styles);
+  strings = (const gchar *) (compiled_properties + header->n_properties);
+
+  /* check every index and offset before creating anything */
+#define CHECK_STRING(o) ((o) == MX_COMPILED_NONE || (o) < header->strings_size)
+#define CHECK_INDEX(i,n) ((i) == MX_COMPILED_NONE || (i) < (n))
+  for (i = 0; i < header->n_selectors; i++)
+    {
+      const MxCompiledSelector *s = &compiled_selectors[i];
+
+      if (!CHECK_STRING (s->type) || !CHECK_STRING (s->id) ||
+          !CHECK_STRING (s->class) || !CHECK_STRING (s->pseudo_class) ||
+          !CHECK_INDEX (s->parent, i) || !CHECK_INDEX (s->ancestor, i) ||
+          !CHECK_INDEX (s->style, header->n_styles))
+        return FALSE;
+    }
+  for (i = 0; i < header->n_roots; i++)
+    if (roots[i] >= header->n_selectors)
+      return FALSE;
+  for (i = 0; i < header->n_styles; i++)
+    if (compiled_styles[i].first_property > header->n_properties ||
+        compiled_styles[i].n_properties >
+        header->n_properties - compiled_styles[i].first_property)
+      return FALSE;
+  for (i = 0; i < header->n_properties; i++)
+    if (compiled_properties[i].name >= header->strings_size ||
+        compiled_properties[i].value >= header->strings_size)
+      return FALSE;
+#undef CHECK_INDEX
+#undef CHECK_STRING
+
+  input_name = g_strdup (id);
+  priority = g_list_length (sheet->filenames);
+  sheet->filenames = g_list_prepend (sheet->filenames, input_name);
+
+  /* the declarations point into the string pool, so the tables do not own
+   * their keys and values */
+  styles = g_new (GHashTable *, header->n_styles);
+  for (i = 0; i < header->n_styles; i++)
+    {
+      const MxCompiledProperty *property;
+      guint j;
+
+      styles[i] = g_hash_table_new (g_str_hash, g_direct_equal);
+
+      property = &compiled_properties[compiled_styles[i].first_property];
+      for (j = 0; j < compiled_styles[i].n_properties; j++, property++)
+        g_hash_table_insert (styles[i],
+                             (gpointer) (strings + property->name),
+                             (gpointer) (strings + property->value));
+    }
+
+#define STRING(o) (((o) == MX_COMPILED_NONE) ? NULL : (gchar *) strings + (o))
+  /* parents and ancestors are always written before the selectors that
+   * refer to them */
+  selectors = g_new (MxSelector *, header->n_selectors);
+  for (i = 0; i < header->n_selectors; i++)
+    {
+      const MxCompiledSelector *s = &compiled_selectors[i];
+      MxSelector *selector;
+
+      selector = mx_selector_new (input_name, priority, s->line, s->position);
+      selector->compiled = TRUE;
+      selector->type = STRING (s->type);
+      selector->id = STRING (s->id);
+      selector->class = STRING (s->class);
+      selector->pseudo_class = STRING (s->pseudo_class);
+
+      if (s->parent != MX_COMPILED_NONE)
+        selector->parent = selectors[s->parent];
+      if (s->ancestor != MX_COMPILED_NONE)
+        selector->ancestor = selectors[s->ancestor];
+      if (s->style != MX_COMPILED_NONE)
+        selector->style = g_hash_table_ref (styles[s->style]);
+
+      css_compile_simple_selector (selector);
+
+      selectors[i] = selector;
+    }
+#undef STRING
+
+  roots_list = NULL;
+  for (i = 0; i < header->n_roots; i++)
+    {
+      roots_list = g_list_prepend (roots_list, selectors[roots[i]]);
+      mx_style_sheet_index_selector (sheet, selectors[roots[i]]);
+    }
+  sheet->selectors = g_list_concat (sheet->selectors,
+                                    g_list_reverse (roots_list));
+
+  for (i = 0; i < header->n_styles; i++)
+    g_hash_table_unref (styles[i]);
+  g_free (styles);
+  g_free (selectors);
+
+  /* keep the data alive for as long as the selectors */
+  blobs = g_hash_table_lookup (sheet->compiled, id);
+  if (!blobs)
+    {
+      blobs = g_ptr_array_new_with_free_func ((GDestroyNotify) g_bytes_unref);
+      g_hash_table_insert (sheet->compiled, g_strdup (id), blobs);
+    }
+  g_ptr_array_add (blobs, g_bytes_ref (bytes));
+
+  MX_NOTE (CSS, "Loaded %u selectors from compiled style sheet for '%s'",
+           header->n_roots, id);
+
+  return TRUE;
+}
+
+static const MxCompiledHeader *
+mx_style_sheet_get_compiled_header (GBytes *bytes)
+{
+  const MxCompiledHeader *header;
+  gsize size;
+
+  header = g_bytes_get_data (bytes, &size);
+
+  if (size < sizeof (MxCompiledHeader) ||
+      memcmp (header->magic, MX_COMPILED_MAGIC, sizeof (header->magic)) ||
+      header->version != MX_COMPILED_VERSION ||
+      header->byte_order != MX_COMPILED_BOM)
+    return NULL;
+
+  return header;
+}
+
+static gboolean
+mx_style_sheet_compiled_is_current (const MxCompiledHeader *header,
+                                    const gchar            *filename,
+                                    const gchar            *compiled_filename)
+{
+  GStatBuf st, compiled_st;
+  gchar *contents;
+  gsize length;
+  gboolean result;
+
+  if (g_stat (filename, &st) != 0 ||
+      header->source_size != (guint64) st.st_size)
+    return FALSE;
+
+  /* the CSS has not changed if it still has the modification time it was
+   * compiled with. Installation does not usually preserve it, but installs
+   * the compiled style sheet after the CSS, so the CSS is only read and
+   * hashed when it has been modified after the compiled style sheet */
+  if (header->source_mtime == (guint64) st.st_mtime ||
+      (g_stat (compiled_filename, &compiled_st) == 0 &&
+       compiled_st.st_mtime >= st.st_mtime))
+    return TRUE;
+
+  if (!g_file_get_contents (filename, &contents, &length, NULL))
+    return FALSE;
+
+  result = (header->source_hash == mx_compiled_hash (contents, length));
+  g_free (contents);
+
+  return result;
+}
+
+/* Loads the compiled form of the style sheet @filename, if it exists and
+ * is up to date. Returns FALSE if the CSS needs to be parsed instead.
+ */
+gboolean
+mx_style_sheet_add_from_compiled_file (MxStyleSheet *sheet,
+                                       const gchar  *filename)
+{
+  const MxCompiledHeader *header;
+  GMappedFile *mapped_file;
+  GBytes *bytes;
+  gchar *compiled_filename;
+  gboolean result = FALSE;
+
+  g_return_val_if_fail (sheet != NULL, FALSE);
+  g_return_val_if_fail (filename != NULL, FALSE);
+
+  compiled_filename = g_strconcat (filename, MX_STYLE_SHEET_COMPILED_SUFFIX,
+                                   NULL);
+  mapped_file = g_mapped_file_new (compiled_filename, FALSE, NULL);
+
+  if (!mapped_file)
+    {
+      g_free (compiled_filename);
+      return FALSE;
+    }
+
+  bytes = g_mapped_file_get_bytes (mapped_file);
+  g_mapped_file_unref (mapped_file);
+
+  header = mx_style_sheet_get_compiled_header (bytes);
+
+  if (header &&
+      !mx_style_sheet_compiled_is_current (header, filename,
+                                           compiled_filename))
+    header = NULL;
+
+  if (!header)
+    MX_NOTE (CSS, "'%s' is out of date, parsing '%s'",
+             compiled_filename, filename);
+  else if (!(result = mx_style_sheet_add_compiled (sheet, filename, bytes)))
+    g_warning ("Invalid compiled style sheet '%s'", compiled_filename);
+
+  g_bytes_unref (bytes);
+  g_free (compiled_filename);
+
+  return result;
+}
+
+/* Loads the compiled style sheet @compiled, if it was compiled from @data.
+ * Returns FALSE if @data needs to be parsed instead.
+ */
+gboolean
+mx_style_sheet_add_from_compiled_data (MxStyleSheet *sheet,
+                                       const gchar  *id,
+                                       const gchar  *data,
+                                       GBytes       *compiled)
+{
+  const MxCompiledHeader *header;
+  gsize length;
+
+  g_return_val_if_fail (sheet != NULL, FALSE);
+  g_return_val_if_fail (id != NULL, FALSE);
+  g_return_val_if_fail (data != NULL, FALSE);
+  g_return_val_if_fail (compiled != NULL, FALSE);
+
+  header = mx_style_sheet_get_compiled_header (compiled);
+  length = strlen (data);
+
+  if (!header ||
+      header->source_size != length ||
+      header->source_hash != mx_compiled_hash (data, length))
+    {
+      MX_NOTE (CSS, "Compiled style sheet for '%s' is out of date", id);
+      return FALSE;
+    }
+
+  if (!mx_style_sheet_add_compiled (sheet, id, compiled))
+    {
+      g_warning ("Invalid compiled style sheet for '%s'", id);
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
+
 MxStyleSheet *
 mx_style_sheet_new ()
 {
-  return g_new0 (MxStyleSheet, 1);
+  MxStyleSheet *sheet = g_new0 (MxStyleSheet, 1);
+
+  sheet->id_index = g_hash_table_new_full (NULL, NULL, NULL,
+                                           (GDestroyNotify) g_ptr_array_unref);
+  sheet->class_index = g_hash_table_new_full (NULL, NULL, NULL,
+                                              (GDestroyNotify) g_ptr_array_unref);
+  sheet->type_index = g_hash_table_new_full (g_str_hash, g_str_equal, NULL,
+                                             (GDestroyNotify) g_ptr_array_unref);
+  sheet->universal = g_ptr_array_new ();
+  sheet->ancestor_quarks = g_hash_table_new (NULL, NULL);
+  sheet->compiled = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+                                           (GDestroyNotify) g_ptr_array_unref);
+
+  return sheet;
 }
 
 void
 mx_style_sheet_destroy (MxStyleSheet *sheet)
 {
+  g_hash_table_unref (sheet->id_index);
+  g_hash_table_unref (sheet->class_index);
+  g_hash_table_unref (sheet->type_index);
+  g_ptr_array_unref (sheet->universal);
+  g_hash_table_unref (sheet->ancestor_quarks);
+
   g_list_foreach (sheet->selectors, (GFunc) mx_selector_free, NULL);
   g_list_free (sheet->selectors);
 
+  g_hash_table_unref (sheet->compiled);
+
   g_list_foreach (sheet->filenames, (GFunc) g_free, NULL);
   g_list_free (sheet->filenames);
 
@@ -1032,4 +1867,9 @@ mx_style_sheet_remove (MxStyleSheet *sheet,
           mx_selector_free (selector);
         }
     }
+
+  /* the selectors of a compiled style sheet point into its data */
+  g_hash_table_remove (sheet->compiled, id);
+
+  mx_style_sheet_rebuild_index (sheet);
 }
@@ -24,6 +24,10 @@
 
 #include <glib.h>
 #include "mx-stylable.h"
+#include "mx-private.h"
+
+/* suffix of a compiled style sheet, installed next to the CSS file */
+#define MX_STYLE_SHEET_COMPILED_SUFFIX ".mxb"
 
 typedef struct _MxStyleSheetValue MxStyleSheetValue;
 typedef struct _MxStyleSheet MxStyleSheet;
@@ -48,4 +52,20 @@ GHashTable*    mx_style_sheet_get_properties (MxStyleSheet *sheet,
 void           mx_style_sheet_remove         (MxStyleSheet *sheet,
                                               const gchar  *id);
 
+gboolean       mx_style_sheet_compile                (const gchar   *filename,
+                                                      const gchar   *output,
+                                                      GError       **error);
+gboolean       mx_style_sheet_add_from_compiled_file (MxStyleSheet  *sheet,
+                                                      const gchar   *filename);
+gboolean       mx_style_sheet_add_from_compiled_data (MxStyleSheet  *sheet,
+                                                      const gchar   *id,
+                                                      const gchar   *data,
+                                                      GBytes        *compiled);
+
+gboolean       mx_style_sheet_affects_descendants (MxStyleSheet           *sheet,
+                                                   const MxStylableQuarks *old_state,
+                                                   const MxStylableQuarks *new_state);
+GHashTable*    mx_style_sheet_properties_diff     (GHashTable             *a,
+                                                   GHashTable             *b);
+
 #endif /* MX_CSS_H */
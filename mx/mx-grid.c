@@ -95,6 +95,7 @@
  * </figure>
  */
 
+#include <math.h>
 #include <string.h>
 
 #include "mx-scrollable.h"
@@ -105,6 +106,8 @@
 #include "mx-private.h"
 
 typedef struct _MxGridActorData MxGridActorData;
+typedef struct _MxGridChildSize MxGridChildSize;
+typedef struct _MxGridLine MxGridLine;
 
 static void mx_grid_finalize            (GObject *object);
 
@@ -189,11 +192,20 @@ struct _MxGridPrivate
 
   MxOrientation orientation;
 
-  gboolean      first_of_batch;
-  gfloat        a_current_sum, a_wrap;
+  /* the preferred sizes of the visible children, along and across the
+   * lines, and the largest of them */
+  GArray       *sizes;
   gfloat        max_extent_a;
   gfloat        max_extent_b;
 
+  /* the children in each line, when wrapped at lines_wrap */
+  GArray       *lines;
+  gfloat        lines_wrap;
+
+  /* the extent of each line across the lines, as last allocated, so that
+   * the lines in view can be found without looking at every child */
+  GArray       *line_index;
+
   gint          max_stride;
 
   MxAdjustment *hadjustment;
@@ -203,6 +215,10 @@ struct _MxGridPrivate
 
   guint ignore_css_col_spacing : 1;
   guint ignore_css_row_spacing : 1;
+
+  guint sizes_valid : 1;
+  guint lines_valid : 1;
+  guint line_index_valid : 1;
 };
 
 enum
@@ -228,6 +244,29 @@ struct _MxGridActorData
   gfloat   pref_width, pref_height;
 };
 
+struct _MxGridChildSize
+{
+  ClutterActor *child;
+  gfloat        min_a, min_b;
+  gfloat        nat_a, nat_b;
+};
+
+struct _MxGridLine
+{
+  guint  first;
+  guint  n_children;
+  gfloat start_a;
+  gfloat extent_b;
+};
+
+typedef struct
+{
+  guint  first;
+  guint  n_children;
+  gfloat start_b;
+  gfloat end_b;
+} MxGridLineExtent;
+
 static void
 mx_grid_style_changed (MxWidget *widget, gpointer userdata)
 {
@@ -378,6 +417,19 @@ scrollable_get_adjustments (MxScrollable  *scrollable,
     }
 }
 
+/* Returns the adjustments that have been set, without creating them as
+ * mx_scrollable_get_adjustments() does */
+void
+_mx_grid_get_adjustments (MxGrid        *grid,
+                          MxAdjustment **hadjustment,
+                          MxAdjustment **vadjustment)
+{
+  if (hadjustment)
+    *hadjustment = grid->priv->hadjustment;
+  if (vadjustment)
+    *vadjustment = grid->priv->vadjustment;
+}
+
 static void
 scrollable_interface_init (MxScrollableIface *iface)
 {
@@ -434,6 +486,21 @@ mx_grid_apply_transform (ClutterActor *a,
   cogl_matrix_translate (m , (int) -x, (int) -y, 0);
 }
 
+/* A relayout is queued on the grid whenever a child's size may have
+ * changed, a child is added, removed, shown or hidden, or a property that
+ * affects the layout is set */
+static void
+mx_grid_queue_relayout (ClutterActor *actor)
+{
+  MxGridPrivate *priv = MX_GRID (actor)->priv;
+
+  priv->sizes_valid = FALSE;
+  priv->lines_valid = FALSE;
+  priv->line_index_valid = FALSE;
+
+  CLUTTER_ACTOR_CLASS (mx_grid_parent_class)->queue_relayout (actor);
+}
+
 static gboolean
 mx_grid_get_paint_volume (ClutterActor       *actor,
                           ClutterPaintVolume *volume)
@@ -477,6 +544,7 @@ mx_grid_class_init (MxGridClass *klass)
   actor_class->allocate             = mx_grid_allocate;
   actor_class->apply_transform      = mx_grid_apply_transform;
   actor_class->get_paint_volume     = mx_grid_get_paint_volume;
+  actor_class->queue_relayout       = mx_grid_queue_relayout;
 
   g_type_class_add_private (klass, sizeof (MxGridPrivate));
 
@@ -766,6 +834,10 @@ mx_grid_init (MxGrid *self)
                              NULL,
                              mx_grid_free_actor_data);
 
+  priv->sizes = g_array_new (FALSE, FALSE, sizeof (MxGridChildSize));
+  priv->lines = g_array_new (FALSE, FALSE, sizeof (MxGridLine));
+  priv->line_index = g_array_new (FALSE, FALSE, sizeof (MxGridLineExtent));
+
   g_signal_connect (self, "style-changed",
                     G_CALLBACK (mx_grid_style_changed), NULL);
 }
@@ -777,6 +849,9 @@ mx_grid_finalize (GObject *object)
   MxGridPrivate *priv = self->priv;
 
   g_hash_table_destroy (priv->hash_table);
+  g_array_free (priv->sizes, TRUE);
+  g_array_free (priv->lines, TRUE);
+  g_array_free (priv->line_index, TRUE);
 
   G_OBJECT_CLASS (mx_grid_parent_class)->finalize (object);
 }
@@ -1164,8 +1239,10 @@ mx_grid_actor_removed (ClutterContainer *container,
   g_hash_table_remove (priv->hash_table, actor);
 }
 
+/* Paints the children that are in view, which is also how they are
+ * picked */
 static void
-mx_grid_paint (ClutterActor *actor)
+mx_grid_paint_children (ClutterActor *actor)
 {
   MxGrid *layout = (MxGrid *) actor;
   MxGridPrivate *priv = layout->priv;
@@ -1184,65 +1261,72 @@ mx_grid_paint (ClutterActor *actor)
   else
     y = 0;
 
-  CLUTTER_ACTOR_CLASS (mx_grid_parent_class)->paint (actor);
-
   clutter_actor_get_allocation_box (actor, &grid_b);
   grid_b.x2 = (grid_b.x2 - grid_b.x1) + x;
   grid_b.x1 = x;
   grid_b.y2 = (grid_b.y2 - grid_b.y1) + y;
   grid_b.y1 = y;
 
-  clutter_actor_iter_init (&iter, actor);
-  while (clutter_actor_iter_next (&iter, &child))
+  if (priv->line_index_valid)
     {
-      ClutterActorBox child_b;
-
-      g_assert (child != NULL);
+      GArray *extents = priv->line_index;
+      gfloat view_start, view_end;
+      guint low, high, i;
 
-      /* ensure the child is "on screen" */
-      clutter_actor_get_allocation_box (CLUTTER_ACTOR (child), &child_b);
+      if (priv->orientation == MX_ORIENTATION_VERTICAL)
+        {
+          view_start = grid_b.x1;
+          view_end = grid_b.x2;
+        }
+      else
+        {
+          view_start = grid_b.y1;
+          view_end = grid_b.y2;
+        }
 
-      if ((child_b.x1 < grid_b.x2)
-          && (child_b.x2 > grid_b.x1)
-          && (child_b.y1 < grid_b.y2)
-          && (child_b.y2 > grid_b.y1)
-          && CLUTTER_ACTOR_IS_VISIBLE (child))
+      /* find the first line that ends after the start of the view */
+      low = 0;
+      high = extents->len;
+      while (low < high)
         {
-          clutter_actor_paint (child);
+          guint mid = (low + high) / 2;
+
+          if (g_array_index (extents, MxGridLineExtent, mid).end_b <=
+              view_start)
+            low = mid + 1;
+          else
+            high = mid;
         }
-    }
-}
 
-static void
-mx_grid_pick (ClutterActor       *actor,
-              const ClutterColor *color)
-{
-  MxGrid *layout = (MxGrid *) actor;
-  MxGridPrivate *priv = layout->priv;
-  gfloat x, y;
-  ClutterActorBox grid_b;
-  ClutterActorIter iter;
-  ClutterActor *child;
+      for (; low < extents->len; low++)
+        {
+          MxGridLineExtent *line = &g_array_index (extents, MxGridLineExtent,
+                                                   low);
 
-  if (priv->hadjustment)
-    x = mx_adjustment_get_value (priv->hadjustment);
-  else
-    x = 0;
+          if (line->start_b >= view_end)
+            break;
 
-  if (priv->vadjustment)
-    y = mx_adjustment_get_value (priv->vadjustment);
-  else
-    y = 0;
+          for (i = line->first; i < line->first + line->n_children; i++)
+            {
+              ClutterActorBox child_b;
 
-  /* Chain up so we get a bounding box pained (if we are reactive) */
-  CLUTTER_ACTOR_CLASS (mx_grid_parent_class)->pick (actor, color);
+              child = g_array_index (priv->sizes, MxGridChildSize, i).child;
 
+              if (!CLUTTER_ACTOR_IS_VISIBLE (child))
+                continue;
 
-  clutter_actor_get_allocation_box (actor, &grid_b);
-  grid_b.x2 = (grid_b.x2 - grid_b.x1) + x;
-  grid_b.x1 = x;
-  grid_b.y2 = (grid_b.y2 - grid_b.y1) + y;
-  grid_b.y1 = y;
+              clutter_actor_get_allocation_box (child, &child_b);
+
+              if ((child_b.x1 < grid_b.x2)
+                  && (child_b.x2 > grid_b.x1)
+                  && (child_b.y1 < grid_b.y2)
+                  && (child_b.y2 > grid_b.y1))
+                clutter_actor_paint (child);
+            }
+        }
+
+      return;
+    }
 
   clutter_actor_iter_init (&iter, actor);
   while (clutter_actor_iter_next (&iter, &child))
@@ -1265,6 +1349,24 @@ mx_grid_pick (ClutterActor       *actor,
     }
 }
 
+static void
+mx_grid_paint (ClutterActor *actor)
+{
+  CLUTTER_ACTOR_CLASS (mx_grid_parent_class)->paint (actor);
+
+  mx_grid_paint_children (actor);
+}
+
+static void
+mx_grid_pick (ClutterActor       *actor,
+              const ClutterColor *color)
+{
+  /* Chain up so we get a bounding box pained (if we are reactive) */
+  CLUTTER_ACTOR_CLASS (mx_grid_parent_class)->pick (actor, color);
+
+  mx_grid_paint_children (actor);
+}
+
 static void
 mx_grid_get_preferred_width (ClutterActor *self,
                              gfloat        for_height,
@@ -1311,123 +1413,124 @@ mx_grid_get_preferred_height (ClutterActor *self,
     *natural_height_p = actual_height;
 }
 
-static gfloat
-compute_row_height (ClutterActor     *self,
-                    ClutterActorIter  siblings,
-                    gfloat            best_yet,
-                    gfloat            current_a,
-                    MxGridPrivate    *priv)
+/* Measures the visible children once, in the axes of the orientation, and
+ * keeps the sizes until a relayout is queued */
+static void
+mx_grid_measure_children (MxGrid *self)
 {
-  gboolean homogenous_a;
-  gfloat gap;
-
+  MxGridPrivate *priv = self->priv;
+  ClutterActorIter iter;
   ClutterActor *child;
 
-  if (priv->orientation == MX_ORIENTATION_VERTICAL)
-    {
-      homogenous_a = priv->homogenous_rows;
-      gap          = priv->row_spacing;
-    }
-  else
-    {
-      homogenous_a = priv->homogenous_columns;
-      gap          = priv->col_spacing;
-    }
+  if (priv->sizes_valid)
+    return;
+
+  g_array_set_size (priv->sizes, 0);
+  priv->max_extent_a = 0;
+  priv->max_extent_b = 0;
 
-  clutter_actor_iter_init (&siblings, self);
-  while (clutter_actor_iter_next (&siblings, &child))
+  clutter_actor_iter_init (&iter, CLUTTER_ACTOR (self));
+  while (clutter_actor_iter_next (&iter, &child))
     {
-      gfloat natural_width, natural_height;
+      MxGridChildSize size;
 
       if (!CLUTTER_ACTOR_IS_VISIBLE (child))
         continue;
 
-      /* each child will get as much space as they require */
-      clutter_actor_get_preferred_size (CLUTTER_ACTOR (child),
-                                        NULL, NULL,
-                                        &natural_width, &natural_height);
+      size.child = child;
 
+      /* each child will get as much space as they require */
       if (priv->orientation == MX_ORIENTATION_VERTICAL)
-        {
-          gfloat temp = natural_height;
-          natural_height = natural_width;
-          natural_width = temp;
-        }
-
-      /* if the primary axis is homogenous, each additional item is the same
-       * width */
-      if (homogenous_a)
-        natural_width = priv->max_extent_a;
+        clutter_actor_get_preferred_size (child, &size.min_b, &size.min_a,
+                                          &size.nat_b, &size.nat_a);
+      else
+        clutter_actor_get_preferred_size (child, &size.min_a, &size.min_b,
+                                          &size.nat_a, &size.nat_b);
 
-      if (natural_height > best_yet)
-        best_yet = natural_height;
+      priv->max_extent_a = MAX (priv->max_extent_a, size.nat_a);
+      priv->max_extent_b = MAX (priv->max_extent_b, size.nat_b);
 
-      /* if the child is overflowing, we wrap to next line */
-      if (current_a + natural_width + gap > priv->a_wrap)
-        {
-          return best_yet;
-        }
-      current_a += natural_width + gap;
+      g_array_append_val (priv->sizes, size);
     }
-  return best_yet;
-}
-
-
 
+  priv->sizes_valid = TRUE;
+  priv->lines_valid = FALSE;
+}
 
-static gfloat
-compute_row_start (ClutterActor     *container,
-                   ClutterActorIter  siblings,
-                   gfloat            start_x,
-                   MxGridPrivate    *priv)
+/* Breaks the measured children into lines of at most @wrap along the
+ * primary axis, and works out where each line starts and how deep it is */
+static void
+mx_grid_break_lines (MxGrid *self,
+                     gfloat  wrap)
 {
-  gfloat current_a = start_x;
-  gboolean homogenous_a;
-  gfloat gap;
-  ClutterActor *child;
+  MxGridPrivate *priv = self->priv;
+  gboolean homogenous_a, homogenous_b;
+  gfloat agap, current_a;
+  MxGridLine line = { 0, };
+  guint i;
+
+  if (priv->lines_valid && priv->lines_wrap == wrap)
+    return;
 
   if (priv->orientation == MX_ORIENTATION_VERTICAL)
     {
       homogenous_a = priv->homogenous_rows;
-      gap          = priv->row_spacing;
+      homogenous_b = priv->homogenous_columns;
+      agap = priv->row_spacing;
     }
   else
     {
       homogenous_a = priv->homogenous_columns;
-      gap          = priv->col_spacing;
+      homogenous_b = priv->homogenous_rows;
+      agap = priv->col_spacing;
     }
 
-  clutter_actor_iter_init (&siblings, container);
-  while (clutter_actor_iter_next (&siblings, &child))
-    {
-      gfloat natural_width, natural_height;
+  g_array_set_size (priv->lines, 0);
+  current_a = 0;
 
-      if (!CLUTTER_ACTOR_IS_VISIBLE (child))
-        continue;
+  for (i = 0; i <= priv->sizes->len; i++)
+    {
+      MxGridChildSize *size = NULL;
+      gfloat extent_a = 0;
 
-      /* each child will get as much space as they require */
-      clutter_actor_get_preferred_size (CLUTTER_ACTOR (child),
-                                        NULL, NULL,
-                                        &natural_width, &natural_height);
+      if (i < priv->sizes->len)
+        {
+          size = &g_array_index (priv->sizes, MxGridChildSize, i);
+          extent_a = homogenous_a ? priv->max_extent_a : size->nat_a;
+        }
 
+      /* if the child is overflowing, or the max-stride has been reached,
+       * we wrap to next line */
+      if (line.n_children &&
+          (!size ||
+           (priv->max_stride > 0 && line.n_children >= priv->max_stride) ||
+           current_a + extent_a > wrap))
+        {
+          gfloat length = current_a - agap;
 
-      if (priv->orientation == MX_ORIENTATION_VERTICAL)
-        natural_width = natural_height;
+          line.start_a = (wrap - length) *
+            MX_ALIGN_TO_FLOAT (priv->line_alignment);
+          if (homogenous_b)
+            line.extent_b = priv->max_extent_b;
 
-      /* if the primary axis is homogenous, each additional item is the same width */
-      if (homogenous_a)
-        natural_width = priv->max_extent_a;
+          g_array_append_val (priv->lines, line);
 
-      /* if the child is overflowing, we wrap to next line */
-      if (current_a + natural_width + gap > priv->a_wrap)
-        {
-          if (current_a == start_x)
-            return start_x;
-          return (priv->a_wrap - current_a);
+          line.first = i;
+          line.n_children = 0;
+          line.extent_b = 0;
+          current_a = 0;
         }
-      current_a += natural_width + gap;
+
+      if (!size)
+        break;
+
+      line.n_children ++;
+      line.extent_b = MAX (line.extent_b, size->nat_b);
+      current_a += extent_a + agap;
     }
-  return (priv->a_wrap - current_a);
+
+  priv->lines_wrap = wrap;
+  priv->lines_valid = TRUE;
 }
 
 static void
@@ -1444,20 +1547,15 @@ mx_grid_do_allocate (ClutterActor          *self,
   MxGridPrivate *priv = layout->priv;
   MxPadding padding;
 
-  gfloat current_a;
   gfloat current_b;
-  gfloat next_b;
   gfloat agap;
   gfloat bgap;
+  gfloat wrap;
 
   gboolean homogenous_a;
-  gboolean homogenous_b;
   gdouble aalign;
   gdouble balign;
-  int current_stride;
-
-  ClutterActorIter iter;
-  ClutterActor *child;
+  guint l, i;
 
   mx_widget_get_padding (MX_WIDGET (self), &padding);
 
@@ -1473,12 +1571,9 @@ mx_grid_do_allocate (ClutterActor          *self,
   if (min_height)
     *min_height = 0;
 
-  current_a = current_b = next_b = 0;
-
   if (priv->orientation == MX_ORIENTATION_VERTICAL)
     {
-      priv->a_wrap = box->y2 - box->y1 - padding.top - padding.bottom;
-      homogenous_b = priv->homogenous_columns;
+      wrap = box->y2 - box->y1 - padding.top - padding.bottom;
       homogenous_a = priv->homogenous_rows;
       aalign = MX_ALIGN_TO_FLOAT (priv->child_y_align);
       balign = MX_ALIGN_TO_FLOAT (priv->child_x_align);
@@ -1487,197 +1582,112 @@ mx_grid_do_allocate (ClutterActor          *self,
     }
   else
     {
-      priv->a_wrap = box->x2 - box->x1 - padding.left - padding.right;
+      wrap = box->x2 - box->x1 - padding.left - padding.right;
       homogenous_a = priv->homogenous_columns;
-      homogenous_b = priv->homogenous_rows;
       aalign = MX_ALIGN_TO_FLOAT (priv->child_x_align);
       balign = MX_ALIGN_TO_FLOAT (priv->child_y_align);
       agap          = priv->col_spacing;
       bgap          = priv->row_spacing;
     }
 
-  priv->max_extent_a = 0;
-  priv->max_extent_b = 0;
-
-  priv->first_of_batch = TRUE;
+  mx_grid_measure_children (layout);
+  mx_grid_break_lines (layout, wrap);
 
-  if (homogenous_a ||
-      homogenous_b)
+  if (!calculate_extents_only)
     {
-      clutter_actor_iter_init (&iter, self);
-      while (clutter_actor_iter_next (&iter, &child))
-        {
-          gfloat natural_width;
-          gfloat natural_height;
-
-          if (!CLUTTER_ACTOR_IS_VISIBLE (child))
-            continue;
-
-          /* each child will get as much space as they require */
-          clutter_actor_get_preferred_size (CLUTTER_ACTOR (child),
-                                            NULL, NULL,
-                                            &natural_width, &natural_height);
-          if (natural_width > priv->max_extent_a)
-            priv->max_extent_a = natural_width;
-          if (natural_height > priv->max_extent_b)
-            priv->max_extent_b = natural_width;
-        }
+      g_array_set_size (priv->line_index, priv->lines->len);
+      priv->line_index_valid = TRUE;
     }
 
-  if (priv->orientation == MX_ORIENTATION_VERTICAL)
+  current_b = 0;
+  for (l = 0; l < priv->lines->len; l++)
     {
-      gfloat temp = priv->max_extent_a;
-      priv->max_extent_a = priv->max_extent_b;
-      priv->max_extent_b = temp;
-    }
+      MxGridLine *line = &g_array_index (priv->lines, MxGridLine, l);
+      gfloat current_a = line->start_a;
 
-  current_stride = 0;
-  clutter_actor_iter_init (&iter, self);
-  while (clutter_actor_iter_next (&iter, &child))
-    {
-      gfloat natural_a;
-      gfloat natural_b;
-      gfloat min_a;
-      gfloat min_b;
+      if (!calculate_extents_only)
+        {
+          MxGridLineExtent *extent;
+          gfloat start_b;
 
-      if (!CLUTTER_ACTOR_IS_VISIBLE (child))
-        continue;
+          start_b = current_b + ((priv->orientation == MX_ORIENTATION_VERTICAL)
+                                 ? padding.left : padding.top);
 
-      /* each child will get as much space as they require */
-      clutter_actor_get_preferred_size (CLUTTER_ACTOR (child),
-                                        &min_a, &min_b,
-                                        &natural_a, &natural_b);
+          extent = &g_array_index (priv->line_index, MxGridLineExtent, l);
+          extent->first = line->first;
+          extent->n_children = line->n_children;
+          extent->start_b = floorf (start_b);
+          extent->end_b = ceilf (start_b + line->extent_b);
+        }
 
-      /* swap axes around if column is major */
-      if (priv->orientation == MX_ORIENTATION_VERTICAL)
+      for (i = line->first; i < line->first + line->n_children; i++)
         {
-          gfloat temp = natural_a;
-          natural_a = natural_b;
-          natural_b = temp;
+          MxGridChildSize *size = &g_array_index (priv->sizes,
+                                                  MxGridChildSize, i);
+          ClutterActorBox child_box;
+          ClutterActorBox min_child_box;
+
+          if (homogenous_a)
+            child_box.x1 = current_a +
+              (priv->max_extent_a - size->nat_a) * aalign;
+          else
+            child_box.x1 = current_a;
+          child_box.x2 = child_box.x1 + size->nat_a;
 
-          temp = min_a;
-          min_a = min_b;
-          min_b = temp;
-        }
+          child_box.y1 = current_b +
+            (line->extent_b - size->nat_b) * balign;
+          child_box.y2 = child_box.y1 + size->nat_b;
 
-      /* if the child is overflowing, or the max-stride has been reached,
-       * we wrap to next line */
-      current_stride++;
-      if ((priv->max_stride > 0 && current_stride > priv->max_stride)
-          || (current_a + natural_a > priv->a_wrap
-              || (homogenous_a && current_a + priv->max_extent_a > priv->a_wrap)))
-        {
-          current_b = next_b + bgap;
-          current_a = 0;
-          next_b = current_b + bgap;
-          priv->first_of_batch = TRUE;
-          current_stride = 1;
-        }
+          min_child_box.x1 = 0;
+          min_child_box.y1 = 0;
+          min_child_box.x2 = size->min_a;
+          min_child_box.y2 = size->min_b;
 
-      if (priv->line_alignment &&
-          priv->first_of_batch)
-        {
-          current_a = compute_row_start (self, iter, current_a, priv);
-          priv->first_of_batch = FALSE;
-        }
+          if (priv->orientation == MX_ORIENTATION_VERTICAL)
+            {
+              gfloat temp = child_box.x1;
+              child_box.x1 = child_box.y1;
+              child_box.y1 = temp;
 
-      if (next_b-current_b < natural_b)
-        next_b = current_b + natural_b;
-
-      {
-        gfloat row_height;
-        ClutterActorBox child_box;
-        ClutterActorBox min_child_box;
-
-        if (homogenous_b)
-          {
-            row_height = priv->max_extent_b;
-          }
-        else
-          {
-            row_height = compute_row_height (self, iter, next_b-current_b,
-                                             current_a, priv);
-          }
-
-        if (homogenous_a)
-          {
-            child_box.x1 = current_a + (priv->max_extent_a-natural_a) * aalign;
-            child_box.x2 = child_box.x1 + natural_a;
-
-          }
-        else
-          {
-            child_box.x1 = current_a;
-            child_box.x2 = child_box.x1 + natural_a;
-          }
-
-        child_box.y1 = current_b + (row_height-natural_b) * balign;
-        child_box.y2 = child_box.y1 + natural_b;
-
-        min_child_box.x1 = 0;
-        min_child_box.y1 = 0;
-        min_child_box.x2 = min_a;
-        min_child_box.y2 = min_b;
-
-        if (priv->orientation == MX_ORIENTATION_VERTICAL)
-          {
-            gfloat temp = child_box.x1;
-            child_box.x1 = child_box.y1;
-            child_box.y1 = temp;
-
-            temp = child_box.x2;
-            child_box.x2 = child_box.y2;
-            child_box.y2 = temp;
-
-            temp = min_child_box.x1;
-            min_child_box.x1 = min_child_box.y1;
-            min_child_box.y1 = temp;
-
-            temp = min_child_box.x2;
-            min_child_box.x2 = min_child_box.y2;
-            min_child_box.y2 = temp;
-          }
-
-        /* account for padding and pixel-align */
-        child_box.x1 = (int)(child_box.x1 + padding.left);
-        child_box.y1 = (int)(child_box.y1 + padding.top);
-        child_box.x2 = (int)(child_box.x2 + padding.left);
-        child_box.y2 = (int)(child_box.y2 + padding.top);
-
-        /* update the allocation */
-        if (!calculate_extents_only)
-          clutter_actor_allocate (CLUTTER_ACTOR (child),
-                                  &child_box,
-                                  flags);
-
-        /* update extents */
-        if (actual_width && (child_box.x2 + padding.right) > *actual_width)
-          *actual_width = child_box.x2 + padding.right;
-
-        if (actual_height && (child_box.y2 + padding.bottom) > *actual_height)
-          *actual_height = child_box.y2 + padding.bottom;
-
-        if (min_width &&
-            padding.left + min_child_box.x2 + padding.right > *min_width)
-          {
+              temp = child_box.x2;
+              child_box.x2 = child_box.y2;
+              child_box.y2 = temp;
+
+              temp = min_child_box.x2;
+              min_child_box.x2 = min_child_box.y2;
+              min_child_box.y2 = temp;
+            }
+
+          /* account for padding and pixel-align */
+          child_box.x1 = (int)(child_box.x1 + padding.left);
+          child_box.y1 = (int)(child_box.y1 + padding.top);
+          child_box.x2 = (int)(child_box.x2 + padding.left);
+          child_box.y2 = (int)(child_box.y2 + padding.top);
+
+          /* update the allocation */
+          if (!calculate_extents_only)
+            clutter_actor_allocate (size->child, &child_box, flags);
+
+          /* update extents */
+          if (actual_width && (child_box.x2 + padding.right) > *actual_width)
+            *actual_width = child_box.x2 + padding.right;
+
+          if (actual_height &&
+              (child_box.y2 + padding.bottom) > *actual_height)
+            *actual_height = child_box.y2 + padding.bottom;
+
+          if (min_width &&
+              padding.left + min_child_box.x2 + padding.right > *min_width)
             *min_width = padding.left + min_child_box.x2 + padding.right;
-          }
-
-        if (min_height &&
-            padding.top + min_child_box.y2 + padding.bottom > *min_height)
-          {
-            *min_height = padding.left + min_child_box.y2 + padding.right;
-          }
-
-        if (homogenous_a)
-          {
-            current_a += priv->max_extent_a + agap;
-          }
-        else
-          {
-            current_a += natural_a + agap;
-          }
-      }
+
+          if (min_height &&
+              padding.top + min_child_box.y2 + padding.bottom > *min_height)
+            *min_height = padding.top + min_child_box.y2 + padding.bottom;
+
+          current_a += (homogenous_a ? priv->max_extent_a : size->nat_a) + agap;
+        }
+
+      current_b += line->extent_b + bgap;
     }
 }
 
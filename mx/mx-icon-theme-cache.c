@@ -0,0 +1,610 @@
+/*
+ * mx-icon-theme-cache.c: On-disk cache of icon theme lookups
+ *
+ * Copyright 2012 Intel Corporation.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU Lesser General Public License,
+ * version 2.1, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+/*
+ * The files icon names resolved to are kept in the user's cache directory,
+ * so that a process looking up the same icons again, for example when an
+ * application is started, can read them from a mapped file instead of
+ * loading the theme and searching its directories.
+ *
+ * There is one file for each theme name and list of search paths. It
+ * holds a hash table of icon names, and the modification times of the
+ * directories and files that the lookups depend on: the theme directories
+ * in each search path, their index.theme files and every theme
+ * subdirectory that was searched, whether or not an icon was found in it.
+ * When any of these has changed, the file is ignored, and is replaced once
+ * icons have been looked up again.
+ *
+ * New lookups are written a short time after they are added, by replacing
+ * the file, so processes that have it mapped are not affected.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+#include <glib/gstdio.h>
+
+#include "mx-icon-theme-cache.h"
+
+#define MX_ICON_THEME_CACHE_MAGIC      "MXICONS\0"
+#define MX_ICON_THEME_CACHE_VERSION    2
+#define MX_ICON_THEME_CACHE_BYTE_ORDER 0x01020304
+#define MX_ICON_THEME_CACHE_SUFFIX     ".cache"
+
+/* how long to wait for more lookups before writing the file, in seconds */
+#define MX_ICON_THEME_CACHE_SAVE_DELAY 2
+
+/* The file starts with the header, which is followed by the dependencies,
+ * the hash table buckets, the entries and the strings. All offsets are
+ * from the start of the file, except string offsets, which are from the
+ * start of the strings. */
+typedef struct
+{
+  gchar   magic[8];
+  guint32 version;
+  guint32 byte_order;
+  guint32 n_deps;
+  guint32 deps_offset;
+  guint32 n_buckets;
+  guint32 buckets_offset;
+  guint32 strings_offset;
+  guint32 strings_length;
+} MxIconThemeCacheHeader;
+
+typedef struct
+{
+  gint64  mtime;
+  guint32 path;
+  guint32 padding;
+} MxIconThemeCacheDep;
+
+/* An entry is followed by n_icons MxIconThemeCacheIcons. An entry with
+ * no icons records that the name isn't in the theme. */
+typedef struct
+{
+  guint32 next;
+  guint32 name;
+  guint32 n_icons;
+} MxIconThemeCacheEntry;
+
+typedef struct
+{
+  guint32 path;
+  gint32  size;
+  gint32  type;
+  gint32  min_size;
+  gint32  max_size;
+  gint32  threshold;
+} MxIconThemeCacheIcon;
+
+struct _MxIconThemeCache
+{
+  gchar       *filename;
+
+  /* the file, if it is up to date */
+  GMappedFile *file;
+  const MxIconThemeCacheHeader *header;
+
+  GHashTable  *deps;     /* path -> modification time */
+  GHashTable  *entries;  /* icon name -> GList of MxIconData */
+  guint        save_id;
+};
+
+static void
+mx_icon_theme_cache_data_free (GList *data)
+{
+  while (data)
+    {
+      MxIconData *icon_data = data->data;
+
+      g_free (icon_data->path);
+      g_free (icon_data);
+
+      data = g_list_delete_link (data, data);
+    }
+}
+
+static GList *
+mx_icon_theme_cache_data_copy (const GList *data)
+{
+  GList *copy = NULL;
+
+  for (; data; data = data->next)
+    {
+      MxIconData *icon_data = g_memdup (data->data, sizeof (MxIconData));
+
+      icon_data->path = g_strdup (icon_data->path);
+      copy = g_list_prepend (copy, icon_data);
+    }
+
+  return g_list_reverse (copy);
+}
+
+static gint64
+mx_icon_theme_cache_get_mtime (const gchar *path)
+{
+  GStatBuf info;
+
+  if (g_stat (path, &info) != 0)
+    return -1;
+
+  return info.st_mtime;
+}
+
+static gconstpointer
+mx_icon_theme_cache_get (MxIconThemeCache *cache,
+                         guint32           offset,
+                         gsize             size)
+{
+  if ((offset % 4) ||
+      (gsize) offset + size > g_mapped_file_get_length (cache->file))
+    return NULL;
+
+  return g_mapped_file_get_contents (cache->file) + offset;
+}
+
+static const gchar *
+mx_icon_theme_cache_get_string (MxIconThemeCache *cache,
+                                guint32           offset)
+{
+  const gchar *string;
+
+  if (offset >= cache->header->strings_length)
+    return NULL;
+
+  string = g_mapped_file_get_contents (cache->file) +
+    cache->header->strings_offset + offset;
+
+  if (!memchr (string, '\0', cache->header->strings_length - offset))
+    return NULL;
+
+  return string;
+}
+
+/* Checks the file is one we can read and that none of the lookups it
+ * holds have changed, and reads its dependencies */
+static gboolean
+mx_icon_theme_cache_validate (MxIconThemeCache *cache)
+{
+  const MxIconThemeCacheHeader *header;
+  const MxIconThemeCacheDep *deps;
+  guint32 i;
+
+  header = mx_icon_theme_cache_get (cache, 0, sizeof (MxIconThemeCacheHeader));
+
+  if (!header ||
+      memcmp (header->magic, MX_ICON_THEME_CACHE_MAGIC, 8) != 0 ||
+      header->version != MX_ICON_THEME_CACHE_VERSION ||
+      header->byte_order != MX_ICON_THEME_CACHE_BYTE_ORDER ||
+      header->n_buckets == 0 ||
+      (gsize) header->strings_offset + header->strings_length >
+      g_mapped_file_get_length (cache->file))
+    return FALSE;
+
+  cache->header = header;
+
+  deps = mx_icon_theme_cache_get (cache, header->deps_offset,
+                                  (gsize) header->n_deps *
+                                  sizeof (MxIconThemeCacheDep));
+  if (!deps ||
+      !mx_icon_theme_cache_get (cache, header->buckets_offset,
+                                (gsize) header->n_buckets * 4))
+    return FALSE;
+
+  for (i = 0; i < header->n_deps; i++)
+    {
+      const gchar *path = mx_icon_theme_cache_get_string (cache, deps[i].path);
+
+      if (!path || mx_icon_theme_cache_get_mtime (path) != deps[i].mtime)
+        return FALSE;
+
+      g_hash_table_insert (cache->deps, g_strdup (path),
+                           g_memdup (&deps[i].mtime, sizeof (gint64)));
+    }
+
+  return TRUE;
+}
+
+/* Looks an icon name up in the mapped file */
+static gboolean
+mx_icon_theme_cache_lookup_file (MxIconThemeCache  *cache,
+                                 const gchar       *icon_name,
+                                 GList            **data)
+{
+  const guint32 *buckets;
+  guint32 offset;
+  gsize max_chain;
+
+  buckets = mx_icon_theme_cache_get (cache, cache->header->buckets_offset,
+                                     (gsize) cache->header->n_buckets * 4);
+  offset = buckets[g_str_hash (icon_name) % cache->header->n_buckets];
+
+  /* don't follow a corrupt chain forever */
+  max_chain = g_mapped_file_get_length (cache->file) /
+    sizeof (MxIconThemeCacheEntry);
+
+  while (offset && max_chain--)
+    {
+      const MxIconThemeCacheEntry *entry;
+      const MxIconThemeCacheIcon *icons;
+      const gchar *name;
+      GList *list = NULL;
+      gint i;
+
+      entry = mx_icon_theme_cache_get (cache, offset,
+                                       sizeof (MxIconThemeCacheEntry));
+      if (!entry)
+        return FALSE;
+
+      name = mx_icon_theme_cache_get_string (cache, entry->name);
+
+      if (!name || strcmp (name, icon_name) != 0)
+        {
+          offset = entry->next;
+          continue;
+        }
+
+      icons = mx_icon_theme_cache_get (cache,
+                                       offset + sizeof (MxIconThemeCacheEntry),
+                                       (gsize) entry->n_icons *
+                                       sizeof (MxIconThemeCacheIcon));
+      if (!icons)
+        return FALSE;
+
+      for (i = entry->n_icons - 1; i >= 0; i--)
+        {
+          const gchar *path;
+          MxIconData *icon_data;
+
+          path = mx_icon_theme_cache_get_string (cache, icons[i].path);
+          if (!path)
+            continue;
+
+          icon_data = g_new (MxIconData, 1);
+          icon_data->size = icons[i].size;
+          icon_data->path = g_strdup (path);
+          icon_data->type = icons[i].type;
+          icon_data->min_size = icons[i].min_size;
+          icon_data->max_size = icons[i].max_size;
+          icon_data->threshold = icons[i].threshold;
+
+          list = g_list_prepend (list, icon_data);
+        }
+
+      *data = list;
+
+      return TRUE;
+    }
+
+  return FALSE;
+}
+
+static guint32
+mx_icon_theme_cache_add_string (GString     *strings,
+                                const gchar *string)
+{
+  guint32 offset = strings->len;
+
+  g_string_append_len (strings, string, strlen (string) + 1);
+
+  return offset;
+}
+
+static void
+mx_icon_theme_cache_save (MxIconThemeCache *cache)
+{
+  MxIconThemeCacheHeader header;
+  GHashTableIter iter;
+  GByteArray *table;
+  GString *strings;
+  guint32 *buckets;
+  gpointer key, value;
+  gchar *dir;
+
+  /* add the lookups from the file, so that they are not lost */
+  if (cache->file)
+    {
+      const MxIconThemeCacheEntry *entry;
+      const guint32 *file_buckets;
+      guint32 i, offset;
+      gsize max_entries;
+
+      file_buckets = mx_icon_theme_cache_get (cache,
+                                              cache->header->buckets_offset,
+                                              (gsize) cache->header->n_buckets *
+                                              4);
+
+      max_entries = g_mapped_file_get_length (cache->file) /
+        sizeof (MxIconThemeCacheEntry);
+
+      for (i = 0; i < cache->header->n_buckets; i++)
+        for (offset = file_buckets[i];
+             offset && max_entries;
+             offset = entry->next, max_entries--)
+          {
+            const gchar *name;
+            GList *data;
+
+            entry = mx_icon_theme_cache_get (cache, offset,
+                                             sizeof (MxIconThemeCacheEntry));
+            if (!entry)
+              break;
+
+            name = mx_icon_theme_cache_get_string (cache, entry->name);
+
+            if (name && !g_hash_table_contains (cache->entries, name) &&
+                mx_icon_theme_cache_lookup_file (cache, name, &data))
+              g_hash_table_insert (cache->entries, g_strdup (name), data);
+          }
+
+      g_mapped_file_unref (cache->file);
+      cache->file = NULL;
+      cache->header = NULL;
+    }
+
+  memset (&header, 0, sizeof (header));
+  memcpy (header.magic, MX_ICON_THEME_CACHE_MAGIC, 8);
+  header.version = MX_ICON_THEME_CACHE_VERSION;
+  header.byte_order = MX_ICON_THEME_CACHE_BYTE_ORDER;
+  header.n_deps = g_hash_table_size (cache->deps);
+  header.n_buckets = MAX (1, g_hash_table_size (cache->entries));
+
+  table = g_byte_array_new ();
+  strings = g_string_new (NULL);
+
+  g_byte_array_set_size (table, sizeof (header));
+
+  header.deps_offset = table->len;
+  g_hash_table_iter_init (&iter, cache->deps);
+  while (g_hash_table_iter_next (&iter, &key, &value))
+    {
+      MxIconThemeCacheDep dep;
+
+      dep.mtime = *((gint64 *) value);
+      dep.path = mx_icon_theme_cache_add_string (strings, key);
+      dep.padding = 0;
+
+      g_byte_array_append (table, (guint8 *) &dep, sizeof (dep));
+    }
+
+  header.buckets_offset = table->len;
+  g_byte_array_set_size (table, table->len + header.n_buckets * 4);
+  buckets = g_new0 (guint32, header.n_buckets);
+
+  g_hash_table_iter_init (&iter, cache->entries);
+  while (g_hash_table_iter_next (&iter, &key, &value))
+    {
+      MxIconThemeCacheEntry entry;
+      guint bucket;
+      GList *d;
+
+      bucket = g_str_hash (key) % header.n_buckets;
+
+      entry.next = buckets[bucket];
+      entry.name = mx_icon_theme_cache_add_string (strings, key);
+      entry.n_icons = g_list_length (value);
+
+      buckets[bucket] = table->len;
+      g_byte_array_append (table, (guint8 *) &entry, sizeof (entry));
+
+      for (d = value; d; d = d->next)
+        {
+          MxIconData *icon_data = d->data;
+          MxIconThemeCacheIcon icon;
+
+          icon.path = mx_icon_theme_cache_add_string (strings, icon_data->path);
+          icon.size = icon_data->size;
+          icon.type = icon_data->type;
+          icon.min_size = icon_data->min_size;
+          icon.max_size = icon_data->max_size;
+          icon.threshold = icon_data->threshold;
+
+          g_byte_array_append (table, (guint8 *) &icon, sizeof (icon));
+        }
+    }
+
+  memcpy (table->data + header.buckets_offset, buckets,
+          header.n_buckets * 4);
+  g_free (buckets);
+
+  header.strings_offset = table->len;
+  header.strings_length = strings->len;
+  g_byte_array_append (table, (guint8 *) strings->str, strings->len);
+  memcpy (table->data, &header, sizeof (header));
+
+  /* the file is written to a temporary file and renamed, so processes
+   * reading the old one are not affected */
+  dir = g_path_get_dirname (cache->filename);
+  if (g_mkdir_with_parents (dir, 0700) == 0)
+    g_file_set_contents (cache->filename, (const gchar *) table->data,
+                         table->len, NULL);
+  g_free (dir);
+
+  g_string_free (strings, TRUE);
+  g_byte_array_unref (table);
+}
+
+static gboolean
+mx_icon_theme_cache_save_cb (MxIconThemeCache *cache)
+{
+  cache->save_id = 0;
+  mx_icon_theme_cache_save (cache);
+
+  return FALSE;
+}
+
+/*
+ * _mx_icon_theme_cache_new:
+ * @theme_name: the name of the icon theme, or %NULL
+ * @search_paths: the directories the theme is searched for in
+ *
+ * Opens the cache for @theme_name and @search_paths, mapping the file if
+ * it is up to date.
+ */
+MxIconThemeCache *
+_mx_icon_theme_cache_new (const gchar *theme_name,
+                          const GList *search_paths)
+{
+  MxIconThemeCache *cache;
+  gchar *checksum, *name;
+  GString *key;
+
+  cache = g_slice_new0 (MxIconThemeCache);
+
+  key = g_string_new (theme_name ? theme_name : "");
+  for (; search_paths; search_paths = search_paths->next)
+    {
+      g_string_append_c (key, '\n');
+      g_string_append (key, search_paths->data);
+    }
+
+  checksum = g_compute_checksum_for_string (G_CHECKSUM_SHA1, key->str,
+                                            key->len);
+  name = g_strconcat (checksum, MX_ICON_THEME_CACHE_SUFFIX, NULL);
+  cache->filename = g_build_filename (g_get_user_cache_dir (), "mx", "icons",
+                                      name, NULL);
+  g_free (name);
+  g_free (checksum);
+  g_string_free (key, TRUE);
+
+  cache->deps = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                       g_free, g_free);
+  cache->entries =
+    g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+                           (GDestroyNotify) mx_icon_theme_cache_data_free);
+
+  cache->file = g_mapped_file_new (cache->filename, FALSE, NULL);
+
+  if (cache->file && !mx_icon_theme_cache_validate (cache))
+    {
+      g_mapped_file_unref (cache->file);
+      cache->file = NULL;
+      cache->header = NULL;
+
+      g_hash_table_remove_all (cache->deps);
+    }
+
+  return cache;
+}
+
+/*
+ * _mx_icon_theme_cache_free:
+ * @cache: an #MxIconThemeCache
+ *
+ * Writes any lookups that have not been written yet, and frees @cache.
+ */
+void
+_mx_icon_theme_cache_free (MxIconThemeCache *cache)
+{
+  if (cache->save_id)
+    {
+      g_source_remove (cache->save_id);
+      mx_icon_theme_cache_save (cache);
+    }
+
+  if (cache->file)
+    g_mapped_file_unref (cache->file);
+
+  g_hash_table_unref (cache->deps);
+  g_hash_table_unref (cache->entries);
+  g_free (cache->filename);
+
+  g_slice_free (MxIconThemeCache, cache);
+}
+
+/*
+ * _mx_icon_theme_cache_lookup:
+ * @cache: an #MxIconThemeCache
+ * @icon_name: the name of an icon
+ * @data: return location for a newly allocated list of #MxIconData
+ *
+ * Returns: %TRUE if @icon_name was found in the cache, in which case @data
+ *   is set to the files it is available in, or to %NULL if it isn't in the
+ *   theme
+ */
+gboolean
+_mx_icon_theme_cache_lookup (MxIconThemeCache  *cache,
+                             const gchar       *icon_name,
+                             GList            **data)
+{
+  GList *list;
+
+  if (g_hash_table_lookup_extended (cache->entries, icon_name,
+                                    NULL, (gpointer *) &list))
+    {
+      *data = mx_icon_theme_cache_data_copy (list);
+      return TRUE;
+    }
+
+  if (cache->file)
+    return mx_icon_theme_cache_lookup_file (cache, icon_name, data);
+
+  return FALSE;
+}
+
+/*
+ * _mx_icon_theme_cache_add:
+ * @cache: an #MxIconThemeCache
+ * @icon_name: the name of an icon
+ * @data: the #MxIconData of the files @icon_name is available in, or %NULL
+ *
+ * Adds the result of looking up @icon_name to the cache. The cache is
+ * written shortly after.
+ */
+void
+_mx_icon_theme_cache_add (MxIconThemeCache *cache,
+                          const gchar      *icon_name,
+                          const GList      *data)
+{
+  /* the directories that were searched have already been added as
+   * dependencies, including those where the icon wasn't found */
+  g_hash_table_insert (cache->entries, g_strdup (icon_name),
+                       mx_icon_theme_cache_data_copy (data));
+
+  if (!cache->save_id)
+    cache->save_id =
+      g_timeout_add_seconds (MX_ICON_THEME_CACHE_SAVE_DELAY,
+                             (GSourceFunc) mx_icon_theme_cache_save_cb,
+                             cache);
+}
+
+/*
+ * _mx_icon_theme_cache_add_dependency:
+ * @cache: an #MxIconThemeCache
+ * @path: a file or directory
+ *
+ * Records that the lookups in @cache are no longer valid if @path changes
+ * or is created.
+ */
+void
+_mx_icon_theme_cache_add_dependency (MxIconThemeCache *cache,
+                                     const gchar      *path)
+{
+  gint64 mtime;
+
+  if (g_hash_table_contains (cache->deps, path))
+    return;
+
+  mtime = mx_icon_theme_cache_get_mtime (path);
+  g_hash_table_insert (cache->deps, g_strdup (path),
+                       g_memdup (&mtime, sizeof (gint64)));
+}
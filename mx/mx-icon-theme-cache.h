@@ -0,0 +1,64 @@
+/*
+ * mx-icon-theme-cache.h: On-disk cache of icon theme lookups
+ *
+ * Copyright 2012 Intel Corporation.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU Lesser General Public License,
+ * version 2.1, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef _MX_ICON_THEME_CACHE_H
+#define _MX_ICON_THEME_CACHE_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef enum
+{
+  MX_FIXED,
+  MX_SCALABLE,
+  MX_THRESHOLD
+} MxIconType;
+
+/* A file an icon is available in, and the sizes it is meant for */
+typedef struct
+{
+  gint         size;
+  gchar       *path;
+  MxIconType   type;
+  gint         min_size;
+  gint         max_size;
+  gint         threshold;
+} MxIconData;
+
+typedef struct _MxIconThemeCache MxIconThemeCache;
+
+MxIconThemeCache *_mx_icon_theme_cache_new   (const gchar       *theme_name,
+                                              const GList       *search_paths);
+void              _mx_icon_theme_cache_free  (MxIconThemeCache  *cache);
+
+gboolean          _mx_icon_theme_cache_lookup (MxIconThemeCache  *cache,
+                                               const gchar       *icon_name,
+                                               GList            **data);
+void              _mx_icon_theme_cache_add    (MxIconThemeCache  *cache,
+                                               const gchar       *icon_name,
+                                               const GList       *data);
+
+void              _mx_icon_theme_cache_add_dependency (MxIconThemeCache *cache,
+                                                       const gchar      *path);
+
+G_END_DECLS
+
+#endif /* _MX_ICON_THEME_CACHE_H */
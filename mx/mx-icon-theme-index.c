@@ -0,0 +1,498 @@
+/*
+ * mx-icon-theme-index.c: Index of the icons in icon theme directories
+ *
+ * Copyright 2012 Intel Corporation.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU Lesser General Public License,
+ * version 2.1, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+/*
+ * Rather than testing for every file an icon could be in, the contents of
+ * each theme directory are listed once and kept in a hash table of icon
+ * names, so that looking up an icon doesn't touch the disk. When a theme
+ * has an up to date icon-theme.cache file, as written by
+ * gtk-update-icon-cache, the cache is used instead of listing directories.
+ *
+ * Theme directories are watched with GFileMonitor. When anything in a
+ * theme changes, the indexes of the theme are dropped and the serial is
+ * incremented, so that icon themes know to drop the lookups they have
+ * kept. The index is shared by all icon themes, and is only used from the
+ * main thread.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+#include <gio/gio.h>
+#include <glib/gstdio.h>
+
+#include "mx-icon-theme-index.h"
+
+#define MX_ICON_THEME_INDEX_CACHE_NAME "icon-theme.cache"
+
+/* The layout of icon-theme.cache files, which are big-endian */
+#define MX_ICON_CACHE_MAJOR_VERSION 1
+
+#define MX_ICON_CACHE_HAS_SUFFIX_XPM (1 << 0)
+#define MX_ICON_CACHE_HAS_SUFFIX_SVG (1 << 1)
+#define MX_ICON_CACHE_HAS_SUFFIX_PNG (1 << 2)
+
+#define MX_ICON_CACHE_NONE 0xffffffff
+
+typedef struct
+{
+  GHashTable   *icons;   /* icon name -> MxIconThemeIndexFlags */
+  GFileMonitor *monitor;
+} MxIconThemeIndexDir;
+
+typedef struct
+{
+  gchar        *path;
+  GHashTable   *dirs;    /* subdirectory -> MxIconThemeIndexDir */
+  GFileMonitor *monitor;
+
+  guint         checked : 1;
+  guint         exists  : 1;
+  GMappedFile  *cache;
+} MxIconThemeIndexTheme;
+
+static GHashTable *mx_icon_theme_index_themes = NULL;
+static guint mx_icon_theme_index_serial = 1;
+
+static void
+mx_icon_theme_index_changed_cb (GFileMonitor          *monitor,
+                                GFile                 *file,
+                                GFile                 *other_file,
+                                GFileMonitorEvent      event,
+                                MxIconThemeIndexTheme *theme);
+
+static GFileMonitor *
+mx_icon_theme_index_monitor (MxIconThemeIndexTheme *theme,
+                             const gchar           *path)
+{
+  GFileMonitor *monitor;
+  GFile *file;
+
+  file = g_file_new_for_path (path);
+  monitor = g_file_monitor_directory (file, G_FILE_MONITOR_NONE, NULL, NULL);
+  g_object_unref (file);
+
+  if (monitor)
+    g_signal_connect (monitor, "changed",
+                      G_CALLBACK (mx_icon_theme_index_changed_cb), theme);
+
+  return monitor;
+}
+
+static void
+mx_icon_theme_index_unmonitor (GFileMonitor          *monitor,
+                               MxIconThemeIndexTheme *theme)
+{
+  if (!monitor)
+    return;
+
+  g_signal_handlers_disconnect_by_func (monitor,
+                                        mx_icon_theme_index_changed_cb,
+                                        theme);
+  g_file_monitor_cancel (monitor);
+  g_object_unref (monitor);
+}
+
+static void
+mx_icon_theme_index_dir_free (MxIconThemeIndexDir *dir)
+{
+  if (dir->icons)
+    g_hash_table_unref (dir->icons);
+
+  if (dir->monitor)
+    {
+      /* the handler's data is the theme, which is gone or being cleared */
+      g_signal_handlers_disconnect_matched (dir->monitor,
+                                            G_SIGNAL_MATCH_FUNC,
+                                            0, 0, NULL,
+                                            mx_icon_theme_index_changed_cb,
+                                            NULL);
+      g_file_monitor_cancel (dir->monitor);
+      g_object_unref (dir->monitor);
+    }
+
+  g_slice_free (MxIconThemeIndexDir, dir);
+}
+
+/* Lists the icons in a directory of @theme */
+static MxIconThemeIndexDir *
+mx_icon_theme_index_dir_new (MxIconThemeIndexTheme *theme,
+                             const gchar           *subdir)
+{
+  MxIconThemeIndexDir *dir;
+  const gchar *name;
+  gchar *path;
+  GDir *gdir;
+
+  dir = g_slice_new0 (MxIconThemeIndexDir);
+
+  path = g_build_filename (theme->path, subdir, NULL);
+  gdir = g_dir_open (path, 0, NULL);
+
+  if (gdir)
+    {
+      dir->icons = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                          g_free, NULL);
+
+      while ((name = g_dir_read_name (gdir)))
+        {
+          MxIconThemeIndexFlags flags, flag;
+          const gchar *suffix = strrchr (name, '.');
+
+          if (!suffix)
+            continue;
+
+          if (g_str_equal (suffix, ".png"))
+            flag = MX_ICON_THEME_INDEX_PNG;
+          else if (g_str_equal (suffix, ".svg"))
+            flag = MX_ICON_THEME_INDEX_SVG;
+          else if (g_str_equal (suffix, ".xpm"))
+            flag = MX_ICON_THEME_INDEX_XPM;
+          else
+            continue;
+
+          name = g_strndup (name, suffix - name);
+          flags = GPOINTER_TO_UINT (g_hash_table_lookup (dir->icons, name));
+
+          /* this frees name if the icon was already in the table */
+          g_hash_table_insert (dir->icons, (gchar *) name,
+                               GUINT_TO_POINTER (flags | flag));
+        }
+
+      g_dir_close (gdir);
+
+      dir->monitor = mx_icon_theme_index_monitor (theme, path);
+    }
+
+  g_free (path);
+
+  return dir;
+}
+
+static guint32
+mx_icon_theme_index_cache_card32 (GMappedFile *cache,
+                                  guint32      offset)
+{
+  guint32 value;
+
+  if (offset == MX_ICON_CACHE_NONE ||
+      (gsize) offset + 4 > g_mapped_file_get_length (cache))
+    return MX_ICON_CACHE_NONE;
+
+  memcpy (&value, g_mapped_file_get_contents (cache) + offset, 4);
+
+  return GUINT32_FROM_BE (value);
+}
+
+static guint16
+mx_icon_theme_index_cache_card16 (GMappedFile *cache,
+                                  guint32      offset)
+{
+  guint16 value;
+
+  if (offset == MX_ICON_CACHE_NONE ||
+      (gsize) offset + 2 > g_mapped_file_get_length (cache))
+    return 0xffff;
+
+  memcpy (&value, g_mapped_file_get_contents (cache) + offset, 2);
+
+  return GUINT16_FROM_BE (value);
+}
+
+static const gchar *
+mx_icon_theme_index_cache_string (GMappedFile *cache,
+                                  guint32      offset)
+{
+  gsize length = g_mapped_file_get_length (cache);
+  const gchar *contents = g_mapped_file_get_contents (cache);
+
+  if (offset == MX_ICON_CACHE_NONE || offset >= length ||
+      !memchr (contents + offset, '\0', length - offset))
+    return NULL;
+
+  return contents + offset;
+}
+
+/* The hash function of icon-theme.cache files */
+static guint32
+mx_icon_theme_index_cache_hash (const gchar *name)
+{
+  const signed char *p = (const signed char *) name;
+  guint32 h = *p;
+
+  if (h)
+    for (p += 1; *p != '\0'; p++)
+      h = (h << 5) - h + *p;
+
+  return h;
+}
+
+static MxIconThemeIndexFlags
+mx_icon_theme_index_cache_lookup (GMappedFile *cache,
+                                  const gchar *subdir,
+                                  const gchar *icon_name)
+{
+  guint32 hash_offset, dir_list_offset, n_buckets, n_dirs, offset;
+  gsize max_chain;
+
+  hash_offset = mx_icon_theme_index_cache_card32 (cache, 4);
+  dir_list_offset = mx_icon_theme_index_cache_card32 (cache, 8);
+
+  n_buckets = mx_icon_theme_index_cache_card32 (cache, hash_offset);
+  n_dirs = mx_icon_theme_index_cache_card32 (cache, dir_list_offset);
+
+  if (n_buckets == 0 || n_buckets == MX_ICON_CACHE_NONE ||
+      n_dirs == MX_ICON_CACHE_NONE)
+    return 0;
+
+  offset = mx_icon_theme_index_cache_card32 (cache, hash_offset + 4 + 4 *
+    (mx_icon_theme_index_cache_hash (icon_name) % n_buckets));
+
+  /* don't follow a corrupt chain forever */
+  max_chain = g_mapped_file_get_length (cache) / 12;
+
+  while (offset != MX_ICON_CACHE_NONE && max_chain--)
+    {
+      const gchar *name;
+      guint32 image_list_offset, n_images, i;
+
+      name = mx_icon_theme_index_cache_string (cache,
+               mx_icon_theme_index_cache_card32 (cache, offset + 4));
+
+      if (!name || strcmp (name, icon_name) != 0)
+        {
+          offset = mx_icon_theme_index_cache_card32 (cache, offset);
+          continue;
+        }
+
+      image_list_offset = mx_icon_theme_index_cache_card32 (cache,
+                                                            offset + 8);
+      n_images = mx_icon_theme_index_cache_card32 (cache, image_list_offset);
+
+      if (n_images == MX_ICON_CACHE_NONE)
+        return 0;
+
+      for (i = 0; i < n_images; i++)
+        {
+          MxIconThemeIndexFlags flags = 0;
+          guint32 image_offset = image_list_offset + 4 + 8 * i;
+          const gchar *dir;
+          guint16 dir_index, cache_flags;
+
+          dir_index = mx_icon_theme_index_cache_card16 (cache, image_offset);
+          cache_flags = mx_icon_theme_index_cache_card16 (cache,
+                                                          image_offset + 2);
+
+          if (dir_index >= n_dirs)
+            continue;
+
+          dir = mx_icon_theme_index_cache_string (cache,
+                  mx_icon_theme_index_cache_card32 (cache, dir_list_offset +
+                                                    4 + 4 * dir_index));
+
+          if (!dir || strcmp (dir, subdir) != 0)
+            continue;
+
+          if (cache_flags & MX_ICON_CACHE_HAS_SUFFIX_PNG)
+            flags |= MX_ICON_THEME_INDEX_PNG;
+          if (cache_flags & MX_ICON_CACHE_HAS_SUFFIX_SVG)
+            flags |= MX_ICON_THEME_INDEX_SVG;
+          if (cache_flags & MX_ICON_CACHE_HAS_SUFFIX_XPM)
+            flags |= MX_ICON_THEME_INDEX_XPM;
+
+          return flags;
+        }
+
+      return 0;
+    }
+
+  return 0;
+}
+
+/* Checks whether the theme directory exists, and maps its cache file if
+ * it is newer than the directory */
+static void
+mx_icon_theme_index_theme_check (MxIconThemeIndexTheme *theme)
+{
+  GStatBuf theme_stat, cache_stat;
+  gchar *path;
+
+  theme->checked = TRUE;
+  theme->exists = (g_stat (theme->path, &theme_stat) == 0);
+
+  if (!theme->exists)
+    return;
+
+  path = g_build_filename (theme->path, MX_ICON_THEME_INDEX_CACHE_NAME, NULL);
+
+  if (g_stat (path, &cache_stat) == 0 &&
+      cache_stat.st_mtime >= theme_stat.st_mtime)
+    {
+      theme->cache = g_mapped_file_new (path, FALSE, NULL);
+
+      if (theme->cache &&
+          (g_mapped_file_get_length (theme->cache) < 12 ||
+           mx_icon_theme_index_cache_card16 (theme->cache, 0) !=
+           MX_ICON_CACHE_MAJOR_VERSION))
+        {
+          g_mapped_file_unref (theme->cache);
+          theme->cache = NULL;
+        }
+    }
+
+  g_free (path);
+}
+
+static void
+mx_icon_theme_index_theme_clear (MxIconThemeIndexTheme *theme)
+{
+  g_hash_table_remove_all (theme->dirs);
+
+  if (theme->cache)
+    {
+      g_mapped_file_unref (theme->cache);
+      theme->cache = NULL;
+    }
+
+  theme->checked = FALSE;
+  theme->exists = FALSE;
+
+  mx_icon_theme_index_serial ++;
+}
+
+static void
+mx_icon_theme_index_theme_free (MxIconThemeIndexTheme *theme)
+{
+  g_hash_table_unref (theme->dirs);
+
+  if (theme->cache)
+    g_mapped_file_unref (theme->cache);
+
+  mx_icon_theme_index_unmonitor (theme->monitor, theme);
+  g_free (theme->path);
+
+  g_slice_free (MxIconThemeIndexTheme, theme);
+}
+
+static MxIconThemeIndexTheme *
+mx_icon_theme_index_theme_new (const gchar *path)
+{
+  MxIconThemeIndexTheme *theme = g_slice_new0 (MxIconThemeIndexTheme);
+
+  theme->path = g_strdup (path);
+  theme->dirs =
+    g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+                           (GDestroyNotify) mx_icon_theme_index_dir_free);
+
+  /* this also notices the theme being installed, and the cache file or
+   * directories being added or removed */
+  theme->monitor = mx_icon_theme_index_monitor (theme, path);
+
+  return theme;
+}
+
+static void
+mx_icon_theme_index_changed_cb (GFileMonitor          *monitor,
+                                GFile                 *file,
+                                GFile                 *other_file,
+                                GFileMonitorEvent      event,
+                                MxIconThemeIndexTheme *theme)
+{
+  switch (event)
+    {
+    case G_FILE_MONITOR_EVENT_CHANGED:
+    case G_FILE_MONITOR_EVENT_DELETED:
+    case G_FILE_MONITOR_EVENT_CREATED:
+    case G_FILE_MONITOR_EVENT_MOVED:
+      if (theme->checked)
+        mx_icon_theme_index_theme_clear (theme);
+      break;
+
+    default:
+      break;
+    }
+}
+
+/*
+ * _mx_icon_theme_index_lookup:
+ * @theme_path: the directory of an icon theme in one of the search paths
+ * @subdir: a directory of the theme, as listed in its index.theme
+ * @icon_name: the name of an icon
+ *
+ * Returns: the file types @icon_name is available in, in @subdir of the
+ *   theme, or 0 if it isn't there
+ */
+MxIconThemeIndexFlags
+_mx_icon_theme_index_lookup (const gchar *theme_path,
+                             const gchar *subdir,
+                             const gchar *icon_name)
+{
+  MxIconThemeIndexTheme *theme;
+  MxIconThemeIndexDir *dir;
+
+  if (!mx_icon_theme_index_themes)
+    mx_icon_theme_index_themes =
+      g_hash_table_new_full (g_str_hash, g_str_equal, NULL,
+                             (GDestroyNotify) mx_icon_theme_index_theme_free);
+
+  theme = g_hash_table_lookup (mx_icon_theme_index_themes, theme_path);
+
+  if (!theme)
+    {
+      theme = mx_icon_theme_index_theme_new (theme_path);
+      g_hash_table_insert (mx_icon_theme_index_themes, theme->path, theme);
+    }
+
+  if (!theme->checked)
+    mx_icon_theme_index_theme_check (theme);
+
+  if (!theme->exists)
+    return 0;
+
+  if (theme->cache)
+    return mx_icon_theme_index_cache_lookup (theme->cache, subdir, icon_name);
+
+  dir = g_hash_table_lookup (theme->dirs, subdir);
+
+  if (!dir)
+    {
+      dir = mx_icon_theme_index_dir_new (theme, subdir);
+      g_hash_table_insert (theme->dirs, g_strdup (subdir), dir);
+    }
+
+  if (!dir->icons)
+    return 0;
+
+  return GPOINTER_TO_UINT (g_hash_table_lookup (dir->icons, icon_name));
+}
+
+/*
+ * _mx_icon_theme_index_get_serial:
+ *
+ * Returns: a number that changes whenever an icon theme directory changes,
+ *   and previous lookups may no longer be correct
+ */
+guint
+_mx_icon_theme_index_get_serial (void)
+{
+  return mx_icon_theme_index_serial;
+}
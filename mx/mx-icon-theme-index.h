@@ -0,0 +1,44 @@
+/*
+ * mx-icon-theme-index.h: Index of the icons in icon theme directories
+ *
+ * Copyright 2012 Intel Corporation.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU Lesser General Public License,
+ * version 2.1, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef _MX_ICON_THEME_INDEX_H
+#define _MX_ICON_THEME_INDEX_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* The file types an icon is available in */
+typedef enum
+{
+  MX_ICON_THEME_INDEX_PNG = 1 << 0,
+  MX_ICON_THEME_INDEX_SVG = 1 << 1,
+  MX_ICON_THEME_INDEX_XPM = 1 << 2
+} MxIconThemeIndexFlags;
+
+MxIconThemeIndexFlags _mx_icon_theme_index_lookup (const gchar *theme_path,
+                                                   const gchar *subdir,
+                                                   const gchar *icon_name);
+
+guint                 _mx_icon_theme_index_get_serial (void);
+
+G_END_DECLS
+
+#endif /* _MX_ICON_THEME_INDEX_H */
@@ -24,6 +24,8 @@
 #include <string.h>
 #include <gio/gio.h>
 #include "mx-icon-theme.h"
+#include "mx-icon-theme-cache.h"
+#include "mx-icon-theme-index.h"
 #include "mx-marshal.h"
 #include "mx-texture-cache.h"
 #include "mx-private.h"
@@ -41,36 +43,26 @@ enum
 #define ICON_THEME_PRIVATE(o) \
   (G_TYPE_INSTANCE_GET_PRIVATE ((o), MX_TYPE_ICON_THEME, MxIconThemePrivate))
 
-typedef enum
-{
-  MX_FIXED,
-  MX_SCALABLE,
-  MX_THRESHOLD
-} MxIconType;
-
-typedef struct
-{
-  gint         size;
-  gchar       *path;
-  MxIconType   type;
-  gint         min_size;
-  gint         max_size;
-  gint         threshold;
-} MxIconData;
-
 struct _MxIconThemePrivate
 {
   guint       override_theme : 1;
+  guint       theme_loaded : 1;
 
   GList      *search_paths;
   GHashTable *icon_hash;
   GHashTable *theme_path_hash;
 
+  /* the serial of the directory index when icon_hash was last cleared */
+  guint       index_serial;
+
   gchar      *theme;
   GKeyFile   *theme_file;
   GList      *theme_fallbacks;
 
   GKeyFile   *hicolor_file;
+
+  /* the lookups of previous processes, see mx_icon_theme_load_icon() */
+  MxIconThemeCache *cache;
 };
 
 enum
@@ -129,6 +121,9 @@ mx_icon_theme_finalize (GObject *object)
   MxIconTheme *self = MX_ICON_THEME (object);
   MxIconThemePrivate *priv = self->priv;
 
+  _mx_icon_theme_cache_free (priv->cache);
+  priv->cache = NULL;
+
   mx_icon_theme_set_search_paths (self, NULL);
   g_hash_table_unref (priv->icon_hash);
   g_hash_table_unref (priv->theme_path_hash);
@@ -179,12 +174,24 @@ mx_icon_theme_load_theme (MxIconTheme *self, const gchar *name)
   GKeyFile *key_file;
   MxIconThemePrivate *priv = self->priv;
 
+  /* Icons are looked for in the theme's directory in each search path, so
+   * cached lookups are out of date when any of them change */
+  for (p = priv->search_paths; p; p = p->next)
+    {
+      gchar *theme_path = g_build_filename (p->data, name, NULL);
+      _mx_icon_theme_cache_add_dependency (priv->cache, theme_path);
+      g_free (theme_path);
+    }
+
   key_file = g_key_file_new ();
   for (p = priv->search_paths; p; p = p->next)
     {
       const gchar *path = p->data;
       gchar *key_path = g_build_filename (path, name, "index.theme", NULL);
       gboolean success = g_key_file_load_from_file (key_file, key_path, 0, NULL);
+
+      if (success)
+        _mx_icon_theme_cache_add_dependency (priv->cache, key_path);
       g_free (key_path);
 
       if (success)
@@ -201,6 +208,47 @@ mx_icon_theme_load_theme (MxIconTheme *self, const gchar *name)
   return NULL;
 }
 
+/* Forgets the icons that were found and opens a new lookup cache. The theme
+ * files are unloaded as well, so that loading them again adds their
+ * directories to the new cache as dependencies */
+static void
+mx_icon_theme_reset (MxIconTheme *self)
+{
+  MxIconThemePrivate *priv = self->priv;
+
+  g_hash_table_remove_all (priv->icon_hash);
+
+  if (priv->theme_file)
+    {
+      g_hash_table_remove (priv->theme_path_hash, priv->theme_file);
+      g_key_file_free (priv->theme_file);
+      priv->theme_file = NULL;
+    }
+
+  while (priv->theme_fallbacks)
+    {
+      g_hash_table_remove (priv->theme_path_hash, priv->theme_fallbacks->data);
+      g_key_file_free ((GKeyFile *)priv->theme_fallbacks->data);
+      priv->theme_fallbacks = g_list_delete_link (priv->theme_fallbacks,
+                                                  priv->theme_fallbacks);
+    }
+
+  if (priv->hicolor_file)
+    {
+      g_hash_table_remove (priv->theme_path_hash, priv->hicolor_file);
+      g_key_file_free (priv->hicolor_file);
+      priv->hicolor_file = NULL;
+    }
+
+  /* The theme files are loaded when an icon is looked up that isn't in
+   * the lookup cache */
+  priv->theme_loaded = FALSE;
+
+  if (priv->cache)
+    _mx_icon_theme_cache_free (priv->cache);
+  priv->cache = _mx_icon_theme_cache_new (priv->theme, priv->search_paths);
+}
+
 static void
 mx_icon_theme_icon_data_free (MxIconData *data)
 {
@@ -383,9 +431,8 @@ mx_icon_theme_init (MxIconTheme *self)
                                                  NULL,
                                                  g_free);
 
-  priv->hicolor_file = mx_icon_theme_load_theme (self, "hicolor");
-  if (!priv->hicolor_file)
-    g_warning ("Error loading fallback icon theme");
+  priv->index_serial = _mx_icon_theme_index_get_serial ();
+  priv->cache = _mx_icon_theme_cache_new (NULL, priv->search_paths);
 
   theme = g_getenv ("MX_ICON_THEME");
   if (theme)
@@ -498,27 +545,36 @@ mx_icon_theme_set_theme_name (MxIconTheme *theme,
     return;
 
   /* Clear old data */
-  g_hash_table_remove_all (priv->icon_hash);
-
   g_free (priv->theme);
+  priv->theme = g_strdup (theme_name);
 
-  if (priv->theme_file)
-    {
-      g_hash_table_remove (priv->theme_path_hash, priv->theme_file);
-      g_key_file_free (priv->theme_file);
-    }
+  mx_icon_theme_reset (theme);
 
-  while (priv->theme_fallbacks)
+  g_object_notify (G_OBJECT (theme), "theme-name");
+}
+
+static void
+mx_icon_theme_ensure_loaded (MxIconTheme *theme)
+{
+  MxIconThemePrivate *priv = theme->priv;
+
+  if (priv->theme_loaded)
+    return;
+
+  priv->theme_loaded = TRUE;
+
+  if (!priv->hicolor_file)
     {
-      g_hash_table_remove (priv->theme_path_hash, priv->theme_fallbacks->data);
-      g_key_file_free ((GKeyFile *)priv->theme_fallbacks->data);
-      priv->theme_fallbacks = g_list_delete_link (priv->theme_fallbacks,
-                                                  priv->theme_fallbacks);
+      priv->hicolor_file = mx_icon_theme_load_theme (theme, "hicolor");
+      if (!priv->hicolor_file)
+        g_warning ("Error loading fallback icon theme");
     }
 
+  if (!priv->theme)
+    return;
+
   /* Load new theme file */
-  priv->theme = g_strdup (theme_name);
-  priv->theme_file = mx_icon_theme_load_theme (theme, theme_name);
+  priv->theme_file = mx_icon_theme_load_theme (theme, priv->theme);
 
   if (!priv->theme_file)
     {
@@ -528,8 +584,6 @@ mx_icon_theme_set_theme_name (MxIconTheme *theme,
 
   /* Load fallbacks */
   mx_icon_theme_load_fallbacks (theme, priv->theme_file, TRUE);
-
-  g_object_notify (G_OBJECT (theme), "theme-name");
 }
 
 static void
@@ -688,40 +742,41 @@ mx_icon_theme_theme_load_icon (MxIconTheme *self,
 
           for (p = priv->search_paths; p; p = p->next)
             {
-              gchar *file;
+              MxIconThemeIndexFlags flags;
+              gchar *theme_path, *dir_path;
+              const gchar *suffix;
 
-              MxIconData *icon_data = NULL;
               const gchar *search_path = p->data;
-              gchar *path = g_build_filename (search_path,
-                                              theme,
-                                              dir,
-                                              NULL);
+
+              /* Look the icon up in the directory index rather than
+               * testing for each file it could be */
+              theme_path = g_build_filename (search_path, theme, NULL);
+              flags = _mx_icon_theme_index_lookup (theme_path, dir, icon);
+
+              /* whether or not the icon is here, the cached lookup is out
+               * of date once an icon is added to or removed from this
+               * directory */
+              dir_path = g_build_filename (theme_path, dir, NULL);
+              _mx_icon_theme_cache_add_dependency (priv->cache, dir_path);
+              g_free (dir_path);
 
               /* Try png first, then svg and xpm */
-              file = g_strconcat (path, G_DIR_SEPARATOR_S, icon, ".png", NULL);
-              if (!g_file_test (file, G_FILE_TEST_EXISTS |
-                                      G_FILE_TEST_IS_REGULAR))
+              if (flags & MX_ICON_THEME_INDEX_PNG)
+                suffix = ".png";
+              else if (flags & MX_ICON_THEME_INDEX_SVG)
+                suffix = ".svg";
+              else if (flags & MX_ICON_THEME_INDEX_XPM)
+                suffix = ".xpm";
+              else
+                suffix = NULL;
+
+              if (suffix)
                 {
-                  g_free (file);
-                  file = g_strconcat (path, G_DIR_SEPARATOR_S, icon, ".svg",
-                                      NULL);
-                  if (!g_file_test (file, G_FILE_TEST_EXISTS |
-                                          G_FILE_TEST_IS_REGULAR))
-                    {
-                      g_free (file);
-                      file = g_strconcat (path, G_DIR_SEPARATOR_S, icon, ".xpm",
-                                          NULL);
-                      if (!g_file_test (file, G_FILE_TEST_EXISTS |
-                                              G_FILE_TEST_IS_REGULAR))
-                        {
-                          g_free (file);
-                          file = NULL;
-                        }
-                    }
-                }
+                  MxIconData *icon_data;
+                  gchar *file;
 
-              if (file)
-                {
+                  file = g_strconcat (theme_path, G_DIR_SEPARATOR_S, dir,
+                                      G_DIR_SEPARATOR_S, icon, suffix, NULL);
                   icon_data = mx_icon_theme_icon_data_new (size,
                                                            file,
                                                            type,
@@ -732,7 +787,7 @@ mx_icon_theme_theme_load_icon (MxIconTheme *self,
 
                   data = g_list_prepend (data, icon_data);
                 }
-              g_free (path);
+              g_free (theme_path);
             }
         }
       g_free (dirs);
@@ -753,9 +808,9 @@ mx_icon_theme_theme_load_icon (MxIconTheme *self,
 }
 
 static GList *
-mx_icon_theme_load_icon (MxIconTheme *theme,
-                         const gchar *icon_name,
-                         GIcon       *store_icon)
+mx_icon_theme_search_icon (MxIconTheme *theme,
+                           const gchar *icon_name,
+                           GIcon       *store_icon)
 {
   GList *data, *f;
   MxIconThemePrivate *priv = theme->priv;
@@ -785,6 +840,36 @@ mx_icon_theme_load_icon (MxIconTheme *theme,
 
 }
 
+static GList *
+mx_icon_theme_load_icon (MxIconTheme *theme,
+                         const gchar *icon_name,
+                         GIcon       *store_icon)
+{
+  GList *data;
+  MxIconThemePrivate *priv = theme->priv;
+
+  /* Try the lookups of previous processes first, which don't need the
+   * theme to be loaded or its directories to be read */
+  if (_mx_icon_theme_cache_lookup (priv->cache, icon_name, &data))
+    {
+      if (!store_icon)
+        store_icon = g_themed_icon_new_with_default_fallbacks (icon_name);
+      else
+        store_icon = g_object_ref (store_icon);
+
+      g_hash_table_insert (priv->icon_hash, store_icon, data);
+
+      return data;
+    }
+
+  mx_icon_theme_ensure_loaded (theme);
+
+  data = mx_icon_theme_search_icon (theme, icon_name, store_icon);
+  _mx_icon_theme_cache_add (priv->cache, icon_name, data);
+
+  return data;
+}
+
 static GList *
 mx_icon_theme_copy_data_list (GList *data)
 {
@@ -811,6 +896,14 @@ mx_icon_theme_get_icons (MxIconTheme *theme,
   const gchar * const *names = NULL;
   MxIconThemePrivate *priv = theme->priv;
 
+  /* Forget the icons that were found if the theme directories have changed
+   * since */
+  if (priv->index_serial != _mx_icon_theme_index_get_serial ())
+    {
+      priv->index_serial = _mx_icon_theme_index_get_serial ();
+      mx_icon_theme_reset (theme);
+    }
+
   /* Load the icon, or a fallback */
   icon = g_themed_icon_new_with_default_fallbacks (icon_name);
   names = g_themed_icon_get_names (G_THEMED_ICON (icon));
@@ -859,6 +952,260 @@ mx_icon_theme_get_icons (MxIconTheme *theme,
   return data;
 }
 
+/* Icons from scalable directories are rasterised at the size they are
+ * looked up at, rather than at the size of their file. Each size is kept
+ * in the texture cache as a meta texture of the file, so the sizes are
+ * shared between icons and evicted with the file when the cache is over
+ * its size limit.
+ */
+static GArray *mx_icon_theme_size_idents = NULL;
+
+/* Icons being rasterised in a worker thread, by size and path */
+static GHashTable *mx_icon_theme_rasterising = NULL;
+
+typedef struct
+{
+  gchar     *key;
+  gchar     *path;
+  gint       size;
+
+  /* the lookups waiting for the icon */
+  GList     *waiters;
+
+  GdkPixbuf *pixbuf;
+} MxIconThemeRasterise;
+
+static gpointer
+mx_icon_theme_get_size_ident (gint size)
+{
+  GQuark quark;
+
+  if (!mx_icon_theme_size_idents)
+    mx_icon_theme_size_idents = g_array_new (FALSE, TRUE, sizeof (GQuark));
+
+  if (size >= mx_icon_theme_size_idents->len)
+    g_array_set_size (mx_icon_theme_size_idents, size + 1);
+
+  quark = g_array_index (mx_icon_theme_size_idents, GQuark, size);
+  if (!quark)
+    {
+      gchar *name = g_strdup_printf ("mx-icon-theme-size-%d", size);
+
+      quark = g_quark_from_string (name);
+      g_array_index (mx_icon_theme_size_idents, GQuark, size) = quark;
+
+      g_free (name);
+    }
+
+  return GUINT_TO_POINTER (quark);
+}
+
+static gboolean
+mx_icon_theme_icon_is_loaded (MxIconData *icon_data,
+                              gint        size)
+{
+  MxTextureCache *texture_cache = mx_texture_cache_get_default ();
+
+  if (icon_data->type == MX_SCALABLE)
+    return mx_texture_cache_contains_meta (texture_cache, icon_data->path,
+                                           mx_icon_theme_get_size_ident (size));
+  else
+    return mx_texture_cache_contains (texture_cache, icon_data->path);
+}
+
+/* Returns the texture of @icon_data at @size if it has already been
+ * loaded, without touching the disk, or %NULL */
+static CoglHandle
+mx_icon_theme_get_loaded_texture (MxIconData *icon_data,
+                                  gint        size)
+{
+  MxTextureCache *texture_cache = mx_texture_cache_get_default ();
+
+  if (!mx_icon_theme_icon_is_loaded (icon_data, size))
+    return NULL;
+
+  if (icon_data->type == MX_SCALABLE)
+    return mx_texture_cache_get_meta_cogl_texture (texture_cache,
+                                                   icon_data->path,
+                                                   mx_icon_theme_get_size_ident (size));
+  else
+    return mx_texture_cache_get_cogl_texture (texture_cache, icon_data->path);
+}
+
+/* Adds an icon rasterised at @size to the texture cache, and returns its
+ * texture */
+static CoglHandle
+mx_icon_theme_add_rasterised (const gchar *path,
+                              gint         size,
+                              GdkPixbuf   *pixbuf)
+{
+  MxTextureCache *texture_cache = mx_texture_cache_get_default ();
+  gpointer ident = mx_icon_theme_get_size_ident (size);
+  CoglHandle texture;
+
+  texture = _mx_texture_cache_texture_from_pixbuf (texture_cache, pixbuf);
+  if (texture == COGL_INVALID_HANDLE)
+    return NULL;
+
+  mx_texture_cache_insert_meta (texture_cache, path, ident, texture, NULL);
+  cogl_handle_unref (texture);
+
+  /* hand out a texture shared through the cache, so that it knows the
+   * size is in use */
+  return mx_texture_cache_get_meta_cogl_texture (texture_cache, path, ident);
+}
+
+static CoglHandle
+mx_icon_theme_load_texture (MxIconData *icon_data,
+                            gint        size)
+{
+  MxTextureCache *texture_cache = mx_texture_cache_get_default ();
+  GError *error = NULL;
+  CoglHandle texture;
+  GdkPixbuf *pixbuf;
+
+  if (icon_data->type != MX_SCALABLE)
+    return mx_texture_cache_get_cogl_texture (texture_cache, icon_data->path);
+
+  if ((texture = mx_icon_theme_get_loaded_texture (icon_data, size)))
+    return texture;
+
+  pixbuf = gdk_pixbuf_new_from_file_at_size (icon_data->path, size, size,
+                                             &error);
+  if (!pixbuf)
+    {
+      g_warning ("Error loading icon \"%s\": %s", icon_data->path,
+                 error->message);
+      g_error_free (error);
+      return NULL;
+    }
+
+  texture = mx_icon_theme_add_rasterised (icon_data->path, size, pixbuf);
+  g_object_unref (pixbuf);
+
+  return texture;
+}
+
+static void
+mx_icon_theme_rasterise_free (MxIconThemeRasterise *rasterise)
+{
+  g_free (rasterise->key);
+  g_free (rasterise->path);
+  g_list_free (rasterise->waiters);
+
+  if (rasterise->pixbuf)
+    g_object_unref (rasterise->pixbuf);
+
+  g_slice_free (MxIconThemeRasterise, rasterise);
+}
+
+static void
+mx_icon_theme_rasterise_thread (GSimpleAsyncResult *result,
+                                GObject            *object,
+                                GCancellable       *cancellable)
+{
+  MxIconThemeRasterise *rasterise;
+  GError *error = NULL;
+
+  rasterise = g_simple_async_result_get_op_res_gpointer (result);
+  rasterise->pixbuf = gdk_pixbuf_new_from_file_at_size (rasterise->path,
+                                                        rasterise->size,
+                                                        rasterise->size,
+                                                        &error);
+  if (!rasterise->pixbuf)
+    g_simple_async_result_take_error (result, error);
+}
+
+static void
+mx_icon_theme_rasterise_cb (GObject      *source,
+                            GAsyncResult *result,
+                            gpointer      user_data)
+{
+  MxIconThemeRasterise *rasterise;
+  CoglHandle texture = NULL;
+  GError *error = NULL;
+  GList *w;
+
+  rasterise =
+    g_simple_async_result_get_op_res_gpointer (G_SIMPLE_ASYNC_RESULT (result));
+  g_hash_table_remove (mx_icon_theme_rasterising, rasterise->key);
+
+  if (!g_simple_async_result_propagate_error (G_SIMPLE_ASYNC_RESULT (result),
+                                              &error))
+    {
+      texture = mx_icon_theme_add_rasterised (rasterise->path,
+                                              rasterise->size,
+                                              rasterise->pixbuf);
+      if (!texture)
+        g_set_error (&error, G_IO_ERROR, G_IO_ERROR_FAILED,
+                     "Unable to upload icon \"%s\"", rasterise->path);
+    }
+
+  for (w = rasterise->waiters; w; w = w->next)
+    {
+      GSimpleAsyncResult *simple = w->data;
+
+      if (texture)
+        g_simple_async_result_set_op_res_gpointer (simple,
+                                                   cogl_handle_ref (texture),
+                                                   (GDestroyNotify) cogl_handle_unref);
+      else
+        g_simple_async_result_set_from_error (simple, error);
+
+      g_simple_async_result_complete (simple);
+      g_object_unref (simple);
+    }
+
+  if (texture)
+    cogl_handle_unref (texture);
+  if (error)
+    g_error_free (error);
+}
+
+/* Rasterises a scalable icon at @size in a worker thread, and completes
+ * @simple with it. Lookups of the same icon at the same size share the
+ * work */
+static void
+mx_icon_theme_rasterise_async (MxIconTheme        *theme,
+                               MxIconData         *icon_data,
+                               gint                size,
+                               GSimpleAsyncResult *simple)
+{
+  MxIconThemeRasterise *rasterise;
+  GSimpleAsyncResult *result;
+  gchar *key;
+
+  if (!mx_icon_theme_rasterising)
+    mx_icon_theme_rasterising = g_hash_table_new (g_str_hash, g_str_equal);
+
+  key = g_strdup_printf ("%d:%s", size, icon_data->path);
+  rasterise = g_hash_table_lookup (mx_icon_theme_rasterising, key);
+
+  if (rasterise)
+    {
+      rasterise->waiters = g_list_prepend (rasterise->waiters, simple);
+      g_free (key);
+      return;
+    }
+
+  rasterise = g_slice_new0 (MxIconThemeRasterise);
+  rasterise->key = key;
+  rasterise->path = g_strdup (icon_data->path);
+  rasterise->size = size;
+  rasterise->waiters = g_list_prepend (NULL, simple);
+  g_hash_table_insert (mx_icon_theme_rasterising, rasterise->key, rasterise);
+
+  result = g_simple_async_result_new (G_OBJECT (theme),
+                                      mx_icon_theme_rasterise_cb, NULL,
+                                      mx_icon_theme_rasterise_async);
+  g_simple_async_result_set_op_res_gpointer (result, rasterise,
+                                             (GDestroyNotify)
+                                             mx_icon_theme_rasterise_free);
+  g_simple_async_result_run_in_thread (result, mx_icon_theme_rasterise_thread,
+                                       G_PRIORITY_DEFAULT, NULL);
+  g_object_unref (result);
+}
+
 static MxIconData *
 mx_icon_theme_lookup_internal (MxIconTheme *theme,
                                const gchar *icon_name,
@@ -914,6 +1261,34 @@ mx_icon_theme_lookup_internal (MxIconTheme *theme,
       return NULL;
     }
 
+  /* Rather than loading the best match, use a fixed size that has already
+   * been loaded if the size is within its threshold */
+  if (!mx_icon_theme_icon_is_loaded (best_match, size))
+    {
+      MxIconData *loaded = NULL;
+
+      distance = G_MAXINT;
+      for (d = data; d; d = d->next)
+        {
+          MxIconData *current = d->data;
+          gint current_distance = ABS (size - current->size);
+
+          if (current->type == MX_SCALABLE ||
+              current_distance > current->threshold ||
+              current_distance >= distance)
+            continue;
+
+          if (mx_icon_theme_icon_is_loaded (current, size))
+            {
+              distance = current_distance;
+              loaded = current;
+            }
+        }
+
+      if (loaded)
+        best_match = loaded;
+    }
+
   return best_match;
 }
 
@@ -923,16 +1298,18 @@ mx_icon_theme_lookup_internal (MxIconTheme *theme,
  * @icon_name: The name of the icon
  * @size: The desired size of the icon
  *
- * If the icon is available, returns a #CoglHandle of the icon.
+ * If the icon is available, returns a #CoglHandle of the icon. Icons
+ * from scalable directories are rendered at @size, and the textures of
+ * each size are shared with the other lookups of that size.
  *
- * Return value: (transfer none): a #CoglHandle of the icon, or %NULL.
+ * Return value: (transfer full): a #CoglHandle of the icon, or %NULL. Use
+ *   cogl_handle_unref() when you are done with it.
  */
 CoglHandle
 mx_icon_theme_lookup (MxIconTheme *theme,
                       const gchar *icon_name,
                       gint         size)
 {
-  MxTextureCache *texture_cache;
   MxIconData *icon_data;
 
   g_return_val_if_fail (MX_IS_ICON_THEME (theme), NULL);
@@ -942,8 +1319,147 @@ mx_icon_theme_lookup (MxIconTheme *theme,
   if (!(icon_data = mx_icon_theme_lookup_internal (theme, icon_name, size)))
     return NULL;
 
-  texture_cache = mx_texture_cache_get_default ();
-  return mx_texture_cache_get_cogl_texture (texture_cache, icon_data->path);
+  return mx_icon_theme_load_texture (icon_data, size);
+}
+
+static void
+mx_icon_theme_lookup_cb (MxTextureCache     *cache,
+                         GAsyncResult       *result,
+                         GSimpleAsyncResult *simple)
+{
+  GError *error = NULL;
+  CoglHandle texture;
+
+  texture = mx_texture_cache_get_cogl_texture_finish (cache, result, &error);
+
+  if (texture)
+    g_simple_async_result_set_op_res_gpointer (simple, texture,
+                                               (GDestroyNotify) cogl_handle_unref);
+  else
+    g_simple_async_result_take_error (simple, error);
+
+  g_simple_async_result_complete (simple);
+  g_object_unref (simple);
+}
+
+/**
+ * mx_icon_theme_lookup_async:
+ * @theme: an #MxIconTheme
+ * @icon_name: The name of the icon
+ * @size: The desired size of the icon
+ * @cancellable: (allow-none): a #GCancellable or %NULL
+ * @callback: a #GAsyncReadyCallback to call when the icon is ready
+ * @user_data: the data to pass to @callback
+ *
+ * Asynchronously looks up an icon, as mx_icon_theme_lookup() does. The
+ * icon is loaded from disk and decoded in a worker thread, and uploaded
+ * in the main thread together with other icons that are ready, so that
+ * looking up many icons at once doesn't block painting.
+ *
+ * @callback is called in the main thread, and should call
+ * mx_icon_theme_lookup_finish() to retrieve the icon.
+ *
+ * Since: 2.0
+ */
+void
+mx_icon_theme_lookup_async (MxIconTheme         *theme,
+                            const gchar         *icon_name,
+                            gint                 size,
+                            GCancellable        *cancellable,
+                            GAsyncReadyCallback  callback,
+                            gpointer             user_data)
+{
+  GSimpleAsyncResult *simple;
+  MxIconData *icon_data;
+  CoglHandle texture;
+
+  g_return_if_fail (MX_IS_ICON_THEME (theme));
+  g_return_if_fail (icon_name);
+  g_return_if_fail (size > 0);
+
+  simple = g_simple_async_result_new (G_OBJECT (theme), callback, user_data,
+                                      mx_icon_theme_lookup_async);
+  g_simple_async_result_set_check_cancellable (simple, cancellable);
+
+  if (!(icon_data = mx_icon_theme_lookup_internal (theme, icon_name, size)))
+    {
+      g_simple_async_result_set_error (simple, G_IO_ERROR,
+                                       G_IO_ERROR_NOT_FOUND,
+                                       "Icon \"%s\" not found", icon_name);
+      g_simple_async_result_complete_in_idle (simple);
+      g_object_unref (simple);
+      return;
+    }
+
+  if ((texture = mx_icon_theme_get_loaded_texture (icon_data, size)))
+    {
+      g_simple_async_result_set_op_res_gpointer (simple, texture,
+                                                 (GDestroyNotify) cogl_handle_unref);
+      g_simple_async_result_complete_in_idle (simple);
+      g_object_unref (simple);
+      return;
+    }
+
+  if (icon_data->type == MX_SCALABLE)
+    {
+      mx_icon_theme_rasterise_async (theme, icon_data, size, simple);
+      return;
+    }
+
+  mx_texture_cache_get_cogl_texture_async (mx_texture_cache_get_default (),
+                                           icon_data->path,
+                                           cancellable,
+                                           (GAsyncReadyCallback) mx_icon_theme_lookup_cb,
+                                           simple);
+}
+
+/**
+ * mx_icon_theme_lookup_finish:
+ * @theme: an #MxIconTheme
+ * @result: the #GAsyncResult passed to the callback
+ * @error: return location for a #GError, or %NULL
+ *
+ * Finishes a lookup started with mx_icon_theme_lookup_async().
+ *
+ * Returns: (transfer full): a #CoglHandle of the icon, or %NULL if it
+ *   could not be found or loaded
+ *
+ * Since: 2.0
+ */
+CoglHandle
+mx_icon_theme_lookup_finish (MxIconTheme   *theme,
+                             GAsyncResult  *result,
+                             GError       **error)
+{
+  GSimpleAsyncResult *simple;
+
+  g_return_val_if_fail (MX_IS_ICON_THEME (theme), NULL);
+  g_return_val_if_fail (g_simple_async_result_is_valid (result,
+                                                        G_OBJECT (theme),
+                                                        mx_icon_theme_lookup_async),
+                        NULL);
+
+  simple = G_SIMPLE_ASYNC_RESULT (result);
+
+  if (g_simple_async_result_propagate_error (simple, error))
+    return NULL;
+
+  return cogl_handle_ref (g_simple_async_result_get_op_res_gpointer (simple));
+}
+
+/* Returns the icon if it has already been loaded, without touching the
+ * disk, or %NULL */
+CoglHandle
+_mx_icon_theme_lookup_loaded (MxIconTheme *theme,
+                              const gchar *icon_name,
+                              gint         size)
+{
+  MxIconData *icon_data;
+
+  if (!(icon_data = mx_icon_theme_lookup_internal (theme, icon_name, size)))
+    return NULL;
+
+  return mx_icon_theme_get_loaded_texture (icon_data, size);
 }
 
 gboolean
@@ -1004,4 +1520,8 @@ mx_icon_theme_set_search_paths (MxIconTheme *theme,
   priv->search_paths = g_list_copy ((GList *)paths);
   for (p = priv->search_paths; p; p = p->next)
     p->data = g_strdup ((const gchar *)p->data);
+
+  /* Forget the icons found in the previous search paths */
+  if (priv->cache)
+    mx_icon_theme_reset (theme);
 }
@@ -28,6 +28,12 @@
  *
  * #MxIcon is a simple styled texture actor that displays an image from
  * a stylesheet.
+ *
+ * Icons are looked up asynchronously: the icons whose name or size
+ * changed are looked up together before the next frame is painted, and
+ * those that haven't been loaded yet are decoded in worker threads. Until
+ * an icon is ready, the #MxIcon keeps showing its previous icon, or takes
+ * up the space of the icon if it had none.
  */
 
 #include "mx-icon.h"
@@ -58,8 +64,11 @@ struct _MxIconPrivate
   guint         icon_set         : 1;
   guint         size_set         : 1;
   guint         is_content_image : 1;
+  guint         pending          : 1;
+  guint         missing          : 1;
 
   CoglTexture  *icon_texture;
+  GCancellable *cancellable;
 
   gchar        *icon_name;
   gchar        *icon_suffix;
@@ -67,6 +76,11 @@ struct _MxIconPrivate
 };
 
 static void mx_icon_update (MxIcon *icon);
+static void mx_icon_cancel_lookup (MxIcon *icon);
+
+/* Icons waiting to be looked up before the next frame */
+static GList *mx_icon_pending = NULL;
+static guint mx_icon_pending_id = 0;
 
 static void
 mx_stylable_iface_init (MxStylableIface *iface)
@@ -168,6 +182,16 @@ mx_icon_notify_theme_name_cb (MxIconTheme *theme,
 static void
 mx_icon_dispose (GObject *gobject)
 {
+  MxIconPrivate *priv = MX_ICON (gobject)->priv;
+
+  mx_icon_cancel_lookup (MX_ICON (gobject));
+
+  if (priv->icon_texture)
+    {
+      cogl_object_unref (priv->icon_texture);
+      priv->icon_texture = NULL;
+    }
+
   if (mx_icon_theme_get_default ())
     {
       g_signal_handlers_disconnect_by_func (mx_icon_theme_get_default (),
@@ -217,6 +241,8 @@ mx_icon_get_preferred_height (ClutterActor *actor,
       else
         pref_height = height;
     }
+  else if (priv->icon_name && (priv->pending || priv->cancellable))
+    pref_height = priv->icon_size;
   else
     pref_height = 0;
 
@@ -258,6 +284,8 @@ mx_icon_get_preferred_width (ClutterActor *actor,
       else
         pref_width = width;
     }
+  else if (priv->icon_name && (priv->pending || priv->cancellable))
+    pref_width = priv->icon_size;
   else
     pref_width = 0;
 
@@ -325,6 +353,133 @@ mx_icon_class_init (MxIconClass *klass)
   g_object_class_install_property (object_class, PROP_ICON_SIZE, pspec);
 }
 
+static void
+mx_icon_set_texture (MxIcon     *icon,
+                     CoglHandle  texture)
+{
+  MxIconPrivate *priv = icon->priv;
+
+  if (priv->icon_texture)
+    cogl_object_unref (priv->icon_texture);
+  priv->icon_texture = texture;
+
+  clutter_actor_queue_relayout (CLUTTER_ACTOR (icon));
+}
+
+static void mx_icon_lookup (MxIcon *icon);
+
+static void
+mx_icon_lookup_cb (MxIconTheme  *theme,
+                   GAsyncResult *result,
+                   MxIcon       *icon)
+{
+  MxIconPrivate *priv;
+  GError *error = NULL;
+  CoglHandle texture;
+
+  texture = mx_icon_theme_lookup_finish (theme, result, &error);
+
+  /* The icon has changed or been destroyed since the lookup started */
+  if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+    {
+      g_error_free (error);
+      g_object_unref (icon);
+      return;
+    }
+
+  priv = icon->priv;
+  g_clear_object (&priv->cancellable);
+
+  if (texture)
+    mx_icon_set_texture (icon, texture);
+  else
+    {
+      g_error_free (error);
+
+      /* If the icon is missing, use the image-missing icon */
+      if (!priv->missing)
+        {
+          priv->missing = TRUE;
+          mx_icon_lookup (icon);
+        }
+      else
+        mx_icon_set_texture (icon, NULL);
+    }
+
+  g_object_unref (icon);
+}
+
+static void
+mx_icon_lookup (MxIcon *icon)
+{
+  MxIconPrivate *priv = icon->priv;
+  MxIconTheme *theme = mx_icon_theme_get_default ();
+  CoglHandle texture;
+  gchar *icon_name;
+
+  if (priv->missing)
+    icon_name = g_strdup ("image-missing");
+  else
+    icon_name = g_strconcat (priv->icon_name, priv->icon_suffix, NULL);
+
+  /* Icons that have been loaded before can be used straight away */
+  texture = _mx_icon_theme_lookup_loaded (theme, icon_name, priv->icon_size);
+
+  if (texture)
+    mx_icon_set_texture (icon, texture);
+  else
+    {
+      priv->cancellable = g_cancellable_new ();
+      mx_icon_theme_lookup_async (theme, icon_name, priv->icon_size,
+                                  priv->cancellable,
+                                  (GAsyncReadyCallback) mx_icon_lookup_cb,
+                                  g_object_ref (icon));
+    }
+
+  g_free (icon_name);
+}
+
+static gboolean
+mx_icon_lookup_pending_cb (gpointer data)
+{
+  GList *pending;
+
+  /* Look the icons up in the order they were changed in */
+  pending = g_list_reverse (mx_icon_pending);
+  mx_icon_pending = NULL;
+  mx_icon_pending_id = 0;
+
+  while (pending)
+    {
+      MxIcon *icon = pending->data;
+
+      icon->priv->pending = FALSE;
+      mx_icon_lookup (icon);
+
+      pending = g_list_delete_link (pending, pending);
+    }
+
+  return FALSE;
+}
+
+static void
+mx_icon_cancel_lookup (MxIcon *icon)
+{
+  MxIconPrivate *priv = icon->priv;
+
+  if (priv->pending)
+    {
+      mx_icon_pending = g_list_remove (mx_icon_pending, icon);
+      priv->pending = FALSE;
+    }
+
+  if (priv->cancellable)
+    {
+      g_cancellable_cancel (priv->cancellable);
+      g_clear_object (&priv->cancellable);
+    }
+}
+
 static void
 mx_icon_update (MxIcon *icon)
 {
@@ -337,31 +492,46 @@ mx_icon_update (MxIcon *icon)
                         G_CALLBACK (mx_icon_notify_theme_name_cb), icon);
     }
 
-  /* Get rid of the old one */
-  if (priv->icon_texture)
+  /* A lookup that is in progress is for the old icon */
+  if (priv->cancellable)
     {
-      cogl_object_unref (priv->icon_texture);
-      priv->icon_texture = NULL;
+      g_cancellable_cancel (priv->cancellable);
+      g_clear_object (&priv->cancellable);
     }
 
-  /* Try to lookup the new one */
-  if (priv->icon_name)
+  priv->missing = FALSE;
+
+  if (!priv->icon_name)
     {
-      gchar *icon_name;
-      MxIconTheme *theme = mx_icon_theme_get_default ();
+      if (priv->pending)
+        {
+          mx_icon_pending = g_list_remove (mx_icon_pending, icon);
+          priv->pending = FALSE;
+        }
 
-      icon_name = g_strconcat (priv->icon_name, priv->icon_suffix, NULL);
-      priv->icon_texture = mx_icon_theme_lookup (theme, icon_name,
-                                                 priv->icon_size);
-      g_free (icon_name);
+      mx_icon_set_texture (icon, NULL);
+      return;
+    }
 
-      /* If the icon is missing, use the image-missing icon */
-      if (!priv->icon_texture)
-        priv->icon_texture = mx_icon_theme_lookup (theme, "image-missing",
-                                                   priv->icon_size);
+  /* Queue the lookup of the new icon. The old one is kept until the new
+   * one is ready, so that changing icons doesn't flicker */
+  if (!priv->pending)
+    {
+      priv->pending = TRUE;
+      mx_icon_pending = g_list_prepend (mx_icon_pending, icon);
+
+      if (!mx_icon_pending_id)
+        mx_icon_pending_id =
+          clutter_threads_add_repaint_func_full (CLUTTER_REPAINT_FLAGS_PRE_PAINT,
+                                                 mx_icon_lookup_pending_cb,
+                                                 NULL, NULL);
     }
 
-  clutter_actor_queue_relayout (CLUTTER_ACTOR (icon));
+  /* make sure there is a frame to look the icon up in */
+  clutter_actor_queue_redraw (CLUTTER_ACTOR (icon));
+
+  if (!priv->icon_texture)
+    clutter_actor_queue_relayout (CLUTTER_ACTOR (icon));
 }
 
 static void
@@ -392,6 +562,7 @@ mx_icon_style_changed_cb (MxWidget *widget)
       g_signal_handlers_disconnect_by_func (mx_icon_theme_get_default (),
                                             mx_icon_notify_theme_name_cb,
                                             self);
+      mx_icon_cancel_lookup (self);
 
       if (priv->icon_texture)
         {
@@ -0,0 +1,446 @@
+/*
+ * mx-image-disk-cache.c: On-disk cache of decoded, scaled images
+ *
+ * Copyright 2012 Intel Corporation.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU Lesser General Public License,
+ * version 2.1, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+/*
+ * Images that MxImage loads at a particular size are stored in the user's
+ * cache directory as raw pixel data, after they have been decoded and
+ * scaled. The pixels are stored as they are uploaded to the texture:
+ * premultiplied RGBA with a transparent 1-pixel border (see
+ * mx_image_pixels_new_from_pixbuf()). Loading the same file at the same
+ * size again maps the stored pixels instead of decoding and converting
+ * the file.
+ *
+ * Entries are named after a checksum of the path, modification time and
+ * size of the image file, of the parameters it was loaded with and of the
+ * version of the format, so entries for modified files, or written by an
+ * older version, are never found again. They are evicted, least recently
+ * used first, when the cache grows beyond its maximum size.
+ *
+ * This is used from the MxImage loading threads as well as from the main
+ * thread.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <glib/gstdio.h>
+
+#include "mx-image-disk-cache.h"
+#include "mx-private.h"
+
+#define MX_IMAGE_DISK_CACHE_MAGIC      "MXIMGRAW"
+#define MX_IMAGE_DISK_CACHE_VERSION    2
+#define MX_IMAGE_DISK_CACHE_BYTE_ORDER 0x01020304
+#define MX_IMAGE_DISK_CACHE_SUFFIX     ".raw"
+
+#define MX_IMAGE_DISK_CACHE_DEFAULT_MAX_SIZE (128 * 1024 * 1024)
+
+typedef enum
+{
+  MX_IMAGE_DISK_CACHE_SCALED = 1 << 0
+} MxImageDiskCacheFlags;
+
+/* The header of a cache entry, which is followed by the pixel data. The
+ * header is a multiple of 8 bytes so that the pixels are aligned. The
+ * width and height are those of the image, without the border. */
+typedef struct
+{
+  gchar   magic[8];
+  guint32 version;
+  guint32 byte_order;
+  guint32 width;
+  guint32 height;
+  guint32 rowstride;
+  guint32 flags;
+} MxImageDiskCacheHeader;
+
+typedef struct
+{
+  gchar  *path;
+  gint64  size;
+  gint64  mtime;
+} MxImageDiskCacheEntry;
+
+/* protects the variables below */
+G_LOCK_DEFINE_STATIC (disk_cache);
+
+static gchar   *cache_dir = NULL;
+static guint64  cache_max_size = MX_IMAGE_DISK_CACHE_DEFAULT_MAX_SIZE;
+
+/* the size of all of the entries, or -1 until the directory is scanned */
+static gint64   cache_size = -1;
+
+/* called with the lock held */
+static const gchar *
+mx_image_disk_cache_get_dir (void)
+{
+  if (!cache_dir)
+    cache_dir = g_build_filename (g_get_user_cache_dir (), "mx", "images",
+                                  NULL);
+
+  return cache_dir;
+}
+
+static gchar *
+mx_image_disk_cache_get_path (const gchar               *filename,
+                              const MxImageDiskCacheKey *key,
+                              const GStatBuf            *info)
+{
+  gchar *new_filename = NULL;
+  gchar *string, *checksum, *name, *path;
+
+  if (!g_path_is_absolute (filename))
+    {
+      gchar *cwd = g_get_current_dir ();
+      filename = new_filename = g_build_filename (cwd, filename, NULL);
+      g_free (cwd);
+    }
+
+  string = g_strdup_printf ("%d\n%s\n%" G_GINT64_FORMAT "\n%" G_GINT64_FORMAT
+                            "\n%d\n%d\n%u\n%u\n%d",
+                            MX_IMAGE_DISK_CACHE_VERSION, filename,
+                            (gint64) info->st_mtime,
+                            (gint64) info->st_size,
+                            key->width, key->height,
+                            key->width_threshold, key->height_threshold,
+                            key->upscale ? 1 : 0);
+  checksum = g_compute_checksum_for_string (G_CHECKSUM_SHA1, string, -1);
+  name = g_strconcat (checksum, MX_IMAGE_DISK_CACHE_SUFFIX, NULL);
+
+  G_LOCK (disk_cache);
+  path = g_build_filename (mx_image_disk_cache_get_dir (), name, NULL);
+  G_UNLOCK (disk_cache);
+
+  g_free (name);
+  g_free (checksum);
+  g_free (string);
+  g_free (new_filename);
+
+  return path;
+}
+
+static gint
+mx_image_disk_cache_compare_entry_mtime (gconstpointer a,
+                                         gconstpointer b)
+{
+  const MxImageDiskCacheEntry *entry_a = a;
+  const MxImageDiskCacheEntry *entry_b = b;
+
+  if (entry_a->mtime < entry_b->mtime)
+    return -1;
+  else if (entry_a->mtime > entry_b->mtime)
+    return 1;
+  else
+    return 0;
+}
+
+/* Works out the size of the cache and, if it is too big, evicts the least
+ * recently used entries until it is well below the maximum size, so that
+ * the directory is not scanned again for every new entry. Called with the
+ * lock held. */
+static void
+mx_image_disk_cache_trim (void)
+{
+  MxImageDiskCacheEntry *entry;
+  const gchar *dir_name, *name;
+  GArray *entries;
+  gint64 total;
+  GDir *dir;
+  guint i;
+
+  dir_name = mx_image_disk_cache_get_dir ();
+  dir = g_dir_open (dir_name, 0, NULL);
+
+  if (!dir)
+    {
+      cache_size = 0;
+      return;
+    }
+
+  entries = g_array_new (FALSE, FALSE, sizeof (MxImageDiskCacheEntry));
+  total = 0;
+
+  while ((name = g_dir_read_name (dir)))
+    {
+      MxImageDiskCacheEntry new_entry;
+      GStatBuf info;
+
+      /* skip entries that are still being written */
+      if (!g_str_has_suffix (name, MX_IMAGE_DISK_CACHE_SUFFIX))
+        continue;
+
+      new_entry.path = g_build_filename (dir_name, name, NULL);
+
+      if (g_stat (new_entry.path, &info) != 0)
+        {
+          g_free (new_entry.path);
+          continue;
+        }
+
+      new_entry.size = info.st_size;
+      new_entry.mtime = info.st_mtime;
+      g_array_append_val (entries, new_entry);
+
+      total += new_entry.size;
+    }
+
+  g_dir_close (dir);
+
+  if ((guint64) total > cache_max_size)
+    {
+      gint64 limit = cache_max_size / 4 * 3;
+      guint n_evicted = 0;
+
+      g_array_sort (entries, mx_image_disk_cache_compare_entry_mtime);
+
+      for (i = 0; i < entries->len && total > limit; i++)
+        {
+          entry = &g_array_index (entries, MxImageDiskCacheEntry, i);
+
+          if (g_unlink (entry->path) == 0)
+            {
+              total -= entry->size;
+              n_evicted ++;
+            }
+        }
+
+      MX_NOTE (TEXTURE_CACHE, "Evicted %u images from the disk cache, "
+               "%" G_GINT64_FORMAT " bytes left", n_evicted, total);
+    }
+
+  for (i = 0; i < entries->len; i++)
+    g_free (g_array_index (entries, MxImageDiskCacheEntry, i).path);
+  g_array_free (entries, TRUE);
+
+  cache_size = total;
+}
+
+/*
+ * _mx_image_disk_cache_lookup:
+ * @filename: the path of the image file
+ * @key: the parameters the image is being loaded with
+ * @width: return location for the width of the image
+ * @height: return location for the height of the image
+ * @scaled: return location for whether the image was scaled
+ *
+ * Looks for the decoded image in the cache. The returned pixels refer
+ * directly to the mapped cache entry.
+ *
+ * Returns: the pixels of the image, with its border, or %NULL if the
+ *   image is not in the cache
+ */
+GBytes *
+_mx_image_disk_cache_lookup (const gchar               *filename,
+                             const MxImageDiskCacheKey *key,
+                             gint                      *width,
+                             gint                      *height,
+                             gboolean                  *scaled)
+{
+  const MxImageDiskCacheHeader *header;
+  GMappedFile *file;
+  GBytes *contents, *pixels;
+  gsize length;
+  GStatBuf info;
+  gchar *path;
+
+  if (g_stat (filename, &info) != 0)
+    return NULL;
+
+  path = mx_image_disk_cache_get_path (filename, key, &info);
+
+  file = g_mapped_file_new (path, FALSE, NULL);
+  if (!file)
+    {
+      g_free (path);
+      return NULL;
+    }
+
+  contents = g_mapped_file_get_bytes (file);
+  g_mapped_file_unref (file);
+
+  header = g_bytes_get_data (contents, &length);
+
+  if ((length < sizeof (MxImageDiskCacheHeader)) ||
+      memcmp (header->magic, MX_IMAGE_DISK_CACHE_MAGIC,
+              sizeof (header->magic)) != 0 ||
+      header->version != MX_IMAGE_DISK_CACHE_VERSION ||
+      header->byte_order != MX_IMAGE_DISK_CACHE_BYTE_ORDER ||
+      header->width == 0 || header->height == 0 ||
+      header->width > G_MAXINT / 4 - 2 || header->height > G_MAXINT - 2 ||
+      header->rowstride != (header->width + 2) * 4 ||
+      length != sizeof (MxImageDiskCacheHeader) +
+                (guint64) header->rowstride * (header->height + 2))
+    {
+      g_warning ("Removing invalid image cache entry %s", path);
+
+      g_bytes_unref (contents);
+      g_unlink (path);
+      g_free (path);
+      return NULL;
+    }
+
+  pixels = g_bytes_new_from_bytes (contents, sizeof (MxImageDiskCacheHeader),
+                                   length - sizeof (MxImageDiskCacheHeader));
+
+  *width = header->width;
+  *height = header->height;
+  if (scaled)
+    *scaled = (header->flags & MX_IMAGE_DISK_CACHE_SCALED) ? TRUE : FALSE;
+
+  g_bytes_unref (contents);
+
+  /* mark the entry as recently used */
+  g_utime (path, NULL);
+
+  g_free (path);
+
+  return pixels;
+}
+
+/*
+ * _mx_image_disk_cache_store:
+ * @filename: the path of the image file
+ * @key: the parameters the image was loaded with
+ * @pixels: the decoded image, with its border
+ * @width: the width of the image, without the border
+ * @height: the height of the image, without the border
+ * @scaled: whether the image was scaled
+ *
+ * Adds a decoded image to the cache, evicting older entries if the cache
+ * has grown too big. Failures are silently ignored.
+ */
+void
+_mx_image_disk_cache_store (const gchar               *filename,
+                            const MxImageDiskCacheKey *key,
+                            GBytes                    *pixels,
+                            gint                       width,
+                            gint                       height,
+                            gboolean                   scaled)
+{
+  MxImageDiskCacheHeader header;
+  gchar *path, *dir_name, *tmp_path;
+  gboolean success;
+  GStatBuf info;
+  FILE *stream;
+  gsize length;
+  gint fd;
+
+  length = g_bytes_get_size (pixels);
+
+  if (length != (gsize) (width + 2) * 4 * (height + 2))
+    return;
+
+  if (g_stat (filename, &info) != 0)
+    return;
+
+  path = mx_image_disk_cache_get_path (filename, key, &info);
+
+  dir_name = g_path_get_dirname (path);
+  success = (g_mkdir_with_parents (dir_name, 0700) == 0);
+  g_free (dir_name);
+
+  if (!success)
+    {
+      g_free (path);
+      return;
+    }
+
+  /* write to a temporary file, so that other processes never map a
+   * partially written entry */
+  tmp_path = g_strconcat (path, ".XXXXXX", NULL);
+  fd = g_mkstemp (tmp_path);
+
+  if (fd == -1 || !(stream = fdopen (fd, "wb")))
+    {
+      if (fd != -1)
+        {
+          close (fd);
+          g_unlink (tmp_path);
+        }
+      g_free (tmp_path);
+      g_free (path);
+      return;
+    }
+
+  memset (&header, 0, sizeof (header));
+  memcpy (header.magic, MX_IMAGE_DISK_CACHE_MAGIC, sizeof (header.magic));
+  header.version = MX_IMAGE_DISK_CACHE_VERSION;
+  header.byte_order = MX_IMAGE_DISK_CACHE_BYTE_ORDER;
+  header.width = width;
+  header.height = height;
+  header.rowstride = (width + 2) * 4;
+  header.flags = scaled ? MX_IMAGE_DISK_CACHE_SCALED : 0;
+
+  success = (fwrite (&header, sizeof (header), 1, stream) == 1) &&
+            (fwrite (g_bytes_get_data (pixels, NULL), length, 1, stream) == 1);
+
+  if (fclose (stream) != 0)
+    success = FALSE;
+
+  if (!success || g_rename (tmp_path, path) != 0)
+    {
+      g_unlink (tmp_path);
+      g_free (tmp_path);
+      g_free (path);
+      return;
+    }
+
+  g_free (tmp_path);
+  g_free (path);
+
+  G_LOCK (disk_cache);
+
+  if (cache_size >= 0)
+    cache_size += sizeof (header) + length;
+
+  if (cache_size < 0 || (guint64) cache_size > cache_max_size)
+    mx_image_disk_cache_trim ();
+
+  G_UNLOCK (disk_cache);
+}
+
+void
+_mx_image_disk_cache_set_max_size (guint64 max_size)
+{
+  G_LOCK (disk_cache);
+
+  cache_max_size = max_size;
+
+  if (cache_size > 0 && (guint64) cache_size > cache_max_size)
+    mx_image_disk_cache_trim ();
+
+  G_UNLOCK (disk_cache);
+}
+
+guint64
+_mx_image_disk_cache_get_max_size (void)
+{
+  guint64 max_size;
+
+  G_LOCK (disk_cache);
+  max_size = cache_max_size;
+  G_UNLOCK (disk_cache);
+
+  return max_size;
+}
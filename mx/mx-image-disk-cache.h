@@ -0,0 +1,56 @@
+/*
+ * mx-image-disk-cache.h: On-disk cache of decoded, scaled images
+ *
+ * Copyright 2012 Intel Corporation.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU Lesser General Public License,
+ * version 2.1, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef _MX_IMAGE_DISK_CACHE_H
+#define _MX_IMAGE_DISK_CACHE_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* The parameters an image was loaded with, which together with the
+ * modification time and size of the file identify a cache entry */
+typedef struct
+{
+  gint     width;
+  gint     height;
+  guint    width_threshold;
+  guint    height_threshold;
+  gboolean upscale;
+} MxImageDiskCacheKey;
+
+GBytes  *_mx_image_disk_cache_lookup (const gchar               *filename,
+                                      const MxImageDiskCacheKey *key,
+                                      gint                      *width,
+                                      gint                      *height,
+                                      gboolean                  *scaled);
+void     _mx_image_disk_cache_store  (const gchar               *filename,
+                                      const MxImageDiskCacheKey *key,
+                                      GBytes                    *pixels,
+                                      gint                       width,
+                                      gint                       height,
+                                      gboolean                   scaled);
+
+void     _mx_image_disk_cache_set_max_size (guint64 max_size);
+guint64  _mx_image_disk_cache_get_max_size (void);
+
+G_END_DECLS
+
+#endif /* _MX_IMAGE_DISK_CACHE_H */
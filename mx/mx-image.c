@@ -28,13 +28,17 @@
  * Since: 1.2
  */
 
+#include <errno.h>
+#include <fcntl.h>
 #include <unistd.h>
 #include <cogl/cogl.h>
+#include <glib/gstdio.h>
 
 #include "mx-image.h"
 #include "mx-enum-types.h"
 #include "mx-marshal.h"
 #include "mx-texture-cache.h"
+#include "mx-image-disk-cache.h"
 
 #include <gdk-pixbuf/gdk-pixbuf.h>
 
@@ -48,7 +52,7 @@ G_DEFINE_TYPE (MxImage, mx_image, MX_TYPE_WIDGET)
 /* This stucture holds all that is necessary for cancellable async
  * image loading using thread pools.
  *
- * The idea is that you create this structure (with the pixbuf as NULL)
+ * The idea is that you create this structure (with the pixels as NULL)
  * and add it to the thread-pool.
  *
  * The 'complete' member of the struct is protected by the mutex.
@@ -59,18 +63,34 @@ G_DEFINE_TYPE (MxImage, mx_image, MX_TYPE_WIDGET)
  * main thread free the data.
  *
  * The idle handler will check that the cancelled member isn't set and if not,
- * will try to upload the image using mx_image_set_from_pixbuf(). It will free
- * the async structure always. It will also reset the pointer to the task in
- * the MxImage priv struct, but only if the cancelled member *isn't* set.
+ * will try to upload the image using mx_image_upload(). It will free the
+ * async structure, unless a large image is being uploaded over several main
+ * loop iterations, in which case the upload idle handler frees it. It will
+ * also reset the pointer to the task in the MxImage priv struct, but only if
+ * the cancelled member *isn't* set.
+ *
+ * Loads are not added to the thread-pool straight away, but scheduled by
+ * priority (see mx_image_schedule_loads()). The members used for this are
+ * only accessed from the main thread.
  */
 typedef struct
 {
   MxImage   *parent;
 
+  /* scheduling */
+  GList           link;
+  gint            priority;
+  guint           serial;
+  gsize           cost;
+  gboolean        queued;
+  GCancellable   *cancellable;
+
   GMutex          mutex;
   guint           complete  : 1;
   guint           cancelled : 1;
   guint           upscale   : 1;
+  guint           disk_cache : 1;
+  guint           reload    : 1;
   guint           idle_handler;
 
   gchar          *filename;
@@ -83,8 +103,15 @@ typedef struct
   guint           width_threshold;
   guint           height_threshold;
 
-  GdkPixbuf      *pixbuf;
   GError         *error;
+
+  /* the decoded image, in the format of the texture (see
+   * mx_image_pixels_new()), and the progress of uploading it */
+  GBytes         *pixels;
+  gint            pixels_width;
+  gint            pixels_height;
+  CoglHandle      texture;
+  gint            upload_row;
 } MxImageAsyncData;
 
 struct _MxImagePrivate
@@ -93,6 +120,9 @@ struct _MxImagePrivate
   MxImageScaleMode previous_mode;
   guint            load_async : 1;
   guint            upscale    : 1;
+  guint            use_disk_cache : 1;
+  guint            use_scaled_variants : 1;
+  guint            variant_update_queued : 1;
   guint            width_threshold;
   guint            height_threshold;
 
@@ -100,6 +130,22 @@ struct _MxImagePrivate
   CoglHandle old_texture;
   CoglHandle blank_texture;
 
+  /* the size of texture, which is kept while texture is released for a
+   * variant, see mx_image_ensure_texture() */
+  gint       texture_width;
+  gint       texture_height;
+
+  /* a smaller copy of texture that is painted in its place, see
+   * mx_image_update_variant() */
+  CoglHandle variant;
+  guint      variant_level;
+
+  /* the URI texture is stored under in the texture cache, if any */
+  gchar     *uri;
+
+  /* loads texture again from uri, see mx_image_ensure_texture() */
+  MxImageAsyncData *reload_data;
+
   gint rotation;
   gint old_rotation;
   MxImageScaleMode old_mode;
@@ -113,6 +159,7 @@ struct _MxImagePrivate
   guint transition_duration;
 
   MxImageAsyncData *async_load_data;
+  guint             painted_frame;
 };
 
 enum
@@ -127,6 +174,8 @@ enum
   PROP_IMAGE_ROTATION,
   PROP_TRANSITION_DURATION,
   PROP_FILENAME,
+  PROP_USE_DISK_CACHE,
+  PROP_USE_SCALED_VARIANTS,
 
   LAST_PROP
 };
@@ -144,6 +193,61 @@ static guint signals[LAST_SIGNAL] = { 0, };
 static GThreadPool *mx_image_threads = NULL;
 static GQuark mx_image_cache_quark = 0;
 
+/* Scaled variants of an image are stored in the texture cache under a URI
+ * of their own, made from the URI the full-size image is cached under and
+ * the size of the variant, so that every image showing the same file finds
+ * the same variants. Level n is the image halved n times. As they are not
+ * kept with the image, the cache can evict the full-size image while only a
+ * variant is in use.
+ *
+ * Variants are rendered offscreen, which can't be done while painting, so
+ * images that need a different variant are queued when they are painted and
+ * updated from an idle handler. They keep painting the texture they have
+ * until then. */
+#define MX_IMAGE_MAX_VARIANT_LEVEL 8
+
+static GList *mx_image_variant_updates = NULL;
+static guint mx_image_variant_updates_id = 0;
+
+/* Images that have been painted recently are loaded first, then images
+ * that are mapped but have been scrolled out of view, then images that
+ * are not mapped at all. Cancelled loads go before all of them, as they
+ * are discarded straight away. */
+typedef enum
+{
+  MX_IMAGE_LOAD_PREFETCH,
+  MX_IMAGE_LOAD_NEAR_VISIBLE,
+  MX_IMAGE_LOAD_VISIBLE,
+  MX_IMAGE_LOAD_CANCELLED
+} MxImageLoadPriority;
+
+/* Once this much encoded image data has been handed to the thread-pool,
+ * loads of images that are not visible wait, so that loads of images that
+ * become visible do not have to wait behind them */
+#define MX_IMAGE_MAX_QUEUED_BYTES (16 * 1024 * 1024)
+
+/* The size of the chunks images are read and decoded in. Loads are
+ * cancelled between chunks */
+#define MX_IMAGE_DECODE_CHUNK_SIZE (64 * 1024)
+
+/* Decoded images bigger than this are uploaded a strip at a time, over
+ * several main loop iterations, so that they do not hold up frames */
+#define MX_IMAGE_UPLOAD_CHUNK_SIZE (1024 * 1024)
+
+/* the materials and blank texture shared by all images */
+static CoglMaterial *mx_image_template_material = NULL;
+static CoglMaterial *mx_image_single_material = NULL;
+static CoglHandle mx_image_blank_texture = NULL;
+
+/* loads that have not finished, most recently requested first */
+static GQueue mx_image_loads = G_QUEUE_INIT;
+static gsize mx_image_queued_bytes = 0;
+static guint mx_image_load_serial = 0;
+
+/* used to work out which images have been painted in the last frame */
+static guint mx_image_frame = 1;
+static guint mx_image_repaint_id = 0;
+
 static gboolean
 mx_image_set_from_data_internal (MxImage          *image,
                                  const guchar     *data,
@@ -155,6 +259,30 @@ mx_image_set_from_data_internal (MxImage          *image,
                                  gint              rowstride,
                                  GError          **error);
 
+static CoglHandle
+mx_image_texture_new_from_data (const guchar    *data,
+                                CoglPixelFormat  pixel_format,
+                                gint             width,
+                                gint             height,
+                                gint             rowstride);
+
+static GdkPixbuf *
+mx_image_pixbuf_new (const gchar  *filename,
+                     guchar       *buffer,
+                     gsize         count,
+                     gint          width,
+                     gint          height,
+                     guint         width_threshold,
+                     guint         height_threshold,
+                     gboolean      upscale,
+                     gboolean     *scaled,
+                     GCancellable *cancellable,
+                     GError      **error);
+
+static void
+mx_image_async_cb (gpointer task_data,
+                   gpointer user_data);
+
 GQuark
 mx_image_error_quark (void)
 {
@@ -164,6 +292,9 @@ mx_image_error_quark (void)
 static void
 mx_image_async_data_free (MxImageAsyncData *data)
 {
+  if (data->link.data)
+    g_queue_unlink (&mx_image_loads, &data->link);
+
   if (data->free_func)
     data->free_func (data->buffer);
 
@@ -172,12 +303,18 @@ mx_image_async_data_free (MxImageAsyncData *data)
   if (data->idle_handler)
     g_source_remove (data->idle_handler);
 
-  if (data->pixbuf)
-    g_object_unref (data->pixbuf);
-
   if (data->error)
     g_error_free (data->error);
 
+  if (data->pixels)
+    g_bytes_unref (data->pixels);
+
+  if (data->texture)
+    cogl_handle_unref (data->texture);
+
+  g_object_unref (data->cancellable);
+  g_mutex_clear (&data->mutex);
+
   g_free (data);
 }
 
@@ -187,16 +324,202 @@ mx_image_async_data_new (MxImage *parent)
   MxImageAsyncData *data = g_new0 (MxImageAsyncData, 1);
 
   data->parent = parent;
+  data->cancellable = g_cancellable_new ();
   g_mutex_init (&data->mutex);
   data->width = -1;
   data->height = -1;
   data->upscale = parent->priv->upscale;
+  data->disk_cache = parent->priv->use_disk_cache;
   data->width_threshold = parent->priv->width_threshold;
   data->height_threshold = parent->priv->height_threshold;
 
   return data;
 }
 
+static gint
+mx_image_load_compare (gconstpointer a,
+                       gconstpointer b,
+                       gpointer      user_data)
+{
+  const MxImageAsyncData *data_a = a;
+  const MxImageAsyncData *data_b = b;
+
+  if (data_a->priority != data_b->priority)
+    return data_b->priority - data_a->priority;
+
+  /* Load the most recently requested image first, the older requests are
+   * more likely to have been scrolled past */
+  if (data_a->serial != data_b->serial)
+    return (data_a->serial > data_b->serial) ? -1 : 1;
+
+  return 0;
+}
+
+static MxImageLoadPriority
+mx_image_get_load_priority (MxImageAsyncData *data)
+{
+  MxImage *image = data->parent;
+
+  if (image->priv->painted_frame &&
+      image->priv->painted_frame + 1 >= mx_image_frame)
+    return MX_IMAGE_LOAD_VISIBLE;
+  else if (CLUTTER_ACTOR_IS_MAPPED (image))
+    return MX_IMAGE_LOAD_NEAR_VISIBLE;
+  else
+    return MX_IMAGE_LOAD_PREFETCH;
+}
+
+/* Hands waiting loads to the thread-pool, unless they are not visible and
+ * there are enough loads queued already */
+static void
+mx_image_schedule_loads (void)
+{
+  GList *l;
+
+  for (l = mx_image_loads.head; l; l = l->next)
+    {
+      MxImageAsyncData *data = l->data;
+
+      if (data->queued)
+        continue;
+
+      if (data->priority < MX_IMAGE_LOAD_VISIBLE &&
+          mx_image_queued_bytes > 0 &&
+          mx_image_queued_bytes + data->cost > MX_IMAGE_MAX_QUEUED_BYTES)
+        continue;
+
+      data->queued = TRUE;
+      mx_image_queued_bytes += data->cost;
+      g_thread_pool_push (mx_image_threads, data, NULL);
+    }
+}
+
+static gboolean
+mx_image_loads_repaint_cb (gpointer user_data)
+{
+  gboolean changed = FALSE;
+  GList *l;
+
+  /* images painted in the frame that just finished are visible */
+  mx_image_frame ++;
+
+  for (l = mx_image_loads.head; l; l = l->next)
+    {
+      MxImageAsyncData *data = l->data;
+      MxImageLoadPriority priority = mx_image_get_load_priority (data);
+
+      if (data->priority != priority)
+        {
+          data->priority = priority;
+          changed = TRUE;
+        }
+    }
+
+  if (changed)
+    {
+      /* this re-sorts the loads that are waiting for a thread */
+      g_thread_pool_set_sort_function (mx_image_threads,
+                                       mx_image_load_compare, NULL);
+      mx_image_schedule_loads ();
+    }
+
+  /* frames aren't counted while there is nothing to prioritise */
+  if (g_queue_is_empty (&mx_image_loads))
+    {
+      mx_image_repaint_id = 0;
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
+static gsize
+mx_image_get_load_cost (const gchar *filename,
+                        gsize        count)
+{
+  GStatBuf info;
+
+  if (!filename)
+    return count;
+
+  return (g_stat (filename, &info) == 0) ? info.st_size : 0;
+}
+
+/* Schedules a new load, or a load whose parameters have changed */
+static void
+mx_image_async_data_enqueue (MxImageAsyncData *data)
+{
+  if (!mx_image_repaint_id)
+    {
+      /* frames may have been painted since the last one that was counted,
+       * so images painted before now are no longer known to be visible */
+      mx_image_frame += 2;
+
+      mx_image_repaint_id =
+        clutter_threads_add_repaint_func_full (CLUTTER_REPAINT_FLAGS_POST_PAINT,
+                                               mx_image_loads_repaint_cb,
+                                               NULL, NULL);
+    }
+
+  data->serial = ++mx_image_load_serial;
+  data->priority = mx_image_get_load_priority (data);
+
+  if (data->link.data)
+    g_queue_unlink (&mx_image_loads, &data->link);
+  data->link.data = data;
+  g_queue_push_head_link (&mx_image_loads, &data->link);
+
+  mx_image_schedule_loads ();
+}
+
+/* Cancels a load. If it has been handed to the thread-pool, the load is
+ * freed by mx_image_load_complete_cb(), otherwise it is freed now */
+static void
+mx_image_async_data_cancel (MxImageAsyncData *data)
+{
+  data->cancelled = TRUE;
+  g_cancellable_cancel (data->cancellable);
+
+  if (data->link.data)
+    {
+      g_queue_unlink (&mx_image_loads, &data->link);
+      data->link.data = NULL;
+    }
+
+  if (data->queued)
+    {
+      /* discarded as soon as a thread is free, the next time the
+       * thread-pool is sorted */
+      data->priority = MX_IMAGE_LOAD_CANCELLED;
+    }
+  else
+    mx_image_async_data_free (data);
+}
+
+/* Creates the thread-pool images are loaded in, if it doesn't exist yet */
+static gboolean
+mx_image_ensure_threads (GError **error)
+{
+  if (mx_image_threads)
+    return TRUE;
+
+  mx_image_threads = g_thread_pool_new (mx_image_async_cb, NULL,
+#ifdef _SC_NPROCESSORS_ONLN
+                                        sysconf (_SC_NPROCESSORS_ONLN),
+#else
+                                        /* FIXME: add more OSs */
+                                        1,
+#endif
+                                        FALSE, error);
+  if (!mx_image_threads)
+    return FALSE;
+
+  g_thread_pool_set_sort_function (mx_image_threads,
+                                   mx_image_load_compare, NULL);
+
+  return TRUE;
+}
+
 static void
 get_center_coords (CoglHandle  tex,
                    float       rotation,
@@ -216,20 +539,18 @@ get_center_coords (CoglHandle  tex,
 }
 
 static gfloat
-calculate_scale (CoglHandle       texture,
-                 float            rotation,
-                 float            aw,
-                 float            ah,
-                 MxImageScaleMode mode)
+calculate_scale_for_size (float            bw,
+                          float            bh,
+                          float            rotation,
+                          float            aw,
+                          float            ah,
+                          MxImageScaleMode mode)
 {
-  float bw, bh, tmp, factor;
+  float tmp, factor;
 
   if (mode == MX_IMAGE_SCALE_NONE)
     return 1.0;
 
-  bw = cogl_texture_get_width (texture); /* base texture width */
-  bh = cogl_texture_get_height (texture); /* base texture height */
-
   /* account for the 1px transparent border */
   bw -= 2; bh -= 2;
 
@@ -260,6 +581,422 @@ calculate_scale (CoglHandle       texture,
     }
 }
 
+static gfloat
+calculate_scale (CoglHandle       texture,
+                 float            rotation,
+                 float            aw,
+                 float            ah,
+                 MxImageScaleMode mode)
+{
+  return calculate_scale_for_size (cogl_texture_get_width (texture),
+                                   cogl_texture_get_height (texture),
+                                   rotation, aw, ah, mode);
+}
+
+/* Renders a copy of @texture at half the size, keeping the 1px transparent
+ * border around it */
+static CoglHandle
+mx_image_halve_texture (CoglHandle texture)
+{
+  gint width, height, new_width, new_height;
+  CoglMaterial *tex_material, *clear_material;
+  CoglHandle new_texture, fbo;
+  CoglColor transparent;
+
+  /* the size of the image, without the border */
+  width = cogl_texture_get_width (texture) - 2;
+  height = cogl_texture_get_height (texture) - 2;
+
+  new_width = MAX (1, width / 2);
+  new_height = MAX (1, height / 2);
+
+  new_texture = cogl_texture_new_with_size (new_width + 2, new_height + 2,
+                                            COGL_TEXTURE_NO_ATLAS,
+                                            cogl_texture_get_format (texture));
+  if (!new_texture)
+    return NULL;
+
+  fbo = cogl_offscreen_new_to_texture (new_texture);
+  if (!fbo)
+    {
+      cogl_handle_unref (new_texture);
+      return NULL;
+    }
+
+  /* copy the bits without blending them with the destination */
+  tex_material = cogl_material_new ();
+  cogl_material_set_blend (tex_material, "RGBA=ADD(SRC_COLOR, 0)", NULL);
+
+  clear_material = cogl_material_copy (tex_material);
+  cogl_color_init_from_4ub (&transparent, 0, 0, 0, 0);
+  cogl_material_set_color (clear_material, &transparent);
+
+  /* sampling halfway between texels averages each 2x2 block of the image */
+  cogl_material_set_layer (tex_material, 0, texture);
+  cogl_material_set_layer_filters (tex_material, 0,
+                                   COGL_MATERIAL_FILTER_LINEAR,
+                                   COGL_MATERIAL_FILTER_LINEAR);
+
+  cogl_push_framebuffer (fbo);
+  cogl_ortho (0, new_width + 2, new_height + 2, 0, -1, 1);
+
+  /* draw the image, without its border, into the middle */
+  cogl_push_source (tex_material);
+  cogl_rectangle_with_texture_coords (1, 1, new_width + 1, new_height + 1,
+                                      1.0 / (width + 2),
+                                      1.0 / (height + 2),
+                                      (width + 1.0) / (width + 2),
+                                      (height + 1.0) / (height + 2));
+
+  /* clear the border */
+  cogl_set_source (clear_material);
+  cogl_rectangle (0, 0, new_width + 2, 1);
+  cogl_rectangle (0, new_height + 1, new_width + 2, new_height + 2);
+  cogl_rectangle (0, 1, 1, new_height + 1);
+  cogl_rectangle (new_width + 1, 1, new_width + 2, new_height + 1);
+
+  cogl_pop_source ();
+  cogl_pop_framebuffer ();
+
+  cogl_object_unref (clear_material);
+  cogl_object_unref (tex_material);
+  cogl_handle_unref (fbo);
+
+  return new_texture;
+}
+
+/* Starts loading the full-size texture from the file again, after the
+ * texture cache has evicted it. The load is handed to the thread-pool like
+ * any other, and mx_image_set_reloaded_texture() is called once it has been
+ * uploaded */
+static void
+mx_image_reload_texture (MxImage *image)
+{
+  MxImagePrivate *priv = image->priv;
+  MxImageAsyncData *data;
+
+  if (priv->reload_data || !priv->uri || !mx_image_ensure_threads (NULL))
+    return;
+
+  priv->reload_data = data = mx_image_async_data_new (image);
+  data->reload = TRUE;
+  data->filename = g_strdup (priv->uri);
+  data->disk_cache = FALSE;
+  data->cost = mx_image_get_load_cost (data->filename, 0);
+  mx_image_async_data_enqueue (data);
+}
+
+static void
+mx_image_cancel_reload (MxImage *image)
+{
+  MxImagePrivate *priv = image->priv;
+
+  if (priv->reload_data)
+    {
+      mx_image_async_data_cancel (priv->reload_data);
+      priv->reload_data = NULL;
+    }
+}
+
+/* Gets the full-size texture again after it was released while a variant
+ * was painted. Returns %FALSE if it isn't in the texture cache any more, in
+ * which case it is loaded from the file again in the background */
+static gboolean
+mx_image_ensure_texture (MxImage *image)
+{
+  MxImagePrivate *priv = image->priv;
+  CoglHandle texture;
+
+  if (priv->texture)
+    return TRUE;
+
+  texture = mx_texture_cache_get_meta_cogl_texture (mx_texture_cache_get_default (),
+                                                    priv->uri,
+                                                    GINT_TO_POINTER (mx_image_cache_quark));
+  if (!texture)
+    {
+      mx_image_reload_texture (image);
+      return FALSE;
+    }
+
+  priv->texture = texture;
+
+  return TRUE;
+}
+
+/* Returns the key the variant of the image at @level is stored under in
+ * the texture cache. The size is that of the image halved @level times,
+ * without its border, as mx_image_halve_texture() makes it */
+static gchar *
+mx_image_get_variant_uri (MxImage *image,
+                          guint    level)
+{
+  MxImagePrivate *priv = image->priv;
+  gint width = priv->texture_width - 2;
+  gint height = priv->texture_height - 2;
+
+  for (; level; level--)
+    {
+      width = MAX (1, width / 2);
+      height = MAX (1, height / 2);
+    }
+
+  return g_strdup_printf ("mx-image-variant://%dx%d/%s", width, height,
+                          priv->uri);
+}
+
+/* Returns a reference to the variant of the current texture at @level,
+ * making it from the next largest level if it isn't in the cache. Without
+ * a URI the larger levels are only kept while the variant is made. */
+static CoglHandle
+mx_image_get_variant (MxImage *image,
+                      guint    level)
+{
+  MxImagePrivate *priv = image->priv;
+  MxTextureCache *cache;
+  CoglHandle variant, larger;
+  gchar *variant_uri = NULL;
+
+  if (level == 0)
+    {
+      if (!mx_image_ensure_texture (image))
+        return NULL;
+
+      return cogl_handle_ref (priv->texture);
+    }
+
+  if (priv->variant && level == priv->variant_level)
+    return cogl_handle_ref (priv->variant);
+
+  cache = mx_texture_cache_get_default ();
+
+  if (priv->uri)
+    {
+      variant_uri = mx_image_get_variant_uri (image, level);
+      variant = mx_texture_cache_get_meta_cogl_texture (cache, variant_uri,
+                  GINT_TO_POINTER (mx_image_cache_quark));
+
+      if (variant)
+        {
+          g_free (variant_uri);
+          return variant;
+        }
+    }
+
+  larger = mx_image_get_variant (image, level - 1);
+  variant = larger ? mx_image_halve_texture (larger) : NULL;
+
+  if (larger)
+    cogl_handle_unref (larger);
+
+  if (variant && variant_uri)
+    mx_texture_cache_insert_meta (cache, variant_uri,
+                                  GINT_TO_POINTER (mx_image_cache_quark),
+                                  variant, NULL);
+
+  g_free (variant_uri);
+
+  return variant;
+}
+
+static void
+mx_image_release_variant (MxImage *image)
+{
+  MxImagePrivate *priv = image->priv;
+
+  if (priv->variant)
+    {
+      cogl_handle_unref (priv->variant);
+      priv->variant = NULL;
+    }
+
+  priv->variant_level = 0;
+
+  /* the full-size texture is only reloaded to paint or make a variant */
+  mx_image_cancel_reload (image);
+}
+
+/* Returns the level of the smallest variant of the image that is still at
+ * least as large as the image is drawn at @aw x @ah */
+static guint
+mx_image_get_variant_level (MxImage *image,
+                            gfloat   aw,
+                            gfloat   ah)
+{
+  MxImagePrivate *priv = image->priv;
+  gint width, height;
+  guint level = 0;
+  gfloat scale;
+
+  if (!priv->use_scaled_variants || aw < 1 || ah < 1 ||
+      !clutter_feature_available (CLUTTER_FEATURE_OFFSCREEN))
+    return 0;
+
+  scale = calculate_scale_for_size (priv->texture_width, priv->texture_height,
+                                    priv->rotation, aw, ah, priv->mode);
+
+  width = priv->texture_width - 2;
+  height = priv->texture_height - 2;
+
+  while (scale >= 2.0 && level < MX_IMAGE_MAX_VARIANT_LEVEL &&
+         width >= 2 && height >= 2)
+    {
+      scale /= 2;
+      width /= 2;
+      height /= 2;
+      level ++;
+    }
+
+  return level;
+}
+
+/* Paints the variant that suits the size the image is drawn at, so that a
+ * large image drawn small doesn't sample the whole texture every frame. The
+ * variant is only changed when the image isn't fading from a previous one.
+ *
+ * While a variant of an image from the texture cache is painted, the
+ * full-size texture is released, so that the cache can evict it. It is
+ * loaded again when it is needed. */
+static void
+mx_image_update_variant (MxImage *image)
+{
+  MxImagePrivate *priv = image->priv;
+  ClutterActorBox box;
+  MxPadding padding;
+  CoglHandle variant;
+  guint level;
+
+  if (!priv->material || priv->old_texture ||
+      clutter_timeline_is_playing (priv->redraw_timeline))
+    return;
+
+  clutter_actor_get_allocation_box (CLUTTER_ACTOR (image), &box);
+  mx_widget_get_padding (MX_WIDGET (image), &padding);
+
+  level = mx_image_get_variant_level (image,
+                                      box.x2 - box.x1 - padding.left -
+                                      padding.right,
+                                      box.y2 - box.y1 - padding.top -
+                                      padding.bottom);
+
+  if (level == priv->variant_level)
+    return;
+
+  if (level)
+    {
+      variant = mx_image_get_variant (image, level);
+      if (!variant)
+        return;
+    }
+  else
+    {
+      /* back to the full-size texture */
+      if (!mx_image_ensure_texture (image))
+        return;
+
+      variant = NULL;
+    }
+
+  /* drop the reference to the previous level; it stays in the texture
+   * cache until the cache needs the space */
+  mx_image_release_variant (image);
+
+  priv->variant = variant;
+  priv->variant_level = level;
+
+  if (variant && priv->uri && priv->texture)
+    {
+      cogl_handle_unref (priv->texture);
+      priv->texture = NULL;
+    }
+
+  clutter_actor_queue_redraw (CLUTTER_ACTOR (image));
+}
+
+static gboolean
+mx_image_variant_updates_cb (gpointer user_data)
+{
+  GList *images, *l;
+
+  images = mx_image_variant_updates;
+  mx_image_variant_updates = NULL;
+  mx_image_variant_updates_id = 0;
+
+  for (l = images; l; l = l->next)
+    {
+      MxImage *image = l->data;
+
+      image->priv->variant_update_queued = FALSE;
+      mx_image_update_variant (image);
+    }
+
+  g_list_free (images);
+
+  return FALSE;
+}
+
+static void
+mx_image_queue_variant_update (MxImage *image)
+{
+  MxImagePrivate *priv = image->priv;
+
+  if (priv->variant_update_queued)
+    return;
+
+  priv->variant_update_queued = TRUE;
+  mx_image_variant_updates = g_list_prepend (mx_image_variant_updates, image);
+
+  if (!mx_image_variant_updates_id)
+    mx_image_variant_updates_id =
+      clutter_threads_add_idle_full (G_PRIORITY_DEFAULT_IDLE,
+                                     mx_image_variant_updates_cb,
+                                     NULL, NULL);
+}
+
+static void
+mx_image_unqueue_variant_update (MxImage *image)
+{
+  MxImagePrivate *priv = image->priv;
+
+  if (!priv->variant_update_queued)
+    return;
+
+  priv->variant_update_queued = FALSE;
+  mx_image_variant_updates = g_list_remove (mx_image_variant_updates, image);
+
+  if (!mx_image_variant_updates && mx_image_variant_updates_id)
+    {
+      g_source_remove (mx_image_variant_updates_id);
+      mx_image_variant_updates_id = 0;
+    }
+}
+
+/* Makes @texture, the full-size texture loaded again by
+ * mx_image_reload_texture(), the image's texture again. Takes ownership of
+ * @texture */
+static void
+mx_image_set_reloaded_texture (MxImage    *image,
+                               CoglHandle  texture)
+{
+  MxImagePrivate *priv = image->priv;
+
+  /* the file may have changed since it was first loaded */
+  if (priv->texture || !priv->uri ||
+      cogl_texture_get_width (texture) != priv->texture_width ||
+      cogl_texture_get_height (texture) != priv->texture_height)
+    {
+      cogl_handle_unref (texture);
+      return;
+    }
+
+  mx_texture_cache_insert_meta (mx_texture_cache_get_default (), priv->uri,
+                                GINT_TO_POINTER (mx_image_cache_quark),
+                                texture, NULL);
+  priv->texture = texture;
+
+  mx_image_queue_variant_update (image);
+}
+
 static void
 mx_image_paint (ClutterActor *actor)
 {
@@ -270,6 +1007,7 @@ mx_image_paint (ClutterActor *actor)
   float tex_coords[8];
   MxPadding padding;
   CoglMatrix matrix;
+  CoglHandle texture;
   gfloat scale = 1;
   gfloat ratio;
   CoglColor color;
@@ -277,6 +1015,9 @@ mx_image_paint (ClutterActor *actor)
   /* chain up to draw the background */
   CLUTTER_ACTOR_CLASS (mx_image_parent_class)->paint (actor);
 
+  /* raises the priority of a pending load */
+  priv->painted_frame = mx_image_frame;
+
   if (!priv->material)
     return;
 
@@ -291,8 +1032,19 @@ mx_image_paint (ClutterActor *actor)
   aw -= (float) (padding.left + padding.right);
   ah -= (float) (padding.top + padding.bottom);
 
-  bw = cogl_texture_get_width (priv->texture); /* base texture width */
-  bh = cogl_texture_get_height (priv->texture); /* base texture height */
+  /* paint a smaller variant of the texture, if there is one, and change to
+   * the variant that suits this size after the frame. A reload of the
+   * full-size texture queues an update when it finishes */
+  if (!priv->old_texture && !priv->reload_data &&
+      !clutter_timeline_is_playing (priv->redraw_timeline) &&
+      mx_image_get_variant_level (MX_IMAGE (actor), aw, ah) !=
+      priv->variant_level)
+    mx_image_queue_variant_update (MX_IMAGE (actor));
+
+  texture = priv->variant ? priv->variant : priv->texture;
+
+  bw = cogl_texture_get_width (texture); /* base texture width */
+  bh = cogl_texture_get_height (texture); /* base texture height */
   ratio = bw/bh;
 
   alpha = clutter_actor_get_paint_opacity (actor);
@@ -307,20 +1059,20 @@ mx_image_paint (ClutterActor *actor)
   else
     {
       cogl_material_set_color (priv->material, &color);
-      cogl_material_set_layer (priv->material, 0, priv->texture);
+      cogl_material_set_layer (priv->material, 0, texture);
     }
 
   /* calculate texture co-ordinates */
-  get_center_coords (priv->texture, priv->rotation, aw, ah, tex_coords);
+  get_center_coords (texture, priv->rotation, aw, ah, tex_coords);
 
   /* current texture */
-  scale = calculate_scale (priv->texture, priv->rotation, aw, ah, priv->mode);
+  scale = calculate_scale (texture, priv->rotation, aw, ah, priv->mode);
 
   if (clutter_timeline_is_playing (priv->redraw_timeline))
     {
       gfloat progress, previous_scale;
 
-      previous_scale = calculate_scale (priv->texture, priv->rotation, aw, ah,
+      previous_scale = calculate_scale (texture, priv->rotation, aw, ah,
                                         priv->previous_mode);
 
       progress = clutter_timeline_get_progress (priv->redraw_timeline);
@@ -386,7 +1138,7 @@ mx_image_get_preferred_width (ClutterActor *actor,
 
   mx_widget_get_padding (MX_WIDGET (actor), &padding);
 
-  width = cogl_texture_get_width (priv->texture);
+  width = priv->texture_width;
 
   if (min_width)
     *min_width = 0;
@@ -407,7 +1159,7 @@ mx_image_get_preferred_height (ClutterActor *actor,
 
   mx_widget_get_padding (MX_WIDGET (actor), &padding);
 
-  height = cogl_texture_get_height (priv->texture);
+  height = priv->texture_height;
 
   if (min_height)
     *min_height = 0;
@@ -458,6 +1210,14 @@ mx_image_set_property (GObject      *object,
       mx_image_set_from_file (image, g_value_get_string (value), NULL);
       break;
 
+    case PROP_USE_DISK_CACHE:
+      mx_image_set_use_disk_cache (image, g_value_get_boolean (value));
+      break;
+
+    case PROP_USE_SCALED_VARIANTS:
+      mx_image_set_use_scaled_variants (image, g_value_get_boolean (value));
+      break;
+
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -502,6 +1262,14 @@ mx_image_get_property (GObject    *object,
       g_value_set_uint (value, priv->transition_duration);
       break;
 
+    case PROP_USE_DISK_CACHE:
+      g_value_set_boolean (value, priv->use_disk_cache);
+      break;
+
+    case PROP_USE_SCALED_VARIANTS:
+      g_value_set_boolean (value, priv->use_scaled_variants);
+      break;
+
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -538,6 +1306,12 @@ mx_image_dispose (GObject *object)
       priv->material = NULL;
     }
 
+  mx_image_unqueue_variant_update (MX_IMAGE (object));
+  mx_image_release_variant (MX_IMAGE (object));
+
+  g_free (priv->uri);
+  priv->uri = NULL;
+
   if (priv->texture)
     {
       cogl_object_unref (priv->texture);
@@ -568,7 +1342,7 @@ mx_image_dispose (GObject *object)
 
   if (priv->async_load_data)
     {
-      priv->async_load_data->cancelled = TRUE;
+      mx_image_async_data_cancel (priv->async_load_data);
       priv->async_load_data = NULL;
     }
 
@@ -663,6 +1437,48 @@ mx_image_class_init (MxImageClass *klass)
 
   g_object_class_install_property (object_class, PROP_FILENAME, pspec);
 
+  /**
+   * MxImage:use-disk-cache:
+   *
+   * Whether images loaded from files at a particular size are stored in
+   * the user's cache directory once they have been decoded and scaled.
+   * This makes loading the same image at the same size again, for example
+   * when an application is started again, much quicker.
+   *
+   * Since: 2.0
+   */
+  pspec = g_param_spec_boolean ("use-disk-cache",
+                                "Use Disk Cache",
+                                "Whether to keep scaled images in the "
+                                "disk cache",
+                                FALSE,
+                                G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+  g_object_class_install_property (object_class, PROP_USE_DISK_CACHE, pspec);
+
+  /**
+   * MxImage:use-scaled-variants:
+   *
+   * Whether a smaller copy of the image is painted when the image is drawn
+   * at less than half of its size, for example by the
+   * %MX_IMAGE_SCALE_FIT and %MX_IMAGE_SCALE_CROP scale modes. The copies
+   * are made by halving the image as many times as possible while staying
+   * larger than the allocation. Copies of images loaded from a file at
+   * their full size are kept in the texture cache, keyed on the file and
+   * the size of the copy, and are shared by all images showing that file.
+   *
+   * Since: 2.0
+   */
+  pspec = g_param_spec_boolean ("use-scaled-variants",
+                                "Use Scaled Variants",
+                                "Whether to paint smaller copies of the "
+                                "image when it is drawn smaller",
+                                FALSE,
+                                G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+  g_object_class_install_property (object_class, PROP_USE_SCALED_VARIANTS,
+                                   pspec);
+
   /**
    * MxImage::image-loaded:
    * @image: the #MxImage that emitted the signal
@@ -714,9 +1530,7 @@ create_new_material (MxImage *image,
       if (priv->material)
         cogl_object_unref (priv->material);
 
-      priv->material = cogl_material_new ();
-      cogl_material_set_layer_wrap_mode (priv->material, 0,
-                                         COGL_MATERIAL_WRAP_MODE_CLAMP_TO_EDGE);
+      priv->material = cogl_material_copy (mx_image_single_material);
 
       return;
     }
@@ -774,47 +1588,39 @@ timeline_complete (ClutterTimeline *timeline,
   create_new_material (image, 1.0);
 }
 
+/* Creates the materials shared by all images. All of the materials used by
+ * images are copies of these, so they share their state and Cogl only has
+ * to generate one program for them. */
 static void
-mx_image_init (MxImage *self)
+mx_image_ensure_materials (void)
 {
-  MxImagePrivate *priv;
   guchar data[4] = { 0, 0, 0, 0 };
 
-  priv = self->priv = MX_IMAGE_GET_PRIVATE (self);
-
-  priv->transition_duration = DEFAULT_DURATION;
-  priv->timeline = clutter_timeline_new (priv->transition_duration);
-  priv->redraw_timeline = clutter_timeline_new (200);
-  clutter_timeline_set_progress_mode (priv->redraw_timeline,
-                                      CLUTTER_EASE_OUT_CUBIC);
-
-  g_signal_connect (priv->timeline, "new-frame", G_CALLBACK (new_frame_cb),
-                    self);
-  g_signal_connect (priv->timeline, "completed", G_CALLBACK (timeline_complete),
-                    self);
-
-  g_signal_connect_swapped (priv->redraw_timeline, "new-frame",
-                            G_CALLBACK (clutter_actor_queue_redraw), self);
+  if (mx_image_template_material)
+    return;
 
-  priv->blank_texture = cogl_texture_new_from_data (1, 1, COGL_TEXTURE_NO_ATLAS,
-                                                    COGL_PIXEL_FORMAT_RGBA_8888,
-                                                    COGL_PIXEL_FORMAT_ANY,
-                                                    1, data);
+  mx_image_blank_texture =
+    cogl_texture_new_from_data (1, 1, COGL_TEXTURE_NO_ATLAS,
+                                COGL_PIXEL_FORMAT_RGBA_8888,
+                                COGL_PIXEL_FORMAT_ANY,
+                                1, data);
 
   /* set up the initial material */
-  priv->template_material = cogl_material_new ();
+  mx_image_template_material = cogl_material_new ();
 
-  cogl_material_set_layer (priv->template_material, 1, priv->blank_texture);
-  cogl_material_set_layer (priv->template_material, 0, priv->blank_texture);
+  cogl_material_set_layer (mx_image_template_material, 1,
+                           mx_image_blank_texture);
+  cogl_material_set_layer (mx_image_template_material, 0,
+                           mx_image_blank_texture);
 
-  cogl_material_set_layer_wrap_mode (priv->template_material, 0,
+  cogl_material_set_layer_wrap_mode (mx_image_template_material, 0,
                                      COGL_MATERIAL_WRAP_MODE_CLAMP_TO_EDGE);
-  cogl_material_set_layer_wrap_mode (priv->template_material, 1,
+  cogl_material_set_layer_wrap_mode (mx_image_template_material, 1,
                                      COGL_MATERIAL_WRAP_MODE_CLAMP_TO_EDGE);
 
   /* override the default combination description in the first layer so that the
    * paint opacity is not applied to the texture */
-  cogl_material_set_layer_combine (priv->template_material, 0,
+  cogl_material_set_layer_combine (mx_image_template_material, 0,
                                    "RGBA = REPLACE (TEXTURE)",
                                    NULL);
 
@@ -825,17 +1631,48 @@ mx_image_init (MxImage *self)
    * current one, using the alpha component of a constant color as
    * the interpolation factor.
    */
-  cogl_material_set_layer_combine (priv->template_material, 1,
+  cogl_material_set_layer_combine (mx_image_template_material, 1,
                                    "RGBA = INTERPOLATE (PREVIOUS, "
                                                        "TEXTURE, "
                                                        "CONSTANT[A])",
                                    NULL);
 
   /* apply the paint opacity */
-  cogl_material_set_layer_combine (priv->template_material, 2,
+  cogl_material_set_layer_combine (mx_image_template_material, 2,
                                    "RGBA = MODULATE (PREVIOUS, CONSTANT[A])",
                                    NULL);
 
+  /* the material used once the transition has finished */
+  mx_image_single_material = cogl_material_new ();
+  cogl_material_set_layer_wrap_mode (mx_image_single_material, 0,
+                                     COGL_MATERIAL_WRAP_MODE_CLAMP_TO_EDGE);
+}
+
+static void
+mx_image_init (MxImage *self)
+{
+  MxImagePrivate *priv;
+  priv = self->priv = MX_IMAGE_GET_PRIVATE (self);
+
+  priv->transition_duration = DEFAULT_DURATION;
+  priv->timeline = clutter_timeline_new (priv->transition_duration);
+  priv->redraw_timeline = clutter_timeline_new (200);
+  clutter_timeline_set_progress_mode (priv->redraw_timeline,
+                                      CLUTTER_EASE_OUT_CUBIC);
+
+  g_signal_connect (priv->timeline, "new-frame", G_CALLBACK (new_frame_cb),
+                    self);
+  g_signal_connect (priv->timeline, "completed", G_CALLBACK (timeline_complete),
+                    self);
+
+  g_signal_connect_swapped (priv->redraw_timeline, "new-frame",
+                            G_CALLBACK (clutter_actor_queue_redraw), self);
+
+  mx_image_ensure_materials ();
+
+  priv->blank_texture = cogl_object_ref (mx_image_blank_texture);
+  priv->template_material = cogl_object_ref (mx_image_template_material);
+
   /* set the transparent texture to start from */
   mx_image_clear (self);
 }
@@ -948,19 +1785,50 @@ mx_image_prepare_texture (MxImage  *image)
   cogl_material_set_layer (priv->material, 1, priv->old_texture);
   cogl_material_set_layer (priv->material, 0, priv->texture);
 
+  priv->texture_width = cogl_texture_get_width (priv->texture);
+  priv->texture_height = cogl_texture_get_height (priv->texture);
+
   /* start the cross fade animation. When not having a transition duration,
-   * we directly jump forward a create the material corresponding to the end
-   * of the transition animation */
+   * we directly jump forward to the end of the transition animation, which
+   * drops the old texture */
   clutter_timeline_stop (priv->timeline);
   if (priv->transition_duration)
     clutter_timeline_start (priv->timeline);
   else
-    create_new_material (image, 1.0);
+    timeline_complete (priv->timeline, image);
 
   /* the image has changed size, so update the preferred width/height */
   clutter_actor_queue_relayout (CLUTTER_ACTOR (image));
 }
 
+/* Makes @texture the current image, fading from the previous one. Takes
+ * ownership of @texture */
+static void
+mx_image_replace_texture (MxImage    *image,
+                          CoglHandle  texture)
+{
+  MxImagePrivate *priv = image->priv;
+
+  if (priv->old_texture)
+    cogl_object_unref (priv->old_texture);
+
+  /* fade from the variant if the full-size texture has been released */
+  if (priv->texture)
+    priv->old_texture = priv->texture;
+  else
+    priv->old_texture = cogl_handle_ref (priv->variant);
+  priv->old_rotation = priv->rotation;
+  priv->old_mode = priv->mode;
+
+  mx_image_release_variant (image);
+  g_free (priv->uri);
+  priv->uri = NULL;
+
+  priv->texture = texture;
+
+  mx_image_prepare_texture (image);
+}
+
 static void
 mx_image_cancel_in_progress (MxImage *image)
 {
@@ -969,9 +1837,11 @@ mx_image_cancel_in_progress (MxImage *image)
   /* Cancel any asynchronous image load */
   if (priv->async_load_data)
     {
-      priv->async_load_data->cancelled = TRUE;
+      mx_image_async_data_cancel (priv->async_load_data);
       priv->async_load_data = NULL;
     }
+
+  mx_image_cancel_reload (image);
 }
 
 /**
@@ -991,10 +1861,16 @@ mx_image_clear (MxImage *image)
 
   mx_image_cancel_in_progress (image);
 
+  mx_image_release_variant (image);
+  g_free (priv->uri);
+  priv->uri = NULL;
+
   if (priv->texture)
     cogl_object_unref (priv->texture);
 
   priv->texture = cogl_object_ref (priv->blank_texture);
+  priv->texture_width = cogl_texture_get_width (priv->texture);
+  priv->texture_height = cogl_texture_get_height (priv->texture);
 
 
   if (priv->old_texture)
@@ -1008,12 +1884,58 @@ mx_image_clear (MxImage *image)
   if (priv->material)
     cogl_object_unref (priv->material);
 
-  priv->material = cogl_object_ref (priv->template_material);
+  /* paint modifies the material, so the template can't be used directly */
+  priv->material = cogl_material_copy (priv->template_material);
 
   /* the image has changed size, so update the preferred width/height */
   clutter_actor_queue_relayout (CLUTTER_ACTOR (image));
 }
 
+/* Creates a texture of an image with a 1px transparent border around it */
+static CoglHandle
+mx_image_texture_new_from_data (const guchar    *data,
+                                CoglPixelFormat  pixel_format,
+                                gint             width,
+                                gint             height,
+                                gint             rowstride)
+{
+  CoglHandle texture;
+  gint *blank_area;
+
+  texture = cogl_texture_new_with_size (width + 2, height + 2,
+                                        COGL_TEXTURE_NO_ATLAS,
+                                        COGL_PIXEL_FORMAT_ANY);
+  if (!texture)
+    return NULL;
+
+  /* Create the new texture */
+  cogl_texture_set_region (texture, 0, 0, 1, 1,
+                           width, height, width, height,
+                           pixel_format, rowstride, data);
+
+  /* Blit a transparent buffer around the texture */
+  blank_area = g_new0 (gint, MAX (width, height) + 2);
+  cogl_texture_set_region (texture, 0, 0, 0, 0,
+                           width, 1, width, 1,
+                           COGL_PIXEL_FORMAT_RGBA_8888, (width + 2) * 4,
+                           (const guint8 *)blank_area);
+  cogl_texture_set_region (texture, 0, 0, 0, height + 1,
+                           width + 2, 1, width + 2, 1,
+                           COGL_PIXEL_FORMAT_RGBA_8888, (width + 2) * 4,
+                           (const guint8 *)blank_area);
+  cogl_texture_set_region (texture, 0, 0, 0, 0,
+                           1, height + 2, 1, height + 2,
+                           COGL_PIXEL_FORMAT_RGBA_8888, 4,
+                           (const guint8 *)blank_area);
+  cogl_texture_set_region (texture, 0, 0, width + 1, 0,
+                           1, height + 2, 1, height + 2,
+                           COGL_PIXEL_FORMAT_RGBA_8888, 4,
+                           (const guint8 *)blank_area);
+  g_free (blank_area);
+
+  return texture;
+}
+
 /*
  * mx_image_set_from_data_internal:
  * @image: An #MxImage
@@ -1081,11 +2003,9 @@ mx_image_set_from_data_internal (MxImage          *image,
     }
   else
     {
-      gint *blank_area;
-
-      priv->texture = cogl_texture_new_with_size (width + 2, height + 2,
-                                                  COGL_TEXTURE_NO_ATLAS,
-                                                  COGL_PIXEL_FORMAT_ANY);
+      priv->texture = mx_image_texture_new_from_data (data, pixel_format,
+                                                      width, height,
+                                                      rowstride);
 
       if (!priv->texture)
         {
@@ -1097,31 +2017,6 @@ mx_image_set_from_data_internal (MxImage          *image,
           return FALSE;
         }
 
-      /* Create the new texture */
-      cogl_texture_set_region (priv->texture, 0, 0, 1, 1,
-                               width, height, width, height,
-                               pixel_format, rowstride, data);
-
-      /* Blit a transparent buffer around the texture */
-      blank_area = g_new0 (gint, MAX (width, height) + 2);
-      cogl_texture_set_region (priv->texture, 0, 0, 0, 0,
-                               width, 1, width, 1,
-                               COGL_PIXEL_FORMAT_RGBA_8888, (width + 2) * 4,
-                               (const guint8 *)blank_area);
-      cogl_texture_set_region (priv->texture, 0, 0, 0, height + 1,
-                               width + 2, 1, width + 2, 1,
-                               COGL_PIXEL_FORMAT_RGBA_8888, (width + 2) * 4,
-                               (const guint8 *)blank_area);
-      cogl_texture_set_region (priv->texture, 0, 0, 0, 0,
-                               1, height + 2, 1, height + 2,
-                               COGL_PIXEL_FORMAT_RGBA_8888, 4,
-                               (const guint8 *)blank_area);
-      cogl_texture_set_region (priv->texture, 0, 0, width + 1, 0,
-                               1, height + 2, 1, height + 2,
-                               COGL_PIXEL_FORMAT_RGBA_8888, 4,
-                               (const guint8 *)blank_area);
-      g_free (blank_area);
-
       /* Insert the processed image into the cache, if we have a URI */
       if (uri)
         {
@@ -1131,6 +2026,15 @@ mx_image_set_from_data_internal (MxImage          *image,
         }
     }
 
+  /* fade from the variant if the full-size texture has been released */
+  if (!old_texture)
+    old_texture = cogl_handle_ref (priv->variant);
+
+  /* the texture is the one in the cache for uri, if there is one */
+  mx_image_release_variant (image);
+  g_free (priv->uri);
+  priv->uri = g_strdup (uri);
+
   /* Replace the old texture */
   if (priv->old_texture)
     cogl_object_unref (priv->old_texture);
@@ -1263,13 +2167,165 @@ mx_image_set_from_pixbuf (MxImage      *image,
       has_alpha = TRUE;
     }
 
-  return
-    mx_image_set_from_data_internal (image,
-                                 pixbuf ? gdk_pixbuf_get_pixels (pixbuf) : NULL,
-                                 filename, TRUE,
-                                 has_alpha ? COGL_PIXEL_FORMAT_RGBA_8888 :
-                                             COGL_PIXEL_FORMAT_RGB_888,
-                                 width, height, rowstride, error);
+  return
+    mx_image_set_from_data_internal (image,
+                                 pixbuf ? gdk_pixbuf_get_pixels (pixbuf) : NULL,
+                                 filename, TRUE,
+                                 has_alpha ? COGL_PIXEL_FORMAT_RGBA_8888 :
+                                             COGL_PIXEL_FORMAT_RGB_888,
+                                 width, height, rowstride, error);
+}
+
+/* Uploads the next strip of a decoded image to its texture. Returns %TRUE
+ * once the whole image has been uploaded */
+static gboolean
+mx_image_upload_rows (MxImageAsyncData *data)
+{
+  gint width = data->pixels_width + 2;
+  gint height = data->pixels_height + 2;
+  gint rowstride = width * 4;
+  gint n_rows;
+
+  n_rows = MAX (1, MX_IMAGE_UPLOAD_CHUNK_SIZE / rowstride);
+  n_rows = MIN (n_rows, height - data->upload_row);
+
+  cogl_texture_set_region (data->texture, 0, 0, 0, data->upload_row,
+                           width, n_rows, width, n_rows,
+                           COGL_PIXEL_FORMAT_RGBA_8888_PRE, rowstride,
+                           (const guchar *) g_bytes_get_data (data->pixels,
+                                                              NULL) +
+                           data->upload_row * rowstride);
+
+  data->upload_row += n_rows;
+
+  return (data->upload_row >= height);
+}
+
+/* Reports the error in @data, which couldn't be loaded or uploaded */
+static void
+mx_image_load_failed (MxImageAsyncData *data)
+{
+  if (data->reload)
+    {
+      /* keep painting the variant */
+      data->parent->priv->reload_data = NULL;
+      return;
+    }
+
+  /* Reset the current async image load data pointer */
+  data->parent->priv->async_load_data = NULL;
+
+  g_signal_emit (data->parent, signals[IMAGE_LOAD_ERROR], 0, data->error);
+}
+
+static void
+mx_image_upload_complete (MxImageAsyncData *data)
+{
+  MxImage *image = data->parent;
+  CoglHandle texture = data->texture;
+
+  data->texture = NULL;
+
+  if (data->reload)
+    {
+      image->priv->reload_data = NULL;
+      mx_image_set_reloaded_texture (image, texture);
+      return;
+    }
+
+  image->priv->async_load_data = NULL;
+
+  mx_image_replace_texture (image, texture);
+
+  /* Insert the processed image into the cache, if it is the size of the
+   * file (see mx_image_async_cb()) */
+  if (data->filename && data->width == -1 && data->height == -1)
+    {
+      mx_texture_cache_insert_meta (mx_texture_cache_get_default (),
+                                    data->filename,
+                                    GINT_TO_POINTER (mx_image_cache_quark),
+                                    texture, NULL);
+      image->priv->uri = g_strdup (data->filename);
+    }
+
+  g_signal_emit (image, signals[IMAGE_LOADED], 0);
+}
+
+static gboolean
+mx_image_upload_cb (gpointer user_data)
+{
+  MxImageAsyncData *data = user_data;
+
+  if (!data->cancelled && !mx_image_upload_rows (data))
+    return TRUE;
+
+  data->idle_handler = 0;
+
+  if (!data->cancelled)
+    mx_image_upload_complete (data);
+
+  mx_image_async_data_free (data);
+
+  return FALSE;
+}
+
+/* Creates a texture from an image decoded by mx_image_pixels_new() */
+static CoglHandle
+mx_image_texture_new_from_pixels (GBytes *pixels,
+                                  gint    width,
+                                  gint    height)
+{
+  return cogl_texture_new_from_data (width + 2, height + 2,
+                                     COGL_TEXTURE_NO_ATLAS,
+                                     COGL_PIXEL_FORMAT_RGBA_8888_PRE,
+                                     COGL_PIXEL_FORMAT_ANY,
+                                     (width + 2) * 4,
+                                     g_bytes_get_data (pixels, NULL));
+}
+
+/* Starts uploading a decoded image. Returns %TRUE if the image has been
+ * uploaded, or %FALSE if it is being uploaded over several main loop
+ * iterations */
+static gboolean
+mx_image_upload (MxImageAsyncData *data)
+{
+  gint width = data->pixels_width + 2;
+  gint height = data->pixels_height + 2;
+  gboolean small = (width * height * 4 <= MX_IMAGE_UPLOAD_CHUNK_SIZE);
+
+  /* small images are uploaded straight away */
+  if (small)
+    data->texture = mx_image_texture_new_from_pixels (data->pixels,
+                                                      data->pixels_width,
+                                                      data->pixels_height);
+  else
+    data->texture = cogl_texture_new_with_size (width, height,
+                                                COGL_TEXTURE_NO_ATLAS,
+                                                COGL_PIXEL_FORMAT_RGBA_8888_PRE);
+
+  if (!data->texture)
+    {
+      g_set_error (&data->error, MX_IMAGE_ERROR, MX_IMAGE_ERROR_INTERNAL,
+                   "Unable to create a %dx%d texture for '%s'", width, height,
+                   data->filename ? data->filename : "buffer");
+      mx_image_load_failed (data);
+      return TRUE;
+    }
+
+  if (small)
+    {
+      mx_image_upload_complete (data);
+      return TRUE;
+    }
+
+  mx_image_upload_rows (data);
+
+  /* the remaining strips are uploaded between frames */
+  data->idle_handler =
+    clutter_threads_add_idle_full (G_PRIORITY_DEFAULT_IDLE,
+                                   mx_image_upload_cb, data, NULL);
+
+  return FALSE;
 }
 
 static gboolean
@@ -1290,33 +2346,31 @@ mx_image_load_complete_cb (gpointer task_data)
    */
   data->idle_handler = 0;
 
+  /* Let the next loads take this one's place in the thread-pool */
+  if (data->link.data)
+    {
+      g_queue_unlink (&mx_image_loads, &data->link);
+      data->link.data = NULL;
+    }
+  mx_image_queued_bytes -= data->cost;
+
+  mx_image_schedule_loads ();
+
   /* Don't do anything with the image data if we've been cancelled already */
   if (!data->cancelled && data->complete)
     {
-      /* Reset the current async image load data pointer */
-      data->parent->priv->async_load_data = NULL;
-
-      /* If we managed to load the pixbuf, set it now, otherwise forward the
-       * error on to the user via a signal.
+      /* If we managed to load the image, upload it now, otherwise forward
+       * the error on to the user via a signal. Large images stay the
+       * current async load until they have been uploaded, so that they
+       * can still be cancelled.
        */
-      if (data->pixbuf)
+      if (data->pixels)
         {
-          GError *error = NULL;
-          gboolean resized = (data->width != -1 || data->height != -1);
-          gboolean success =
-            mx_image_set_from_pixbuf (data->parent, data->pixbuf,
-                                      resized ? data->filename : NULL, &error);
-
-          if (success)
-            g_signal_emit (data->parent, signals[IMAGE_LOADED], 0);
-          else
-            {
-              g_signal_emit (data->parent, signals[IMAGE_LOAD_ERROR], 0, error);
-              g_error_free (error);
-            }
+          if (!mx_image_upload (data))
+            return FALSE;
         }
       else
-        g_signal_emit (data->parent, signals[IMAGE_LOAD_ERROR], 0, data->error);
+        mx_image_load_failed (data);
     }
 
   /* Free the async loading struct */
@@ -1370,8 +2424,8 @@ mx_image_size_prepared_cb (GdkPixbufLoader *loader,
         return;
 
       gdk_pixbuf_loader_set_size (loader, constraints->width,
-                                  (constraints->width / (gfloat)width) *
-                                  (gfloat)height);
+                                  MAX (1, (constraints->width / (gfloat)width) *
+                                          (gfloat)height));
       constraints->scaled = TRUE;
     }
   else
@@ -1383,13 +2437,115 @@ mx_image_size_prepared_cb (GdkPixbufLoader *loader,
         return;
 
       gdk_pixbuf_loader_set_size (loader,
-                                  (constraints->height / (gfloat)height) *
-                                  (gfloat)width,
+                                  MAX (1, (constraints->height / (gfloat)height) *
+                                          (gfloat)width),
                                   constraints->height);
       constraints->scaled = TRUE;
     }
 }
 
+static gboolean
+mx_image_loader_write_buffer (GdkPixbufLoader  *loader,
+                              const guchar     *buffer,
+                              gsize             count,
+                              GCancellable     *cancellable,
+                              GError          **error)
+{
+  gsize offset;
+
+  for (offset = 0; offset < count; offset += MX_IMAGE_DECODE_CHUNK_SIZE)
+    {
+      if (g_cancellable_set_error_if_cancelled (cancellable, error))
+        return FALSE;
+
+      if (!gdk_pixbuf_loader_write (loader, buffer + offset,
+                                    MIN (count - offset,
+                                         MX_IMAGE_DECODE_CHUNK_SIZE),
+                                    error))
+        return FALSE;
+    }
+
+  return TRUE;
+}
+
+/* Streams a file into the loader a chunk at a time, rather than reading
+ * the whole file into memory first. The loader emits size-prepared as soon
+ * as it has read the image header, so the decode size is chosen before the
+ * bulk of the image data arrives, and the JPEG loader can use libjpeg's
+ * DCT scaling to decode large images straight at a fraction of their
+ * size. */
+static gboolean
+mx_image_loader_write_file (GdkPixbufLoader  *loader,
+                            const gchar      *filename,
+                            GCancellable     *cancellable,
+                            GError          **error)
+{
+  gboolean success = TRUE;
+  guchar *chunk;
+  gssize n_read;
+  gint fd;
+
+  fd = g_open (filename, O_RDONLY, 0);
+  if (fd == -1)
+    {
+      gint saved_errno = errno;
+      gchar *display_name = g_filename_display_name (filename);
+
+      g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (saved_errno),
+                   "Failed to open file '%s': %s", display_name,
+                   g_strerror (saved_errno));
+      g_free (display_name);
+
+      return FALSE;
+    }
+
+#ifdef POSIX_FADV_SEQUENTIAL
+  posix_fadvise (fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
+  chunk = g_malloc (MX_IMAGE_DECODE_CHUNK_SIZE);
+
+  while (success)
+    {
+      if (g_cancellable_set_error_if_cancelled (cancellable, error))
+        {
+          success = FALSE;
+          break;
+        }
+
+      n_read = read (fd, chunk, MX_IMAGE_DECODE_CHUNK_SIZE);
+
+      if (n_read == 0)
+        break;
+
+      if (n_read < 0)
+        {
+          gint saved_errno = errno;
+          gchar *display_name;
+
+          if (saved_errno == EINTR)
+            continue;
+
+          display_name = g_filename_display_name (filename);
+          g_set_error (error, G_FILE_ERROR,
+                       g_file_error_from_errno (saved_errno),
+                       "Failed to read from file '%s': %s", display_name,
+                       g_strerror (saved_errno));
+          g_free (display_name);
+
+          success = FALSE;
+          break;
+        }
+
+      success = gdk_pixbuf_loader_write (loader, chunk, n_read, error);
+    }
+
+  g_free (chunk);
+  close (fd);
+
+  return success;
+}
+
 /*
  * mx_image_pixbuf_new:
  * @filename: A local file path, or %NULL
@@ -1401,6 +2557,8 @@ mx_image_size_prepared_cb (GdkPixbufLoader *loader,
  * @height_threshold: The delta allowed before actually scaling the height
  * @upscale: %TRUE if the image should be allowed to scale upwards,
  *   %FALSE otherwise
+ * @scaled: A pointer to a #gboolean to store whether the image was scaled
+ * @cancellable: A #GCancellable to abort decoding with, or %NULL
  * @error: A pointer to a #GError
  *
  * Loads and scales a #GdkPixbuf using the given filename or data.
@@ -1417,9 +2575,11 @@ mx_image_pixbuf_new (const gchar  *filename,
                      guint         height_threshold,
                      gboolean      upscale,
                      gboolean     *scaled,
+                     GCancellable *cancellable,
                      GError      **error)
 {
   GdkPixbuf *pixbuf;
+  gboolean success;
   GdkPixbufLoader *loader;
   MxImageSizeRequest constraints;
 
@@ -1432,36 +2592,29 @@ mx_image_pixbuf_new (const gchar  *filename,
   constraints.width_threshold = width_threshold;
   constraints.height_threshold = height_threshold;
   constraints.upscale = upscale;
+  constraints.scaled = FALSE;
 
   g_signal_connect (loader, "size-prepared",
                     G_CALLBACK (mx_image_size_prepared_cb),
                     &constraints);
 
   if (filename)
+    success = mx_image_loader_write_file (loader, filename, cancellable, &err);
+  else if (buffer)
+    success = mx_image_loader_write_buffer (loader, buffer, count,
+                                            cancellable, &err);
+  else
+    success = FALSE;
+
+  if (!success)
     {
-      if (!g_file_get_contents (filename, (gchar **)&buffer, &count, &err))
+      if (err)
         {
           if (error)
             g_propagate_error (error, err);
-          gdk_pixbuf_loader_close (loader, NULL);
-          g_object_unref (loader);
-          return NULL;
+          else
+            g_error_free (err);
         }
-
-      g_object_weak_ref (G_OBJECT (loader), (GWeakNotify)g_free, buffer);
-    }
-
-  if (!buffer)
-    {
-      gdk_pixbuf_loader_close (loader, NULL);
-      g_object_unref (loader);
-      return NULL;
-    }
-
-  if (!gdk_pixbuf_loader_write (loader, buffer, count, &err))
-    {
-      if (error)
-        g_propagate_error (error, err);
       gdk_pixbuf_loader_close (loader, NULL);
       g_object_unref (loader);
       return NULL;
@@ -1488,11 +2641,179 @@ mx_image_pixbuf_new (const gchar  *filename,
   return pixbuf;
 }
 
+/*
+ * mx_image_pixels_new_from_pixbuf:
+ * @pixbuf: A #GdkPixbuf
+ * @error: A pointer to a #GError
+ *
+ * Converts a pixbuf to premultiplied RGBA with a transparent 1-pixel
+ * border, which is what the textures of #MxImage hold, so that uploading it
+ * is a straight copy. Asynchronous loads do this in the loading threads,
+ * rather than leaving it to Cogl in the main thread.
+ *
+ * Returns: The converted pixels, or %NULL on failure (@error will be set)
+ */
+static guchar *
+mx_image_pixels_new_from_pixbuf (GdkPixbuf  *pixbuf,
+                                 GError    **error)
+{
+  gint x, y, width, height, rowstride, channels, new_rowstride;
+  const guchar *src_row;
+  guchar *pixels;
+  gboolean has_alpha;
+
+  width = gdk_pixbuf_get_width (pixbuf);
+  height = gdk_pixbuf_get_height (pixbuf);
+  has_alpha = gdk_pixbuf_get_has_alpha (pixbuf);
+  rowstride = gdk_pixbuf_get_rowstride (pixbuf);
+  channels = gdk_pixbuf_get_n_channels (pixbuf);
+
+  if ((gdk_pixbuf_get_bits_per_sample (pixbuf) != 8) ||
+      (gdk_pixbuf_get_colorspace (pixbuf) != GDK_COLORSPACE_RGB) ||
+      !((has_alpha && channels == 4) ||
+        (!has_alpha && channels == 3)))
+    {
+      g_set_error (error, MX_IMAGE_ERROR, MX_IMAGE_ERROR_BAD_FORMAT,
+                   "Unsupported image formatting");
+      return NULL;
+    }
+
+  new_rowstride = (width + 2) * 4;
+  pixels = g_try_malloc0 (new_rowstride * (height + 2));
+
+  if (!pixels)
+    {
+      g_set_error (error, MX_IMAGE_ERROR, MX_IMAGE_ERROR_INTERNAL,
+                   "Not enough memory to load the image");
+      return NULL;
+    }
+
+  src_row = gdk_pixbuf_get_pixels (pixbuf);
+
+  for (y = 0; y < height; y++, src_row += rowstride)
+    {
+      const guchar *src = src_row;
+      guchar *dest = pixels + (y + 1) * new_rowstride + 4;
+
+      if (has_alpha)
+        for (x = 0; x < width; x++, src += 4, dest += 4)
+          {
+            guint alpha = src[3];
+            guint t;
+
+            /* multiply by alpha and divide by 255, rounding */
+            t = src[0] * alpha + 0x80; dest[0] = (t + (t >> 8)) >> 8;
+            t = src[1] * alpha + 0x80; dest[1] = (t + (t >> 8)) >> 8;
+            t = src[2] * alpha + 0x80; dest[2] = (t + (t >> 8)) >> 8;
+            dest[3] = alpha;
+          }
+      else
+        for (x = 0; x < width; x++, src += 3, dest += 4)
+          {
+            dest[0] = src[0];
+            dest[1] = src[1];
+            dest[2] = src[2];
+            dest[3] = 0xff;
+          }
+    }
+
+  return pixels;
+}
+
+/*
+ * mx_image_pixels_new:
+ * @filename: A local file path, or %NULL
+ * @buffer: Encoded image data buffer, or %NULL
+ * @count: The size of @buffer
+ * @width: The scaled width, or -1
+ * @height: The scaled height, or -1
+ * @width_threshold: The delta allowed before actually scaling the width
+ * @height_threshold: The delta allowed before actually scaling the height
+ * @upscale: %TRUE if the image should be allowed to scale upwards,
+ *   %FALSE otherwise
+ * @use_disk_cache: %TRUE if a scaled image loaded from a file may be
+ *   looked up in and added to the disk cache
+ * @scaled: A pointer to a #gboolean to store whether the image was scaled
+ * @pixels_width: A pointer to store the width of the image
+ * @pixels_height: A pointer to store the height of the image
+ * @cancellable: A #GCancellable to abort decoding with, or %NULL
+ * @error: A pointer to a #GError
+ *
+ * Loads an image as mx_image_pixbuf_new() does and converts it with
+ * mx_image_pixels_new_from_pixbuf(). The disk cache holds the converted
+ * pixels, so images found there are not converted again.
+ *
+ * Returns: The pixels of the image, or %NULL on failure (@error will be set)
+ */
+static GBytes *
+mx_image_pixels_new (const gchar  *filename,
+                     guchar       *buffer,
+                     gsize         count,
+                     gint          width,
+                     gint          height,
+                     guint         width_threshold,
+                     guint         height_threshold,
+                     gboolean      upscale,
+                     gboolean      use_disk_cache,
+                     gboolean     *scaled,
+                     gint         *pixels_width,
+                     gint         *pixels_height,
+                     GCancellable *cancellable,
+                     GError      **error)
+{
+  MxImageDiskCacheKey key;
+  GdkPixbuf *pixbuf;
+  GBytes *bytes;
+  guchar *pixels;
+
+  /* Only images loaded from files at a particular size are kept on disk,
+   * as the texture cache is used for the rest */
+  use_disk_cache = use_disk_cache && filename && (width != -1 || height != -1);
+
+  if (use_disk_cache)
+    {
+      key.width = width;
+      key.height = height;
+      key.width_threshold = width_threshold;
+      key.height_threshold = height_threshold;
+      key.upscale = upscale;
+
+      bytes = _mx_image_disk_cache_lookup (filename, &key, pixels_width,
+                                           pixels_height, scaled);
+      if (bytes)
+        return bytes;
+    }
+
+  pixbuf = mx_image_pixbuf_new (filename, buffer, count, width, height,
+                                width_threshold, height_threshold, upscale,
+                                scaled, cancellable, error);
+  if (!pixbuf)
+    return NULL;
+
+  pixels = mx_image_pixels_new_from_pixbuf (pixbuf, error);
+  *pixels_width = gdk_pixbuf_get_width (pixbuf);
+  *pixels_height = gdk_pixbuf_get_height (pixbuf);
+
+  g_object_unref (pixbuf);
+
+  if (!pixels)
+    return NULL;
+
+  bytes = g_bytes_new_take (pixels, (gsize) (*pixels_width + 2) * 4 *
+                                    (*pixels_height + 2));
+
+  if (use_disk_cache)
+    _mx_image_disk_cache_store (filename, &key, bytes, *pixels_width,
+                                *pixels_height, scaled && *scaled);
+
+  return bytes;
+}
+
 static void
 mx_image_async_cb (gpointer task_data,
                    gpointer user_data)
 {
-  gboolean scaled;
+  gboolean scaled = FALSE;
   MxImageAsyncData *data = task_data;
 
   g_mutex_lock (&data->mutex);
@@ -1510,13 +2831,15 @@ mx_image_async_cb (gpointer task_data,
       return;
     }
 
-  /* Try to load the pixbuf */
-  data->pixbuf = mx_image_pixbuf_new (data->filename, data->buffer,
+  /* Try to load the image, in the format it is uploaded in */
+  data->pixels = mx_image_pixels_new (data->filename, data->buffer,
                                       data->count, data->width, data->height,
                                       data->width_threshold,
                                       data->height_threshold, data->upscale,
-                                      &scaled,
-                                      &data->error);
+                                      data->disk_cache, &scaled,
+                                      &data->pixels_width,
+                                      &data->pixels_height,
+                                      data->cancellable, &data->error);
 
   /* If scaling was unnecessary, we can cache the result */
   if (!scaled)
@@ -1543,7 +2866,6 @@ mx_image_set_async (MxImage         *image,
                     gint             height,
                     GError         **error)
 {
-  GError *err;
   MxImagePrivate *priv;
   MxImageAsyncData *data;
 
@@ -1565,26 +2887,11 @@ mx_image_set_async (MxImage         *image,
       return FALSE;
     }
 
-  err = NULL;
   data = NULL;
 
   /* Load the pixbuf in a thread, then later on upload it to the GPU */
-  if (!mx_image_threads)
-    {
-      mx_image_threads = g_thread_pool_new (mx_image_async_cb, NULL,
-#ifdef _SC_NPROCESSORS_ONLN
-                                            sysconf (_SC_NPROCESSORS_ONLN),
-#else
-                                            /* FIXME: add more OSs */
-                                            1,
-#endif
-                                            FALSE, &err);
-      if (!mx_image_threads)
-        {
-          g_propagate_error (error, err);
-          return FALSE;
-        }
-    }
+  if (!mx_image_ensure_threads (error))
+    return FALSE;
 
   /* Cancel/free any in-progress load */
   if (priv->async_load_data)
@@ -1594,19 +2901,28 @@ mx_image_set_async (MxImage         *image,
       if (!g_mutex_trylock (&old_data->mutex))
         {
           /* The thread is busy, cancel it and start a new one */
-          old_data->cancelled = TRUE;
+          mx_image_async_data_cancel (old_data);
         }
       else
         {
           if (old_data->complete)
             {
               /* The load finished, cancel the upload */
-              old_data->cancelled = TRUE;
               g_mutex_unlock (&old_data->mutex);
+              mx_image_async_data_cancel (old_data);
             }
           else
             {
+              gsize cost = mx_image_get_load_cost (filename, count);
+
               /* The load hasn't begun, we'll hijack it */
+              if (old_data->free_func)
+                old_data->free_func (old_data->buffer);
+
+              if (old_data->queued)
+                mx_image_queued_bytes += cost - old_data->cost;
+              old_data->cost = cost;
+
               g_free (old_data->filename);
               old_data->filename = g_strdup (filename);
               old_data->buffer = buffer;
@@ -1614,10 +2930,12 @@ mx_image_set_async (MxImage         *image,
               old_data->free_func = free_func;
               old_data->width = width;
               old_data->height = height;
+              old_data->disk_cache = priv->use_disk_cache;
               old_data->cancelled = FALSE;
               g_mutex_unlock (&old_data->mutex);
 
               data = old_data;
+              mx_image_async_data_enqueue (data);
             }
         }
     }
@@ -1632,7 +2950,8 @@ mx_image_set_async (MxImage         *image,
       data->free_func = free_func;
       data->width = width;
       data->height = height;
-      g_thread_pool_push (mx_image_threads, data, NULL);
+      data->cost = mx_image_get_load_cost (filename, count);
+      mx_image_async_data_enqueue (data);
     }
 
   return TRUE;
@@ -1682,10 +3001,12 @@ mx_image_set_from_file_at_size (MxImage      *image,
                                 gint          height,
                                 GError      **error)
 {
-  GdkPixbuf *pixbuf;
+  gint pixels_width, pixels_height;
   MxImagePrivate *priv;
   MxTextureCache *cache;
-  gboolean retval, use_cache;
+  CoglHandle texture;
+  gboolean scaled;
+  GBytes *pixels;
 
   if (G_UNLIKELY (!MX_IS_IMAGE (image)))
     {
@@ -1696,13 +3017,12 @@ mx_image_set_from_file_at_size (MxImage      *image,
     }
 
   priv = image->priv;
-  pixbuf = NULL;
 
   /* Check if the processed image is in the cache - we don't use the cache
    * if we're loading at a particular size.
    */
   cache = mx_texture_cache_get_default ();
-  use_cache = TRUE;
+  scaled = FALSE;
 
   if ((width != -1) || (height != -1) ||
       !mx_texture_cache_contains_meta (cache, filename,
@@ -1721,6 +3041,7 @@ mx_image_set_from_file_at_size (MxImage      *image,
               mx_texture_cache_insert_meta (cache, filename,
                                         GINT_TO_POINTER (mx_image_cache_quark),
                                         priv->texture, NULL);
+              priv->uri = g_strdup (filename);
               return TRUE;
             }
           else
@@ -1737,22 +3058,43 @@ mx_image_set_from_file_at_size (MxImage      *image,
         return mx_image_set_async (image, filename, NULL, 0, NULL,
                                    width, height, error);
 
-      /* Synchronously load the pixbuf and set it */
-      pixbuf = mx_image_pixbuf_new (filename, NULL, 0, width, height,
+      /* Synchronously load the image and set it */
+      pixels = mx_image_pixels_new (filename, NULL, 0, width, height,
                                     priv->width_threshold,
                                     priv->height_threshold,
-                                    priv->upscale, &use_cache, error);
-      if (!pixbuf)
+                                    priv->upscale, priv->use_disk_cache,
+                                    &scaled, &pixels_width, &pixels_height,
+                                    NULL, error);
+      if (!pixels)
         return FALSE;
-    }
 
-  retval = mx_image_set_from_pixbuf (image, pixbuf,
-                                     use_cache ? filename : NULL, error);
+      texture = mx_image_texture_new_from_pixels (pixels, pixels_width,
+                                                  pixels_height);
+      g_bytes_unref (pixels);
 
-  if (pixbuf)
-    g_object_unref (pixbuf);
+      if (!texture)
+        {
+          g_set_error (error, MX_IMAGE_ERROR, MX_IMAGE_ERROR_BAD_FORMAT,
+                       "Failed to create Cogl texture");
+          return FALSE;
+        }
 
-  return retval;
+      mx_image_cancel_in_progress (image);
+      mx_image_replace_texture (image, texture);
+
+      /* only an image at the size of the file is cached under its name */
+      if (!scaled)
+        {
+          mx_texture_cache_insert_meta (cache, filename,
+                                        GINT_TO_POINTER (mx_image_cache_quark),
+                                        texture, NULL);
+          priv->uri = g_strdup (filename);
+        }
+
+      return TRUE;
+    }
+
+  return mx_image_set_from_pixbuf (image, NULL, filename, error);
 }
 
 /**
@@ -1832,16 +3174,7 @@ mx_image_set_from_cogl_texture (MxImage    *image,
       cogl_handle_unref (fbo);
 
       /* Replace the old texture */
-      if (priv->old_texture)
-        cogl_object_unref (priv->old_texture);
-
-      priv->old_texture = priv->texture;
-      priv->old_rotation = priv->rotation;
-      priv->old_mode = priv->mode;
-
-      priv->texture = new_texture;
-
-      mx_image_prepare_texture (image);
+      mx_image_replace_texture (image, new_texture);
 
       return TRUE;
     }
@@ -1940,7 +3273,7 @@ mx_image_set_from_buffer_at_size (MxImage         *image,
 
   pixbuf = mx_image_pixbuf_new (NULL, buffer, buffer_size, width, height,
                                 priv->width_threshold, priv->height_threshold,
-                                priv->upscale, NULL, error);
+                                priv->upscale, NULL, NULL, error);
   if (!pixbuf)
     return FALSE;
 
@@ -1967,6 +3300,10 @@ mx_image_set_from_buffer_at_size (MxImage         *image,
  * #MxImage::image-load-error signals are used to signal success or failure
  * of asynchronous image loading.
  *
+ * Images that are being painted are loaded before images that are mapped
+ * but scrolled out of view, which are loaded before images that are not
+ * mapped. Loads are reprioritised as images come into and go out of view.
+ *
  * Since: 1.2
  */
 void
@@ -1986,7 +3323,7 @@ mx_image_set_load_async (MxImage  *image,
       /* Cancel the old transfer if we're turning async off */
       if (!load_async && priv->async_load_data)
         {
-          priv->async_load_data->cancelled = TRUE;
+          mx_image_async_data_cancel (priv->async_load_data);
           priv->async_load_data = NULL;
         }
     }
@@ -2235,3 +3572,124 @@ mx_image_get_transition_duration (MxImage *image)
 
   return image->priv->transition_duration;
 }
+
+/**
+ * mx_image_set_use_disk_cache:
+ * @image: A #MxImage
+ * @use_disk_cache: %TRUE to keep scaled images in the disk cache
+ *
+ * Set the MxImage:use-disk-cache property.
+ *
+ * Since: 2.0
+ */
+void
+mx_image_set_use_disk_cache (MxImage  *image,
+                             gboolean  use_disk_cache)
+{
+  MxImagePrivate *priv;
+
+  g_return_if_fail (MX_IS_IMAGE (image));
+
+  priv = image->priv;
+  if (priv->use_disk_cache != use_disk_cache)
+    {
+      priv->use_disk_cache = use_disk_cache;
+      g_object_notify (G_OBJECT (image), "use-disk-cache");
+    }
+}
+
+/**
+ * mx_image_get_use_disk_cache:
+ * @image: A #MxImage
+ *
+ * Get the value of the MxImage:use-disk-cache property.
+ *
+ * Returns: %TRUE if scaled images are kept in the disk cache
+ *
+ * Since: 2.0
+ */
+gboolean
+mx_image_get_use_disk_cache (MxImage *image)
+{
+  g_return_val_if_fail (MX_IS_IMAGE (image), FALSE);
+
+  return image->priv->use_disk_cache;
+}
+
+/**
+ * mx_image_set_disk_cache_max_size:
+ * @max_size: The maximum size of the disk cache, in bytes
+ *
+ * Sets the maximum size of the disk cache shared by all #MxImage<!-- -->s
+ * that have MxImage:use-disk-cache set. When the cache grows beyond this
+ * size, the least recently used images are removed from it. The default
+ * is 128 MiB.
+ *
+ * Since: 2.0
+ */
+void
+mx_image_set_disk_cache_max_size (guint64 max_size)
+{
+  _mx_image_disk_cache_set_max_size (max_size);
+}
+
+/**
+ * mx_image_get_disk_cache_max_size:
+ *
+ * Gets the maximum size of the disk cache. See
+ * mx_image_set_disk_cache_max_size().
+ *
+ * Returns: The maximum size of the disk cache, in bytes
+ *
+ * Since: 2.0
+ */
+guint64
+mx_image_get_disk_cache_max_size (void)
+{
+  return _mx_image_disk_cache_get_max_size ();
+}
+
+/**
+ * mx_image_set_use_scaled_variants:
+ * @image: A #MxImage
+ * @use_scaled_variants: %TRUE to paint smaller copies of large images
+ *
+ * Set the MxImage:use-scaled-variants property.
+ *
+ * Since: 2.0
+ */
+void
+mx_image_set_use_scaled_variants (MxImage  *image,
+                                  gboolean  use_scaled_variants)
+{
+  MxImagePrivate *priv;
+
+  g_return_if_fail (MX_IS_IMAGE (image));
+
+  priv = image->priv;
+  if (priv->use_scaled_variants != use_scaled_variants)
+    {
+      priv->use_scaled_variants = use_scaled_variants;
+
+      clutter_actor_queue_redraw (CLUTTER_ACTOR (image));
+      g_object_notify (G_OBJECT (image), "use-scaled-variants");
+    }
+}
+
+/**
+ * mx_image_get_use_scaled_variants:
+ * @image: A #MxImage
+ *
+ * Get the value of the MxImage:use-scaled-variants property.
+ *
+ * Returns: %TRUE if smaller copies of large images are painted
+ *
+ * Since: 2.0
+ */
+gboolean
+mx_image_get_use_scaled_variants (MxImage *image)
+{
+  g_return_val_if_fail (MX_IS_IMAGE (image), FALSE);
+
+  return image->priv->use_scaled_variants;
+}
@@ -154,6 +154,17 @@ void     mx_image_animate_scale_mode (MxImage          *image,
                                       gulong            mode,
                                       guint             duration,
                                       MxImageScaleMode  scale_mode);
+
+void     mx_image_set_use_disk_cache (MxImage  *image,
+                                      gboolean  use_disk_cache);
+gboolean mx_image_get_use_disk_cache (MxImage  *image);
+
+void     mx_image_set_disk_cache_max_size (guint64 max_size);
+guint64  mx_image_get_disk_cache_max_size (void);
+
+void     mx_image_set_use_scaled_variants (MxImage  *image,
+                                           gboolean  use_scaled_variants);
+gboolean mx_image_get_use_scaled_variants (MxImage  *image);
 G_END_DECLS
 
 #endif /* _MX_IMAGE */
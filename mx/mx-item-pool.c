@@ -0,0 +1,311 @@
+/*
+ * mx-item-pool.c: Recycled items for the visible rows of a model
+ *
+ * Copyright 2012 Intel Corporation.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU Lesser General Public License,
+ * version 2.1, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+/*
+ * An item pool keeps the children of a model-driven container for a
+ * range of consecutive rows of the model, so that the container only has
+ * to create children for the rows it shows. When the range changes, the
+ * items of the rows that are no longer in it are hidden and bound to the
+ * rows that have come into it, rather than being destroyed and created
+ * again.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+
+#include "mx-item-pool.h"
+
+/* The number of unused items that are kept even if the range shrinks,
+ * so that a range that grows and shrinks as it is scrolled doesn't
+ * create items every time */
+#define MX_ITEM_POOL_MIN_UNUSED 16
+
+struct _MxItemPool
+{
+  ClutterActor         *container;
+
+  MxItemPoolCreateFunc  create_func;
+  MxItemPoolBindFunc    bind_func;
+  gpointer              user_data;
+
+  /* the items of the rows from start, in order */
+  GPtrArray            *items;
+  gint                  start;
+
+  /* hidden items that can be bound to other rows */
+  GQueue                unused;
+
+  /* whether the rows of the items have changed since they were bound */
+  guint                 stale : 1;
+
+  /* whether rows have been inserted into the range without items */
+  guint                 unbound : 1;
+};
+
+MxItemPool *
+_mx_item_pool_new (ClutterActor         *container,
+                   MxItemPoolCreateFunc  create_func,
+                   MxItemPoolBindFunc    bind_func,
+                   gpointer              user_data)
+{
+  MxItemPool *pool = g_slice_new0 (MxItemPool);
+
+  pool->container = container;
+  pool->create_func = create_func;
+  pool->bind_func = bind_func;
+  pool->user_data = user_data;
+  pool->items = g_ptr_array_new ();
+
+  return pool;
+}
+
+/* The items are children of the container, so they are left for it to
+ * destroy */
+void
+_mx_item_pool_free (MxItemPool *pool)
+{
+  g_ptr_array_free (pool->items, TRUE);
+  g_queue_clear (&pool->unused);
+
+  g_slice_free (MxItemPool, pool);
+}
+
+/* Makes sure that there are items bound to the rows from @start up to,
+ * but not including, @end, and returns whether any of the items have
+ * changed */
+gboolean
+_mx_item_pool_set_range (MxItemPool   *pool,
+                         ClutterModel *model,
+                         gint          start,
+                         gint          end)
+{
+  ClutterModelIter *iter = NULL;
+  gint row, iter_row = -1;
+  GPtrArray *items;
+  guint i, keep;
+
+  if (!model || end < start)
+    start = end = 0;
+
+  if (!pool->stale && !pool->unbound && start == pool->start &&
+      end == pool->start + (gint) pool->items->len)
+    return FALSE;
+
+  items = g_ptr_array_sized_new (end - start);
+
+  /* keep the items of the rows that are still in the range */
+  for (row = start; row < end; row++)
+    {
+      ClutterActor *item = NULL;
+      gint old = row - pool->start;
+
+      if (!pool->stale && old >= 0 && old < (gint) pool->items->len)
+        {
+          item = g_ptr_array_index (pool->items, old);
+          g_ptr_array_index (pool->items, old) = NULL;
+        }
+
+      g_ptr_array_add (items, item);
+    }
+
+  /* and hide the rest, to be reused */
+  for (i = 0; i < pool->items->len; i++)
+    {
+      ClutterActor *item = g_ptr_array_index (pool->items, i);
+
+      if (item)
+        {
+          clutter_actor_hide (item);
+          g_queue_push_head (&pool->unused, item);
+        }
+    }
+
+  /* bind items to the rows that have come into the range */
+  for (row = start; row < end; row++)
+    {
+      ClutterActor *item;
+
+      if (g_ptr_array_index (items, row - start))
+        continue;
+
+      if (!iter || iter_row > row)
+        {
+          if (iter)
+            g_object_unref (iter);
+
+          iter = clutter_model_get_iter_at_row (model, row);
+          iter_row = row;
+
+          if (!iter)
+            break;
+        }
+      else
+        {
+          for (; iter_row < row; iter_row++)
+            clutter_model_iter_next (iter);
+        }
+
+      item = g_queue_pop_head (&pool->unused);
+      if (!item)
+        {
+          item = pool->create_func (pool->user_data);
+          if (!item)
+            continue;
+
+          clutter_actor_add_child (pool->container, item);
+        }
+
+      pool->bind_func (item, iter, pool->user_data);
+      clutter_actor_show (item);
+
+      g_ptr_array_index (items, row - start) = item;
+    }
+
+  if (iter)
+    g_object_unref (iter);
+
+  g_ptr_array_free (pool->items, TRUE);
+  pool->items = items;
+  pool->start = start;
+  pool->stale = FALSE;
+  pool->unbound = FALSE;
+
+  /* don't keep many more unused items than there are items in use */
+  keep = MAX (items->len, MX_ITEM_POOL_MIN_UNUSED);
+  while (g_queue_get_length (&pool->unused) > keep)
+    clutter_actor_destroy (g_queue_pop_tail (&pool->unused));
+
+  return TRUE;
+}
+
+gint
+_mx_item_pool_get_start (MxItemPool *pool)
+{
+  return pool->start;
+}
+
+gint
+_mx_item_pool_get_end (MxItemPool *pool)
+{
+  return pool->start + pool->items->len;
+}
+
+/* Returns the item bound to @row, or %NULL if the row is not in the range
+ * of the pool */
+ClutterActor *
+_mx_item_pool_get_item (MxItemPool *pool,
+                        gint        row)
+{
+  row -= pool->start;
+
+  if (row < 0 || row >= (gint) pool->items->len)
+    return NULL;
+
+  return g_ptr_array_index (pool->items, row);
+}
+
+/* Moves the items of the rows after @row down by one, after a row has been
+ * inserted into the model. The next call to _mx_item_pool_set_range() binds
+ * an item to the new row, if it is in the range */
+void
+_mx_item_pool_insert_row (MxItemPool *pool,
+                          gint        row)
+{
+  GPtrArray *items = pool->items;
+  gint index = row - pool->start;
+
+  if (index <= 0)
+    {
+      if (items->len)
+        pool->start ++;
+      return;
+    }
+
+  if (index >= (gint) items->len)
+    return;
+
+  g_ptr_array_add (items, NULL);
+  memmove (items->pdata + index + 1, items->pdata + index,
+           (items->len - index - 1) * sizeof (gpointer));
+  items->pdata[index] = NULL;
+
+  pool->unbound = TRUE;
+}
+
+/* Hides the item of @row to be reused and moves the items of the rows
+ * after it up by one, after a row has been removed from the model */
+void
+_mx_item_pool_remove_row (MxItemPool *pool,
+                          gint        row)
+{
+  ClutterActor *item;
+  gint index = row - pool->start;
+
+  if (index < 0)
+    {
+      pool->start --;
+      return;
+    }
+
+  if (index >= (gint) pool->items->len)
+    return;
+
+  item = g_ptr_array_remove_index (pool->items, index);
+  if (item)
+    {
+      clutter_actor_hide (item);
+      g_queue_push_head (&pool->unused, item);
+    }
+
+  /* the range has shrunk, so the next row has to be bound */
+  pool->unbound = TRUE;
+}
+
+/* Makes the next call to _mx_item_pool_set_range() bind all of the items
+ * again, after the rows of the model have changed */
+void
+_mx_item_pool_invalidate (MxItemPool *pool)
+{
+  pool->stale = TRUE;
+}
+
+/* Destroys all of the items, so that new items are created for the rows,
+ * after the way items are created has changed */
+void
+_mx_item_pool_clear (MxItemPool *pool)
+{
+  ClutterActor *item;
+  guint i;
+
+  for (i = 0; i < pool->items->len; i++)
+    if ((item = g_ptr_array_index (pool->items, i)))
+      clutter_actor_destroy (item);
+
+  while ((item = g_queue_pop_head (&pool->unused)))
+    clutter_actor_destroy (item);
+
+  g_ptr_array_set_size (pool->items, 0);
+  pool->start = 0;
+  pool->stale = FALSE;
+  pool->unbound = FALSE;
+}
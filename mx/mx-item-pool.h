@@ -0,0 +1,59 @@
+/*
+ * mx-item-pool.h: Recycled items for the visible rows of a model
+ *
+ * Copyright 2012 Intel Corporation.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU Lesser General Public License,
+ * version 2.1, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef _MX_ITEM_POOL_H
+#define _MX_ITEM_POOL_H
+
+#include <clutter/clutter.h>
+
+G_BEGIN_DECLS
+
+typedef struct _MxItemPool MxItemPool;
+
+typedef ClutterActor * (*MxItemPoolCreateFunc) (gpointer          user_data);
+typedef void           (*MxItemPoolBindFunc)   (ClutterActor     *item,
+                                                ClutterModelIter *iter,
+                                                gpointer          user_data);
+
+MxItemPool   *_mx_item_pool_new        (ClutterActor         *container,
+                                        MxItemPoolCreateFunc  create_func,
+                                        MxItemPoolBindFunc    bind_func,
+                                        gpointer              user_data);
+void          _mx_item_pool_free       (MxItemPool           *pool);
+
+gboolean      _mx_item_pool_set_range  (MxItemPool           *pool,
+                                        ClutterModel         *model,
+                                        gint                  start,
+                                        gint                  end);
+gint          _mx_item_pool_get_start  (MxItemPool           *pool);
+gint          _mx_item_pool_get_end    (MxItemPool           *pool);
+ClutterActor *_mx_item_pool_get_item   (MxItemPool           *pool,
+                                        gint                  row);
+
+void          _mx_item_pool_insert_row (MxItemPool           *pool,
+                                        gint                  row);
+void          _mx_item_pool_remove_row (MxItemPool           *pool,
+                                        gint                  row);
+void          _mx_item_pool_invalidate (MxItemPool           *pool);
+void          _mx_item_pool_clear      (MxItemPool           *pool);
+
+G_END_DECLS
+
+#endif /* _MX_ITEM_POOL_H */
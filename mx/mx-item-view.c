@@ -32,12 +32,29 @@
  *
  * Data is set on the children by mapping columns in the model to object
  * properties on the children.
+ *
+ * If #MxItemView:virtualized is set, children are only created for the rows
+ * that are visible, and they are reused for other rows as the view is
+ * scrolled. Each child is then placed in a cell the size of the largest
+ * child, in rows from left to right, so the position of every row is known
+ * without creating its child, and keyboard focus can be moved to rows that
+ * don't have a child yet.
  */
 
+#include <math.h>
+
 #include "mx-item-view.h"
+#include "mx-focusable.h"
+#include "mx-item-pool.h"
 #include "mx-private.h"
 
-G_DEFINE_TYPE (MxItemView, mx_item_view, MX_TYPE_GRID)
+static void mx_item_view_focusable_iface_init (MxFocusableIface *iface);
+
+static MxFocusableIface *mx_item_view_parent_focusable_iface = NULL;
+
+G_DEFINE_TYPE_WITH_CODE (MxItemView, mx_item_view, MX_TYPE_GRID,
+                         G_IMPLEMENT_INTERFACE (MX_TYPE_FOCUSABLE,
+                                                mx_item_view_focusable_iface_init))
 
 #define ITEM_VIEW_PRIVATE(o) \
   (G_TYPE_INSTANCE_GET_PRIVATE ((o), MX_TYPE_ITEM_VIEW, MxItemViewPrivate))
@@ -54,7 +71,9 @@ enum
 
   PROP_MODEL,
   PROP_ITEM_TYPE,
-  PROP_FACTORY
+  PROP_FACTORY,
+  PROP_VIRTUALIZED,
+  PROP_OVERSCAN
 };
 
 struct _MxItemViewPrivate
@@ -71,7 +90,30 @@ struct _MxItemViewPrivate
   gulong         row_removed;
   gulong         sort_changed;
 
-  guint          is_frozen : 1;
+  guint          virtualized : 1;
+
+  /* changes to the model are not acted on while the view is frozen, and
+   * update_pending is set so that the view is updated once it is thawed */
+  guint          freeze_count;
+  guint          update_pending : 1;
+
+  /* virtualized mode */
+  MxItemPool    *pool;
+  guint          overscan;
+  guint          update_id;
+  MxAdjustment  *vadjustment;
+
+  /* the size of the largest item that has been measured */
+  gfloat         cell_width;
+  gfloat         cell_height;
+
+  /* the row that last had focus */
+  gint           focus_row;
+
+  /* the area the items cover */
+  gfloat         items_y1;
+  gfloat         items_y2;
+  gfloat         content_height;
 };
 
 /* gobject implementations */
@@ -94,6 +136,12 @@ mx_item_view_get_property (GObject    *object,
     case PROP_FACTORY:
       g_value_set_object (value, priv->factory);
       break;
+    case PROP_VIRTUALIZED:
+      g_value_set_boolean (value, priv->virtualized);
+      break;
+    case PROP_OVERSCAN:
+      g_value_set_uint (value, priv->overscan);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
     }
@@ -119,17 +167,773 @@ mx_item_view_set_property (GObject      *object,
       mx_item_view_set_factory ((MxItemView*) object,
                                 (MxItemFactory*) g_value_get_object (value));
       break;
+    case PROP_VIRTUALIZED:
+      mx_item_view_set_virtualized ((MxItemView*) object,
+                                    g_value_get_boolean (value));
+      break;
+    case PROP_OVERSCAN:
+      mx_item_view_set_overscan ((MxItemView*) object,
+                                 g_value_get_uint (value));
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
     }
 }
 
+static ClutterActor *
+mx_item_view_create_item (MxItemView *item_view)
+{
+  MxItemViewPrivate *priv = item_view->priv;
+
+  if (priv->item_type)
+    return g_object_new (priv->item_type, NULL);
+  else
+    return mx_item_factory_create (priv->factory);
+}
+
+static void
+mx_item_view_bind_item (ClutterActor     *item,
+                        ClutterModelIter *iter,
+                        MxItemView       *item_view)
+{
+  GSList *p;
+  GObject *child = G_OBJECT (item);
+
+  g_object_freeze_notify (child);
+  for (p = item_view->priv->attributes; p; p = p->next)
+    {
+      GValue value = { 0, };
+      AttributeData *attr = p->data;
+      GParamSpec *pspec;
+
+      clutter_model_iter_get_value (iter, attr->col, &value);
+
+      /* only set the properties that have changed, so that rebinding a row
+       * doesn't make the item relayout for the columns that haven't */
+      pspec = g_object_class_find_property (G_OBJECT_GET_CLASS (child),
+                                            attr->name);
+      if (pspec && G_VALUE_TYPE (&value) == pspec->value_type)
+        {
+          GValue old_value = { 0, };
+
+          g_value_init (&old_value, pspec->value_type);
+          g_object_get_property (child, attr->name, &old_value);
+
+          if (g_param_values_cmp (pspec, &value, &old_value) != 0)
+            g_object_set_property (child, attr->name, &value);
+
+          g_value_unset (&old_value);
+        }
+      else
+        g_object_set_property (child, attr->name, &value);
+
+      g_value_unset (&value);
+    }
+  g_object_thaw_notify (child);
+}
+
+/* virtualized mode */
+
+static gint
+mx_item_view_get_n_items (MxItemView *item_view)
+{
+  MxItemViewPrivate *priv = item_view->priv;
+
+  if (priv->freeze_count || !priv->model || (!priv->item_type && !priv->factory))
+    return 0;
+
+  return clutter_model_get_n_rows (priv->model);
+}
+
+/* Every item is given a cell the size of the largest item that has been
+ * measured, so the position of an item follows from its row */
+static gint
+mx_item_view_get_n_columns (MxItemView *item_view,
+                            gfloat      for_width)
+{
+  MxItemViewPrivate *priv = item_view->priv;
+  MxGrid *grid = MX_GRID (item_view);
+  gfloat col_spacing = mx_grid_get_column_spacing (grid);
+  gint max_stride = mx_grid_get_max_stride (grid);
+  gint n_columns;
+
+  if (for_width < 0 || priv->cell_width + col_spacing <= 0)
+    n_columns = G_MAXINT;
+  else
+    n_columns = (for_width + col_spacing) / (priv->cell_width + col_spacing);
+
+  if (max_stride > 0)
+    n_columns = MIN (n_columns, max_stride);
+
+  return MAX (1, n_columns);
+}
+
+static gfloat
+mx_item_view_get_content_height (MxItemView *item_view,
+                                 gint        n_columns)
+{
+  gfloat row_spacing = mx_grid_get_row_spacing (MX_GRID (item_view));
+  gint n_items, n_lines;
+
+  n_items = mx_item_view_get_n_items (item_view);
+  if (!n_items)
+    return 0;
+
+  n_lines = (n_items + n_columns - 1) / n_columns;
+
+  return n_lines * (item_view->priv->cell_height + row_spacing) - row_spacing;
+}
+
+static gboolean
+mx_item_view_measure_item (MxItemView   *item_view,
+                           ClutterActor *item)
+{
+  MxItemViewPrivate *priv = item_view->priv;
+  gboolean grown = FALSE;
+  gfloat width, height;
+
+  clutter_actor_get_preferred_size (item, NULL, NULL, &width, &height);
+
+  if (width > priv->cell_width)
+    {
+      priv->cell_width = width;
+      grown = TRUE;
+    }
+
+  if (height > priv->cell_height)
+    {
+      priv->cell_height = height;
+      grown = TRUE;
+    }
+
+  return grown;
+}
+
+/* Chooses the rows to create items for, from the lines of cells that are
+ * visible at the position of the vertical adjustment */
+static void
+mx_item_view_update_items (MxItemView *item_view)
+{
+  MxItemViewPrivate *priv = item_view->priv;
+  gfloat value, view_height, line_height, content_height;
+  gint n_items, n_columns, first, last, start, end;
+  ClutterActor *actor = CLUTTER_ACTOR (item_view);
+  gboolean changed = FALSE;
+  ClutterActorBox box;
+  MxPadding padding;
+
+  n_items = mx_item_view_get_n_items (item_view);
+  if (!n_items)
+    {
+      if (_mx_item_pool_set_range (priv->pool, NULL, 0, 0))
+        clutter_actor_queue_relayout (actor);
+      return;
+    }
+
+  /* without a cell size, measure the first item to have one */
+  if (priv->cell_width <= 0 && priv->cell_height <= 0)
+    {
+      ClutterActor *item;
+
+      _mx_item_pool_set_range (priv->pool, priv->model, 0, 1);
+      if ((item = _mx_item_pool_get_item (priv->pool, 0)))
+        mx_item_view_measure_item (item_view, item);
+
+      changed = TRUE;
+    }
+
+  mx_widget_get_padding (MX_WIDGET (actor), &padding);
+  clutter_actor_get_allocation_box (actor, &box);
+  view_height = box.y2 - box.y1;
+
+  n_columns = mx_item_view_get_n_columns (item_view, box.x2 - box.x1 -
+                                          padding.left - padding.right);
+  line_height = priv->cell_height +
+    mx_grid_get_row_spacing (MX_GRID (item_view));
+
+  value = priv->vadjustment ? mx_adjustment_get_value (priv->vadjustment) : 0;
+
+  if (line_height > 0)
+    {
+      first = MAX (0, (value - padding.top) / line_height);
+      last = ceilf ((value + view_height - padding.top) / line_height);
+    }
+  else
+    first = last = 0;
+
+  first = MAX (0, first - (gint) priv->overscan);
+  last = MAX (first + 1, last + (gint) priv->overscan);
+
+  /* keep the line that focus has moved to while it is scrolled into
+   * view, so that its item isn't reused */
+  if (priv->focus_row >= 0 && priv->focus_row < n_items)
+    {
+      gint focus_line = priv->focus_row / n_columns;
+
+      if (focus_line == first - 1)
+        first = focus_line;
+      else if (focus_line == last)
+        last = focus_line + 1;
+    }
+
+  start = MIN (n_items, (gint64) first * n_columns);
+  end = MIN (n_items, (gint64) last * n_columns);
+
+  if (_mx_item_pool_set_range (priv->pool, priv->model, start, end))
+    changed = TRUE;
+
+  /* the preferred height changes as the cells grow */
+  content_height = mx_item_view_get_content_height (item_view, n_columns);
+  if (priv->content_height != content_height)
+    {
+      priv->content_height = content_height;
+      changed = TRUE;
+    }
+
+  if (changed)
+    clutter_actor_queue_relayout (actor);
+}
+
+static gboolean
+mx_item_view_update_cb (MxItemView *item_view)
+{
+  item_view->priv->update_id = 0;
+
+  mx_item_view_update_items (item_view);
+
+  return FALSE;
+}
+
+/* Items are created and bound before the next frame is laid out, rather
+ * than while the view is being allocated */
+static void
+mx_item_view_queue_update (MxItemView *item_view)
+{
+  MxItemViewPrivate *priv = item_view->priv;
+
+  if (!priv->update_id)
+    priv->update_id =
+      clutter_threads_add_repaint_func_full (CLUTTER_REPAINT_FLAGS_PRE_PAINT,
+                                             (GSourceFunc) mx_item_view_update_cb,
+                                             item_view, NULL);
+
+  clutter_actor_queue_redraw (CLUTTER_ACTOR (item_view));
+}
+
+/* Checks whether the items that have been laid out still cover the view,
+ * and updates them if they don't */
+static void
+mx_item_view_check_items (MxItemView *item_view)
+{
+  MxItemViewPrivate *priv = item_view->priv;
+  gfloat value, view_height, content_height;
+  gint start, end, n_columns;
+  MxPadding padding;
+
+  value = priv->vadjustment ? mx_adjustment_get_value (priv->vadjustment) : 0;
+  view_height = clutter_actor_get_height (CLUTTER_ACTOR (item_view));
+
+  mx_widget_get_padding (MX_WIDGET (item_view), &padding);
+  n_columns = mx_item_view_get_n_columns (item_view,
+    clutter_actor_get_width (CLUTTER_ACTOR (item_view)) -
+    padding.left - padding.right);
+  content_height = mx_item_view_get_content_height (item_view, n_columns);
+
+  start = _mx_item_pool_get_start (priv->pool);
+  end = _mx_item_pool_get_end (priv->pool);
+
+  if ((start > 0 && priv->items_y1 > value) ||
+      (end < mx_item_view_get_n_items (item_view) &&
+       priv->items_y2 < value + view_height) ||
+      priv->content_height != content_height)
+    mx_item_view_queue_update (item_view);
+}
+
+static void
+mx_item_view_adjustment_value_cb (MxAdjustment *adjustment,
+                                  GParamSpec   *pspec,
+                                  MxItemView   *item_view)
+{
+  if (item_view->priv->virtualized)
+    mx_item_view_check_items (item_view);
+}
+
+static void
+mx_item_view_notify_vadjustment_cb (MxItemView *item_view,
+                                    GParamSpec *pspec)
+{
+  MxItemViewPrivate *priv = item_view->priv;
+  MxAdjustment *vadjustment;
+
+  _mx_grid_get_adjustments (MX_GRID (item_view), NULL, &vadjustment);
+
+  if (priv->vadjustment == vadjustment)
+    return;
+
+  if (priv->vadjustment)
+    {
+      g_signal_handlers_disconnect_by_func (priv->vadjustment,
+                                            mx_item_view_adjustment_value_cb,
+                                            item_view);
+      g_object_unref (priv->vadjustment);
+    }
+
+  priv->vadjustment = vadjustment ? g_object_ref (vadjustment) : NULL;
+
+  if (priv->vadjustment)
+    g_signal_connect (priv->vadjustment, "notify::value",
+                      G_CALLBACK (mx_item_view_adjustment_value_cb),
+                      item_view);
+
+  if (priv->virtualized)
+    mx_item_view_queue_update (item_view);
+}
+
+/* Throws away the cell size and the bindings, after the model has
+ * changed */
+static void
+mx_item_view_reset_items (MxItemView *item_view)
+{
+  MxItemViewPrivate *priv = item_view->priv;
+
+  priv->cell_width = 0;
+  priv->cell_height = 0;
+  priv->focus_row = -1;
+
+  _mx_item_pool_invalidate (priv->pool);
+  mx_item_view_queue_update (item_view);
+}
+
+static void
+mx_item_view_get_preferred_width (ClutterActor *actor,
+                                  gfloat        for_height,
+                                  gfloat       *min_width_p,
+                                  gfloat       *nat_width_p)
+{
+  MxItemView *item_view = MX_ITEM_VIEW (actor);
+  MxItemViewPrivate *priv = item_view->priv;
+  gfloat col_spacing;
+  gint n_columns;
+  MxPadding padding;
+
+  if (!priv->virtualized)
+    {
+      CLUTTER_ACTOR_CLASS (mx_item_view_parent_class)->
+        get_preferred_width (actor, for_height, min_width_p, nat_width_p);
+      return;
+    }
+
+  mx_widget_get_padding (MX_WIDGET (actor), &padding);
+  col_spacing = mx_grid_get_column_spacing (MX_GRID (actor));
+
+  /* naturally, every item would be on one line */
+  n_columns = MIN (mx_item_view_get_n_columns (item_view, -1),
+                   MAX (1, mx_item_view_get_n_items (item_view)));
+
+  if (min_width_p)
+    *min_width_p = priv->cell_width + padding.left + padding.right;
+  if (nat_width_p)
+    *nat_width_p = n_columns * (priv->cell_width + col_spacing) -
+      col_spacing + padding.left + padding.right;
+}
+
+static void
+mx_item_view_get_preferred_height (ClutterActor *actor,
+                                   gfloat        for_width,
+                                   gfloat       *min_height_p,
+                                   gfloat       *nat_height_p)
+{
+  MxItemView *item_view = MX_ITEM_VIEW (actor);
+  MxPadding padding;
+  gfloat height;
+
+  if (!item_view->priv->virtualized)
+    {
+      CLUTTER_ACTOR_CLASS (mx_item_view_parent_class)->
+        get_preferred_height (actor, for_width, min_height_p, nat_height_p);
+      return;
+    }
+
+  mx_widget_get_padding (MX_WIDGET (actor), &padding);
+
+  if (for_width >= 0)
+    for_width = MAX (0, for_width - padding.left - padding.right);
+
+  height = mx_item_view_get_content_height (item_view,
+    mx_item_view_get_n_columns (item_view, for_width)) +
+    padding.top + padding.bottom;
+
+  if (min_height_p)
+    *min_height_p = height;
+  if (nat_height_p)
+    *nat_height_p = height;
+}
+
+static void
+mx_item_view_allocate (ClutterActor          *actor,
+                       const ClutterActorBox *box,
+                       ClutterAllocationFlags flags)
+{
+  MxItemView *item_view = MX_ITEM_VIEW (actor);
+  MxItemViewPrivate *priv = item_view->priv;
+  gfloat avail_width, avail_height, col_spacing, row_spacing;
+  MxAdjustment *hadjustment;
+  gint row, start, end, n_columns;
+  MxAlign x_align, y_align;
+  MxPadding padding;
+
+  if (!priv->virtualized)
+    {
+      CLUTTER_ACTOR_CLASS (mx_item_view_parent_class)->allocate (actor, box,
+                                                                 flags);
+      return;
+    }
+
+  /* MxGrid would flow the items as if they were the only rows, so skip it
+   * and place them in the cells of their rows instead */
+  CLUTTER_ACTOR_CLASS (g_type_class_peek (MX_TYPE_WIDGET))->allocate (actor,
+                                                                      box,
+                                                                      flags);
+
+  mx_widget_get_padding (MX_WIDGET (actor), &padding);
+  col_spacing = mx_grid_get_column_spacing (MX_GRID (actor));
+  row_spacing = mx_grid_get_row_spacing (MX_GRID (actor));
+  x_align = mx_grid_get_child_x_align (MX_GRID (actor));
+  y_align = mx_grid_get_child_y_align (MX_GRID (actor));
+
+  avail_width = box->x2 - box->x1 - padding.left - padding.right;
+  avail_height = box->y2 - box->y1 - padding.top - padding.bottom;
+
+  start = _mx_item_pool_get_start (priv->pool);
+  end = _mx_item_pool_get_end (priv->pool);
+
+  /* grow the cells to fit the items that have just been created, before
+   * placing any of them */
+  for (row = start; row < end; row++)
+    mx_item_view_measure_item (item_view,
+                               _mx_item_pool_get_item (priv->pool, row));
+
+  n_columns = mx_item_view_get_n_columns (item_view, avail_width);
+
+  for (row = start; row < end; row++)
+    {
+      ClutterActor *item = _mx_item_pool_get_item (priv->pool, row);
+      ClutterActorBox child_box;
+
+      child_box.x1 = padding.left +
+        (row % n_columns) * (priv->cell_width + col_spacing);
+      child_box.y1 = padding.top +
+        (row / n_columns) * (priv->cell_height + row_spacing);
+      child_box.x2 = child_box.x1 + priv->cell_width;
+      child_box.y2 = child_box.y1 + priv->cell_height;
+
+      mx_allocate_align_fill (item, &child_box, x_align, y_align,
+                              FALSE, FALSE);
+      clutter_actor_allocate (item, &child_box, flags);
+    }
+
+  priv->items_y1 = padding.top +
+    (start / n_columns) * (priv->cell_height + row_spacing);
+  priv->items_y2 = padding.top +
+    ((end + n_columns - 1) / n_columns) * (priv->cell_height + row_spacing);
+
+  if (priv->vadjustment)
+    g_object_set (G_OBJECT (priv->vadjustment),
+                  "lower", 0.0,
+                  "upper",
+                  mx_item_view_get_content_height (item_view, n_columns),
+                  "page-size", avail_height,
+                  "step-increment", priv->cell_height + row_spacing,
+                  "page-increment", avail_height,
+                  NULL);
+
+  _mx_grid_get_adjustments (MX_GRID (actor), &hadjustment, NULL);
+  if (hadjustment)
+    g_object_set (G_OBJECT (hadjustment),
+                  "lower", 0.0,
+                  "upper", avail_width,
+                  "page-size", avail_width,
+                  "step-increment", avail_width / 6,
+                  "page-increment", avail_width,
+                  NULL);
+
+  mx_item_view_check_items (item_view);
+}
+
+/* focus navigation in virtualized mode, where the rows that will be
+ * focused may not have items yet */
+
+static gint
+mx_item_view_get_item_row (MxItemView   *item_view,
+                           ClutterActor *item)
+{
+  MxItemPool *pool = item_view->priv->pool;
+  gint row;
+
+  for (row = _mx_item_pool_get_start (pool);
+       row < _mx_item_pool_get_end (pool); row++)
+    if (_mx_item_pool_get_item (pool, row) == item)
+      return row;
+
+  return -1;
+}
+
+static gint
+mx_item_view_get_allocated_columns (MxItemView *item_view)
+{
+  MxPadding padding;
+
+  mx_widget_get_padding (MX_WIDGET (item_view), &padding);
+
+  return mx_item_view_get_n_columns (item_view,
+    clutter_actor_get_width (CLUTTER_ACTOR (item_view)) -
+    padding.left - padding.right);
+}
+
+/* Scrolls @row into view and makes sure it has an item, which is
+ * returned */
+static ClutterActor *
+mx_item_view_bring_row_into_view (MxItemView *item_view,
+                                  gint        row)
+{
+  MxItemViewPrivate *priv = item_view->priv;
+  gint n_columns, start, end;
+  gfloat line_y, line_height;
+  ClutterActor *item;
+  MxPadding padding;
+  gboolean near;
+
+  mx_widget_get_padding (MX_WIDGET (item_view), &padding);
+  n_columns = mx_item_view_get_allocated_columns (item_view);
+  line_height = priv->cell_height +
+    mx_grid_get_row_spacing (MX_GRID (item_view));
+  line_y = padding.top + (row / n_columns) * line_height;
+
+  start = row - row % n_columns;
+  end = MIN ((gint64) start + n_columns, mx_item_view_get_n_items (item_view));
+
+  /* a line next to the rows that have items is scrolled to, any other line
+   * is jumped to, so that the rows in between are never given items */
+  near = ((gint64) start >=
+          (gint64) _mx_item_pool_get_start (priv->pool) - n_columns &&
+          start <= _mx_item_pool_get_end (priv->pool));
+
+  if (priv->vadjustment)
+    {
+      gdouble value, new_value, page_size;
+
+      mx_adjustment_get_values (priv->vadjustment, &value, NULL, NULL,
+                                NULL, NULL, &page_size);
+
+      if (line_y < value)
+        new_value = line_y;
+      else if (line_y + priv->cell_height > value + page_size)
+        new_value = line_y + priv->cell_height - page_size;
+      else
+        new_value = value;
+
+      if (new_value != value && near)
+        mx_adjustment_interpolate (priv->vadjustment, new_value,
+                                   250, CLUTTER_EASE_OUT_CUBIC);
+      else if (new_value != value)
+        mx_adjustment_set_value (priv->vadjustment, new_value);
+    }
+
+  item = _mx_item_pool_get_item (priv->pool, row);
+  if (item)
+    return item;
+
+  /* give the row's line items straight away, the next update will set the
+   * range to the rows in view again */
+  if (near)
+    {
+      start = MIN (_mx_item_pool_get_start (priv->pool), start);
+      end = MAX (_mx_item_pool_get_end (priv->pool), end);
+    }
+
+  _mx_item_pool_set_range (priv->pool, priv->model, start, end);
+  clutter_actor_queue_relayout (CLUTTER_ACTOR (item_view));
+
+  return _mx_item_pool_get_item (priv->pool, row);
+}
+
+static MxFocusable *
+mx_item_view_focus_row (MxItemView  *item_view,
+                        gint         row,
+                        MxFocusHint  hint)
+{
+  ClutterActor *item;
+  MxFocusable *focused;
+
+  if (row < 0 || row >= mx_item_view_get_n_items (item_view))
+    return NULL;
+
+  item = mx_item_view_bring_row_into_view (item_view, row);
+  if (!item || !MX_IS_FOCUSABLE (item))
+    return NULL;
+
+  focused = mx_focusable_accept_focus (MX_FOCUSABLE (item), hint);
+  if (focused)
+    item_view->priv->focus_row = row;
+
+  return focused;
+}
+
+static MxFocusable *
+mx_item_view_move_focus (MxFocusable      *focusable,
+                         MxFocusDirection  direction,
+                         MxFocusable      *from)
+{
+  MxItemView *item_view = MX_ITEM_VIEW (focusable);
+  gint row, n_items, n_columns, target;
+  MxFocusHint hint;
+
+  if (!item_view->priv->virtualized)
+    return mx_item_view_parent_focusable_iface->move_focus (focusable,
+                                                            direction,
+                                                            from);
+
+  row = mx_item_view_get_item_row (item_view, CLUTTER_ACTOR (from));
+  if (row < 0)
+    return NULL;
+
+  item_view->priv->focus_row = row;
+
+  n_items = mx_item_view_get_n_items (item_view);
+  n_columns = mx_item_view_get_allocated_columns (item_view);
+
+  /* the cells are in rows of n_columns, so the row to focus follows from
+   * the row that has focus */
+  switch (direction)
+    {
+    case MX_FOCUS_DIRECTION_LEFT:
+      target = (row % n_columns) ? row - 1 : -1;
+      hint = MX_FOCUS_HINT_FROM_RIGHT;
+      break;
+
+    case MX_FOCUS_DIRECTION_RIGHT:
+      target = ((row + 1) % n_columns) ? row + 1 : -1;
+      hint = MX_FOCUS_HINT_FROM_LEFT;
+      break;
+
+    case MX_FOCUS_DIRECTION_UP:
+      target = row - n_columns;
+      hint = MX_FOCUS_HINT_FROM_BELOW;
+      break;
+
+    case MX_FOCUS_DIRECTION_DOWN:
+      target = row + n_columns;
+
+      /* move to the last item if the next line isn't full */
+      if (target >= n_items && row / n_columns < (n_items - 1) / n_columns)
+        target = n_items - 1;
+      hint = MX_FOCUS_HINT_FROM_ABOVE;
+      break;
+
+    case MX_FOCUS_DIRECTION_NEXT:
+      target = row + 1;
+      hint = MX_FOCUS_HINT_FIRST;
+      break;
+
+    case MX_FOCUS_DIRECTION_PREVIOUS:
+      target = row - 1;
+      hint = MX_FOCUS_HINT_LAST;
+      break;
+
+    default:
+      return NULL;
+    }
+
+  return mx_item_view_focus_row (item_view, target, hint);
+}
+
+static MxFocusable *
+mx_item_view_accept_focus (MxFocusable *focusable,
+                           MxFocusHint  hint)
+{
+  MxItemView *item_view = MX_ITEM_VIEW (focusable);
+  MxItemViewPrivate *priv = item_view->priv;
+  gint n_items, n_columns, first, last;
+  gfloat value, line_height;
+  MxPadding padding;
+
+  if (!priv->virtualized)
+    return mx_item_view_parent_focusable_iface->accept_focus (focusable,
+                                                              hint);
+
+  n_items = mx_item_view_get_n_items (item_view);
+  if (!n_items)
+    return NULL;
+
+  if (hint == MX_FOCUS_HINT_PRIOR &&
+      priv->focus_row >= 0 && priv->focus_row < n_items)
+    return mx_item_view_focus_row (item_view, priv->focus_row, hint);
+
+  /* otherwise, focus the first or last row in view */
+  mx_widget_get_padding (MX_WIDGET (item_view), &padding);
+  n_columns = mx_item_view_get_allocated_columns (item_view);
+  line_height = priv->cell_height +
+    mx_grid_get_row_spacing (MX_GRID (item_view));
+  value = priv->vadjustment ? mx_adjustment_get_value (priv->vadjustment) : 0;
+
+  if (line_height > 0)
+    {
+      first = ceilf ((value - padding.top) / line_height);
+      last = (value - padding.top +
+              clutter_actor_get_height (CLUTTER_ACTOR (item_view)) -
+              priv->cell_height) / line_height;
+    }
+  else
+    first = last = 0;
+
+  first = CLAMP ((gint64) first * n_columns, 0, n_items - 1);
+  last = CLAMP ((gint64) last * n_columns + n_columns - 1, first, n_items - 1);
+
+  if (hint == MX_FOCUS_HINT_LAST || hint == MX_FOCUS_HINT_FROM_BELOW)
+    return mx_item_view_focus_row (item_view, last, hint);
+  else
+    return mx_item_view_focus_row (item_view, first, hint);
+}
+
+static void
+mx_item_view_focusable_iface_init (MxFocusableIface *iface)
+{
+  mx_item_view_parent_focusable_iface = g_type_interface_peek_parent (iface);
+
+  iface->move_focus = mx_item_view_move_focus;
+  iface->accept_focus = mx_item_view_accept_focus;
+}
+
 static void
 mx_item_view_dispose (GObject *object)
 {
+  MxItemViewPrivate *priv = MX_ITEM_VIEW (object)->priv;
+
   /* This will cause the unref of the model and also disconnect the signals */
   mx_item_view_set_model (MX_ITEM_VIEW (object), NULL);
 
+  if (priv->update_id)
+    {
+      clutter_threads_remove_repaint_func (priv->update_id);
+      priv->update_id = 0;
+    }
+
+  if (priv->vadjustment)
+    {
+      g_signal_handlers_disconnect_by_func (priv->vadjustment,
+                                            mx_item_view_adjustment_value_cb,
+                                            object);
+      g_object_unref (priv->vadjustment);
+      priv->vadjustment = NULL;
+    }
+
+  /* the items are destroyed with the rest of the children */
+  if (priv->pool)
+    {
+      _mx_item_pool_free (priv->pool);
+      priv->pool = NULL;
+    }
+
   G_OBJECT_CLASS (mx_item_view_parent_class)->dispose (object);
 }
 
@@ -152,6 +956,7 @@ static void
 mx_item_view_class_init (MxItemViewClass *klass)
 {
   GObjectClass *object_class = G_OBJECT_CLASS (klass);
+  ClutterActorClass *actor_class = CLUTTER_ACTOR_CLASS (klass);
   GParamSpec *pspec;
 
   g_type_class_add_private (klass, sizeof (MxItemViewPrivate));
@@ -161,6 +966,10 @@ mx_item_view_class_init (MxItemViewClass *klass)
   object_class->dispose = mx_item_view_dispose;
   object_class->finalize = mx_item_view_finalize;
 
+  actor_class->get_preferred_width = mx_item_view_get_preferred_width;
+  actor_class->get_preferred_height = mx_item_view_get_preferred_height;
+  actor_class->allocate = mx_item_view_allocate;
+
   pspec = g_param_spec_object ("model",
                                "model",
                                "The model for the item view",
@@ -186,12 +995,34 @@ mx_item_view_class_init (MxItemViewClass *klass)
                                G_TYPE_OBJECT /*MX_TYPE_ITEM_FACTORY*/,
                                MX_PARAM_READWRITE);
   g_object_class_install_property (object_class, PROP_FACTORY, pspec);
+
+  pspec = g_param_spec_boolean ("virtualized",
+                                "Virtualized",
+                                "Whether items are only created for the rows "
+                                "that are visible.",
+                                FALSE,
+                                MX_PARAM_READWRITE);
+  g_object_class_install_property (object_class, PROP_VIRTUALIZED, pspec);
+
+  pspec = g_param_spec_uint ("overscan",
+                             "Overscan",
+                             "The number of lines of items before and after "
+                             "the visible lines to create when virtualized.",
+                             0, G_MAXUINT, 2,
+                             MX_PARAM_READWRITE);
+  g_object_class_install_property (object_class, PROP_OVERSCAN, pspec);
 }
 
 static void
 mx_item_view_init (MxItemView *item_view)
 {
   item_view->priv = ITEM_VIEW_PRIVATE (item_view);
+
+  item_view->priv->overscan = 2;
+  item_view->priv->focus_row = -1;
+
+  g_signal_connect (item_view, "notify::vertical-adjustment",
+                    G_CALLBACK (mx_item_view_notify_vadjustment_cb), NULL);
 }
 
 
@@ -200,8 +1031,7 @@ static void
 model_changed_cb (ClutterModel *model,
                   MxItemView   *item_view)
 {
-  GSList *p;
-  GList *l, *children;
+  ClutterActor *child;
   MxItemViewPrivate *priv = item_view->priv;
   ClutterModelIter *iter = NULL;
   gint model_n = 0, child_n = 0;
@@ -211,8 +1041,11 @@ model_changed_cb (ClutterModel *model,
   if (!priv->item_type && !priv->factory)
     return;
 
-  if (priv->is_frozen)
-    return;
+  if (priv->freeze_count)
+    {
+      priv->update_pending = TRUE;
+      return;
+    }
 
   if (priv->item_type)
     {
@@ -226,8 +1059,13 @@ model_changed_cb (ClutterModel *model,
         }
     }
 
-  children = clutter_actor_get_children (CLUTTER_ACTOR (item_view));
-  child_n = g_list_length (children);
+  if (priv->virtualized)
+    {
+      mx_item_view_reset_items (item_view);
+      return;
+    }
+
+  child_n = clutter_actor_get_n_children (CLUTTER_ACTOR (item_view));
 
   if (model)
     model_n = clutter_model_get_n_rows (priv->model);
@@ -239,66 +1077,80 @@ model_changed_cb (ClutterModel *model,
     {
       ClutterActor *new_child;
 
-      if (priv->item_type)
-        {
-          new_child = g_object_new (priv->item_type, NULL);
-        }
-      else
-        {
-          new_child = mx_item_factory_create (priv->factory);
-        }
+      new_child = mx_item_view_create_item (item_view);
 
       clutter_actor_add_child (CLUTTER_ACTOR (item_view), new_child);
       child_n++;
     }
 
   /* remove children as needed */
-  l = g_list_last (children);
   while (child_n > model_n)
     {
-      clutter_actor_remove_child (CLUTTER_ACTOR (item_view), l->data);
-      l = g_list_previous (l);
+      child = clutter_actor_get_last_child (CLUTTER_ACTOR (item_view));
+      clutter_actor_remove_child (CLUTTER_ACTOR (item_view), child);
       child_n--;
     }
 
-  g_list_free (children);
-
   if (!priv->model)
     return;
 
-  children = clutter_actor_get_children (CLUTTER_ACTOR (item_view));
-
   /* set the properties on the children */
   iter = clutter_model_get_first_iter (priv->model);
-  l = children;
-  while (iter && !clutter_model_iter_is_last (iter))
+  child = clutter_actor_get_first_child (CLUTTER_ACTOR (item_view));
+  while (iter && child && !clutter_model_iter_is_last (iter))
     {
-      GObject *child;
+      mx_item_view_bind_item (child, iter, item_view);
 
-      child = G_OBJECT (l->data);
+      child = clutter_actor_get_next_sibling (child);
+      clutter_model_iter_next (iter);
+    }
 
-      g_object_freeze_notify (child);
-      for (p = priv->attributes; p; p = p->next)
-        {
-          GValue value = { 0, };
-          AttributeData *attr = p->data;
+  if (iter)
+    g_object_unref (iter);
+}
 
-          clutter_model_iter_get_value (iter, attr->col, &value);
+static void
+row_added_cb (ClutterModel     *model,
+              ClutterModelIter *iter,
+              MxItemView       *item_view)
+{
+  MxItemViewPrivate *priv = item_view->priv;
+  ClutterActor *child;
+  gint row;
 
-          g_object_set_property (child, attr->name, &value);
+  if (priv->freeze_count)
+    {
+      priv->update_pending = TRUE;
+      return;
+    }
 
-          g_value_unset (&value);
-        }
-      g_object_thaw_notify (child);
+  if (!priv->item_type && !priv->factory)
+    return;
 
-      l = g_list_next (l);
-      clutter_model_iter_next (iter);
+  /* the row may not pass the filter */
+  if (clutter_model_get_filter_set (model))
+    {
+      model_changed_cb (model, item_view);
+      return;
     }
 
-  g_list_free (children);
+  row = clutter_model_iter_get_row (iter);
 
-  if (iter)
-    g_object_unref (iter);
+  if (priv->virtualized)
+    {
+      /* keep the focused row on the same item */
+      if (priv->focus_row >= row)
+        priv->focus_row++;
+
+      _mx_item_pool_insert_row (priv->pool, row);
+      mx_item_view_queue_update (item_view);
+      return;
+    }
+
+  /* only the new row needs a child */
+  child = mx_item_view_create_item (item_view);
+  mx_item_view_bind_item (child, iter, item_view);
+  clutter_actor_insert_child_at_index (CLUTTER_ACTOR (item_view), child, row);
 }
 
 static void
@@ -306,7 +1158,40 @@ row_changed_cb (ClutterModel     *model,
                 ClutterModelIter *iter,
                 MxItemView       *item_view)
 {
-  model_changed_cb (model, item_view);
+  MxItemViewPrivate *priv = item_view->priv;
+  ClutterActor *child;
+  gint row;
+
+  if (priv->freeze_count)
+    {
+      priv->update_pending = TRUE;
+      return;
+    }
+
+  /* the row may have stopped or started passing the filter */
+  if (clutter_model_get_filter_set (model))
+    {
+      model_changed_cb (model, item_view);
+      return;
+    }
+
+  row = clutter_model_iter_get_row (iter);
+
+  if (priv->virtualized)
+    {
+      /* the cell may have to grow to fit the item */
+      child = _mx_item_pool_get_item (priv->pool, row);
+      if (child)
+        {
+          mx_item_view_bind_item (child, iter, item_view);
+          clutter_actor_queue_relayout (CLUTTER_ACTOR (item_view));
+        }
+      return;
+    }
+
+  child = clutter_actor_get_child_at_index (CLUTTER_ACTOR (item_view), row);
+  if (child)
+    mx_item_view_bind_item (child, iter, item_view);
 }
 
 static void
@@ -314,18 +1199,40 @@ row_removed_cb (ClutterModel     *model,
                 ClutterModelIter *iter,
                 MxItemView       *item_view)
 {
-  GList *children;
-  GList *l;
+  MxItemViewPrivate *priv = item_view->priv;
   ClutterActor *child;
+  gint row;
 
-  if (item_view->priv->is_frozen)
-    return;
+  if (priv->freeze_count)
+    {
+      priv->update_pending = TRUE;
+      return;
+    }
 
-  children = clutter_actor_get_children (CLUTTER_ACTOR (item_view));
-  l = g_list_nth (children, clutter_model_iter_get_row (iter));
-  child = (ClutterActor *) l->data;
-  clutter_actor_remove_child (CLUTTER_ACTOR (item_view), child);
-  g_list_free (children);
+  /* the row number counts the rows that don't pass the filter */
+  if (clutter_model_get_filter_set (model))
+    {
+      model_changed_cb (model, item_view);
+      return;
+    }
+
+  row = clutter_model_iter_get_row (iter);
+
+  if (priv->virtualized)
+    {
+      if (priv->focus_row == row)
+        priv->focus_row = -1;
+      else if (priv->focus_row > row)
+        priv->focus_row--;
+
+      _mx_item_pool_remove_row (priv->pool, row);
+      mx_item_view_queue_update (item_view);
+      return;
+    }
+
+  child = clutter_actor_get_child_at_index (CLUTTER_ACTOR (item_view), row);
+  if (child)
+    clutter_actor_remove_child (CLUTTER_ACTOR (item_view), child);
 }
 
 /* public api */
@@ -377,6 +1284,10 @@ mx_item_view_set_item_type (MxItemView *item_view,
 
   item_view->priv->item_type = item_type;
 
+  /* the items of the old type can't be reused */
+  if (item_view->priv->pool)
+    _mx_item_pool_clear (item_view->priv->pool);
+
   /* update the view */
   model_changed_cb (item_view->priv->model, item_view);
 }
@@ -420,6 +1331,9 @@ mx_item_view_set_model (MxItemView   *item_view,
       g_signal_handlers_disconnect_by_func (priv->model,
                                             (GCallback) model_changed_cb,
                                             item_view);
+      g_signal_handlers_disconnect_by_func (priv->model,
+                                            (GCallback) row_added_cb,
+                                            item_view);
       g_signal_handlers_disconnect_by_func (priv->model,
                                             (GCallback) row_changed_cb,
                                             item_view);
@@ -444,7 +1358,7 @@ mx_item_view_set_model (MxItemView   *item_view,
 
       priv->row_added = g_signal_connect (priv->model,
                                           "row-added",
-                                          G_CALLBACK (row_changed_cb),
+                                          G_CALLBACK (row_added_cb),
                                           item_view);
 
       priv->row_changed = g_signal_connect (priv->model,
@@ -453,8 +1367,8 @@ mx_item_view_set_model (MxItemView   *item_view,
                                             item_view);
 
       /*
-       * model_changed_cb (called from row_changed_cb) expect the row to already
-       * have been removed, thus we need to use _after
+       * row_removed_cb only removes the child of the row, so it is fine for
+       * the row to still be in the model
        */
       priv->row_removed = g_signal_connect_after (priv->model,
                                                   "row-removed",
@@ -511,14 +1425,19 @@ mx_item_view_add_attribute (MxItemView  *item_view,
  * @item_view: An #MxItemView
  *
  * Freeze the view. This means that the view will not act on changes to the
- * model until it is thawed. Call #mx_item_view_thaw to thaw the view
+ * model until it is thawed. Call #mx_item_view_thaw to thaw the view.
+ *
+ * Freezing the view while a lot of the model is changed is quicker than
+ * updating the children as each row is added, changed or removed. Calls to
+ * this function can be nested, and the view is thawed by the last of the
+ * matching calls to mx_item_view_thaw().
  */
 void
 mx_item_view_freeze (MxItemView *item_view)
 {
   g_return_if_fail (MX_IS_ITEM_VIEW (item_view));
 
-  item_view->priv->is_frozen = TRUE;
+  item_view->priv->freeze_count ++;
 }
 
 /**
@@ -526,7 +1445,8 @@ mx_item_view_freeze (MxItemView *item_view)
  * @item_view: An #MxItemView
  *
  * Thaw the view. This means that the view will now act on changes to the
- * model.
+ * model. If the model was changed while the view was frozen, the children
+ * are updated for all of the changes at once.
  */
 void
 mx_item_view_thaw (MxItemView *item_view)
@@ -537,10 +1457,23 @@ mx_item_view_thaw (MxItemView *item_view)
 
   priv = item_view->priv;
 
-  priv->is_frozen = FALSE;
+  g_return_if_fail (priv->freeze_count > 0);
 
-  /* Repopulate */
-  model_changed_cb (priv->model, item_view);
+  if (--priv->freeze_count)
+    return;
+
+  if (priv->update_pending)
+    {
+      priv->update_pending = FALSE;
+
+      /* Repopulate */
+      model_changed_cb (priv->model, item_view);
+    }
+  else if (priv->virtualized)
+    {
+      /* the visible rows are not laid out while the view is frozen */
+      mx_item_view_queue_update (item_view);
+    }
 }
 
 /**
@@ -573,6 +1506,12 @@ mx_item_view_set_factory (MxItemView    *item_view,
   if (factory)
     priv->factory = g_object_ref (factory);
 
+  if (priv->pool)
+    {
+      _mx_item_pool_clear (priv->pool);
+      mx_item_view_reset_items (item_view);
+    }
+
   g_object_notify (G_OBJECT (item_view), "factory");
 }
 
@@ -590,3 +1529,136 @@ mx_item_view_get_factory (MxItemView *item_view)
   g_return_val_if_fail (MX_IS_ITEM_VIEW (item_view), NULL);
   return item_view->priv->factory;
 }
+
+/**
+ * mx_item_view_set_virtualized:
+ * @item_view: A #MxItemView
+ * @virtualized: %TRUE to only create items for the visible rows
+ *
+ * Sets whether the view only creates items for the rows of the model that
+ * are visible, and the @overscan lines of items either side of them. When
+ * it does, the items are reused for other rows as the view is scrolled, so
+ * the number of items doesn't depend on the number of rows in the model.
+ *
+ * A virtualized view should be placed in an #MxScrollView. Every item is
+ * given a cell the size of the largest item that has been shown, and the
+ * cells are placed in rows from left to right, whatever the
+ * #MxGrid:orientation. Moving the focus to a row scrolls it into view and
+ * creates its item if needed.
+ *
+ * Since: 2.0
+ */
+void
+mx_item_view_set_virtualized (MxItemView *item_view,
+                              gboolean    virtualized)
+{
+  MxItemViewPrivate *priv;
+
+  g_return_if_fail (MX_IS_ITEM_VIEW (item_view));
+
+  priv = item_view->priv;
+
+  if (priv->virtualized == virtualized)
+    return;
+
+  priv->virtualized = virtualized;
+
+  if (virtualized)
+    {
+      clutter_actor_destroy_all_children (CLUTTER_ACTOR (item_view));
+
+      priv->pool =
+        _mx_item_pool_new (CLUTTER_ACTOR (item_view),
+                           (MxItemPoolCreateFunc) mx_item_view_create_item,
+                           (MxItemPoolBindFunc) mx_item_view_bind_item,
+                           item_view);
+      priv->content_height = 0;
+    }
+  else
+    {
+      if (priv->update_id)
+        {
+          clutter_threads_remove_repaint_func (priv->update_id);
+          priv->update_id = 0;
+        }
+
+      _mx_item_pool_clear (priv->pool);
+      _mx_item_pool_free (priv->pool);
+      priv->pool = NULL;
+    }
+
+  model_changed_cb (priv->model, item_view);
+  clutter_actor_queue_relayout (CLUTTER_ACTOR (item_view));
+
+  g_object_notify (G_OBJECT (item_view), "virtualized");
+}
+
+/**
+ * mx_item_view_get_virtualized:
+ * @item_view: A #MxItemView
+ *
+ * Gets whether the view only creates items for the visible rows. See
+ * mx_item_view_set_virtualized().
+ *
+ * Returns: %TRUE if the view is virtualized
+ *
+ * Since: 2.0
+ */
+gboolean
+mx_item_view_get_virtualized (MxItemView *item_view)
+{
+  g_return_val_if_fail (MX_IS_ITEM_VIEW (item_view), FALSE);
+
+  return item_view->priv->virtualized;
+}
+
+/**
+ * mx_item_view_set_overscan:
+ * @item_view: A #MxItemView
+ * @overscan: A number of lines
+ *
+ * Sets the number of lines of items before and after the visible lines
+ * that a virtualized view creates, so that they are ready before they
+ * are scrolled into view.
+ *
+ * Since: 2.0
+ */
+void
+mx_item_view_set_overscan (MxItemView *item_view,
+                           guint       overscan)
+{
+  MxItemViewPrivate *priv;
+
+  g_return_if_fail (MX_IS_ITEM_VIEW (item_view));
+
+  priv = item_view->priv;
+
+  if (priv->overscan == overscan)
+    return;
+
+  priv->overscan = overscan;
+
+  if (priv->virtualized)
+    mx_item_view_queue_update (item_view);
+
+  g_object_notify (G_OBJECT (item_view), "overscan");
+}
+
+/**
+ * mx_item_view_get_overscan:
+ * @item_view: A #MxItemView
+ *
+ * Gets the number of lines of items either side of the visible lines that
+ * a virtualized view creates.
+ *
+ * Returns: the number of lines
+ *
+ * Since: 2.0
+ */
+guint
+mx_item_view_get_overscan (MxItemView *item_view)
+{
+  g_return_val_if_fail (MX_IS_ITEM_VIEW (item_view), 0);
+
+  return item_view->priv->overscan;
+}
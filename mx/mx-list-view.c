@@ -32,12 +32,22 @@
  *
  * Data is set on the children by mapping columns in the model to object
  * properties on the children.
+ *
+ * When #MxListView:virtualized is set, children are only created for the
+ * rows that are visible through the vertical #MxAdjustment of the view,
+ * and the #MxListView:overscan rows before and after them, so that large
+ * models can be shown. As the view is scrolled, the children of the rows
+ * that are no longer visible are reused for the rows that have become
+ * visible. The height of the rows that haven't been shown is estimated
+ * from the height of the rows that have.
  */
 
 #include "mx-list-view.h"
 #include "mx-box-layout.h"
+#include "mx-box-layout-child.h"
 #include "mx-private.h"
 #include "mx-item-factory.h"
+#include "mx-item-pool.h"
 
 G_DEFINE_TYPE (MxListView, mx_list_view, MX_TYPE_BOX_LAYOUT)
 
@@ -56,7 +66,9 @@ enum
 
   PROP_MODEL,
   PROP_ITEM_TYPE,
-  PROP_FACTORY
+  PROP_FACTORY,
+  PROP_VIRTUALIZED,
+  PROP_OVERSCAN
 };
 
 struct _MxListViewPrivate
@@ -73,7 +85,33 @@ struct _MxListViewPrivate
   gulong         row_removed;
   gulong         sort_changed;
 
-  guint          is_frozen : 1;
+  guint          virtualized : 1;
+
+  /* changes to the model are not acted on while the view is frozen, and
+   * update_pending is set so that the view is updated once it is thawed */
+  guint          freeze_count;
+  guint          update_pending : 1;
+
+  /* the items of the visible rows, when virtualized */
+  MxItemPool    *pool;
+  guint          overscan;
+  guint          update_id;
+  MxAdjustment  *vadjustment;
+
+  /* the height of each row at the width in measured_width, or -1 if it
+   * hasn't been measured, and the sum and number of the measured heights */
+  GArray        *heights;
+  gdouble        measured_height;
+  gint           n_measured;
+  gfloat         measured_width;
+
+  /* the row from which the other rows are laid out and its position, and
+   * the area the rows cover */
+  gint           anchor_row;
+  gfloat         anchor_y;
+  gfloat         items_y1;
+  gfloat         items_y2;
+  gfloat         content_height;
 };
 
 /* gobject implementations */
@@ -96,6 +134,12 @@ mx_list_view_get_property (GObject    *object,
     case PROP_FACTORY:
       g_value_set_object (value, priv->factory);
       break;
+    case PROP_VIRTUALIZED:
+      g_value_set_boolean (value, priv->virtualized);
+      break;
+    case PROP_OVERSCAN:
+      g_value_set_uint (value, priv->overscan);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
     }
@@ -121,11 +165,532 @@ mx_list_view_set_property (GObject      *object,
       mx_list_view_set_factory ((MxListView*) object,
                                 (MxItemFactory*) g_value_get_object (value));
       break;
+    case PROP_VIRTUALIZED:
+      mx_list_view_set_virtualized ((MxListView*) object,
+                                    g_value_get_boolean (value));
+      break;
+    case PROP_OVERSCAN:
+      mx_list_view_set_overscan ((MxListView*) object,
+                                 g_value_get_uint (value));
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
     }
 }
 
+static ClutterActor *
+mx_list_view_create_item (MxListView *list_view)
+{
+  MxListViewPrivate *priv = list_view->priv;
+
+  if (priv->item_type)
+    return g_object_new (priv->item_type, NULL);
+  else
+    return mx_item_factory_create (priv->factory);
+}
+
+static void
+mx_list_view_bind_item (ClutterActor     *item,
+                        ClutterModelIter *iter,
+                        MxListView       *list_view)
+{
+  GSList *p;
+  GObject *child = G_OBJECT (item);
+
+  g_object_freeze_notify (child);
+  for (p = list_view->priv->attributes; p; p = p->next)
+    {
+      GValue value = { 0, };
+      AttributeData *attr = p->data;
+      GParamSpec *pspec;
+
+      clutter_model_iter_get_value (iter, attr->col, &value);
+
+      /* only set the properties that have changed, so that rebinding a row
+       * doesn't make the item relayout for the columns that haven't */
+      pspec = g_object_class_find_property (G_OBJECT_GET_CLASS (child),
+                                            attr->name);
+      if (pspec && G_VALUE_TYPE (&value) == pspec->value_type)
+        {
+          GValue old_value = { 0, };
+
+          g_value_init (&old_value, pspec->value_type);
+          g_object_get_property (child, attr->name, &old_value);
+
+          if (g_param_values_cmp (pspec, &value, &old_value) != 0)
+            g_object_set_property (child, attr->name, &value);
+
+          g_value_unset (&old_value);
+        }
+      else
+        g_object_set_property (child, attr->name, &value);
+
+      g_value_unset (&value);
+    }
+  g_object_thaw_notify (child);
+}
+
+/* virtualized mode */
+
+static void
+mx_list_view_set_row_height (MxListViewPrivate *priv,
+                             gint               row,
+                             gfloat             height)
+{
+  gfloat *old_height = &g_array_index (priv->heights, gfloat, row);
+
+  if (*old_height >= 0)
+    {
+      priv->measured_height -= *old_height;
+      priv->n_measured --;
+    }
+
+  if (height >= 0)
+    {
+      priv->measured_height += height;
+      priv->n_measured ++;
+    }
+
+  *old_height = height;
+}
+
+static void
+mx_list_view_reset_heights (MxListViewPrivate *priv,
+                            gint               n_rows)
+{
+  gint i;
+
+  g_array_set_size (priv->heights, n_rows);
+  for (i = 0; i < n_rows; i++)
+    g_array_index (priv->heights, gfloat, i) = -1;
+
+  priv->measured_height = 0;
+  priv->n_measured = 0;
+}
+
+static gfloat
+mx_list_view_get_estimated_height (MxListViewPrivate *priv)
+{
+  return priv->n_measured ? priv->measured_height / priv->n_measured : 0;
+}
+
+static gfloat
+mx_list_view_get_row_height (MxListViewPrivate *priv,
+                             gint               row,
+                             gfloat             estimate)
+{
+  gfloat height = g_array_index (priv->heights, gfloat, row);
+
+  return (height >= 0) ? height : estimate;
+}
+
+/* The height of all of the rows, with the rows that haven't been measured
+ * taking the average height of the ones that have */
+static gfloat
+mx_list_view_get_content_height (MxListView *list_view)
+{
+  MxListViewPrivate *priv = list_view->priv;
+  gint n_rows = priv->heights->len;
+
+  if (!n_rows)
+    return 0;
+
+  return priv->measured_height +
+    (n_rows - priv->n_measured) * mx_list_view_get_estimated_height (priv) +
+    mx_box_layout_get_spacing (MX_BOX_LAYOUT (list_view)) * (n_rows - 1);
+}
+
+static gfloat
+mx_list_view_measure_row (MxListView   *list_view,
+                          gint          row,
+                          ClutterActor *item,
+                          gfloat        for_width)
+{
+  gfloat height;
+
+  clutter_actor_get_preferred_height (item, for_width, NULL, &height);
+
+  /* the items may still be bound to rows that have been removed */
+  if (row < (gint) list_view->priv->heights->len)
+    mx_list_view_set_row_height (list_view->priv, row, height);
+
+  return height;
+}
+
+/* Chooses the rows to create items for, from the position of the vertical
+ * adjustment. The row at the top of the view is found by walking from the
+ * current anchor row over the heights of the rows in between, so that rows
+ * that are already laid out stay in place. Only after a jump of more than
+ * two pages, or when there is no anchor, is the row at the top placed at
+ * its estimated position. The rows after it are added until the view is
+ * full. */
+static void
+mx_list_view_update_items (MxListView *list_view)
+{
+  MxListViewPrivate *priv = list_view->priv;
+  gfloat value, view_height, width, estimate, spacing, height, y;
+  gint n_rows, first, last, start, end;
+  ClutterActor *actor = CLUTTER_ACTOR (list_view);
+  gboolean changed = FALSE;
+  ClutterActorBox box;
+  MxPadding padding;
+
+  if (priv->freeze_count || !priv->model || (!priv->item_type && !priv->factory))
+    n_rows = 0;
+  else
+    n_rows = clutter_model_get_n_rows (priv->model);
+
+  if (priv->heights->len != n_rows)
+    mx_list_view_reset_heights (priv, n_rows);
+
+  if (!n_rows)
+    {
+      if (_mx_item_pool_set_range (priv->pool, NULL, 0, 0))
+        clutter_actor_queue_relayout (actor);
+      return;
+    }
+
+  mx_widget_get_padding (MX_WIDGET (actor), &padding);
+  spacing = mx_box_layout_get_spacing (MX_BOX_LAYOUT (actor));
+
+  clutter_actor_get_allocation_box (actor, &box);
+  view_height = box.y2 - box.y1;
+  width = box.x2 - box.x1 - padding.left - padding.right;
+  if (width <= 0)
+    width = -1;
+
+  value = priv->vadjustment ? mx_adjustment_get_value (priv->vadjustment) : 0;
+
+  /* without any measured rows, measure the first one to have an estimate
+   * for the others */
+  if (!priv->n_measured)
+    {
+      ClutterActor *item;
+
+      _mx_item_pool_set_range (priv->pool, priv->model, 0, 1);
+      if ((item = _mx_item_pool_get_item (priv->pool, 0)))
+        mx_list_view_measure_row (list_view, 0, item, width);
+
+      changed = TRUE;
+    }
+
+  estimate = mx_list_view_get_estimated_height (priv);
+
+  if (priv->anchor_row >= 0 && priv->anchor_row < n_rows &&
+      ABS (value - priv->anchor_y) <= 2 * view_height)
+    {
+      first = priv->anchor_row;
+      y = priv->anchor_y;
+
+      while (first > 0 && y > value)
+        {
+          first--;
+          y -= mx_list_view_get_row_height (priv, first, estimate) + spacing;
+        }
+
+      while (first < n_rows - 1 &&
+             y + mx_list_view_get_row_height (priv, first, estimate) +
+             spacing <= value)
+        {
+          y += mx_list_view_get_row_height (priv, first, estimate) + spacing;
+          first++;
+        }
+
+      /* the first row is always at the top, whatever the heights of the
+       * rows before the old anchor were estimated to be */
+      if (first == 0)
+        y = padding.top;
+    }
+  else
+    {
+      if (estimate + spacing > 0)
+        first = (value - padding.top) / (estimate + spacing);
+      else
+        first = 0;
+      first = CLAMP (first, 0, n_rows - 1);
+
+      y = padding.top + first * (estimate + spacing);
+    }
+
+  if (first != priv->anchor_row || y != priv->anchor_y)
+    {
+      priv->anchor_row = first;
+      priv->anchor_y = y;
+      changed = TRUE;
+    }
+
+  for (last = first; last < n_rows && y < value + view_height; last++)
+    y += mx_list_view_get_row_height (priv, last, estimate) + spacing;
+  if (last == first)
+    last = first + 1;
+
+  start = MAX (0, first - (gint) priv->overscan);
+  end = MIN (n_rows, last + (gint) priv->overscan);
+
+  if (_mx_item_pool_set_range (priv->pool, priv->model, start, end))
+    changed = TRUE;
+
+  /* the preferred height changes as rows are measured */
+  height = mx_list_view_get_content_height (list_view);
+  if (priv->content_height != height)
+    {
+      priv->content_height = height;
+      changed = TRUE;
+    }
+
+  if (changed)
+    clutter_actor_queue_relayout (actor);
+}
+
+static gboolean
+mx_list_view_update_cb (MxListView *list_view)
+{
+  list_view->priv->update_id = 0;
+
+  mx_list_view_update_items (list_view);
+
+  return FALSE;
+}
+
+/* Items are created and bound before the next frame is laid out, rather
+ * than while the view is being allocated */
+static void
+mx_list_view_queue_update (MxListView *list_view)
+{
+  MxListViewPrivate *priv = list_view->priv;
+
+  if (!priv->update_id)
+    priv->update_id =
+      clutter_threads_add_repaint_func_full (CLUTTER_REPAINT_FLAGS_PRE_PAINT,
+                                             (GSourceFunc) mx_list_view_update_cb,
+                                             list_view, NULL);
+
+  clutter_actor_queue_redraw (CLUTTER_ACTOR (list_view));
+}
+
+/* Checks whether the items that have been laid out still cover the view,
+ * and updates them if they don't */
+static void
+mx_list_view_check_items (MxListView *list_view)
+{
+  MxListViewPrivate *priv = list_view->priv;
+  gfloat value, view_height;
+  gint start, end;
+
+  value = priv->vadjustment ? mx_adjustment_get_value (priv->vadjustment) : 0;
+  view_height = clutter_actor_get_height (CLUTTER_ACTOR (list_view));
+
+  start = _mx_item_pool_get_start (priv->pool);
+  end = _mx_item_pool_get_end (priv->pool);
+
+  if ((start > 0 && priv->items_y1 > value) ||
+      (end < (gint) priv->heights->len && priv->items_y2 < value + view_height) ||
+      priv->content_height != mx_list_view_get_content_height (list_view))
+    mx_list_view_queue_update (list_view);
+}
+
+static void
+mx_list_view_adjustment_value_cb (MxAdjustment *adjustment,
+                                  GParamSpec   *pspec,
+                                  MxListView   *list_view)
+{
+  if (list_view->priv->virtualized)
+    mx_list_view_check_items (list_view);
+}
+
+static void
+mx_list_view_notify_vadjustment_cb (MxListView *list_view,
+                                    GParamSpec *pspec)
+{
+  MxListViewPrivate *priv = list_view->priv;
+  MxAdjustment *vadjustment;
+
+  _mx_box_layout_get_adjustments (MX_BOX_LAYOUT (list_view), NULL,
+                                  &vadjustment);
+
+  if (priv->vadjustment == vadjustment)
+    return;
+
+  if (priv->vadjustment)
+    {
+      g_signal_handlers_disconnect_by_func (priv->vadjustment,
+                                            mx_list_view_adjustment_value_cb,
+                                            list_view);
+      g_object_unref (priv->vadjustment);
+    }
+
+  priv->vadjustment = vadjustment ? g_object_ref (vadjustment) : NULL;
+
+  if (priv->vadjustment)
+    g_signal_connect (priv->vadjustment, "notify::value",
+                      G_CALLBACK (mx_list_view_adjustment_value_cb),
+                      list_view);
+
+  if (priv->virtualized)
+    mx_list_view_queue_update (list_view);
+}
+
+/* Throws away what is known about the rows, after the model has changed */
+static void
+mx_list_view_reset_items (MxListView *list_view)
+{
+  MxListViewPrivate *priv = list_view->priv;
+
+  mx_list_view_reset_heights (priv, priv->model ?
+                              clutter_model_get_n_rows (priv->model) : 0);
+  _mx_item_pool_invalidate (priv->pool);
+  priv->anchor_row = -1;
+  mx_list_view_queue_update (list_view);
+}
+
+static void
+mx_list_view_get_preferred_height (ClutterActor *actor,
+                                   gfloat        for_width,
+                                   gfloat       *min_height_p,
+                                   gfloat       *nat_height_p)
+{
+  MxListView *list_view = MX_LIST_VIEW (actor);
+  MxPadding padding;
+  gfloat height;
+
+  if (!list_view->priv->virtualized)
+    {
+      CLUTTER_ACTOR_CLASS (mx_list_view_parent_class)->
+        get_preferred_height (actor, for_width, min_height_p, nat_height_p);
+      return;
+    }
+
+  mx_widget_get_padding (MX_WIDGET (actor), &padding);
+  height = mx_list_view_get_content_height (list_view) +
+    padding.top + padding.bottom;
+
+  if (min_height_p)
+    *min_height_p = height;
+  if (nat_height_p)
+    *nat_height_p = height;
+}
+
+static void
+mx_list_view_allocate_item (ClutterActor          *actor,
+                            ClutterActor          *item,
+                            gfloat                 x,
+                            gfloat                 y,
+                            gfloat                 width,
+                            gfloat                 height,
+                            ClutterAllocationFlags flags)
+{
+  ClutterActorBox child_box;
+  MxBoxLayoutChild *meta;
+
+  meta = (MxBoxLayoutChild *)
+    clutter_container_get_child_meta (CLUTTER_CONTAINER (actor), item);
+
+  child_box.x1 = x;
+  child_box.y1 = y;
+  child_box.x2 = x + width;
+  child_box.y2 = y + height;
+
+  mx_allocate_align_fill (item, &child_box, meta->x_align, meta->y_align,
+                          meta->x_fill, meta->y_fill);
+  clutter_actor_allocate (item, &child_box, flags);
+}
+
+static void
+mx_list_view_allocate (ClutterActor          *actor,
+                       const ClutterActorBox *box,
+                       ClutterAllocationFlags flags)
+{
+  MxListView *list_view = MX_LIST_VIEW (actor);
+  MxListViewPrivate *priv = list_view->priv;
+  gfloat avail_width, avail_height, spacing, height, y;
+  MxAdjustment *hadjustment;
+  gint row, start, end;
+  MxPadding padding;
+
+  if (!priv->virtualized)
+    {
+      CLUTTER_ACTOR_CLASS (mx_list_view_parent_class)->allocate (actor, box,
+                                                                 flags);
+      return;
+    }
+
+  /* MxBoxLayout would lay the items out as if they were the only rows,
+   * so skip it and lay them out around the anchor row instead */
+  CLUTTER_ACTOR_CLASS (g_type_class_peek (MX_TYPE_WIDGET))->allocate (actor,
+                                                                      box,
+                                                                      flags);
+
+  mx_widget_get_padding (MX_WIDGET (actor), &padding);
+  spacing = mx_box_layout_get_spacing (MX_BOX_LAYOUT (actor));
+
+  avail_width = box->x2 - box->x1 - padding.left - padding.right;
+  avail_height = box->y2 - box->y1 - padding.top - padding.bottom;
+
+  /* the heights of the rows depend on the width */
+  if (avail_width != priv->measured_width)
+    {
+      mx_list_view_reset_heights (priv, priv->heights->len);
+      priv->measured_width = avail_width;
+    }
+
+  start = _mx_item_pool_get_start (priv->pool);
+  end = _mx_item_pool_get_end (priv->pool);
+
+  y = priv->items_y1 = priv->items_y2 = priv->anchor_y;
+  for (row = MAX (start, priv->anchor_row); row < end; row++)
+    {
+      ClutterActor *item = _mx_item_pool_get_item (priv->pool, row);
+
+      height = mx_list_view_measure_row (list_view, row, item, avail_width);
+      mx_list_view_allocate_item (actor, item, padding.left, y,
+                                  avail_width, height, flags);
+
+      priv->items_y2 = y + height;
+      y += height + spacing;
+    }
+
+  y = priv->anchor_y;
+  for (row = MIN (end, priv->anchor_row) - 1; row >= start; row--)
+    {
+      ClutterActor *item = _mx_item_pool_get_item (priv->pool, row);
+
+      height = mx_list_view_measure_row (list_view, row, item, avail_width);
+      y -= height + spacing;
+      mx_list_view_allocate_item (actor, item, padding.left, y,
+                                  avail_width, height, flags);
+
+      priv->items_y1 = y;
+    }
+
+  /* make sure the last row can be scrolled to, when it has been laid out
+   * further down than estimated */
+  height = mx_list_view_get_content_height (list_view);
+  if (end == (gint) priv->heights->len && end > start)
+    height = MAX (height, priv->items_y2 - padding.top);
+
+  if (priv->vadjustment)
+    g_object_set (G_OBJECT (priv->vadjustment),
+                  "lower", 0.0,
+                  "upper", height,
+                  "page-size", avail_height,
+                  "step-increment",
+                  mx_list_view_get_estimated_height (priv) + spacing,
+                  "page-increment", avail_height,
+                  NULL);
+
+  _mx_box_layout_get_adjustments (MX_BOX_LAYOUT (actor), &hadjustment, NULL);
+  if (hadjustment)
+    g_object_set (G_OBJECT (hadjustment),
+                  "lower", 0.0,
+                  "upper", avail_width,
+                  "page-size", avail_width,
+                  "step-increment", avail_width / 6,
+                  "page-increment", avail_width,
+                  NULL);
+
+  mx_list_view_check_items (list_view);
+}
+
 static void
 mx_list_view_dispose (GObject *object)
 {
@@ -134,6 +699,28 @@ mx_list_view_dispose (GObject *object)
   /* This will cause the unref of the model and also disconnect the signals */
   mx_list_view_set_model (MX_LIST_VIEW (object), NULL);
 
+  if (priv->update_id)
+    {
+      clutter_threads_remove_repaint_func (priv->update_id);
+      priv->update_id = 0;
+    }
+
+  if (priv->vadjustment)
+    {
+      g_signal_handlers_disconnect_by_func (priv->vadjustment,
+                                            mx_list_view_adjustment_value_cb,
+                                            object);
+      g_object_unref (priv->vadjustment);
+      priv->vadjustment = NULL;
+    }
+
+  /* the items are destroyed with the rest of the children */
+  if (priv->pool)
+    {
+      _mx_item_pool_free (priv->pool);
+      priv->pool = NULL;
+    }
+
   if (priv->factory)
     {
       g_object_unref (priv->factory);
@@ -162,6 +749,9 @@ mx_list_view_finalize (GObject *object)
       priv->attributes = NULL;
     }
 
+  if (priv->heights)
+    g_array_free (priv->heights, TRUE);
+
   G_OBJECT_CLASS (mx_list_view_parent_class)->finalize (object);
 }
 
@@ -169,6 +759,7 @@ static void
 mx_list_view_class_init (MxListViewClass *klass)
 {
   GObjectClass *object_class = G_OBJECT_CLASS (klass);
+  ClutterActorClass *actor_class = CLUTTER_ACTOR_CLASS (klass);
   GParamSpec *pspec;
 
   g_type_class_add_private (klass, sizeof (MxListViewPrivate));
@@ -178,6 +769,9 @@ mx_list_view_class_init (MxListViewClass *klass)
   object_class->dispose = mx_list_view_dispose;
   object_class->finalize = mx_list_view_finalize;
 
+  actor_class->get_preferred_height = mx_list_view_get_preferred_height;
+  actor_class->allocate = mx_list_view_allocate;
+
   pspec = g_param_spec_object ("model",
                                "model",
                                "The model for the item view",
@@ -203,6 +797,22 @@ mx_list_view_class_init (MxListViewClass *klass)
                                G_TYPE_OBJECT /*MX_TYPE_ITEM_FACTORY*/,
                                MX_PARAM_READWRITE);
   g_object_class_install_property (object_class, PROP_FACTORY, pspec);
+
+  pspec = g_param_spec_boolean ("virtualized",
+                                "Virtualized",
+                                "Whether items are only created for the rows "
+                                "that are visible.",
+                                FALSE,
+                                MX_PARAM_READWRITE);
+  g_object_class_install_property (object_class, PROP_VIRTUALIZED, pspec);
+
+  pspec = g_param_spec_uint ("overscan",
+                             "Overscan",
+                             "The number of rows before and after the visible "
+                             "rows to create items for when virtualized.",
+                             0, G_MAXUINT, 4,
+                             MX_PARAM_READWRITE);
+  g_object_class_install_property (object_class, PROP_OVERSCAN, pspec);
 }
 
 static void
@@ -210,7 +820,13 @@ mx_list_view_init (MxListView *list_view)
 {
   list_view->priv = LIST_VIEW_PRIVATE (list_view);
 
+  list_view->priv->overscan = 4;
+  list_view->priv->anchor_row = -1;
+
   mx_box_layout_set_orientation (MX_BOX_LAYOUT (list_view), MX_ORIENTATION_VERTICAL);
+
+  g_signal_connect (list_view, "notify::vertical-adjustment",
+                    G_CALLBACK (mx_list_view_notify_vadjustment_cb), NULL);
 }
 
 
@@ -219,8 +835,7 @@ static void
 model_changed_cb (ClutterModel *model,
                   MxListView   *list_view)
 {
-  GSList *p;
-  GList *l, *children;
+  ClutterActor *child;
   MxListViewPrivate *priv = list_view->priv;
   ClutterModelIter *iter = NULL;
   gint model_n = 0, child_n = 0;
@@ -230,8 +845,11 @@ model_changed_cb (ClutterModel *model,
   if (!priv->item_type && !priv->factory)
     return;
 
-  if (priv->is_frozen)
-    return;
+  if (priv->freeze_count)
+    {
+      priv->update_pending = TRUE;
+      return;
+    }
 
   if (priv->item_type)
     {
@@ -245,8 +863,13 @@ model_changed_cb (ClutterModel *model,
         }
     }
 
-  children = clutter_actor_get_children (CLUTTER_ACTOR (list_view));
-  child_n = g_list_length (children);
+  if (priv->virtualized)
+    {
+      mx_list_view_reset_items (list_view);
+      return;
+    }
+
+  child_n = clutter_actor_get_n_children (CLUTTER_ACTOR (list_view));
 
   if (model)
     model_n = clutter_model_get_n_rows (priv->model);
@@ -258,66 +881,79 @@ model_changed_cb (ClutterModel *model,
     {
       ClutterActor *new_child;
 
-      if (priv->item_type)
-        {
-          new_child = g_object_new (priv->item_type, NULL);
-        }
-      else
-        {
-          new_child = mx_item_factory_create (priv->factory);
-        }
+      new_child = mx_list_view_create_item (list_view);
 
       clutter_actor_add_child (CLUTTER_ACTOR (list_view), new_child);
       child_n++;
     }
 
   /* remove children as needed */
-  l = g_list_last (children);
   while (child_n > model_n)
     {
-      clutter_actor_remove_child (CLUTTER_ACTOR (list_view), l->data);
-      l = g_list_previous (l);
+      child = clutter_actor_get_last_child (CLUTTER_ACTOR (list_view));
+      clutter_actor_remove_child (CLUTTER_ACTOR (list_view), child);
       child_n--;
     }
 
-  g_list_free (children);
-
   if (!priv->model)
     return;
 
-  children = clutter_actor_get_children (CLUTTER_ACTOR (list_view));
-
   /* set the properties on the children */
   iter = clutter_model_get_first_iter (priv->model);
-  l = children;
-  while (iter && !clutter_model_iter_is_last (iter))
+  child = clutter_actor_get_first_child (CLUTTER_ACTOR (list_view));
+  while (iter && child && !clutter_model_iter_is_last (iter))
     {
-      GObject *child;
+      mx_list_view_bind_item (child, iter, list_view);
 
-      child = G_OBJECT (l->data);
+      child = clutter_actor_get_next_sibling (child);
+      clutter_model_iter_next (iter);
+    }
 
-      g_object_freeze_notify (child);
-      for (p = priv->attributes; p; p = p->next)
-        {
-          GValue value = { 0, };
-          AttributeData *attr = p->data;
+  if (iter)
+    g_object_unref (iter);
+}
 
-          clutter_model_iter_get_value (iter, attr->col, &value);
+static void
+row_added_cb (ClutterModel     *model,
+              ClutterModelIter *iter,
+              MxListView       *list_view)
+{
+  MxListViewPrivate *priv = list_view->priv;
+  ClutterActor *child;
+  gint row;
 
-          g_object_set_property (child, attr->name, &value);
+  if (priv->freeze_count)
+    {
+      priv->update_pending = TRUE;
+      return;
+    }
 
-          g_value_unset (&value);
-        }
-      g_object_thaw_notify (child);
+  if (!priv->item_type && !priv->factory)
+    return;
 
-      l = g_list_next (l);
-      clutter_model_iter_next (iter);
+  /* the row may not pass the filter */
+  if (clutter_model_get_filter_set (model))
+    {
+      model_changed_cb (model, list_view);
+      return;
     }
 
-  g_list_free (children);
+  row = clutter_model_iter_get_row (iter);
 
-  if (iter)
-    g_object_unref (iter);
+  if (priv->virtualized)
+    {
+      gfloat height = -1;
+
+      g_array_insert_val (priv->heights, row, height);
+      _mx_item_pool_insert_row (priv->pool, row);
+      mx_list_view_queue_update (list_view);
+      return;
+    }
+
+  /* only the new row needs a child */
+  child = mx_list_view_create_item (list_view);
+  mx_list_view_bind_item (child, iter, list_view);
+  clutter_actor_insert_child_at_index (CLUTTER_ACTOR (list_view), child, row);
 }
 
 static void
@@ -325,7 +961,42 @@ row_changed_cb (ClutterModel     *model,
                 ClutterModelIter *iter,
                 MxListView       *list_view)
 {
-  model_changed_cb (model, list_view);
+  MxListViewPrivate *priv = list_view->priv;
+  ClutterActor *child;
+  guint row;
+
+  if (priv->freeze_count)
+    {
+      priv->update_pending = TRUE;
+      return;
+    }
+
+  /* the row may have stopped or started passing the filter */
+  if (clutter_model_get_filter_set (model))
+    {
+      model_changed_cb (model, list_view);
+      return;
+    }
+
+  row = clutter_model_iter_get_row (iter);
+
+  if (priv->virtualized)
+    {
+      /* the row has to be measured again */
+      if (row < priv->heights->len)
+        mx_list_view_set_row_height (priv, row, -1);
+
+      child = _mx_item_pool_get_item (priv->pool, row);
+      if (child)
+        mx_list_view_bind_item (child, iter, list_view);
+
+      mx_list_view_queue_update (list_view);
+      return;
+    }
+
+  child = clutter_actor_get_child_at_index (CLUTTER_ACTOR (list_view), row);
+  if (child)
+    mx_list_view_bind_item (child, iter, list_view);
 }
 
 static void
@@ -333,18 +1004,41 @@ row_removed_cb (ClutterModel     *model,
                 ClutterModelIter *iter,
                 MxListView       *list_view)
 {
-  GList *children;
-  GList *l;
+  MxListViewPrivate *priv = list_view->priv;
   ClutterActor *child;
+  guint row;
 
-  if (list_view->priv->is_frozen)
-    return;
+  if (priv->freeze_count)
+    {
+      priv->update_pending = TRUE;
+      return;
+    }
+
+  /* the row number counts the rows that don't pass the filter */
+  if (clutter_model_get_filter_set (model))
+    {
+      model_changed_cb (model, list_view);
+      return;
+    }
+
+  row = clutter_model_iter_get_row (iter);
+
+  if (priv->virtualized)
+    {
+      if (row < priv->heights->len)
+        {
+          mx_list_view_set_row_height (priv, row, -1);
+          g_array_remove_index (priv->heights, row);
+        }
 
-  children = clutter_actor_get_children (CLUTTER_ACTOR (list_view));
-  l = g_list_nth (children, clutter_model_iter_get_row (iter));
-  child = (ClutterActor *) l->data;
-  clutter_actor_remove_child (CLUTTER_ACTOR (list_view), child);
-  g_list_free (children);
+      _mx_item_pool_remove_row (priv->pool, row);
+      mx_list_view_queue_update (list_view);
+      return;
+    }
+
+  child = clutter_actor_get_child_at_index (CLUTTER_ACTOR (list_view), row);
+  if (child)
+    clutter_actor_remove_child (CLUTTER_ACTOR (list_view), child);
 }
 
 /* public api */
@@ -396,6 +1090,10 @@ mx_list_view_set_item_type (MxListView *list_view,
 
   list_view->priv->item_type = item_type;
 
+  /* the items of the old type can't be reused */
+  if (list_view->priv->pool)
+    _mx_item_pool_clear (list_view->priv->pool);
+
   /* update the view */
   model_changed_cb (list_view->priv->model, list_view);
 }
@@ -439,6 +1137,9 @@ mx_list_view_set_model (MxListView   *list_view,
       g_signal_handlers_disconnect_by_func (priv->model,
                                             (GCallback) model_changed_cb,
                                             list_view);
+      g_signal_handlers_disconnect_by_func (priv->model,
+                                            (GCallback) row_added_cb,
+                                            list_view);
       g_signal_handlers_disconnect_by_func (priv->model,
                                             (GCallback) row_changed_cb,
                                             list_view);
@@ -463,7 +1164,7 @@ mx_list_view_set_model (MxListView   *list_view,
 
       priv->row_added = g_signal_connect (priv->model,
                                           "row-added",
-                                          G_CALLBACK (row_changed_cb),
+                                          G_CALLBACK (row_added_cb),
                                           list_view);
 
       priv->row_changed = g_signal_connect (priv->model,
@@ -472,8 +1173,8 @@ mx_list_view_set_model (MxListView   *list_view,
                                             list_view);
 
       /*
-       * model_changed_cb (called from row_changed_cb) expect the row to already
-       * have been removed, thus we need to use _after
+       * row_removed_cb only removes the child of the row, so it is fine for
+       * the row to still be in the model
        */
       priv->row_removed = g_signal_connect_after (priv->model,
                                                   "row-removed",
@@ -531,17 +1232,18 @@ mx_list_view_add_attribute (MxListView  *list_view,
  *
  * Freeze the view. This means that the view will not act on changes to the
  * model until it is thawed. Call #mx_list_view_thaw to thaw the view.
+ *
+ * Freezing the view while a lot of the model is changed is quicker than
+ * updating the children as each row is added, changed or removed. Calls to
+ * this function can be nested, and the view is thawed by the last of the
+ * matching calls to mx_list_view_thaw().
  */
 void
 mx_list_view_freeze (MxListView *list_view)
 {
-  MxListViewPrivate *priv;
-
   g_return_if_fail (MX_IS_LIST_VIEW (list_view));
 
-  priv = list_view->priv;
-
-  priv->is_frozen = TRUE;
+  list_view->priv->freeze_count ++;
 }
 
 /**
@@ -549,7 +1251,8 @@ mx_list_view_freeze (MxListView *list_view)
  * @list_view: An #MxListView
  *
  * Thaw the view. This means that the view will now act on changes to the
- * model.
+ * model. If the model was changed while the view was frozen, the children
+ * are updated for all of the changes at once.
  */
 void
 mx_list_view_thaw (MxListView *list_view)
@@ -560,10 +1263,23 @@ mx_list_view_thaw (MxListView *list_view)
 
   priv = list_view->priv;
 
-  priv->is_frozen = FALSE;
+  g_return_if_fail (priv->freeze_count > 0);
 
-  /* Repopulate */
-  model_changed_cb (priv->model, list_view);
+  if (--priv->freeze_count)
+    return;
+
+  if (priv->update_pending)
+    {
+      priv->update_pending = FALSE;
+
+      /* Repopulate */
+      model_changed_cb (priv->model, list_view);
+    }
+  else if (priv->virtualized)
+    {
+      /* the visible rows are not laid out while the view is frozen */
+      mx_list_view_queue_update (list_view);
+    }
 }
 
 /**
@@ -596,6 +1312,12 @@ mx_list_view_set_factory (MxListView    *list_view,
   if (factory)
     priv->factory = g_object_ref (factory);
 
+  if (priv->pool)
+    {
+      _mx_item_pool_clear (priv->pool);
+      mx_list_view_reset_items (list_view);
+    }
+
   g_object_notify (G_OBJECT (list_view), "factory");
 }
 
@@ -613,3 +1335,139 @@ mx_list_view_get_factory (MxListView *list_view)
   g_return_val_if_fail (MX_IS_LIST_VIEW (list_view), NULL);
   return list_view->priv->factory;
 }
+
+/**
+ * mx_list_view_set_virtualized:
+ * @list_view: A #MxListView
+ * @virtualized: %TRUE to only create items for the visible rows
+ *
+ * Sets whether the view only creates items for the rows of the model that
+ * are visible, and the @overscan rows either side of them. When it does,
+ * the items are reused for other rows as the view is scrolled, so the
+ * number of items doesn't depend on the number of rows in the model.
+ *
+ * A virtualized view should be placed in an #MxScrollView, and the heights
+ * of the rows that haven't been shown are estimated from the ones that
+ * have. Only the items that have been created can be focused.
+ *
+ * Since: 2.0
+ */
+void
+mx_list_view_set_virtualized (MxListView *list_view,
+                              gboolean    virtualized)
+{
+  MxListViewPrivate *priv;
+
+  g_return_if_fail (MX_IS_LIST_VIEW (list_view));
+
+  priv = list_view->priv;
+
+  if (priv->virtualized == virtualized)
+    return;
+
+  priv->virtualized = virtualized;
+
+  if (virtualized)
+    {
+      clutter_actor_destroy_all_children (CLUTTER_ACTOR (list_view));
+
+      priv->pool =
+        _mx_item_pool_new (CLUTTER_ACTOR (list_view),
+                           (MxItemPoolCreateFunc) mx_list_view_create_item,
+                           (MxItemPoolBindFunc) mx_list_view_bind_item,
+                           list_view);
+      priv->heights = g_array_new (FALSE, FALSE, sizeof (gfloat));
+      priv->anchor_row = -1;
+      priv->content_height = 0;
+    }
+  else
+    {
+      if (priv->update_id)
+        {
+          clutter_threads_remove_repaint_func (priv->update_id);
+          priv->update_id = 0;
+        }
+
+      _mx_item_pool_clear (priv->pool);
+      _mx_item_pool_free (priv->pool);
+      priv->pool = NULL;
+
+      g_array_free (priv->heights, TRUE);
+      priv->heights = NULL;
+    }
+
+  model_changed_cb (priv->model, list_view);
+  clutter_actor_queue_relayout (CLUTTER_ACTOR (list_view));
+
+  g_object_notify (G_OBJECT (list_view), "virtualized");
+}
+
+/**
+ * mx_list_view_get_virtualized:
+ * @list_view: A #MxListView
+ *
+ * Gets whether the view only creates items for the visible rows. See
+ * mx_list_view_set_virtualized().
+ *
+ * Returns: %TRUE if the view is virtualized
+ *
+ * Since: 2.0
+ */
+gboolean
+mx_list_view_get_virtualized (MxListView *list_view)
+{
+  g_return_val_if_fail (MX_IS_LIST_VIEW (list_view), FALSE);
+
+  return list_view->priv->virtualized;
+}
+
+/**
+ * mx_list_view_set_overscan:
+ * @list_view: A #MxListView
+ * @overscan: A number of rows
+ *
+ * Sets the number of rows before and after the visible rows that a
+ * virtualized view creates items for, so that they are ready before
+ * they are scrolled into view.
+ *
+ * Since: 2.0
+ */
+void
+mx_list_view_set_overscan (MxListView *list_view,
+                           guint       overscan)
+{
+  MxListViewPrivate *priv;
+
+  g_return_if_fail (MX_IS_LIST_VIEW (list_view));
+
+  priv = list_view->priv;
+
+  if (priv->overscan == overscan)
+    return;
+
+  priv->overscan = overscan;
+
+  if (priv->virtualized)
+    mx_list_view_queue_update (list_view);
+
+  g_object_notify (G_OBJECT (list_view), "overscan");
+}
+
+/**
+ * mx_list_view_get_overscan:
+ * @list_view: A #MxListView
+ *
+ * Gets the number of rows either side of the visible rows that a
+ * virtualized view creates items for.
+ *
+ * Returns: the number of rows
+ *
+ * Since: 2.0
+ */
+guint
+mx_list_view_get_overscan (MxListView *list_view)
+{
+  g_return_val_if_fail (MX_IS_LIST_VIEW (list_view), 0);
+
+  return list_view->priv->overscan;
+}
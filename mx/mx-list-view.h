@@ -105,6 +105,14 @@ void          mx_list_view_set_factory   (MxListView    *list_view,
                                           MxItemFactory *factory);
 MxItemFactory *mx_list_view_get_factory  (MxListView    *list_view);
 
+void     mx_list_view_set_virtualized (MxListView *list_view,
+                                       gboolean    virtualized);
+gboolean mx_list_view_get_virtualized (MxListView *list_view);
+
+void     mx_list_view_set_overscan    (MxListView *list_view,
+                                       guint       overscan);
+guint    mx_list_view_get_overscan    (MxListView *list_view);
+
 G_END_DECLS
 
 #endif /* _MX_LIST_VIEW_H */
@@ -28,7 +28,9 @@ static GDebugKey debug_keys[] =
     {"layout", MX_DEBUG_LAYOUT},
     {"inspector", MX_DEBUG_INSPECTOR},
     {"focus", MX_DEBUG_FOCUS},
-    {"css", MX_DEBUG_CSS}
+    {"css", MX_DEBUG_CSS},
+    {"style-cache", MX_DEBUG_STYLE_CACHE},
+    {"texture-cache", MX_DEBUG_TEXTURE_CACHE}
 };
 
 
@@ -93,6 +95,16 @@ _mx_string_to_enum (GType        type,
   return ret;
 }
 
+gint
+_mx_quark_compare (gconstpointer a,
+                   gconstpointer b)
+{
+  GQuark qa = *((const GQuark *) a);
+  GQuark qb = *((const GQuark *) b);
+
+  return (qa < qb) ? -1 : (qa > qb);
+}
+
 void
 _mx_paint_texture_with_opacity (CoglHandle texture,
                                 guint8     opacity,
@@ -25,6 +25,7 @@
 #define __MX_PRIVATE_H__
 
 #include <glib.h>
+#include <gdk-pixbuf/gdk-pixbuf.h>
 #include "mx.h"
 #include "mx-table-child.h"
 
@@ -74,6 +75,13 @@ typedef enum
 ClutterActor *_mx_widget_get_dnd_clone (MxWidget *widget);
 
 void _mx_box_layout_start_animation (MxBoxLayout *box);
+void _mx_box_layout_get_adjustments (MxBoxLayout   *box,
+                                     MxAdjustment **hadjustment,
+                                     MxAdjustment **vadjustment);
+
+void _mx_grid_get_adjustments (MxGrid        *grid,
+                               MxAdjustment **hadjustment,
+                               MxAdjustment **vadjustment);
 
 /* used by MxTableChild to update row/column count */
 void _mx_table_update_row_col (MxTable      *table,
@@ -85,7 +93,30 @@ ClutterActor * _mx_window_get_resize_grip (MxWindow *window);
 
 void _mx_style_invalidate_cache (MxStylable *stylable);
 
-gchar * _mx_stylable_get_style_string (MxStylable *stylable);
+/* The properties of a stylable that can be matched against in CSS, interned
+ * so that matching only needs integer comparisons. The pseudo-classes are
+ * sorted in ascending order, without duplicates.
+ */
+typedef struct
+{
+  GQuark  id;
+  GQuark  style_class;
+  GQuark *pseudo_classes;
+  guint   n_pseudo_classes;
+} MxStylableQuarks;
+
+const MxStylableQuarks * _mx_stylable_get_quarks (MxStylable *stylable);
+void _mx_stylable_invalidate_quarks (MxStylable *stylable);
+
+GHashTable * _mx_style_get_cached_properties (MxStyle    *style,
+                                              MxStylable *stylable);
+const gchar* _mx_style_normalize_property_name (const gchar *name);
+gboolean     _mx_style_affects_descendants   (MxStyle                *style,
+                                              const MxStylableQuarks *old_state,
+                                              const MxStylableQuarks *new_state);
+
+gint _mx_quark_compare (gconstpointer a,
+                        gconstpointer b);
 
 const gchar * _mx_enum_to_string (GType type,
                                   gint  value);
@@ -108,14 +139,22 @@ void _mx_paint_texture_with_opacity (CoglHandle texture,
 
 gboolean _mx_settings_get_touch_mode (MxSettings *settings);
 
+CoglHandle _mx_texture_cache_texture_from_pixbuf (MxTextureCache *self,
+                                                  GdkPixbuf      *pixbuf);
+
+CoglHandle _mx_icon_theme_lookup_loaded (MxIconTheme *theme,
+                                         const gchar *icon_name,
+                                         gint         size);
+
 
 typedef enum
 {
-  MX_DEBUG_LAYOUT      = 1 << 0,
-  MX_DEBUG_INSPECTOR   = 1 << 1,
-  MX_DEBUG_FOCUS       = 1 << 2,
-  MX_DEBUG_CSS         = 1 << 3,
-  MX_DEBUG_STYLE_CACHE = 1 << 4
+  MX_DEBUG_LAYOUT        = 1 << 0,
+  MX_DEBUG_INSPECTOR     = 1 << 1,
+  MX_DEBUG_FOCUS         = 1 << 2,
+  MX_DEBUG_CSS           = 1 << 3,
+  MX_DEBUG_STYLE_CACHE   = 1 << 4,
+  MX_DEBUG_TEXTURE_CACHE = 1 << 5
 } MxDebugTopic;
 
 gboolean _mx_debug (gint debug);
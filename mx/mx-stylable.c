@@ -46,6 +46,7 @@
 #include "mx-private.h"
 #include "mx-stylable.h"
 #include "mx-settings.h"
+#include "mx-css.h"
 
 
 #include <cogl-pango/cogl-pango.h>
@@ -67,6 +68,8 @@ static GParamSpecPool *style_property_spec_pool = NULL;
 
 static GQuark quark_real_owner         = 0;
 static GQuark quark_style              = 0;
+static GQuark quark_quarks             = 0;
+static GQuark quark_previous_quarks    = 0;
 
 static guint stylable_signals[LAST_SIGNAL] = { 0, };
 
@@ -122,6 +125,9 @@ mx_stylable_base_init (gpointer g_iface)
   quark_real_owner =
     g_quark_from_static_string ("mx-stylable-real-owner-quark");
   quark_style = g_quark_from_static_string ("mx-stylable-style-quark");
+  quark_quarks = g_quark_from_static_string ("mx-stylable-quarks-quark");
+  quark_previous_quarks =
+    g_quark_from_static_string ("mx-stylable-previous-quarks-quark");
 
   style_property_spec_pool = g_param_spec_pool_new (FALSE);
 
@@ -204,79 +210,79 @@ mx_stylable_get_type (void)
 }
 
 static void
-_mx_stylable_prepend_style_string (GString    *string,
-                                   MxStylable *stylable)
+mx_stylable_quarks_free (MxStylableQuarks *quarks)
 {
-  GType type_id;
-  gchar *style_string;
-  const gchar *type, *id, *class, *pseudo_class;
-
-  type_id = G_OBJECT_CLASS_TYPE (G_OBJECT_GET_CLASS (stylable));
-  type = g_type_name (type_id);
-
-  id = clutter_actor_get_name ((ClutterActor*) stylable);
-
-  class = mx_stylable_get_style_class (stylable);
-
-  pseudo_class = mx_stylable_get_style_pseudo_class (stylable);
-
-  style_string = g_strconcat (type,
-                              "#", id ? id : "",
-                              ".", class ? class : "",
-                              ":", pseudo_class ? pseudo_class : "",
-                              ">",
-                              NULL);
-  g_string_prepend (string, style_string);
-  g_free (style_string);
+  g_free (quarks->pseudo_classes);
+  g_slice_free (MxStylableQuarks, quarks);
 }
 
-gchar *
-_mx_stylable_get_style_string (MxStylable *stylable)
+const MxStylableQuarks *
+_mx_stylable_get_quarks (MxStylable *stylable)
 {
-  GType type_id;
-  gchar *cstring;
-  GString *string;
-  const gchar *type, *id, *class, *pseudo_class;
-  ClutterActor *actor;
-  ClutterActor *parent;
-
-  /* Create a string that contains all the properties of a
-   * Stylable that can be matched against in the CSS.
-   */
-  type_id = G_OBJECT_CLASS_TYPE (G_OBJECT_GET_CLASS (stylable));
-  type = g_type_name (type_id);
+  MxStylableQuarks *quarks;
+  const gchar *id, *class, *pseudo_class;
+
+  quarks = g_object_get_qdata (G_OBJECT (stylable), quark_quarks);
+  if (G_LIKELY (quarks))
+    return quarks;
 
-  actor = CLUTTER_ACTOR (stylable);
+  quarks = g_slice_new0 (MxStylableQuarks);
 
-  id = clutter_actor_get_name (actor);
+  id = clutter_actor_get_name ((ClutterActor *) stylable);
+  if (id)
+    quarks->id = g_quark_from_string (id);
 
   class = mx_stylable_get_style_class (stylable);
+  if (class)
+    quarks->style_class = g_quark_from_string (class);
 
   pseudo_class = mx_stylable_get_style_pseudo_class (stylable);
+  if (pseudo_class && *pseudo_class)
+    {
+      gchar **list;
+      guint i, n;
 
-  string = g_string_sized_new (512);
+      list = g_strsplit (pseudo_class, ":", -1);
+      quarks->pseudo_classes = g_new (GQuark, g_strv_length (list));
 
-  /* Add the actor hierarchy */
-  parent = clutter_actor_get_parent (actor);
+      for (i = 0, n = 0; list[i]; i++)
+        if (*list[i])
+          quarks->pseudo_classes[n++] = g_quark_from_string (list[i]);
 
-  while (parent)
-    {
-      if (MX_IS_STYLABLE (parent))
-        _mx_stylable_prepend_style_string (string, (MxStylable*) parent);
+      g_strfreev (list);
+
+      qsort (quarks->pseudo_classes, n, sizeof (GQuark), _mx_quark_compare);
 
-      parent = clutter_actor_get_parent (parent);
+      /* remove duplicates */
+      for (i = 1, quarks->n_pseudo_classes = (n > 0); i < n; i++)
+        if (quarks->pseudo_classes[i] !=
+            quarks->pseudo_classes[quarks->n_pseudo_classes - 1])
+          quarks->pseudo_classes[quarks->n_pseudo_classes++] =
+            quarks->pseudo_classes[i];
     }
 
-  g_string_append_printf (string, "%s#%s.%s:%s",
-                          type,
-                          id ? id : "",
-                          class ? class : "",
-                          pseudo_class ? pseudo_class : "");
+  g_object_set_qdata_full (G_OBJECT (stylable), quark_quarks, quarks,
+                           (GDestroyNotify) mx_stylable_quarks_free);
 
-  cstring = string->str;
-  g_string_free (string, FALSE);
+  return quarks;
+}
+
+void
+_mx_stylable_invalidate_quarks (MxStylable *stylable)
+{
+  MxStylableQuarks *quarks;
+
+  quarks = g_object_steal_qdata (G_OBJECT (stylable), quark_quarks);
+  if (!quarks)
+    return;
 
-  return cstring;
+  /* keep the state from before the first of a series of changes, so the
+   * state change handler can tell what changed */
+  if (g_object_get_qdata (G_OBJECT (stylable), quark_previous_quarks))
+    mx_stylable_quarks_free (quarks);
+  else
+    g_object_set_qdata_full (G_OBJECT (stylable), quark_previous_quarks,
+                             quarks, (GDestroyNotify) mx_stylable_quarks_free);
 }
 
 #if 0
@@ -843,6 +849,10 @@ mx_stylable_set_style_pseudo_class (MxStylable  *stylable,
 
   iface = MX_STYLABLE_GET_IFACE (stylable);
 
+  /* the pseudo-class change is notified synchronously, so the interned
+   * pseudo-classes need to be invalidated before it happens */
+  _mx_stylable_invalidate_quarks (stylable);
+
   if (G_LIKELY (iface->set_style_pseudo_class))
     iface->set_style_pseudo_class (stylable, pseudo_class);
   else
@@ -1025,6 +1035,8 @@ mx_stylable_set_style_class (MxStylable  *stylable,
 
   iface = MX_STYLABLE_GET_IFACE (stylable);
 
+  _mx_stylable_invalidate_quarks (stylable);
+
   if (G_LIKELY (iface->set_style_class))
     iface->set_style_class (stylable, style_class);
   else
@@ -1033,10 +1045,417 @@ mx_stylable_set_style_class (MxStylable  *stylable,
                g_type_name (G_OBJECT_TYPE (stylable)));
 }
 
+/* Style invalidations caused by changes to a stylable's state are not
+ * resolved straight away, but queued on the stage the stylable is on and
+ * resolved once, parents first, before the stage is next laid out. This
+ * means that e.g. changing the style class and pseudo-class of an actor in
+ * succession only causes it to be matched and updated once, and that
+ * queued descendants of an actor whose whole subtree is restyled are
+ * skipped.
+ */
+typedef enum
+{
+  MX_STYLE_DIRTY_STATE   = 1 << 0, /* name, class or pseudo-class changed */
+  MX_STYLE_DIRTY_SUBTREE = 1 << 1  /* the whole subtree must be re-matched */
+} MxStyleDirtyFlags;
+
+typedef struct
+{
+  MxStylable        *stylable;
+  MxStyleDirtyFlags  flags;
+
+  /* the properties matched before the first state change */
+  GHashTable        *old_properties;
+
+  guint              depth;
+} MxStyleDirtyEntry;
+
+typedef struct
+{
+  ClutterActor *stage;
+  GHashTable   *entries;
+} MxStyleDirtyQueue;
+
+static GList *style_dirty_queues = NULL;
+static guint  style_dirty_repaint_id = 0;
+
+static guint  style_n_restyles = 0;
+static guint  style_n_restyles_avoided = 0;
+
+static void mx_stylable_style_changed_internal (MxStylable          *stylable,
+                                                MxStyleChangedFlags  flags);
+
+static void
+mx_style_dirty_entry_free (MxStyleDirtyEntry *entry)
+{
+  if (entry->old_properties)
+    g_hash_table_unref (entry->old_properties);
+  g_object_unref (entry->stylable);
+  g_slice_free (MxStyleDirtyEntry, entry);
+}
+
+static void
+mx_style_dirty_queue_free (MxStyleDirtyQueue *queue)
+{
+  g_hash_table_unref (queue->entries);
+  g_object_unref (queue->stage);
+  g_slice_free (MxStyleDirtyQueue, queue);
+}
+
+static gint
+mx_style_dirty_entry_compare (gconstpointer a,
+                              gconstpointer b)
+{
+  const MxStyleDirtyEntry *entry_a = *((MxStyleDirtyEntry **) a);
+  const MxStyleDirtyEntry *entry_b = *((MxStyleDirtyEntry **) b);
+
+  return (gint) entry_a->depth - (gint) entry_b->depth;
+}
+
+/* Returns the subset of the @changed property names that @stylable and its
+ * descendants may inherit, which excludes those @stylable sets itself, or
+ * NULL if there are none. @uses_changed is set if @stylable inherits any
+ * of them.
+ */
+static GHashTable *
+mx_stylable_get_inherited_changes (MxStylable *stylable,
+                                   GHashTable *changed,
+                                   gboolean   *uses_changed)
+{
+  GHashTable *properties, *inherited;
+  GHashTableIter iter;
+  GParamSpec **pspecs;
+  MxStyle *style;
+  gpointer key;
+  guint i, n_pspecs;
+
+  style = mx_stylable_get_style (stylable);
+  properties = style ? _mx_style_get_cached_properties (style, stylable) : NULL;
+
+  /* without a matched style it is not known what the stylable sets */
+  if (!properties)
+    {
+      *uses_changed = TRUE;
+      return g_hash_table_ref (changed);
+    }
+
+  inherited = g_hash_table_new (g_str_hash, g_str_equal);
+  g_hash_table_iter_init (&iter, changed);
+  while (g_hash_table_iter_next (&iter, &key, NULL))
+    if (!g_hash_table_contains (properties, key))
+      g_hash_table_add (inherited, key);
+
+  g_hash_table_unref (properties);
+
+  if (!g_hash_table_size (inherited))
+    {
+      g_hash_table_unref (inherited);
+      *uses_changed = FALSE;
+      return NULL;
+    }
+
+  *uses_changed = FALSE;
+  pspecs = mx_stylable_list_properties (stylable, &n_pspecs);
+  for (i = 0; i < n_pspecs && !*uses_changed; i++)
+    {
+      const gchar *name = _mx_style_normalize_property_name (pspecs[i]->name);
+
+      if ((pspecs[i]->flags & MX_PARAM_STYLE_INHERIT) &&
+          g_hash_table_contains (inherited, name))
+        *uses_changed = TRUE;
+    }
+  g_free (pspecs);
+
+  return inherited;
+}
+
+/* The matched style of @actor has not changed, but it may inherit some of
+ * the @changed properties of an ancestor, so emit style-changed without
+ * invalidating its cache. Subtrees that set all of the changed properties
+ * themselves are not visited. A NULL @changed updates the whole subtree.
+ */
+static void
+mx_stylable_update_inherited_style (ClutterActor *actor,
+                                    GHashTable   *changed)
+{
+  ClutterActorIter iter;
+  ClutterActor *child;
+  GHashTable *inherited = NULL;
+  gboolean uses_changed = TRUE;
+
+  if (!CLUTTER_ACTOR_IS_REALIZED (actor))
+    return;
+
+  if (MX_IS_STYLABLE (actor) && changed)
+    {
+      inherited = mx_stylable_get_inherited_changes (MX_STYLABLE (actor),
+                                                     changed, &uses_changed);
+      if (!inherited)
+        return;
+    }
+
+  if (MX_IS_STYLABLE (actor) && uses_changed)
+    g_signal_emit (actor, stylable_signals[STYLE_CHANGED], 0,
+                   MX_STYLE_CHANGED_NONE);
+
+  clutter_actor_iter_init (&iter, actor);
+  while (clutter_actor_iter_next (&iter, &child))
+    mx_stylable_update_inherited_style (child, inherited ? inherited : changed);
+
+  if (inherited)
+    g_hash_table_unref (inherited);
+}
+
+/* Resolves a change to the name, style class or pseudo-class of a stylable.
+ * Returns TRUE if the whole subtree was matched again.
+ */
+static gboolean
+mx_stylable_resolve_state_change (MxStylable *stylable,
+                                  GHashTable *old_properties)
+{
+  MxStylableQuarks *old_state;
+  const MxStylableQuarks *new_state;
+  GHashTable *new_properties, *changed;
+  ClutterActorIter iter;
+  ClutterActor *child;
+  MxStyle *style;
+
+  old_state = g_object_steal_qdata (G_OBJECT (stylable),
+                                    quark_previous_quarks);
+  new_state = _mx_stylable_get_quarks (stylable);
+  style = mx_stylable_get_style (stylable);
+
+  /* if the change could alter the selectors that match descendants, the
+   * whole subtree needs to be matched again */
+  if (!old_state || !style ||
+      _mx_style_affects_descendants (style, old_state, new_state))
+    {
+      if (old_state)
+        mx_stylable_quarks_free (old_state);
+
+      mx_stylable_style_changed_internal (stylable,
+                                          MX_STYLE_CHANGED_INVALIDATE_CACHE);
+      return TRUE;
+    }
+
+  mx_stylable_quarks_free (old_state);
+
+  _mx_style_invalidate_cache (stylable);
+  g_signal_emit (stylable, stylable_signals[STYLE_CHANGED], 0,
+                 MX_STYLE_CHANGED_INVALIDATE_CACHE);
+
+  new_properties = _mx_style_get_cached_properties (style, stylable);
+
+  /* descendants only need updating if they could inherit a value that
+   * changed, and never need to be matched again */
+  if (!old_properties || !new_properties)
+    {
+      clutter_actor_iter_init (&iter, CLUTTER_ACTOR (stylable));
+      while (clutter_actor_iter_next (&iter, &child))
+        mx_stylable_update_inherited_style (child, NULL);
+    }
+  else if ((changed = mx_style_sheet_properties_diff (old_properties,
+                                                      new_properties)))
+    {
+      clutter_actor_iter_init (&iter, CLUTTER_ACTOR (stylable));
+      while (clutter_actor_iter_next (&iter, &child))
+        mx_stylable_update_inherited_style (child, changed);
+
+      g_hash_table_unref (changed);
+    }
+
+  if (new_properties)
+    g_hash_table_unref (new_properties);
+
+  return FALSE;
+}
+
+static void
+mx_style_dirty_queue_flush (MxStyleDirtyQueue *queue)
+{
+  GHashTableIter iter;
+  GHashTable *restyled;
+  GPtrArray *entries;
+  gpointer value;
+  guint i, n_restyles = 0, n_avoided = 0;
+
+  /* sort the entries so that parents are resolved before their children */
+  entries = g_ptr_array_sized_new (g_hash_table_size (queue->entries));
+  g_hash_table_iter_init (&iter, queue->entries);
+  while (g_hash_table_iter_next (&iter, NULL, &value))
+    {
+      MxStyleDirtyEntry *entry = value;
+      ClutterActor *parent;
+
+      entry->depth = 0;
+      for (parent = clutter_actor_get_parent (CLUTTER_ACTOR (entry->stylable));
+           parent; parent = clutter_actor_get_parent (parent))
+        entry->depth ++;
+
+      g_ptr_array_add (entries, entry);
+    }
+  g_ptr_array_sort (entries, mx_style_dirty_entry_compare);
+
+  restyled = g_hash_table_new (NULL, NULL);
+
+  for (i = 0; i < entries->len; i++)
+    {
+      MxStyleDirtyEntry *entry = g_ptr_array_index (entries, i);
+      ClutterActor *actor = CLUTTER_ACTOR (entry->stylable);
+      ClutterActor *parent;
+
+      /* skip stylables that were restyled along with an ancestor */
+      for (parent = clutter_actor_get_parent (actor); parent;
+           parent = clutter_actor_get_parent (parent))
+        if (g_hash_table_contains (restyled, parent))
+          break;
+
+      if (parent || !CLUTTER_ACTOR_IS_REALIZED (actor))
+        {
+          g_object_set_qdata (G_OBJECT (actor), quark_previous_quarks, NULL);
+
+          if (parent)
+            n_avoided ++;
+
+          continue;
+        }
+
+      n_restyles ++;
+
+      if (entry->flags & MX_STYLE_DIRTY_SUBTREE)
+        {
+          g_object_set_qdata (G_OBJECT (actor), quark_previous_quarks, NULL);
+          mx_stylable_style_changed_internal (entry->stylable,
+                                              MX_STYLE_CHANGED_INVALIDATE_CACHE);
+          g_hash_table_add (restyled, actor);
+        }
+      else if (mx_stylable_resolve_state_change (entry->stylable,
+                                                 entry->old_properties))
+        g_hash_table_add (restyled, actor);
+    }
+
+  g_hash_table_unref (restyled);
+  g_ptr_array_free (entries, TRUE);
+
+  style_n_restyles += n_restyles;
+  style_n_restyles_avoided += n_avoided;
+
+  MX_NOTE (STYLE_CACHE, "(%p) Restyled %u stylables, %u avoided by "
+           "coalescing (Total restyles: %u, avoided by coalescing: %u)",
+           queue->stage, n_restyles, n_avoided,
+           style_n_restyles, style_n_restyles_avoided);
+}
+
+static gboolean
+mx_style_dirty_queues_flush (gpointer user_data)
+{
+  GList *queues, *l;
+
+  /* restyles queued by handlers of style-changed go into new queues, which
+   * are resolved before the next frame by a new repaint function; this one
+   * is removed once it returns */
+  queues = style_dirty_queues;
+  style_dirty_queues = NULL;
+  style_dirty_repaint_id = 0;
+
+  for (l = queues; l; l = l->next)
+    {
+      mx_style_dirty_queue_flush (l->data);
+      mx_style_dirty_queue_free (l->data);
+    }
+
+  g_list_free (queues);
+
+  return FALSE;
+}
+
+static void
+mx_stylable_queue_style_changed (MxStylable        *stylable,
+                                 MxStyleDirtyFlags  flags)
+{
+  MxStyleDirtyQueue *queue = NULL;
+  MxStyleDirtyEntry *entry;
+  ClutterActor *stage;
+  GList *l;
+
+  /* style-changed is not emitted until the stylable is realized, at which
+   * point its whole subtree is restyled */
+  if (!CLUTTER_ACTOR_IS_REALIZED (CLUTTER_ACTOR (stylable)) ||
+      !(stage = clutter_actor_get_stage (CLUTTER_ACTOR (stylable))))
+    {
+      g_object_set_qdata (G_OBJECT (stylable), quark_previous_quarks, NULL);
+      _mx_style_invalidate_cache (stylable);
+      return;
+    }
+
+  for (l = style_dirty_queues; l; l = l->next)
+    if (((MxStyleDirtyQueue *) l->data)->stage == stage)
+      {
+        queue = l->data;
+        break;
+      }
+
+  if (!queue)
+    {
+      queue = g_slice_new (MxStyleDirtyQueue);
+      queue->stage = g_object_ref (stage);
+      queue->entries =
+        g_hash_table_new_full (NULL, NULL, NULL,
+                               (GDestroyNotify) mx_style_dirty_entry_free);
+      style_dirty_queues = g_list_prepend (style_dirty_queues, queue);
+
+      if (!style_dirty_repaint_id)
+        style_dirty_repaint_id =
+          clutter_threads_add_repaint_func_full (CLUTTER_REPAINT_FLAGS_PRE_PAINT,
+                                                 mx_style_dirty_queues_flush,
+                                                 NULL, NULL);
+
+      /* make sure there is a frame to resolve the queue in */
+      clutter_stage_ensure_redraw (CLUTTER_STAGE (stage));
+    }
+
+  entry = g_hash_table_lookup (queue->entries, stylable);
+
+  if (entry)
+    {
+      entry->flags |= flags;
+      style_n_restyles_avoided ++;
+    }
+  else
+    {
+      MxStyle *style = mx_stylable_get_style (stylable);
+
+      entry = g_slice_new (MxStyleDirtyEntry);
+      entry->stylable = g_object_ref (stylable);
+      entry->flags = flags;
+      entry->old_properties = style
+        ? _mx_style_get_cached_properties (style, stylable) : NULL;
+      entry->depth = 0;
+
+      g_hash_table_insert (queue->entries, stylable, entry);
+    }
+
+  /* release the node straight away, so that the stylable sees its new
+   * style if it is queried before the queue is resolved */
+  if (flags & MX_STYLE_DIRTY_STATE)
+    _mx_style_invalidate_cache (stylable);
+}
+
 static void
 mx_stylable_property_changed_notify (MxStylable *stylable)
 {
-  mx_stylable_style_changed (stylable, MX_STYLE_CHANGED_INVALIDATE_CACHE);
+  _mx_stylable_invalidate_quarks (stylable);
+
+  mx_stylable_queue_style_changed (stylable, MX_STYLE_DIRTY_SUBTREE);
+}
+
+static void
+mx_stylable_state_changed_notify (MxStylable *stylable)
+{
+  /* the name, style class or pseudo-class has changed */
+  _mx_stylable_invalidate_quarks (stylable);
+
+  mx_stylable_queue_style_changed (stylable, MX_STYLE_DIRTY_STATE);
 }
 
 static void
@@ -1047,15 +1466,10 @@ mx_stylable_parent_set_notify (ClutterActor *actor,
 
   /* check the actor has a new parent */
   if (new_parent)
-    {
-      mx_stylable_style_changed (MX_STYLABLE (actor),
-                                 MX_STYLE_CHANGED_INVALIDATE_CACHE);
-    }
+    mx_stylable_queue_style_changed (MX_STYLABLE (actor),
+                                     MX_STYLE_DIRTY_SUBTREE);
 }
 
-static void mx_stylable_style_changed_internal (MxStylable          *stylable,
-                                                MxStyleChangedFlags  flags);
-
 static void
 mx_stylable_style_changed_internal (MxStylable          *stylable,
                                     MxStyleChangedFlags  flags)
@@ -1123,7 +1537,7 @@ mx_stylable_connect_change_notifiers (MxStylable *stylable)
 
   /* ClutterActor signals */
   g_signal_connect (stylable, "notify::name",
-                    G_CALLBACK (mx_stylable_property_changed_notify), NULL);
+                    G_CALLBACK (mx_stylable_state_changed_notify), NULL);
   g_signal_connect (stylable, "parent-set",
                     G_CALLBACK (mx_stylable_parent_set_notify), NULL);
 
@@ -1134,9 +1548,9 @@ mx_stylable_connect_change_notifiers (MxStylable *stylable)
 
   /* MxStylable notifiers */
   g_signal_connect (stylable, "notify::style-class",
-                    G_CALLBACK (mx_stylable_property_changed_notify), NULL);
+                    G_CALLBACK (mx_stylable_state_changed_notify), NULL);
   g_signal_connect (stylable, "notify::style-pseudo-class",
-                    G_CALLBACK (mx_stylable_property_changed_notify), NULL);
+                    G_CALLBACK (mx_stylable_state_changed_notify), NULL);
 
 }
 
@@ -1150,6 +1564,9 @@ mx_stylable_disconnect_change_notifiers (MxStylable *stylable)
   g_signal_handlers_disconnect_by_func (stylable,
                                         mx_stylable_property_changed_notify,
                                         NULL);
+  g_signal_handlers_disconnect_by_func (stylable,
+                                        mx_stylable_state_changed_notify,
+                                        NULL);
 
   g_signal_handlers_disconnect_by_func (stylable, mx_stylable_parent_set_notify,
                                         NULL);
@@ -62,36 +62,53 @@ enum
 
 #define MX_STYLE_CACHE g_style_cache_quark ()
 
-/* This is the amount of entries that will be allowed per
- * stylable object.
+/* The maximum number of bytes that style nodes which are no longer used by
+ * any stylable are allowed to take up, before the least recently used ones
+ * are evicted from the cache.
  *
- * In the usual case, objects share rules and
- * so we don't really need to allocate more than one space in
- * the cache per object, but in case of the pathological case
- * of every stylable object having a unique style rule that
- * applies only to itself, we allow 6 per object.
- *
- * e.g. normal, hover, active, checked, focus + 1 extra
+ * Unused nodes are kept around as stylables commonly switch back and forth
+ * between a small number of states (e.g. normal, hover, active, focus).
  */
-#define MX_STYLE_CACHE_SIZE 6
+#define MX_STYLE_CACHE_MAX_BYTES (256 * 1024)
 
-/* A style cache entry is the unique string representing all the properties
- * that can be matched against in CSS, and the matched properties themselves.
+/* A style node represents everything about a stylable that can be matched
+ * against in CSS. Nodes are hash-consed, so stylables with the same type,
+ * name, class and pseudo-classes, whose parents also share a node, share a
+ * single node and the properties matched for it.
  */
-typedef struct
+typedef struct _MxStyleNode MxStyleNode;
+struct _MxStyleNode
 {
-  gchar      *style_string;
-  gint        age;
-  GHashTable *properties;
-} MxStyleCacheEntry;
+  MxStyleNode *parent;
+  GType        type;
+  GQuark       id;
+  GQuark       style_class;
+  GQuark      *pseudo_classes;
+  guint        n_pseudo_classes;
+
+  guint        hash;
+  gint         ref_count;
+
+  /* the matched properties, and the style age they were matched at */
+  GHashTable  *properties;
+  gint         age;
+
+  /* the properties converted to the type of their GParamSpec, keyed by
+   * GParamSpec, filled in as they are requested */
+  GHashTable  *values;
+
+  /* link in the list of unused nodes, and the size accounted for it */
+  GList        lru_link;
+  gsize        bytes;
+};
 
 /* This is the per-stylable cache store. We need a reference back to the
- * parent style so that we can maintain the count of alive stylables.
+ * style so that the node can be released if the stylable outlives it.
  */
 typedef struct
 {
-  GList   *styles;
-  gchar   *string;
+  MxStyle     *style;
+  MxStyleNode *node;
 } MxStylableCache;
 
 typedef struct {
@@ -104,12 +121,14 @@ struct _MxStylePrivate
 {
   MxStyleSheet *stylesheet;
 
-  GHashTable *style_hash;
   GHashTable *node_hash;
+  GQueue      unused_nodes;
+  gsize       unused_bytes;
+
+  guint       n_hits;
+  guint       n_misses;
+  guint       n_evictions;
 
-  gint        alive_stylables;
-  GQueue     *cached_matches;
-  GHashTable *cache_hash;
   gint        age;
 };
 
@@ -159,6 +178,7 @@ static gboolean
 mx_style_real_load_from_file (MxStyle      *style,
                               const gchar  *filename,
                               const gchar  *data,
+                              GBytes       *compiled,
                               GError      **error,
                               gint          priority)
 {
@@ -183,12 +203,17 @@ mx_style_real_load_from_file (MxStyle      *style,
   if (!priv->stylesheet)
     priv->stylesheet = mx_style_sheet_new ();
 
+  /* use the compiled form of the style sheet when it is up to date */
   if (data)
-    result = mx_style_sheet_add_from_data (priv->stylesheet, filename, data,
-                                           NULL);
+    result = (compiled &&
+              mx_style_sheet_add_from_compiled_data (priv->stylesheet,
+                                                     filename, data,
+                                                     compiled)) ||
+      mx_style_sheet_add_from_data (priv->stylesheet, filename, data, NULL);
   else
-    result = mx_style_sheet_add_from_file (priv->stylesheet, filename,
-                                           NULL);
+    result = mx_style_sheet_add_from_compiled_file (priv->stylesheet,
+                                                    filename) ||
+      mx_style_sheet_add_from_file (priv->stylesheet, filename, NULL);
 
   if (!result)
     {
@@ -238,7 +263,7 @@ mx_style_load_from_file (MxStyle      *style,
                          const gchar  *filename,
                          GError      **error)
 {
-  return mx_style_real_load_from_file (style, filename, NULL, error, 0);
+  return mx_style_real_load_from_file (style, filename, NULL, NULL, error, 0);
 }
 
 /**
@@ -261,7 +286,7 @@ mx_style_load_from_data (MxStyle      *style,
                          const gchar  *data,
                          GError      **error)
 {
-  return mx_style_real_load_from_file (style, id, data, error, 0);
+  return mx_style_real_load_from_file (style, id, data, NULL, error, 0);
 }
 
 gboolean
@@ -269,9 +294,9 @@ mx_style_load_from_resource (MxStyle      *style,
                              const gchar  *path,
                              GError      **error)
 {
-  GBytes *bytes;
+  GBytes *bytes, *compiled;
   GError *internal_error = NULL;
-  gchar *id;
+  gchar *id, *compiled_path;
 
   bytes = g_resources_lookup_data (path, G_RESOURCE_LOOKUP_FLAGS_NONE,
                                    &internal_error);
@@ -283,13 +308,21 @@ mx_style_load_from_resource (MxStyle      *style,
       return FALSE;
     }
 
+  /* a compiled style sheet may be bundled alongside the CSS */
+  compiled_path = g_strconcat (path, MX_STYLE_SHEET_COMPILED_SUFFIX, NULL);
+  compiled = g_resources_lookup_data (compiled_path,
+                                      G_RESOURCE_LOOKUP_FLAGS_NONE, NULL);
+  g_free (compiled_path);
+
   id = g_strconcat ("resource://", path, NULL);
 
   mx_style_real_load_from_file (style, id, g_bytes_get_data (bytes, NULL),
-                                error, 0);
+                                compiled, error, 0);
 
   g_free (id);
 
+  if (compiled)
+    g_bytes_unref (compiled);
   g_bytes_unref (bytes);
 
   return TRUE;
@@ -311,7 +344,8 @@ mx_style_load (MxStyle *style)
   if (g_file_test (rc_file, G_FILE_TEST_EXISTS))
     {
       /* load the default theme with lowest priority */
-      if (!mx_style_real_load_from_file (style, rc_file, NULL, &error, 0))
+      if (!mx_style_real_load_from_file (style, rc_file, NULL, NULL, &error,
+                                         0))
         {
           g_critical ("Unable to load resource file '%s': %s",
                       rc_file,
@@ -337,40 +371,127 @@ mx_style_load (MxStyle *style)
 #endif
 }
 
-static MxStyleCacheEntry *
-mx_style_cache_entry_new (const gchar *style_string,
-                          GHashTable  *properties,
-                          gint         age)
+static guint
+mx_style_node_hash (gconstpointer key)
 {
-  MxStyleCacheEntry *entry = g_slice_new (MxStyleCacheEntry);
+  return ((const MxStyleNode *) key)->hash;
+}
 
-  entry->style_string = g_strdup (style_string);
-  entry->properties = properties;
-  entry->age = age;
+static gboolean
+mx_style_node_equal (gconstpointer a,
+                     gconstpointer b)
+{
+  const MxStyleNode *node_a = a;
+  const MxStyleNode *node_b = b;
+
+  return (node_a->hash == node_b->hash &&
+          node_a->parent == node_b->parent &&
+          node_a->type == node_b->type &&
+          node_a->id == node_b->id &&
+          node_a->style_class == node_b->style_class &&
+          node_a->n_pseudo_classes == node_b->n_pseudo_classes &&
+          !memcmp (node_a->pseudo_classes, node_b->pseudo_classes,
+                   node_a->n_pseudo_classes * sizeof (GQuark)));
+}
 
-  return entry;
+static void
+mx_style_node_value_free (GValue *value)
+{
+  g_value_unset (value);
+  g_slice_free (GValue, value);
 }
 
 static void
-mx_style_cache_entry_free (MxStyleCacheEntry *entry,
-                           gboolean           free_struct)
+mx_style_node_free (MxStyleNode *node)
 {
-  g_free (entry->style_string);
-  g_hash_table_unref (entry->properties);
-  if (free_struct)
-    g_slice_free (MxStyleCacheEntry, entry);
+  if (node->properties)
+    g_hash_table_unref (node->properties);
+  if (node->values)
+    g_hash_table_unref (node->values);
+  g_free (node->pseudo_classes);
+  g_slice_free (MxStyleNode, node);
+}
+
+static void
+mx_style_node_ref (MxStyle     *style,
+                   MxStyleNode *node)
+{
+  MxStylePrivate *priv = style->priv;
+
+  /* the node is in use again, so it can't be evicted */
+  if (node->ref_count++ == 0)
+    {
+      g_queue_unlink (&priv->unused_nodes, &node->lru_link);
+      priv->unused_bytes -= node->bytes;
+    }
+}
+
+static void mx_style_node_unref (MxStyle     *style,
+                                 MxStyleNode *node);
+
+static void
+mx_style_trim_cache (MxStyle *style)
+{
+  MxStylePrivate *priv = style->priv;
+
+  while (priv->unused_bytes > MX_STYLE_CACHE_MAX_BYTES)
+    {
+      GList *link = g_queue_pop_tail_link (&priv->unused_nodes);
+      MxStyleNode *node = link->data;
+
+      priv->unused_bytes -= node->bytes;
+      priv->n_evictions ++;
+
+      g_hash_table_remove (priv->node_hash, node);
+
+      /* this may make the parent unused, so it is done last */
+      if (node->parent)
+        mx_style_node_unref (style, node->parent);
+
+      mx_style_node_free (node);
+    }
+}
+
+static void
+mx_style_node_unref (MxStyle     *style,
+                     MxStyleNode *node)
+{
+  MxStylePrivate *priv = style->priv;
+
+  if (--node->ref_count > 0)
+    return;
+
+  /* estimate the memory used by the node, including its properties */
+  node->bytes = sizeof (MxStyleNode)
+    + node->n_pseudo_classes * sizeof (GQuark);
+  if (node->properties)
+    node->bytes += g_hash_table_size (node->properties)
+      * (sizeof (MxStyleSheetValue) + 3 * sizeof (gpointer));
+  if (node->values)
+    node->bytes += g_hash_table_size (node->values)
+      * (sizeof (GValue) + 3 * sizeof (gpointer));
+
+  /* keep the node around in case it is needed again, most recently used
+   * nodes first */
+  g_queue_push_head_link (&priv->unused_nodes, &node->lru_link);
+  priv->unused_bytes += node->bytes;
+
+  mx_style_trim_cache (style);
 }
 
 static void
 mx_style_finalize (GObject *gobject)
 {
   MxStylePrivate *priv = MX_STYLE (gobject)->priv;
+  GHashTableIter iter;
+  MxStyleNode *node;
 
-  g_hash_table_unref (priv->cache_hash);
-
-  while (g_queue_get_length (priv->cached_matches))
-    mx_style_cache_entry_free (g_queue_pop_head (priv->cached_matches), TRUE);
-  g_queue_free (priv->cached_matches);
+  /* stylables that were using these nodes have already been notified by
+   * their weak reference */
+  g_hash_table_iter_init (&iter, priv->node_hash);
+  while (g_hash_table_iter_next (&iter, (gpointer *) &node, NULL))
+    mx_style_node_free (node);
+  g_hash_table_unref (priv->node_hash);
 
   G_OBJECT_CLASS (mx_style_parent_class)->finalize (gobject);
 }
@@ -409,8 +530,8 @@ mx_style_init (MxStyle *style)
 
   style->priv = priv = MX_STYLE_GET_PRIVATE (style);
 
-  priv->cached_matches = g_queue_new ();
-  priv->cache_hash = g_hash_table_new (g_str_hash, g_str_equal);
+  priv->node_hash = g_hash_table_new (mx_style_node_hash, mx_style_node_equal);
+  g_queue_init (&priv->unused_nodes);
 
   mx_style_load (style);
 }
@@ -590,8 +711,8 @@ mx_style_transform_css_value (MxStyleSheetValue *css_value,
 }
 
 
-static const gchar*
-mx_style_normalize_property_name (const gchar *name)
+const gchar*
+_mx_style_normalize_property_name (const gchar *name)
 {
   /* gobject properties cannot start with a '-', but custom CSS properties
    * must be prefixed with '-' + vendor identifier. Therefore, the custom
@@ -612,37 +733,37 @@ mx_style_cache_weak_ref_cb (gpointer  data,
                             GObject  *old_object)
 {
   MxStylableCache *cache = data;
-  GList *style_link = g_list_find (cache->styles, old_object);
 
-  if (style_link)
-    cache->styles = g_list_delete_link (cache->styles, style_link);
-  else
-    g_warning (G_STRLOC ": Weak unref on a stylable with no style reference");
+  /* the node is freed along with the style */
+  cache->style = NULL;
+  cache->node = NULL;
 }
 
 static void
-mx_style_stylable_cache_free (MxStylableCache *cache)
+mx_style_stylable_cache_set_style (MxStylableCache *cache,
+                                   MxStyle         *style)
 {
-  /* If there are still styles referencing this stylable, decrement their
-   * count of alive stylables and remove the weak reference.
-   */
-  while (cache->styles)
+  if (cache->style)
     {
-      MxStyle *style = cache->styles->data;
-      MxStylePrivate *priv = style->priv;
+      if (cache->node)
+        mx_style_node_unref (cache->style, cache->node);
 
-      g_object_weak_unref (G_OBJECT (style),
+      g_object_weak_unref (G_OBJECT (cache->style),
                            mx_style_cache_weak_ref_cb,
                            cache);
-      priv->alive_stylables --;
+    }
 
-      MX_NOTE (STYLE_CACHE, "(%p) Alive stylables: %d",
-               style, priv->alive_stylables);
+  cache->style = style;
+  cache->node = NULL;
 
-      cache->styles = g_list_delete_link (cache->styles, cache->styles);
-    }
+  if (style)
+    g_object_weak_ref (G_OBJECT (style), mx_style_cache_weak_ref_cb, cache);
+}
 
-  g_free (cache->string);
+static void
+mx_style_stylable_cache_free (MxStylableCache *cache)
+{
+  mx_style_stylable_cache_set_style (cache, NULL);
   g_slice_free (MxStylableCache, cache);
 }
 
@@ -652,125 +773,209 @@ _mx_style_invalidate_cache (MxStylable *stylable)
   GObject *object = G_OBJECT (stylable);
   MxStylableCache *cache = g_object_get_qdata (object, MX_STYLE_CACHE);
 
-  /* Reset the cache string */
-  if (cache)
+  /* Release the node, a new one will be looked up next time */
+  if (cache && cache->node)
     {
-      g_free (cache->string);
-      cache->string = NULL;
+      mx_style_node_unref (cache->style, cache->node);
+      cache->node = NULL;
     }
 }
 
-static GHashTable *
-mx_style_get_style_sheet_properties (MxStyle    *style,
-                                     MxStylable *stylable)
+static MxStyleNode *
+mx_style_get_style_node (MxStyle    *style,
+                         MxStylable *stylable)
 {
-  GList *entry_link;
   MxStylableCache *cache;
+  MxStyleNode key, *node;
+  const MxStylableQuarks *quarks;
+  ClutterActor *parent;
+  guint i;
 
-  MxStyleCacheEntry *entry = NULL;
   MxStylePrivate *priv = style->priv;
 
-  /* see if we have a cached style and return that if possible */
   cache = g_object_get_qdata (G_OBJECT (stylable), MX_STYLE_CACHE);
 
-  if (cache)
-    {
-      /* Make sure that the style string is up-to-date. We set this
-       * to NULL when invalidating the stylable's cache.
-       */
-      if (!cache->string)
-        cache->string = _mx_stylable_get_style_string (stylable);
-
-      /* Check that the stylable has a reference to us. If the stylable
-       * cache struct was created by another style, we need to add ourselves
-       * to the list.
-       */
-      if (!g_list_find (cache->styles, style))
-        {
-          cache->styles = g_list_prepend (cache->styles, style);
-          g_object_weak_ref (G_OBJECT (style), mx_style_cache_weak_ref_cb,
-                             cache);
-          priv->alive_stylables ++;
-        }
-    }
-  else
+  if (!cache)
     {
       /* This is the first time this stylable has tried to get style
-       * properties, initialise a cache.
+       * properties, initialise a cache. Use qdata to associate it with the
+       * stylable object.
        */
       cache = g_slice_new0 (MxStylableCache);
-      cache->string = _mx_stylable_get_style_string (stylable);
-      cache->styles = g_list_prepend (NULL, style);
+      g_object_set_qdata_full (G_OBJECT (stylable), MX_STYLE_CACHE, cache,
+                               (GDestroyNotify)mx_style_stylable_cache_free);
+    }
 
-      /* Increase the alive-stylables count and add a weak reference so we
-       * can remove it.
-       */
-      priv->alive_stylables ++;
-      g_object_weak_ref (G_OBJECT (style), mx_style_cache_weak_ref_cb, cache);
+  if (cache->style != style)
+    mx_style_stylable_cache_set_style (cache, style);
 
-      MX_NOTE (STYLE_CACHE, "(%p) Alive stylables: %d",
-               style, priv->alive_stylables);
+  if (cache->node)
+    return cache->node;
 
-      /* Use qdata to associate the cache entry with the stylable object */
-      g_object_set_qdata_full (G_OBJECT (stylable), MX_STYLE_CACHE, cache,
-                               (GDestroyNotify)mx_style_stylable_cache_free);
+  /* Build the key for this stylable. Only the closest parent can be matched
+   * against when it is stylable, so the parent node covers all ancestors.
+   */
+  parent = clutter_actor_get_parent ((ClutterActor *) stylable);
+  quarks = _mx_stylable_get_quarks (stylable);
+
+  key.parent = MX_IS_STYLABLE (parent)
+    ? mx_style_get_style_node (style, (MxStylable *) parent) : NULL;
+  key.type = G_OBJECT_TYPE (stylable);
+  key.id = quarks->id;
+  key.style_class = quarks->style_class;
+  key.pseudo_classes = quarks->pseudo_classes;
+  key.n_pseudo_classes = quarks->n_pseudo_classes;
+
+  key.hash = GPOINTER_TO_UINT (key.parent);
+  key.hash = key.hash * 31 + (guint) key.type;
+  key.hash = key.hash * 31 + key.id;
+  key.hash = key.hash * 31 + key.style_class;
+  for (i = 0; i < key.n_pseudo_classes; i++)
+    key.hash = key.hash * 31 + key.pseudo_classes[i];
+
+  node = g_hash_table_lookup (priv->node_hash, &key);
+
+  if (node)
+    mx_style_node_ref (style, node);
+  else
+    {
+      node = g_slice_new (MxStyleNode);
+      *node = key;
+      node->pseudo_classes = g_memdup (key.pseudo_classes,
+                                       key.n_pseudo_classes * sizeof (GQuark));
+      node->ref_count = 1;
+      node->properties = NULL;
+      node->values = NULL;
+      node->age = priv->age;
+      node->lru_link.data = node;
+      node->lru_link.prev = node->lru_link.next = NULL;
+      node->bytes = 0;
+
+      if (node->parent)
+        mx_style_node_ref (style, node->parent);
+
+      g_hash_table_insert (priv->node_hash, node, node);
     }
 
-  if ((entry_link = g_hash_table_lookup (priv->cache_hash, cache->string)))
+  cache->node = node;
+
+  return node;
+}
+
+GHashTable *
+_mx_style_get_cached_properties (MxStyle    *style,
+                                 MxStylable *stylable)
+{
+  MxStylableCache *cache;
+
+  cache = g_object_get_qdata (G_OBJECT (stylable), MX_STYLE_CACHE);
+
+  if (!cache || cache->style != style || !cache->node ||
+      !cache->node->properties || cache->node->age != style->priv->age)
+    return NULL;
+
+  return g_hash_table_ref (cache->node->properties);
+}
+
+gboolean
+_mx_style_affects_descendants (MxStyle                *style,
+                               const MxStylableQuarks *old_state,
+                               const MxStylableQuarks *new_state)
+{
+  MxStylePrivate *priv = style->priv;
+
+  if (!priv->stylesheet)
+    return FALSE;
+
+  return mx_style_sheet_affects_descendants (priv->stylesheet,
+                                             old_state, new_state);
+}
+
+static MxStyleNode *
+mx_style_get_matched_node (MxStyle    *style,
+                           MxStylable *stylable)
+{
+  MxStyleNode *node;
+  MxStylePrivate *priv = style->priv;
+
+  node = mx_style_get_style_node (style, stylable);
+
+  if (node->properties && node->age == priv->age)
+    {
+      priv->n_hits ++;
+    }
+  else
     {
-      entry = entry_link->data;
+      /* No properties have been matched for this node, or they are out of
+       * date, so look them up from the style-sheet.
+       */
+      if (node->properties)
+        g_hash_table_unref (node->properties);
 
-      /* If the entry is old, remove it from the cache */
-      if (entry->age != priv->age)
+      if (node->values)
         {
-          g_hash_table_remove (priv->cache_hash, entry->style_string);
-          g_queue_delete_link (priv->cached_matches, entry_link);
-          mx_style_cache_entry_free (entry, TRUE);
-          entry = NULL;
+          g_hash_table_unref (node->values);
+          node->values = NULL;
         }
 
-      /* As the cache is rarely emptied, FIFO is good enough for the
-       * eviction strategy (preferring speedy retrieval to efficient
-       * eviction)
-       *
-       * If we did want LRU though, for example, here would be the place
-       * to do it. You could remove the link from the queue using
-       * g_queue_unlink() and reinsert it with g_queue_push_head_link()
-       */
+      node->properties = mx_style_sheet_get_properties (priv->stylesheet,
+                                                        stylable);
+      node->age = priv->age;
+
+      priv->n_misses ++;
+
+      MX_NOTE (STYLE_CACHE, "(%p) Hits: %u, Misses: %u, Evictions: %u, "
+               "Nodes: %u, Unused: %u (%" G_GSIZE_FORMAT " bytes)",
+               style, priv->n_hits, priv->n_misses, priv->n_evictions,
+               g_hash_table_size (priv->node_hash),
+               g_queue_get_length (&priv->unused_nodes),
+               priv->unused_bytes);
     }
 
-  /* No cached style properties were found, or the entry found is out of date,
-   * so look them up from the style-sheet and (re-)add them to the cache.
-   */
-  if (!entry || (entry->age != priv->age))
+  return node;
+}
+
+/* Gets the value of @pspec from the style sheet properties matched for
+ * @node, converting it to the type of @pspec the first time it is requested.
+ * Returns FALSE if the style sheet does not set the property.
+ */
+static gboolean
+mx_style_node_get_value (MxStyleNode *node,
+                         MxStylable  *stylable,
+                         GParamSpec  *pspec,
+                         GValue      *value)
+{
+  GValue *cached_value;
+
+  if (node->values)
+    cached_value = g_hash_table_lookup (node->values, pspec);
+  else
+    cached_value = NULL;
+
+  if (!cached_value)
     {
-      /* Look up style properties */
-      GHashTable *properties = mx_style_sheet_get_properties (priv->stylesheet,
-                                                              stylable);
-
-      /* Append this to the style cache */
-      entry = mx_style_cache_entry_new (cache->string, properties, priv->age);
-      g_queue_push_head (priv->cached_matches, entry);
-      g_hash_table_insert (priv->cache_hash, entry->style_string,
-                           priv->cached_matches->head);
-
-      /* Shrink the cache if its grown too large */
-      while (g_queue_get_length (priv->cached_matches) >
-             (priv->alive_stylables * MX_STYLE_CACHE_SIZE))
-        {
-          MxStyleCacheEntry *old_entry =
-            g_queue_pop_tail (priv->cached_matches);
+      MxStyleSheetValue *css_value;
 
-          g_hash_table_remove (priv->cache_hash, old_entry->style_string);
-          mx_style_cache_entry_free (old_entry, TRUE);
-        }
+      css_value =
+        g_hash_table_lookup (node->properties,
+                             _mx_style_normalize_property_name (pspec->name));
+      if (!css_value)
+        return FALSE;
 
-      MX_NOTE (STYLE_CACHE, "(%p) Cache size: %d, (Max-size: %d)",
-               style, g_queue_get_length (priv->cached_matches),
-               priv->alive_stylables * MX_STYLE_CACHE_SIZE);
+      cached_value = g_slice_new0 (GValue);
+      mx_style_transform_css_value (css_value, stylable, pspec, cached_value);
+
+      if (!node->values)
+        node->values =
+          g_hash_table_new_full (NULL, NULL, NULL,
+                                 (GDestroyNotify) mx_style_node_value_free);
+      g_hash_table_insert (node->values, pspec, cached_value);
     }
 
-  return entry->properties ? g_hash_table_ref (entry->properties) : NULL;
+  g_value_init (value, G_VALUE_TYPE (cached_value));
+  g_value_copy (cached_value, value);
+
+  return TRUE;
 }
 
 /**
@@ -801,15 +1006,12 @@ mx_style_get_property (MxStyle    *style,
   /* look up the property in the css */
   if (priv->stylesheet)
     {
-      MxStyleSheetValue *css_value;
-      GHashTable *properties;
+      MxStyleNode *node;
 
-      properties = mx_style_get_style_sheet_properties (style, stylable);
+      node = mx_style_get_matched_node (style, stylable);
+      mx_style_node_ref (style, node);
 
-      css_value = g_hash_table_lookup (properties,
-                                       mx_style_normalize_property_name (pspec->name));
-
-      if (!css_value)
+      if (!mx_style_node_get_value (node, stylable, pspec, value))
         {
           if (pspec->flags & MX_PARAM_STYLE_INHERIT)
             {
@@ -836,10 +1038,8 @@ mx_style_get_property (MxStyle    *style,
           else
             mx_stylable_get_default_value (stylable, pspec->name, value);
         }
-      else
-        mx_style_transform_css_value (css_value, stylable, pspec, value);
 
-      g_hash_table_unref (properties);
+      mx_style_node_unref (style, node);
     }
 }
 
@@ -874,16 +1074,16 @@ mx_style_get_valist (MxStyle     *style,
   /* look up the property in the css */
   if (priv->stylesheet)
     {
-      GHashTable *properties;
+      MxStyleNode *node;
 
-      properties = mx_style_get_style_sheet_properties (style, stylable);
+      node = mx_style_get_matched_node (style, stylable);
+      mx_style_node_ref (style, node);
 
       while (name)
         {
           GValue value = { 0, };
           GParamSpec *pspec = mx_stylable_find_property (stylable, name);
           gchar *error;
-          MxStyleSheetValue *css_value;
 
           if (!pspec)
             {
@@ -894,10 +1094,7 @@ mx_style_get_valist (MxStyle     *style,
               break;
             }
 
-          css_value = g_hash_table_lookup (properties,
-                                           mx_style_normalize_property_name (name));
-
-          if (!css_value)
+          if (!mx_style_node_get_value (node, stylable, pspec, &value))
             {
               if (pspec->flags & MX_PARAM_STYLE_INHERIT)
                 {
@@ -924,8 +1121,6 @@ mx_style_get_valist (MxStyle     *style,
               else
                 mx_stylable_get_default_value (stylable, pspec->name, &value);
             }
-          else
-            mx_style_transform_css_value (css_value, stylable, pspec, &value);
 
           G_VALUE_LCOPY (&value, va_args, 0, &error);
 
@@ -943,7 +1138,7 @@ mx_style_get_valist (MxStyle     *style,
         }
       values_set = TRUE;
 
-      g_hash_table_unref (properties);
+      mx_style_node_unref (style, node);
     }
 
   if (!values_set)
@@ -33,8 +33,10 @@
 
 #include <glib.h>
 #include <glib-object.h>
+#include <gio/gio.h>
 #include <gdk-pixbuf/gdk-pixbuf.h>
 #include <string.h>
+#include <unistd.h>
 
 #if defined(__ANDROID__) || defined(ANDROID)
 # include <clutter/android/clutter-android-application.h>
@@ -64,8 +66,65 @@ struct _MxTextureCachePrivate
 {
   GHashTable *cache;
   GRegex     *is_uri;
+
+  /* atlases that images can still be packed into */
+  GList      *atlases;
+  guint       use_atlas : 1;
+
+  /* items that are not in use outside the cache, least recently used
+   * first, and the size of all of the items */
+  GQueue      unused;
+  guint64     bytes;
+  guint64     max_bytes;
+
+  guint       n_hits;
+  guint       n_misses;
+  guint       n_evictions;
+
+  /* asynchronous loads in progress, by URI */
+  GHashTable *loads;
+
+  /* loads that have finished decoding and are waiting to be uploaded,
+   * and the idle handler that uploads them. Protected by decoded_lock. */
+  GQueue      decoded;
+  guint       upload_id;
 };
 
+/* The longest time spent uploading decoded images in one main loop
+ * iteration, so that a burst of finished loads does not hold up frames */
+#define MX_TEXTURE_CACHE_UPLOAD_BUDGET_USEC 4000
+
+G_LOCK_DEFINE_STATIC (decoded_lock);
+
+static GThreadPool *mx_texture_cache_threads = NULL;
+
+typedef struct
+{
+  GSimpleAsyncResult *result;
+  GCancellable       *cancellable;
+} MxTextureCacheWaiter;
+
+/* An image being decoded in a worker thread for one or more callers */
+typedef struct
+{
+  MxTextureCache *cache;
+  gchar          *uri;
+  gchar          *filename; /* NULL for resources */
+
+  /* protected by decoded_lock, as the worker checks whether all of the
+   * waiters have been cancelled before decoding */
+  GList          *waiters;
+
+  /* the result of decoding. If neither is set, the image is loaded in the
+   * main thread instead */
+  GdkPixbuf      *pixbuf;
+  GError         *error;
+
+  /* set by the worker when all of the waiters had been cancelled, so it
+   * didn't decode the image */
+  gboolean        skipped;
+} MxTextureCacheLoad;
+
 typedef struct FinalizedClosure
 {
   gchar          *uri;
@@ -75,8 +134,67 @@ typedef struct FinalizedClosure
 enum
 {
   PROP_0,
+
+  PROP_USE_ATLAS,
+  PROP_MAX_BYTES,
+  PROP_BYTES,
+  PROP_HITS,
+  PROP_MISSES,
+  PROP_EVICTIONS
 };
 
+enum
+{
+  EVICTED,
+
+  LAST_SIGNAL
+};
+
+static guint signals[LAST_SIGNAL] = { 0, };
+
+#define MX_TEXTURE_CACHE_DEFAULT_MAX_BYTES (64 * 1024 * 1024)
+
+/* Images no larger than this in either dimension are packed into shared
+ * atlas textures, so that they can be batched when painting */
+#define MX_TEXTURE_ATLAS_MAX_IMAGE_SIZE 128
+#define MX_TEXTURE_ATLAS_SIZE           512
+#define MX_TEXTURE_ATLAS_MAX_ATLASES    4
+
+/* Each image is surrounded by a border of its edge pixels, so that linear
+ * filtering at its edges does not sample its neighbours */
+#define MX_TEXTURE_ATLAS_BORDER         1
+
+/* Images are packed into horizontal shelves, which are as tall as the
+ * tallest image on them. Space is not reused until all of the images in
+ * an atlas have been released, or the atlas is repacked.
+ */
+typedef struct
+{
+  CoglHandle texture;
+
+  gint       shelf_x;
+  gint       shelf_y;
+  gint       shelf_height;
+
+  /* the number of sub-textures using the atlas, and their area */
+  guint      n_images;
+  gint       used_area;
+
+  /* whether new images are still packed into this atlas */
+  gboolean   retired;
+} MxTextureAtlas;
+
+typedef struct
+{
+  MxTextureAtlas *atlas;
+  gint            x;
+  gint            y;
+  gint            width;
+  gint            height;
+} MxTextureAtlasImage;
+
+static CoglUserDataKey atlas_image_key;
+
 static MxTextureCache* __cache_singleton = NULL;
 
 /*
@@ -88,8 +206,27 @@ typedef struct MxTextureCacheItem {
   int           posX, posY;
   CoglHandle    ptr;
   GHashTable   *meta;
+
+  /* the cache the item is in and its key, or NULL once it is removed */
+  MxTextureCache *cache;
+  const gchar  *uri;
+
+  /* textures handed out for the item keep a reference on it */
+  gint          ref_count;
+  guint         n_users;
+
+  /* the size of the texture and its meta textures, and the link in the
+   * list of unused items */
+  gsize         bytes;
+  GList         lru_link;
 } MxTextureCacheItem;
 
+/* Cache files written by mx-create-image-cache hold the fields up to and
+ * including ptr */
+#define MX_TEXTURE_CACHE_ITEM_FILE_SIZE G_STRUCT_OFFSET (MxTextureCacheItem, meta)
+
+static CoglUserDataKey item_user_key;
+
 typedef struct
 {
   gpointer        ident;
@@ -100,12 +237,19 @@ typedef struct
 static MxTextureCacheItem *
 mx_texture_cache_item_new (void)
 {
-  return g_slice_new0 (MxTextureCacheItem);
+  MxTextureCacheItem *item = g_slice_new0 (MxTextureCacheItem);
+
+  item->ref_count = 1;
+
+  return item;
 }
 
 static void
-mx_texture_cache_item_free (MxTextureCacheItem *item)
+mx_texture_cache_item_unref (MxTextureCacheItem *item)
 {
+  if (--item->ref_count > 0)
+    return;
+
   if (item->ptr)
     cogl_handle_unref (item->ptr);
 
@@ -115,6 +259,548 @@ mx_texture_cache_item_free (MxTextureCacheItem *item)
   g_slice_free (MxTextureCacheItem, item);
 }
 
+static void
+mx_texture_cache_item_unlink (MxTextureCacheItem *item)
+{
+  MxTextureCachePrivate *priv = TEXTURE_CACHE_PRIVATE (item->cache);
+
+  if (item->lru_link.data)
+    {
+      g_queue_unlink (&priv->unused, &item->lru_link);
+      item->lru_link.data = NULL;
+    }
+}
+
+/* Called when an item is removed from the hash table of a cache */
+static void
+mx_texture_cache_item_remove (MxTextureCacheItem *item)
+{
+  if (item->cache)
+    {
+      MxTextureCachePrivate *priv = TEXTURE_CACHE_PRIVATE (item->cache);
+
+      mx_texture_cache_item_unlink (item);
+      priv->bytes -= item->bytes;
+
+      item->cache = NULL;
+      item->uri = NULL;
+    }
+
+  mx_texture_cache_item_unref (item);
+}
+
+static gsize
+mx_texture_cache_get_texture_bytes (CoglHandle texture)
+{
+  /* with no buffer, this returns the size of the texture's data */
+  return texture ? cogl_texture_get_data (texture, COGL_PIXEL_FORMAT_ANY,
+                                          0, NULL) : 0;
+}
+
+static void
+mx_texture_cache_trim (MxTextureCache *self)
+{
+  MxTextureCachePrivate *priv = TEXTURE_CACHE_PRIVATE (self);
+  guint n_evictions = priv->n_evictions;
+
+  /* only items that are not used outside of the cache are evicted, as
+   * evicting the others would not release them */
+  while (priv->bytes > priv->max_bytes && priv->unused.head)
+    {
+      MxTextureCacheItem *item = priv->unused.head->data;
+      gchar *uri = g_strdup (item->uri);
+
+      MX_NOTE (TEXTURE_CACHE, "Evicting '%s' (%" G_GSIZE_FORMAT " bytes)",
+               uri, item->bytes);
+
+      priv->n_evictions ++;
+      g_hash_table_remove (priv->cache, uri);
+
+      g_signal_emit (self, signals[EVICTED], 0, uri);
+      g_free (uri);
+    }
+
+  if (priv->n_evictions != n_evictions)
+    {
+      g_object_notify (G_OBJECT (self), "bytes");
+      g_object_notify (G_OBJECT (self), "evictions");
+    }
+}
+
+/* Recalculates the size of a cached item, after its texture or meta
+ * textures have changed */
+static void
+mx_texture_cache_item_update (MxTextureCache     *self,
+                              MxTextureCacheItem *item)
+{
+  MxTextureCachePrivate *priv = TEXTURE_CACHE_PRIVATE (self);
+  GHashTableIter iter;
+  gpointer value;
+  gsize bytes;
+
+  bytes = mx_texture_cache_get_texture_bytes (item->ptr);
+
+  if (item->meta)
+    {
+      g_hash_table_iter_init (&iter, item->meta);
+      while (g_hash_table_iter_next (&iter, NULL, &value))
+        bytes += mx_texture_cache_get_texture_bytes
+          (((MxTextureCacheMetaEntry *) value)->texture);
+    }
+
+  priv->bytes += bytes - item->bytes;
+  item->bytes = bytes;
+
+  /* items that are not in use go to the end of the list of unused items */
+  mx_texture_cache_item_unlink (item);
+  if (item->n_users == 0)
+    {
+      item->lru_link.data = item;
+      g_queue_push_tail_link (&priv->unused, &item->lru_link);
+    }
+
+  g_object_notify (G_OBJECT (self), "bytes");
+}
+
+static void
+mx_texture_cache_item_release (MxTextureCacheItem *item)
+{
+  item->n_users --;
+
+  if (item->n_users == 0 && item->cache)
+    {
+      MxTextureCachePrivate *priv = TEXTURE_CACHE_PRIVATE (item->cache);
+      MxTextureCache *self = item->cache;
+
+      item->lru_link.data = item;
+      g_queue_push_tail_link (&priv->unused, &item->lru_link);
+
+      mx_texture_cache_item_unref (item);
+      mx_texture_cache_trim (self);
+    }
+  else
+    mx_texture_cache_item_unref (item);
+}
+
+/* Returns a new texture for @texture of @item. Rather than the cached
+ * texture itself, a sub-texture covering all of it is returned, so that
+ * the cache knows when the item is no longer in use */
+static CoglHandle
+mx_texture_cache_item_share (MxTextureCacheItem *item,
+                             CoglHandle          texture)
+{
+  CoglHandle shared;
+
+  shared = cogl_texture_new_from_sub_texture (texture, 0, 0,
+                                              cogl_texture_get_width (texture),
+                                              cogl_texture_get_height (texture));
+
+  if (item->n_users++ == 0 && item->cache)
+    mx_texture_cache_item_unlink (item);
+
+  item->ref_count ++;
+  cogl_object_set_user_data (shared, &item_user_key, item,
+                             (CoglUserDataDestroyCallback)
+                             mx_texture_cache_item_release);
+
+  return shared;
+}
+
+static void
+mx_texture_atlas_free (MxTextureAtlas *atlas)
+{
+  cogl_handle_unref (atlas->texture);
+  g_slice_free (MxTextureAtlas, atlas);
+}
+
+static void
+mx_texture_atlas_image_free (MxTextureAtlasImage *image)
+{
+  MxTextureAtlas *atlas = image->atlas;
+
+  atlas->n_images --;
+  atlas->used_area -= (image->width + MX_TEXTURE_ATLAS_BORDER * 2) *
+    (image->height + MX_TEXTURE_ATLAS_BORDER * 2);
+
+  if (atlas->n_images == 0)
+    {
+      if (atlas->retired)
+        mx_texture_atlas_free (atlas);
+      else
+        {
+          /* the atlas is empty, so start packing it again from the top */
+          atlas->shelf_x = atlas->shelf_y = atlas->shelf_height = 0;
+        }
+    }
+
+  g_slice_free (MxTextureAtlasImage, image);
+}
+
+static MxTextureAtlas *
+mx_texture_atlas_new (void)
+{
+  MxTextureAtlas *atlas = g_slice_new0 (MxTextureAtlas);
+
+  atlas->texture = cogl_texture_new_with_size (MX_TEXTURE_ATLAS_SIZE,
+                                               MX_TEXTURE_ATLAS_SIZE,
+                                               COGL_TEXTURE_NO_SLICING |
+                                               COGL_TEXTURE_NO_ATLAS,
+                                               COGL_PIXEL_FORMAT_RGBA_8888_PRE);
+
+  if (atlas->texture == COGL_INVALID_HANDLE)
+    {
+      g_slice_free (MxTextureAtlas, atlas);
+      return NULL;
+    }
+
+  return atlas;
+}
+
+static void
+mx_texture_atlas_retire (MxTextureAtlas *atlas)
+{
+  atlas->retired = TRUE;
+
+  if (atlas->n_images == 0)
+    mx_texture_atlas_free (atlas);
+}
+
+/* Finds space for a @width x @height image, including its border */
+static gboolean
+mx_texture_atlas_allocate (MxTextureAtlas *atlas,
+                           gint            width,
+                           gint            height,
+                           gint           *x,
+                           gint           *y)
+{
+  width += MX_TEXTURE_ATLAS_BORDER * 2;
+  height += MX_TEXTURE_ATLAS_BORDER * 2;
+
+  /* start a new shelf if the image does not fit on the current one */
+  if (atlas->shelf_x + width > MX_TEXTURE_ATLAS_SIZE)
+    {
+      atlas->shelf_y += atlas->shelf_height;
+      atlas->shelf_x = 0;
+      atlas->shelf_height = 0;
+    }
+
+  if (atlas->shelf_y + height > MX_TEXTURE_ATLAS_SIZE ||
+      width > MX_TEXTURE_ATLAS_SIZE)
+    return FALSE;
+
+  *x = atlas->shelf_x + MX_TEXTURE_ATLAS_BORDER;
+  *y = atlas->shelf_y + MX_TEXTURE_ATLAS_BORDER;
+
+  atlas->shelf_x += width;
+  atlas->shelf_height = MAX (atlas->shelf_height, height);
+
+  return TRUE;
+}
+
+/* Returns a sub-texture for the image at @x, @y in @atlas, which releases
+ * its space when it is destroyed */
+static CoglHandle
+mx_texture_atlas_get_sub_texture (MxTextureAtlas *atlas,
+                                  gint            x,
+                                  gint            y,
+                                  gint            width,
+                                  gint            height)
+{
+  MxTextureAtlasImage *image;
+  CoglHandle texture;
+
+  texture = cogl_texture_new_from_sub_texture (atlas->texture,
+                                               x, y, width, height);
+
+  image = g_slice_new (MxTextureAtlasImage);
+  image->atlas = atlas;
+  image->x = x;
+  image->y = y;
+  image->width = width;
+  image->height = height;
+
+  atlas->n_images ++;
+  atlas->used_area += (width + MX_TEXTURE_ATLAS_BORDER * 2) *
+    (height + MX_TEXTURE_ATLAS_BORDER * 2);
+
+  cogl_object_set_user_data (texture, &atlas_image_key, image,
+                             (CoglUserDataDestroyCallback)
+                             mx_texture_atlas_image_free);
+
+  return texture;
+}
+
+/* Uploads an image and the border around it at @x, @y */
+static void
+mx_texture_atlas_upload (MxTextureAtlas  *atlas,
+                         gint             x,
+                         gint             y,
+                         gint             width,
+                         gint             height,
+                         CoglPixelFormat  format,
+                         gint             bpp,
+                         gint             rowstride,
+                         const guchar    *pixels)
+{
+  gint border_width, border_height, border_rowstride, row;
+  guchar *data, *dest;
+
+  border_width = width + MX_TEXTURE_ATLAS_BORDER * 2;
+  border_height = height + MX_TEXTURE_ATLAS_BORDER * 2;
+  border_rowstride = border_width * bpp;
+
+  data = g_malloc (border_rowstride * border_height);
+
+  for (row = 0; row < border_height; row++)
+    {
+      const guchar *src;
+      gint i;
+
+      src = pixels + CLAMP (row - MX_TEXTURE_ATLAS_BORDER, 0, height - 1) *
+        rowstride;
+      dest = data + row * border_rowstride;
+
+      for (i = 0; i < MX_TEXTURE_ATLAS_BORDER; i++)
+        {
+          memcpy (dest + i * bpp, src, bpp);
+          memcpy (dest + (MX_TEXTURE_ATLAS_BORDER + width + i) * bpp,
+                  src + (width - 1) * bpp, bpp);
+        }
+
+      memcpy (dest + MX_TEXTURE_ATLAS_BORDER * bpp, src, width * bpp);
+    }
+
+  cogl_texture_set_region (atlas->texture, 0, 0,
+                           x - MX_TEXTURE_ATLAS_BORDER,
+                           y - MX_TEXTURE_ATLAS_BORDER,
+                           border_width, border_height,
+                           border_width, border_height,
+                           format, border_rowstride, data);
+
+  g_free (data);
+}
+
+/* Compares the textures that two places in the cache hold by height */
+static gint
+mx_texture_cache_compare_slot_height (gconstpointer a,
+                                      gconstpointer b)
+{
+  const CoglHandle *slot_a = *((CoglHandle **) a);
+  const CoglHandle *slot_b = *((CoglHandle **) b);
+
+  return cogl_texture_get_height (*slot_b) - cogl_texture_get_height (*slot_a);
+}
+
+/* Adds @slot to @slots if the texture it holds is packed into @atlas */
+static void
+mx_texture_cache_add_atlas_slot (GPtrArray      *slots,
+                                 CoglHandle     *slot,
+                                 MxTextureAtlas *atlas)
+{
+  MxTextureAtlasImage *image;
+
+  if (!*slot)
+    return;
+
+  image = cogl_object_get_user_data (*slot, &atlas_image_key);
+  if (image && image->atlas == atlas)
+    g_ptr_array_add (slots, slot);
+}
+
+/* Moves the cached images in @atlas, including meta textures such as the
+ * icons that MxIconTheme rasterises, to a new atlas, packing them tallest
+ * first, and retires @atlas. Textures that were handed out before keep
+ * @atlas alive until they are released, as do images that are no longer
+ * in the cache. */
+static MxTextureAtlas *
+mx_texture_cache_repack_atlas (MxTextureCache *self,
+                               MxTextureAtlas *atlas)
+{
+  MxTextureCachePrivate *priv = TEXTURE_CACHE_PRIVATE (self);
+  MxTextureAtlas *new_atlas;
+  GHashTableIter iter, meta_iter;
+  GPtrArray *slots;
+  gpointer value;
+  guchar *pixels;
+  gint rowstride;
+  guint i;
+
+  new_atlas = mx_texture_atlas_new ();
+  if (!new_atlas)
+    return NULL;
+
+  /* the places in the cache that hold a texture in the atlas */
+  slots = g_ptr_array_new ();
+
+  g_hash_table_iter_init (&iter, priv->cache);
+  while (g_hash_table_iter_next (&iter, NULL, &value))
+    {
+      MxTextureCacheItem *item = value;
+
+      mx_texture_cache_add_atlas_slot (slots, &item->ptr, atlas);
+
+      if (!item->meta)
+        continue;
+
+      g_hash_table_iter_init (&meta_iter, item->meta);
+      while (g_hash_table_iter_next (&meta_iter, NULL, &value))
+        {
+          MxTextureCacheMetaEntry *entry = value;
+
+          mx_texture_cache_add_atlas_slot (slots,
+                                           (CoglHandle *) &entry->texture,
+                                           atlas);
+        }
+    }
+
+  g_ptr_array_sort (slots, mx_texture_cache_compare_slot_height);
+
+  /* read the atlas back, rather than loading every image again */
+  rowstride = MX_TEXTURE_ATLAS_SIZE * 4;
+  pixels = g_malloc (rowstride * MX_TEXTURE_ATLAS_SIZE);
+  cogl_texture_get_data (atlas->texture, COGL_PIXEL_FORMAT_RGBA_8888_PRE,
+                         rowstride, pixels);
+
+  for (i = 0; i < slots->len; i++)
+    {
+      CoglHandle *slot = g_ptr_array_index (slots, i);
+      MxTextureAtlasImage *image;
+      gint x, y, width, height;
+
+      image = cogl_object_get_user_data (*slot, &atlas_image_key);
+      width = image->width;
+      height = image->height;
+
+      /* the new atlas is at most as full as the old one */
+      if (!mx_texture_atlas_allocate (new_atlas, width, height, &x, &y))
+        break;
+
+      cogl_texture_set_region (new_atlas->texture,
+                               image->x - MX_TEXTURE_ATLAS_BORDER,
+                               image->y - MX_TEXTURE_ATLAS_BORDER,
+                               x - MX_TEXTURE_ATLAS_BORDER,
+                               y - MX_TEXTURE_ATLAS_BORDER,
+                               width + MX_TEXTURE_ATLAS_BORDER * 2,
+                               height + MX_TEXTURE_ATLAS_BORDER * 2,
+                               MX_TEXTURE_ATLAS_SIZE, MX_TEXTURE_ATLAS_SIZE,
+                               COGL_PIXEL_FORMAT_RGBA_8888_PRE,
+                               rowstride, pixels);
+
+      /* this may release the last image in the old atlas */
+      cogl_handle_unref (*slot);
+      *slot = mx_texture_atlas_get_sub_texture (new_atlas, x, y,
+                                                width, height);
+    }
+
+  MX_NOTE (TEXTURE_CACHE, "Repacked %u images into a new atlas", i);
+
+  g_free (pixels);
+  g_ptr_array_free (slots, TRUE);
+
+  priv->atlases = g_list_remove (priv->atlases, atlas);
+  mx_texture_atlas_retire (atlas);
+
+  priv->atlases = g_list_prepend (priv->atlases, new_atlas);
+
+  return new_atlas;
+}
+
+/* Packs an image into an atlas, returning a sub-texture of it, or
+ * COGL_INVALID_HANDLE if the image should have a texture of its own */
+static CoglHandle
+mx_texture_cache_add_to_atlas (MxTextureCache  *self,
+                               gint             width,
+                               gint             height,
+                               CoglPixelFormat  format,
+                               gint             bpp,
+                               gint             rowstride,
+                               const guchar    *pixels)
+{
+  MxTextureCachePrivate *priv = TEXTURE_CACHE_PRIVATE (self);
+  MxTextureAtlas *atlas = NULL, *most_wasted = NULL;
+  gint x, y, wasted, most_wasted_area = 0;
+  GList *l;
+
+  if (!priv->use_atlas ||
+      width > MX_TEXTURE_ATLAS_MAX_IMAGE_SIZE ||
+      height > MX_TEXTURE_ATLAS_MAX_IMAGE_SIZE)
+    return COGL_INVALID_HANDLE;
+
+  for (l = priv->atlases; l; l = l->next)
+    {
+      MxTextureAtlas *candidate = l->data;
+
+      if (mx_texture_atlas_allocate (candidate, width, height, &x, &y))
+        {
+          atlas = candidate;
+          break;
+        }
+
+      /* space released by images that were dropped from the cache */
+      wasted = candidate->shelf_y * MX_TEXTURE_ATLAS_SIZE -
+        candidate->used_area;
+      if (wasted > most_wasted_area)
+        {
+          most_wasted = candidate;
+          most_wasted_area = wasted;
+        }
+    }
+
+  if (!atlas)
+    {
+      /* all of the atlases are full. Repack the one with the most unused
+       * space if at least half of it is unused, or start a new one. */
+      if (most_wasted &&
+          most_wasted_area >= MX_TEXTURE_ATLAS_SIZE * MX_TEXTURE_ATLAS_SIZE / 2)
+        atlas = mx_texture_cache_repack_atlas (self, most_wasted);
+      else if (g_list_length (priv->atlases) < MX_TEXTURE_ATLAS_MAX_ATLASES)
+        {
+          atlas = mx_texture_atlas_new ();
+          if (atlas)
+            priv->atlases = g_list_prepend (priv->atlases, atlas);
+        }
+
+      if (!atlas ||
+          !mx_texture_atlas_allocate (atlas, width, height, &x, &y))
+        return COGL_INVALID_HANDLE;
+    }
+
+  mx_texture_atlas_upload (atlas, x, y, width, height, format, bpp,
+                           rowstride, pixels);
+
+  return mx_texture_atlas_get_sub_texture (atlas, x, y, width, height);
+}
+
+/* Uploads @pixbuf, packing it into an atlas if it is small enough. This
+ * is also used for the icons that MxIconTheme rasterises itself */
+CoglHandle
+_mx_texture_cache_texture_from_pixbuf (MxTextureCache *self,
+                                       GdkPixbuf      *pixbuf)
+{
+  CoglPixelFormat format;
+  CoglHandle texture;
+  gint width, height, rowstride;
+  gboolean has_alpha;
+
+  width = gdk_pixbuf_get_width (pixbuf);
+  height = gdk_pixbuf_get_height (pixbuf);
+  has_alpha = gdk_pixbuf_get_has_alpha (pixbuf);
+  rowstride = gdk_pixbuf_get_rowstride (pixbuf);
+  format = has_alpha ? COGL_PIXEL_FORMAT_RGBA_8888 : COGL_PIXEL_FORMAT_RGB_888;
+
+  texture = mx_texture_cache_add_to_atlas (self, width, height, format,
+                                           has_alpha ? 4 : 3, rowstride,
+                                           gdk_pixbuf_get_pixels (pixbuf));
+
+  if (texture == COGL_INVALID_HANDLE)
+    texture = cogl_texture_new_from_data (width, height, COGL_TEXTURE_NONE,
+                                          format, COGL_PIXEL_FORMAT_ANY,
+                                          rowstride,
+                                          gdk_pixbuf_get_pixels (pixbuf));
+
+  return texture;
+}
+
 static void
 mx_texture_cache_set_property (GObject      *object,
                                guint         prop_id,
@@ -123,6 +809,16 @@ mx_texture_cache_set_property (GObject      *object,
 {
   switch (prop_id)
     {
+    case PROP_USE_ATLAS:
+      mx_texture_cache_set_use_atlas (MX_TEXTURE_CACHE (object),
+                                      g_value_get_boolean (value));
+      break;
+
+    case PROP_MAX_BYTES:
+      mx_texture_cache_set_max_bytes (MX_TEXTURE_CACHE (object),
+                                      g_value_get_uint64 (value));
+      break;
+
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -135,8 +831,34 @@ mx_texture_cache_get_property (GObject    *object,
                                GValue     *value,
                                GParamSpec *pspec)
 {
+  MxTextureCachePrivate *priv = TEXTURE_CACHE_PRIVATE (object);
+
   switch (prop_id)
     {
+    case PROP_USE_ATLAS:
+      g_value_set_boolean (value, priv->use_atlas);
+      break;
+
+    case PROP_MAX_BYTES:
+      g_value_set_uint64 (value, priv->max_bytes);
+      break;
+
+    case PROP_BYTES:
+      g_value_set_uint64 (value, priv->bytes);
+      break;
+
+    case PROP_HITS:
+      g_value_set_uint (value, priv->n_hits);
+      break;
+
+    case PROP_MISSES:
+      g_value_set_uint (value, priv->n_misses);
+      break;
+
+    case PROP_EVICTIONS:
+      g_value_set_uint (value, priv->n_evictions);
+      break;
+
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -158,6 +880,13 @@ mx_texture_cache_finalize (GObject *object)
   if (priv->cache)
     g_hash_table_unref (priv->cache);
 
+  /* loads hold a reference on the cache, so there are none left */
+  g_hash_table_unref (priv->loads);
+
+  /* atlases still in use by sub-textures are freed with the last one */
+  g_list_foreach (priv->atlases, (GFunc) mx_texture_atlas_retire, NULL);
+  g_list_free (priv->atlases);
+
   if (priv->is_uri)
     g_regex_unref (priv->is_uri);
 
@@ -168,6 +897,7 @@ static void
 mx_texture_cache_class_init (MxTextureCacheClass *klass)
 {
   GObjectClass *object_class = G_OBJECT_CLASS (klass);
+  GParamSpec *pspec;
 
   g_type_class_add_private (klass, sizeof (MxTextureCachePrivate));
 
@@ -176,70 +906,303 @@ mx_texture_cache_class_init (MxTextureCacheClass *klass)
   object_class->dispose = mx_texture_cache_dispose;
   object_class->finalize = mx_texture_cache_finalize;
 
+  /**
+   * MxTextureCache:use-atlas:
+   *
+   * Whether small images are packed into shared atlas textures, which
+   * allows them to be painted in a single batch.
+   *
+   * Since: 2.0
+   */
+  pspec = g_param_spec_boolean ("use-atlas",
+                                "Use atlas",
+                                "Whether to pack small images into shared "
+                                "atlas textures",
+                                FALSE,
+                                MX_PARAM_READWRITE);
+  g_object_class_install_property (object_class, PROP_USE_ATLAS, pspec);
+
+  /**
+   * MxTextureCache:max-bytes:
+   *
+   * The number of bytes of texture data the cache tries to stay under.
+   * When it is exceeded, the least recently used textures that are not
+   * in use outside of the cache are evicted.
+   *
+   * Since: 2.0
+   */
+  pspec = g_param_spec_uint64 ("max-bytes",
+                               "Maximum bytes",
+                               "The size the cache tries to stay under",
+                               0, G_MAXUINT64,
+                               MX_TEXTURE_CACHE_DEFAULT_MAX_BYTES,
+                               MX_PARAM_READWRITE);
+  g_object_class_install_property (object_class, PROP_MAX_BYTES, pspec);
+
+  /**
+   * MxTextureCache:bytes:
+   *
+   * The number of bytes of texture data in the cache, including meta
+   * textures.
+   *
+   * Since: 2.0
+   */
+  pspec = g_param_spec_uint64 ("bytes",
+                               "Bytes",
+                               "The size of the textures in the cache",
+                               0, G_MAXUINT64, 0,
+                               MX_PARAM_READABLE);
+  g_object_class_install_property (object_class, PROP_BYTES, pspec);
+
+  /**
+   * MxTextureCache:hits:
+   *
+   * The number of textures that were requested and found in the cache.
+   * This property is not notified when it changes.
+   *
+   * Since: 2.0
+   */
+  pspec = g_param_spec_uint ("hits",
+                             "Hits",
+                             "The number of requests found in the cache",
+                             0, G_MAXUINT, 0,
+                             MX_PARAM_READABLE);
+  g_object_class_install_property (object_class, PROP_HITS, pspec);
+
+  /**
+   * MxTextureCache:misses:
+   *
+   * The number of textures that were requested and had to be loaded, or
+   * were not found. This property is not notified when it changes.
+   *
+   * Since: 2.0
+   */
+  pspec = g_param_spec_uint ("misses",
+                             "Misses",
+                             "The number of requests not found in the cache",
+                             0, G_MAXUINT, 0,
+                             MX_PARAM_READABLE);
+  g_object_class_install_property (object_class, PROP_MISSES, pspec);
+
+  /**
+   * MxTextureCache:evictions:
+   *
+   * The number of textures that have been evicted from the cache.
+   *
+   * Since: 2.0
+   */
+  pspec = g_param_spec_uint ("evictions",
+                             "Evictions",
+                             "The number of textures evicted from the cache",
+                             0, G_MAXUINT, 0,
+                             MX_PARAM_READABLE);
+  g_object_class_install_property (object_class, PROP_EVICTIONS, pspec);
+
+  /**
+   * MxTextureCache::evicted:
+   * @cache: the #MxTextureCache that received the signal
+   * @uri: the URI of the evicted texture
+   *
+   * Emitted when a texture, along with its meta textures, is evicted from
+   * the cache.
+   *
+   * Since: 2.0
+   */
+  signals[EVICTED] =
+    g_signal_new ("evicted",
+                  G_TYPE_FROM_CLASS (klass),
+                  G_SIGNAL_RUN_LAST,
+                  0, NULL, NULL,
+                  _mx_marshal_VOID__STRING,
+                  G_TYPE_NONE, 1, G_TYPE_STRING);
 }
 
 static void
 mx_texture_cache_init (MxTextureCache *self)
 {
-  GError *error = NULL;
-  MxTextureCachePrivate *priv = TEXTURE_CACHE_PRIVATE(self);
-
-  priv->cache =
-    g_hash_table_new_full (g_str_hash, g_str_equal,
-                           g_free, (GDestroyNotify)mx_texture_cache_item_free);
+  GError *error = NULL;
+  MxTextureCachePrivate *priv = TEXTURE_CACHE_PRIVATE(self);
+
+  priv->cache =
+    g_hash_table_new_full (g_str_hash, g_str_equal,
+                           g_free, (GDestroyNotify)mx_texture_cache_item_remove);
+
+  g_queue_init (&priv->unused);
+  priv->max_bytes = MX_TEXTURE_CACHE_DEFAULT_MAX_BYTES;
+
+  priv->loads = g_hash_table_new (g_str_hash, g_str_equal);
+  g_queue_init (&priv->decoded);
+
+  priv->is_uri = g_regex_new ("^([a-zA-Z0-9+.-]+)://.*",
+                              G_REGEX_OPTIMIZE, 0, &error);
+  if (!priv->is_uri)
+    g_error (G_STRLOC ": Unable to compile regex: %s", error->message);
+}
+
+/**
+ * mx_texture_cache_get_default:
+ *
+ * Returns the default texture cache. This is owned by Mx and should not be
+ * unreferenced or freed.
+ *
+ * Returns: (transfer none): a MxTextureCache
+ */
+MxTextureCache*
+mx_texture_cache_get_default (void)
+{
+  /* the default cache holds the theme images, which are mostly small */
+  if (G_UNLIKELY (__cache_singleton == NULL))
+    __cache_singleton = g_object_new (MX_TYPE_TEXTURE_CACHE,
+                                      "use-atlas", TRUE,
+                                      NULL);
+
+  return __cache_singleton;
+}
+
+#if 0
+static void
+on_texure_finalized (gpointer data,
+                     GObject *where_the_object_was)
+{
+  FinalizedClosure *closure = (FinalizedClosure *) data;
+  MxTextureCachePrivate *priv = TEXTURE_CACHE_PRIVATE(closure->cache);
+
+  g_hash_table_remove (priv->cache, closure->uri);
+
+  g_free(closure->uri);
+  g_free(closure);
+}
+#endif
+
+/**
+ * mx_texture_cache_get_size:
+ * @self: A #MxTextureCache
+ *
+ * Returns the number of items in the texture cache
+ *
+ * Returns: the current size of the cache
+ */
+gint
+mx_texture_cache_get_size (MxTextureCache *self)
+{
+  MxTextureCachePrivate *priv = TEXTURE_CACHE_PRIVATE(self);
+
+  return g_hash_table_size (priv->cache);
+}
+
+/**
+ * mx_texture_cache_set_use_atlas:
+ * @self: A #MxTextureCache
+ * @use_atlas: %TRUE to pack small images into atlases
+ *
+ * Sets whether images loaded by @self that are no larger than 128 pixels
+ * in either dimension are packed into shared atlas textures. The textures
+ * returned for them are sub-textures of the atlas, which can be painted
+ * together without changing textures. Images that are already loaded are
+ * not affected.
+ *
+ * Since: 2.0
+ */
+void
+mx_texture_cache_set_use_atlas (MxTextureCache *self,
+                                gboolean        use_atlas)
+{
+  MxTextureCachePrivate *priv;
+
+  g_return_if_fail (MX_IS_TEXTURE_CACHE (self));
+
+  priv = TEXTURE_CACHE_PRIVATE (self);
+
+  if (priv->use_atlas != use_atlas)
+    {
+      priv->use_atlas = use_atlas;
+      g_object_notify (G_OBJECT (self), "use-atlas");
+    }
+}
+
+/**
+ * mx_texture_cache_get_use_atlas:
+ * @self: A #MxTextureCache
+ *
+ * Gets whether small images are packed into shared atlas textures.
+ *
+ * Returns: %TRUE if @self packs small images into atlases
+ *
+ * Since: 2.0
+ */
+gboolean
+mx_texture_cache_get_use_atlas (MxTextureCache *self)
+{
+  g_return_val_if_fail (MX_IS_TEXTURE_CACHE (self), FALSE);
 
-  priv->is_uri = g_regex_new ("^([a-zA-Z0-9+.-]+)://.*",
-                              G_REGEX_OPTIMIZE, 0, &error);
-  if (!priv->is_uri)
-    g_error (G_STRLOC ": Unable to compile regex: %s", error->message);
+  return TEXTURE_CACHE_PRIVATE (self)->use_atlas;
 }
 
 /**
- * mx_texture_cache_get_default:
+ * mx_texture_cache_set_max_bytes:
+ * @self: A #MxTextureCache
+ * @max_bytes: the maximum number of bytes
  *
- * Returns the default texture cache. This is owned by Mx and should not be
- * unreferenced or freed.
+ * Sets the number of bytes of texture data @self tries to stay under. When
+ * it is exceeded, the least recently used textures that are not in use
+ * outside of the cache are evicted, along with their meta textures.
  *
- * Returns: (transfer none): a MxTextureCache
+ * Since: 2.0
  */
-MxTextureCache*
-mx_texture_cache_get_default (void)
+void
+mx_texture_cache_set_max_bytes (MxTextureCache *self,
+                                guint64         max_bytes)
 {
-  if (G_UNLIKELY (__cache_singleton == NULL))
-    __cache_singleton = g_object_new (MX_TYPE_TEXTURE_CACHE, NULL);
+  MxTextureCachePrivate *priv;
 
-  return __cache_singleton;
+  g_return_if_fail (MX_IS_TEXTURE_CACHE (self));
+
+  priv = TEXTURE_CACHE_PRIVATE (self);
+
+  if (priv->max_bytes != max_bytes)
+    {
+      priv->max_bytes = max_bytes;
+      g_object_notify (G_OBJECT (self), "max-bytes");
+
+      mx_texture_cache_trim (self);
+    }
 }
 
-#if 0
-static void
-on_texure_finalized (gpointer data,
-                     GObject *where_the_object_was)
+/**
+ * mx_texture_cache_get_max_bytes:
+ * @self: A #MxTextureCache
+ *
+ * Gets the number of bytes of texture data @self tries to stay under.
+ *
+ * Returns: the maximum number of bytes
+ *
+ * Since: 2.0
+ */
+guint64
+mx_texture_cache_get_max_bytes (MxTextureCache *self)
 {
-  FinalizedClosure *closure = (FinalizedClosure *) data;
-  MxTextureCachePrivate *priv = TEXTURE_CACHE_PRIVATE(closure->cache);
-
-  g_hash_table_remove (priv->cache, closure->uri);
+  g_return_val_if_fail (MX_IS_TEXTURE_CACHE (self), 0);
 
-  g_free(closure->uri);
-  g_free(closure);
+  return TEXTURE_CACHE_PRIVATE (self)->max_bytes;
 }
-#endif
 
 /**
- * mx_texture_cache_get_size:
+ * mx_texture_cache_get_bytes:
  * @self: A #MxTextureCache
  *
- * Returns the number of items in the texture cache
+ * Gets the number of bytes of texture data in @self, including textures
+ * that are in use and meta textures.
  *
- * Returns: the current size of the cache
+ * Returns: the number of bytes
+ *
+ * Since: 2.0
  */
-gint
-mx_texture_cache_get_size (MxTextureCache *self)
+guint64
+mx_texture_cache_get_bytes (MxTextureCache *self)
 {
-  MxTextureCachePrivate *priv = TEXTURE_CACHE_PRIVATE(self);
+  g_return_val_if_fail (MX_IS_TEXTURE_CACHE (self), 0);
 
-  return g_hash_table_size (priv->cache);
+  return TEXTURE_CACHE_PRIVATE (self)->bytes;
 }
 
 static void
@@ -249,8 +1212,14 @@ add_texture_to_cache (MxTextureCache     *self,
 {
   /*  FinalizedClosure        *closure; */
   MxTextureCachePrivate *priv = TEXTURE_CACHE_PRIVATE(self);
+  gchar *key = g_strdup (uri);
 
-  g_hash_table_insert (priv->cache, g_strdup (uri), item);
+  /* replace the key as well, as the item refers to it */
+  g_hash_table_replace (priv->cache, key, item);
+  item->cache = self;
+  item->uri = key;
+
+  mx_texture_cache_item_update (self, item);
 
 #if 0
   /* Make sure we can remove from hash */
@@ -367,7 +1336,9 @@ mx_texture_cache_get_item (MxTextureCache *self,
 
   item = g_hash_table_lookup (priv->cache, uri);
 
-  if ((!item || !item->ptr) && create_if_not_exists)
+  if (item && item->ptr && create_if_not_exists)
+    priv->n_hits ++;
+  else if (create_if_not_exists)
     {
       gboolean created;
       GError *err = NULL;
@@ -384,7 +1355,6 @@ mx_texture_cache_get_item (MxTextureCache *self,
         {
           GdkPixbuf *pixbuf;
           GInputStream *stream = NULL;
-          gint width, height, has_alpha, rowstride;
 
           stream = g_resources_open_stream (&uri[11],
                                             G_RESOURCE_LOOKUP_FLAGS_NONE,
@@ -392,21 +1362,14 @@ mx_texture_cache_get_item (MxTextureCache *self,
 
           if (stream)
             {
-
               pixbuf = gdk_pixbuf_new_from_stream (stream, NULL, &err);
 
-
-              width = gdk_pixbuf_get_width (pixbuf);
-              height = gdk_pixbuf_get_height (pixbuf);
-              has_alpha = gdk_pixbuf_get_has_alpha (pixbuf);
-              rowstride = gdk_pixbuf_get_rowstride (pixbuf);
-
-              item->ptr = cogl_texture_new_from_data (width, height,
-                                                      COGL_TEXTURE_NONE,
-                                                      has_alpha ? COGL_PIXEL_FORMAT_RGBA_8888 : COGL_PIXEL_FORMAT_RGB_888,
-                                                      COGL_PIXEL_FORMAT_ANY,
-                                                      rowstride,
-                                                      gdk_pixbuf_get_pixels (pixbuf));
+              if (pixbuf)
+                {
+                  item->ptr = _mx_texture_cache_texture_from_pixbuf (self,
+                                                                     pixbuf);
+                  g_object_unref (pixbuf);
+                }
 
               g_object_unref (stream);
             }
@@ -460,9 +1423,21 @@ mx_texture_cache_get_item (MxTextureCache *self,
             err = g_error_new (mx_texture_cache_error_quark (), 0,
                                "Could not open %s", file);
 #else
-          item->ptr = cogl_texture_new_from_file (file, COGL_TEXTURE_NONE,
-                                                  COGL_PIXEL_FORMAT_ANY,
-                                                  &err);
+          if (priv->use_atlas)
+            {
+              GdkPixbuf *pixbuf = gdk_pixbuf_new_from_file (file, &err);
+
+              if (pixbuf)
+                {
+                  item->ptr = _mx_texture_cache_texture_from_pixbuf (self,
+                                                                     pixbuf);
+                  g_object_unref (pixbuf);
+                }
+            }
+          else
+            item->ptr = cogl_texture_new_from_file (file, COGL_TEXTURE_NONE,
+                                                    COGL_PIXEL_FORMAT_ANY,
+                                                    &err);
 #endif
         }
 
@@ -475,7 +1450,7 @@ mx_texture_cache_get_item (MxTextureCache *self,
             }
 
           if (created)
-            mx_texture_cache_item_free (item);
+            mx_texture_cache_item_unref (item);
 
           g_free (new_file);
           g_free (new_uri);
@@ -483,8 +1458,12 @@ mx_texture_cache_get_item (MxTextureCache *self,
           return NULL;
         }
 
+      priv->n_misses ++;
+
       if (created)
         add_texture_to_cache (self, uri, item);
+      else
+        mx_texture_cache_item_update (self, item);
     }
 
   g_free (new_file);
@@ -500,10 +1479,12 @@ mx_texture_cache_get_item (MxTextureCache *self,
  *
  * Create a #CoglHandle representing a texture of the specified image. Adds
  * the image to the cache if the image had not been previously loaded.
- * Subsequent calls with the same image URI/path will return the #CoglHandle of
- * the previously loaded image with an increased reference count.
+ * Subsequent calls with the same image URI/path will return a texture that
+ * shares the data of the previously loaded image. The image is not evicted
+ * from the cache while any of the textures returned for it are in use.
  *
- * Returns: (transfer none): a #CoglHandle to the cached texture
+ * Returns: (transfer full): a #CoglHandle to the cached texture, which
+ *   should be released with cogl_handle_unref()
  */
 CoglHandle
 mx_texture_cache_get_cogl_texture (MxTextureCache *self,
@@ -517,9 +1498,414 @@ mx_texture_cache_get_cogl_texture (MxTextureCache *self,
   item = mx_texture_cache_get_item (self, uri, TRUE);
 
   if (item)
-    return cogl_handle_ref (item->ptr);
+    {
+      CoglHandle texture = mx_texture_cache_item_share (item, item->ptr);
+
+      mx_texture_cache_trim (self);
+
+      return texture;
+    }
+  else
+    return NULL;
+}
+
+static void
+mx_texture_cache_load_free (MxTextureCacheLoad *load)
+{
+  if (load->pixbuf)
+    g_object_unref (load->pixbuf);
+  g_clear_error (&load->error);
+
+  g_object_unref (load->cache);
+  g_free (load->filename);
+  g_free (load->uri);
+
+  g_slice_free (MxTextureCacheLoad, load);
+}
+
+/* Returns %TRUE if any of the requests waiting for @load haven't been
+ * cancelled */
+static gboolean
+mx_texture_cache_load_is_wanted (MxTextureCacheLoad *load)
+{
+  gboolean wanted = FALSE;
+  GList *l;
+
+  G_LOCK (decoded_lock);
+  for (l = load->waiters; l; l = l->next)
+    {
+      MxTextureCacheWaiter *waiter = l->data;
+
+      if (!g_cancellable_is_cancelled (waiter->cancellable))
+        {
+          wanted = TRUE;
+          break;
+        }
+    }
+  G_UNLOCK (decoded_lock);
+
+  return wanted;
+}
+
+/* Uploads a decoded image, adds it to the cache and completes the
+ * requests waiting for it. Returns %FALSE if the load was handed back to
+ * the worker threads instead, in which case it must not be freed */
+static gboolean
+mx_texture_cache_complete_load (MxTextureCacheLoad *load)
+{
+  MxTextureCache *self = load->cache;
+  MxTextureCachePrivate *priv = TEXTURE_CACHE_PRIVATE (self);
+  MxTextureCacheItem *item;
+  GError *error = NULL;
+  GList *l;
+
+  if (load->skipped)
+    {
+      load->skipped = FALSE;
+
+      /* the image is decoded after all if it was requested again after
+       * the worker skipped it. Otherwise, or if there are no threads, it
+       * is loaded in the main thread below */
+      if (!mx_texture_cache_load_is_wanted (load))
+        g_set_error_literal (&load->error, G_IO_ERROR, G_IO_ERROR_CANCELLED,
+                             "Operation was cancelled");
+      else if (g_thread_pool_push (mx_texture_cache_threads, load, NULL))
+        return FALSE;
+    }
+
+  g_hash_table_remove (priv->loads, load->uri);
+
+  item = g_hash_table_lookup (priv->cache, load->uri);
+
+  if (item && item->ptr)
+    {
+      /* the image was loaded synchronously in the meantime */
+    }
+  else if (load->pixbuf)
+    {
+      gboolean created = FALSE;
+
+      if (!item)
+        {
+          item = mx_texture_cache_item_new ();
+          created = TRUE;
+        }
+
+      item->ptr = _mx_texture_cache_texture_from_pixbuf (self, load->pixbuf);
+
+      if (item->ptr)
+        {
+          priv->n_misses ++;
+
+          if (created)
+            add_texture_to_cache (self, load->uri, item);
+          else
+            mx_texture_cache_item_update (self, item);
+        }
+      else
+        {
+          if (created)
+            mx_texture_cache_item_unref (item);
+          item = NULL;
+
+          g_set_error (&error, G_IO_ERROR, G_IO_ERROR_FAILED,
+                       "Unable to create a texture for %s", load->uri);
+        }
+    }
+  else if (load->error)
+    {
+      item = NULL;
+      error = g_error_copy (load->error);
+    }
+  else
+    {
+      item = mx_texture_cache_get_item (self, load->uri, TRUE);
+
+      if (!item)
+        g_set_error (&error, G_IO_ERROR, G_IO_ERROR_FAILED,
+                     "Unable to load %s", load->uri);
+    }
+
+  for (l = load->waiters; l; l = l->next)
+    {
+      MxTextureCacheWaiter *waiter = l->data;
+
+      if (item)
+        g_simple_async_result_set_op_res_gpointer (waiter->result,
+                                                   mx_texture_cache_item_share (item, item->ptr),
+                                                   (GDestroyNotify) cogl_handle_unref);
+      else
+        g_simple_async_result_set_from_error (waiter->result, error);
+
+      /* this reports cancellation instead if the waiter was cancelled */
+      g_simple_async_result_complete (waiter->result);
+
+      g_object_unref (waiter->result);
+      if (waiter->cancellable)
+        g_object_unref (waiter->cancellable);
+      g_slice_free (MxTextureCacheWaiter, waiter);
+    }
+  g_list_free (load->waiters);
+  load->waiters = NULL;
+
+  g_clear_error (&error);
+
+  mx_texture_cache_trim (self);
+
+  return TRUE;
+}
+
+static gboolean
+mx_texture_cache_upload_cb (MxTextureCache *self)
+{
+  MxTextureCachePrivate *priv = TEXTURE_CACHE_PRIVATE (self);
+  gint64 start = g_get_monotonic_time ();
+  MxTextureCacheLoad *load;
+
+  while (TRUE)
+    {
+      G_LOCK (decoded_lock);
+
+      load = g_queue_pop_head (&priv->decoded);
+
+      if (!load)
+        {
+          priv->upload_id = 0;
+          G_UNLOCK (decoded_lock);
+          return FALSE;
+        }
+
+      G_UNLOCK (decoded_lock);
+
+      if (mx_texture_cache_complete_load (load))
+        mx_texture_cache_load_free (load);
+
+      /* carry on in the next main loop iteration once the budget has been
+       * used up, so that the next frame can be painted */
+      if (g_get_monotonic_time () - start >= MX_TEXTURE_CACHE_UPLOAD_BUDGET_USEC)
+        {
+          MX_NOTE (TEXTURE_CACHE, "Upload budget used up, %d images waiting",
+                   priv->decoded.length);
+          return TRUE;
+        }
+    }
+}
+
+/* Queues a load to be uploaded in the main thread. Called with
+ * decoded_lock held. */
+static void
+mx_texture_cache_queue_upload (MxTextureCacheLoad *load)
+{
+  MxTextureCachePrivate *priv = TEXTURE_CACHE_PRIVATE (load->cache);
+
+  g_queue_push_tail (&priv->decoded, load);
+
+  if (!priv->upload_id)
+    priv->upload_id =
+      clutter_threads_add_idle_full (G_PRIORITY_DEFAULT_IDLE,
+                                     (GSourceFunc) mx_texture_cache_upload_cb,
+                                     g_object_ref (load->cache),
+                                     g_object_unref);
+}
+
+static void
+mx_texture_cache_decode_cb (MxTextureCacheLoad *load,
+                            gpointer            user_data)
+{
+  /* don't decode the image if nobody is waiting for it any more. More
+   * requests may be made before the main thread sees this, so it decides
+   * whether the load has been cancelled, see
+   * mx_texture_cache_complete_load() */
+  if (!mx_texture_cache_load_is_wanted (load))
+    load->skipped = TRUE;
   else
+    {
+#if defined(__ANDROID__) || defined(ANDROID)
+      /* assets are loaded in the main thread */
+#else
+      if (load->filename)
+        load->pixbuf = gdk_pixbuf_new_from_file (load->filename,
+                                                 &load->error);
+      else
+        {
+          GInputStream *stream;
+
+          stream = g_resources_open_stream (&load->uri[11],
+                                            G_RESOURCE_LOOKUP_FLAGS_NONE,
+                                            &load->error);
+          if (stream)
+            {
+              load->pixbuf = gdk_pixbuf_new_from_stream (stream, NULL,
+                                                         &load->error);
+              g_object_unref (stream);
+            }
+        }
+#endif
+    }
+
+  G_LOCK (decoded_lock);
+  mx_texture_cache_queue_upload (load);
+  G_UNLOCK (decoded_lock);
+}
+
+/**
+ * mx_texture_cache_get_cogl_texture_async:
+ * @self: A #MxTextureCache
+ * @uri: A URI or path to an image file
+ * @cancellable: (allow-none): a #GCancellable or %NULL
+ * @callback: a #GAsyncReadyCallback to call when the texture is ready
+ * @user_data: the data to pass to @callback
+ *
+ * Asynchronously retrieves a texture representing the specified image, as
+ * mx_texture_cache_get_cogl_texture() does. If the image has not been
+ * loaded before, it is decoded in a worker thread and then uploaded in the
+ * main thread. When many images finish decoding at once, their uploads are
+ * spread over several main loop iterations. Concurrent requests for the
+ * same image only decode it once.
+ *
+ * @callback is called in the main thread, and should call
+ * mx_texture_cache_get_cogl_texture_finish() to retrieve the texture.
+ *
+ * Since: 2.0
+ */
+void
+mx_texture_cache_get_cogl_texture_async (MxTextureCache      *self,
+                                         const gchar         *uri,
+                                         GCancellable        *cancellable,
+                                         GAsyncReadyCallback  callback,
+                                         gpointer             user_data)
+{
+  MxTextureCachePrivate *priv;
+  MxTextureCacheWaiter *waiter;
+  MxTextureCacheLoad *load;
+  MxTextureCacheItem *item;
+  GSimpleAsyncResult *result;
+  gchar *new_uri = NULL, *file = NULL;
+
+  g_return_if_fail (MX_IS_TEXTURE_CACHE (self));
+  g_return_if_fail (uri != NULL);
+
+  priv = TEXTURE_CACHE_PRIVATE (self);
+
+  result = g_simple_async_result_new (G_OBJECT (self), callback, user_data,
+                                      mx_texture_cache_get_cogl_texture_async);
+  g_simple_async_result_set_check_cancellable (result, cancellable);
+
+  /* Make sure we have the URI, and the path if it is not a resource */
+  if (!g_str_has_prefix (uri, "resource://"))
+    {
+      if (g_regex_match (priv->is_uri, uri, 0, NULL))
+        file = mx_texture_cache_uri_to_filename (uri);
+      else
+        {
+          file = g_strdup (uri);
+          uri = new_uri = mx_texture_cache_filename_to_uri (file);
+        }
+
+      if (!file || !uri)
+        {
+          g_simple_async_result_set_error (result, G_IO_ERROR,
+                                           G_IO_ERROR_INVALID_FILENAME,
+                                           "Invalid image location %s",
+                                           uri ? uri : file);
+          g_simple_async_result_complete_in_idle (result);
+          g_object_unref (result);
+          g_free (file);
+          g_free (new_uri);
+          return;
+        }
+    }
+
+  item = g_hash_table_lookup (priv->cache, uri);
+
+  if (item && item->ptr)
+    {
+      priv->n_hits ++;
+
+      g_simple_async_result_set_op_res_gpointer (result,
+                                                 mx_texture_cache_item_share (item, item->ptr),
+                                                 (GDestroyNotify) cogl_handle_unref);
+      g_simple_async_result_complete_in_idle (result);
+      g_object_unref (result);
+      g_free (file);
+      g_free (new_uri);
+      return;
+    }
+
+  waiter = g_slice_new (MxTextureCacheWaiter);
+  waiter->result = result;
+  waiter->cancellable = cancellable ? g_object_ref (cancellable) : NULL;
+
+  /* wait for the image if it is already being loaded */
+  load = g_hash_table_lookup (priv->loads, uri);
+
+  if (load)
+    {
+      G_LOCK (decoded_lock);
+      load->waiters = g_list_prepend (load->waiters, waiter);
+      G_UNLOCK (decoded_lock);
+
+      g_free (file);
+      g_free (new_uri);
+      return;
+    }
+
+  load = g_slice_new0 (MxTextureCacheLoad);
+  load->cache = g_object_ref (self);
+  load->uri = new_uri ? new_uri : g_strdup (uri);
+  load->filename = file;
+  load->waiters = g_list_prepend (NULL, waiter);
+
+  g_hash_table_insert (priv->loads, load->uri, load);
+
+  if (!mx_texture_cache_threads)
+    mx_texture_cache_threads =
+      g_thread_pool_new ((GFunc) mx_texture_cache_decode_cb, NULL,
+                         sysconf (_SC_NPROCESSORS_ONLN),
+                         FALSE, NULL);
+
+  /* if there are no threads, the image is loaded in the main thread */
+  if (!mx_texture_cache_threads ||
+      !g_thread_pool_push (mx_texture_cache_threads, load, NULL))
+    {
+      G_LOCK (decoded_lock);
+      mx_texture_cache_queue_upload (load);
+      G_UNLOCK (decoded_lock);
+    }
+}
+
+/**
+ * mx_texture_cache_get_cogl_texture_finish:
+ * @self: A #MxTextureCache
+ * @result: the #GAsyncResult passed to the callback
+ * @error: return location for a #GError, or %NULL
+ *
+ * Finishes a request started with mx_texture_cache_get_cogl_texture_async().
+ *
+ * Returns: (transfer full): a #CoglHandle to the cached texture, or %NULL
+ *   if the image could not be loaded
+ *
+ * Since: 2.0
+ */
+CoglHandle
+mx_texture_cache_get_cogl_texture_finish (MxTextureCache  *self,
+                                          GAsyncResult    *result,
+                                          GError         **error)
+{
+  GSimpleAsyncResult *simple;
+
+  g_return_val_if_fail (MX_IS_TEXTURE_CACHE (self), NULL);
+  g_return_val_if_fail (g_simple_async_result_is_valid (result,
+                                                        G_OBJECT (self),
+                                                        mx_texture_cache_get_cogl_texture_async),
+                        NULL);
+
+  simple = G_SIMPLE_ASYNC_RESULT (result);
+
+  if (g_simple_async_result_propagate_error (simple, error))
     return NULL;
+
+  return cogl_handle_ref (g_simple_async_result_get_op_res_gpointer (simple));
 }
 
 /**
@@ -543,21 +1929,30 @@ mx_texture_cache_get_meta_cogl_texture (MxTextureCache *self,
                                         const gchar    *uri,
                                         gpointer        ident)
 {
+  MxTextureCachePrivate *priv;
   MxTextureCacheItem *item;
 
   g_return_val_if_fail (MX_IS_TEXTURE_CACHE (self), NULL);
   g_return_val_if_fail (uri != NULL, NULL);
 
-  item = mx_texture_cache_get_item (self, uri, TRUE);
+  priv = TEXTURE_CACHE_PRIVATE (self);
+
+  /* the meta texture does not depend on the image being loaded */
+  item = mx_texture_cache_get_item (self, uri, FALSE);
 
   if (item && item->meta)
     {
       MxTextureCacheMetaEntry *entry = g_hash_table_lookup (item->meta, ident);
 
-      if (entry->texture)
-        return cogl_handle_ref (entry->texture);
+      if (entry && entry->texture)
+        {
+          priv->n_hits ++;
+          return mx_texture_cache_item_share (item, entry->texture);
+        }
     }
 
+  priv->n_misses ++;
+
   return NULL;
 }
 
@@ -658,6 +2053,8 @@ mx_texture_cache_insert (MxTextureCache *self,
   add_texture_to_cache (self, uri, item);
 
   g_free (new_uri);
+
+  mx_texture_cache_trim (self);
 }
 
 static void
@@ -735,6 +2132,9 @@ mx_texture_cache_insert_meta (MxTextureCache *self,
   entry->destroy_func = destroy_func;
 
   g_hash_table_insert (item->meta, ident, entry);
+
+  mx_texture_cache_item_update (self, item);
+  mx_texture_cache_trim (self);
 }
 
 void
@@ -756,7 +2156,7 @@ mx_texture_cache_load_cache (MxTextureCache *self,
   if (!file)
     return;
 
-  ret = fread (&head, sizeof(MxTextureCacheItem), 1, file);
+  ret = fread (&head, MX_TEXTURE_CACHE_ITEM_FILE_SIZE, 1, file);
   if (ret < 0)
     {
       fclose (file);
@@ -785,12 +2185,13 @@ mx_texture_cache_load_cache (MxTextureCache *self,
       gchar *uri;
 
       element = mx_texture_cache_item_new ();
-      ret = fread (element, sizeof (MxTextureCacheItem), 1, file);
+      ret = fread (element, MX_TEXTURE_CACHE_ITEM_FILE_SIZE, 1, file);
 
       if (ret < 1)
         {
           /* end of file */
-          mx_texture_cache_item_free (element);
+          element->ptr = NULL;
+          mx_texture_cache_item_unref (element);
           break;
         }
 
@@ -798,14 +2199,16 @@ mx_texture_cache_load_cache (MxTextureCache *self,
       if (!uri)
         {
           /* Couldn't resolve path */
-          mx_texture_cache_item_free (element);
+          element->ptr = NULL;
+          mx_texture_cache_item_unref (element);
           continue;
         }
 
       if (g_hash_table_lookup (priv->cache, uri))
         {
           /* URI is already in the cache.... */
-          mx_texture_cache_item_free (element);
+          element->ptr = NULL;
+          mx_texture_cache_item_unref (element);
           g_free (uri);
         }
       else
@@ -815,9 +2218,15 @@ mx_texture_cache_load_cache (MxTextureCache *self,
                                                             element->posY,
                                                             element->width,
                                                             element->height);
-          g_hash_table_insert (priv->cache, uri, element);
+          add_texture_to_cache (self, uri, element);
+          g_free (uri);
         }
     }
 
   fclose (file);
+
+  /* the sub-textures keep the data of the full texture alive */
+  cogl_handle_unref (full_texture);
+
+  mx_texture_cache_trim (self);
 }
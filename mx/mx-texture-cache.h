@@ -29,6 +29,7 @@
 #define _MX_TEXTURE_CACHE
 
 #include <glib-object.h>
+#include <gio/gio.h>
 #include <clutter/clutter.h>
 
 G_BEGIN_DECLS
@@ -84,6 +85,15 @@ MxTextureCache* mx_texture_cache_get_default (void);
 CoglHandle      mx_texture_cache_get_cogl_texture (MxTextureCache *self,
                                                    const gchar    *uri);
 
+void            mx_texture_cache_get_cogl_texture_async  (MxTextureCache      *self,
+                                                          const gchar         *uri,
+                                                          GCancellable        *cancellable,
+                                                          GAsyncReadyCallback  callback,
+                                                          gpointer             user_data);
+CoglHandle      mx_texture_cache_get_cogl_texture_finish (MxTextureCache      *self,
+                                                          GAsyncResult        *result,
+                                                          GError             **error);
+
 CoglHandle      mx_texture_cache_get_meta_cogl_texture (MxTextureCache *self,
                                                         const gchar    *uri,
                                                         gpointer        ident);
@@ -109,6 +119,16 @@ void            mx_texture_cache_insert_meta (MxTextureCache *self,
 
 void mx_texture_cache_load_cache (MxTextureCache *self,
                                   const char     *filename);
+
+void            mx_texture_cache_set_use_atlas (MxTextureCache *self,
+                                                gboolean        use_atlas);
+gboolean        mx_texture_cache_get_use_atlas (MxTextureCache *self);
+
+void            mx_texture_cache_set_max_bytes (MxTextureCache *self,
+                                                guint64         max_bytes);
+guint64         mx_texture_cache_get_max_bytes (MxTextureCache *self);
+guint64         mx_texture_cache_get_bytes     (MxTextureCache *self);
+
 G_END_DECLS
 
 #endif /* _MX_TEXTURE_CACHE */
@@ -0,0 +1,137 @@
+/*
+ * Copyright 2012 Intel Corporation.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU Lesser General Public License,
+ * version 2.1, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+ * Boston, MA 02111-1307, USA.
+ *
+ */
+
+/*
+ * Shows a vertical box layout of many children in a scroll view, scrolls
+ * it a little further every frame and reports the time between frames,
+ * which is dominated by painting the box once it has been allocated.
+ * Sync to the vertical blank is turned off unless CLUTTER_VBLANK is set.
+ *
+ * Usage: test-box-layout-bench [n-children]
+ */
+
+#include <mx/mx.h>
+#include <stdlib.h>
+
+#define N_FRAMES 300
+
+static ClutterActor *box = NULL;
+
+static gint64 last_frame_time = 0;
+static gdouble frame_times[N_FRAMES];
+static guint n_frames = 0;
+
+static gint
+compare_doubles (gconstpointer a,
+                 gconstpointer b)
+{
+  gdouble da = *(const gdouble *) a, db = *(const gdouble *) b;
+
+  return (da > db) - (da < db);
+}
+
+static gboolean
+frame_cb (gpointer user_data)
+{
+  gint64 now = g_get_monotonic_time ();
+  MxAdjustment *vadjustment;
+  gdouble value, upper, page_size, total = 0;
+  guint i;
+
+  if (last_frame_time)
+    frame_times[n_frames++] = (now - last_frame_time) / 1000.0;
+  last_frame_time = now;
+
+  if (n_frames == N_FRAMES)
+    {
+      for (i = 0; i < n_frames; i++)
+        total += frame_times[i];
+
+      qsort (frame_times, n_frames, sizeof (gdouble), compare_doubles);
+
+      g_print ("%d children, %u frames while scrolling: mean %.2fms, "
+               "median %.2fms, 95th percentile %.2fms, worst %.2fms\n",
+               clutter_actor_get_n_children (box), n_frames,
+               total / n_frames, frame_times[n_frames / 2],
+               frame_times[n_frames * 95 / 100], frame_times[n_frames - 1]);
+
+      clutter_main_quit ();
+      return FALSE;
+    }
+
+  /* scrolling doesn't change the allocation, so only painting and the
+   * scroll view are left */
+  mx_scrollable_get_adjustments (MX_SCROLLABLE (box), NULL, &vadjustment);
+  mx_adjustment_get_values (vadjustment, &value, NULL, &upper, NULL, NULL,
+                            &page_size);
+  value += page_size / 3;
+  if (value > upper - page_size)
+    value = 0;
+  mx_adjustment_set_value (vadjustment, value);
+
+  return TRUE;
+}
+
+int
+main (int argc, char **argv)
+{
+  ClutterActor *stage, *scroll;
+  gint n_children = 10000;
+  gint i;
+
+  /* the time between frames would otherwise be rounded up to the refresh
+   * interval, hiding the difference the paint path makes */
+  g_setenv ("CLUTTER_VBLANK", "none", FALSE);
+
+  if (clutter_init (&argc, &argv) != CLUTTER_INIT_SUCCESS)
+    return 1;
+
+  if (argc > 1)
+    n_children = atoi (argv[1]);
+
+  stage = clutter_stage_new ();
+  clutter_actor_set_size (stage, 480, 640);
+  g_signal_connect (stage, "destroy", G_CALLBACK (clutter_main_quit), NULL);
+
+  scroll = mx_scroll_view_new ();
+  clutter_actor_set_size (scroll, 480, 640);
+  clutter_actor_add_child (stage, scroll);
+
+  box = mx_box_layout_new_with_orientation (MX_ORIENTATION_VERTICAL);
+  clutter_actor_add_child (scroll, box);
+
+  for (i = 0; i < n_children; i++)
+    {
+      ClutterActor *child = clutter_actor_new ();
+      ClutterColor color = { i * 7, i * 13, i * 29, 0xff };
+
+      clutter_actor_set_background_color (child, &color);
+      clutter_actor_set_size (child, 400, 16 + i % 16);
+      clutter_actor_add_child (box, child);
+    }
+
+  clutter_actor_show (stage);
+
+  clutter_threads_add_repaint_func_full (CLUTTER_REPAINT_FLAGS_POST_PAINT,
+                                         frame_cb, NULL, NULL);
+
+  clutter_main ();
+
+  return 0;
+}
@@ -0,0 +1,140 @@
+/*
+ * Copyright 2012 Intel Corporation.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU Lesser General Public License,
+ * version 2.1, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+ * Boston, MA 02111-1307, USA.
+ *
+ */
+
+/*
+ * Shows a vertical box layout of many children in a scroll view, toggles
+ * the height of one child every frame and reports how long the relayout
+ * that follows took. The relayout is forced by asking for the allocation
+ * of the box, so painting is not included.
+ *
+ * Usage: test-box-relayout-bench [n-children] [child-index]
+ */
+
+#include <mx/mx.h>
+#include <stdlib.h>
+
+#define N_FRAMES 300
+
+static ClutterActor *box = NULL;
+static ClutterActor *toggled = NULL;
+
+static gdouble relayout_times[N_FRAMES];
+static guint n_frames = 0;
+
+static gint
+compare_doubles (gconstpointer a,
+                 gconstpointer b)
+{
+  gdouble da = *(const gdouble *) a, db = *(const gdouble *) b;
+
+  return (da > db) - (da < db);
+}
+
+static gboolean
+frame_cb (gpointer user_data)
+{
+  ClutterActorBox allocation;
+  gdouble total = 0;
+  gint64 start;
+  guint i;
+
+  if (n_frames == N_FRAMES)
+    {
+      for (i = 0; i < n_frames; i++)
+        total += relayout_times[i];
+
+      qsort (relayout_times, n_frames, sizeof (gdouble), compare_doubles);
+
+      g_print ("%d children, %u relayouts after resizing one child: "
+               "mean %.3fms, median %.3fms, 95th percentile %.3fms, "
+               "worst %.3fms\n",
+               clutter_actor_get_n_children (box), n_frames,
+               total / n_frames, relayout_times[n_frames / 2],
+               relayout_times[n_frames * 95 / 100],
+               relayout_times[n_frames - 1]);
+
+      clutter_main_quit ();
+      return FALSE;
+    }
+
+  clutter_actor_set_height (toggled, (n_frames % 2) ? 16 : 48);
+
+  /* the box needs an allocation, so this lays out the stage */
+  start = g_get_monotonic_time ();
+  clutter_actor_get_allocation_box (box, &allocation);
+  relayout_times[n_frames++] = (g_get_monotonic_time () - start) / 1000.0;
+
+  clutter_actor_queue_redraw (box);
+
+  return TRUE;
+}
+
+int
+main (int argc, char **argv)
+{
+  ClutterActor *stage, *scroll;
+  gint n_children = 1000, child_index = -1;
+  gint i;
+
+  if (clutter_init (&argc, &argv) != CLUTTER_INIT_SUCCESS)
+    return 1;
+
+  if (argc > 1)
+    n_children = MAX (1, atoi (argv[1]));
+  if (argc > 2)
+    child_index = atoi (argv[2]);
+
+  /* by default, resize the child in the middle, so that half of the
+   * children move and half don't */
+  if (child_index < 0 || child_index >= n_children)
+    child_index = n_children / 2;
+
+  stage = clutter_stage_new ();
+  clutter_actor_set_size (stage, 480, 640);
+  g_signal_connect (stage, "destroy", G_CALLBACK (clutter_main_quit), NULL);
+
+  scroll = mx_scroll_view_new ();
+  clutter_actor_set_size (scroll, 480, 640);
+  clutter_actor_add_child (stage, scroll);
+
+  box = mx_box_layout_new_with_orientation (MX_ORIENTATION_VERTICAL);
+  clutter_actor_add_child (scroll, box);
+
+  for (i = 0; i < n_children; i++)
+    {
+      ClutterActor *child = clutter_actor_new ();
+      ClutterColor color = { i * 7, i * 13, i * 29, 0xff };
+
+      clutter_actor_set_background_color (child, &color);
+      clutter_actor_set_size (child, 400, 16 + i % 16);
+      clutter_actor_add_child (box, child);
+
+      if (i == child_index)
+        toggled = child;
+    }
+
+  clutter_actor_show (stage);
+
+  clutter_threads_add_repaint_func_full (CLUTTER_REPAINT_FLAGS_POST_PAINT,
+                                         frame_cb, NULL, NULL);
+
+  clutter_main ();
+
+  return 0;
+}
@@ -0,0 +1,114 @@
+/*
+ * Copyright 2012 Intel Corporation.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU Lesser General Public License,
+ * version 2.1, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+ * Boston, MA 02111-1307, USA.
+ *
+ */
+
+/*
+ * Allocates grids of 100, 1,000 and 10,000 children of varying sizes, as
+ * a scroll view would, and reports how long an allocation took after a
+ * child had changed size, and after only the width of the grid had
+ * changed.
+ *
+ * Usage: test-grid-bench [n-iterations]
+ */
+
+#include <mx/mx.h>
+#include <stdlib.h>
+
+static const gint n_children[] = { 100, 1000, 10000 };
+
+static void
+allocate_grid (ClutterActor *grid,
+               gfloat        width)
+{
+  ClutterActorBox box;
+  gfloat height;
+
+  /* an allocation in a scroll view asks for the height first */
+  clutter_actor_get_preferred_height (grid, width, NULL, &height);
+
+  box.x1 = 0;
+  box.y1 = 0;
+  box.x2 = width;
+  box.y2 = height;
+  clutter_actor_allocate (grid, &box, CLUTTER_ALLOCATION_NONE);
+}
+
+static void
+bench_grid (gint n,
+            gint n_iterations)
+{
+  ClutterActor *grid, *child = NULL;
+  gdouble changed = 0, resized = 0;
+  GTimer *timer;
+  gint i;
+
+  grid = mx_grid_new ();
+  g_object_ref_sink (grid);
+  mx_grid_set_column_spacing (MX_GRID (grid), 4);
+  mx_grid_set_row_spacing (MX_GRID (grid), 4);
+
+  for (i = 0; i < n; i++)
+    {
+      child = clutter_actor_new ();
+      clutter_actor_set_size (child, 48 + (i * 7) % 32, 48 + (i * 13) % 24);
+      clutter_actor_add_child (grid, child);
+    }
+
+  timer = g_timer_new ();
+
+  for (i = 0; i < n_iterations; i++)
+    {
+      /* a child changing size makes everything be measured again */
+      clutter_actor_set_width (child, 48 + i % 32);
+
+      g_timer_start (timer);
+      allocate_grid (grid, 800);
+      changed += g_timer_elapsed (timer, NULL);
+
+      /* the children haven't changed, so they don't need measuring */
+      g_timer_start (timer);
+      allocate_grid (grid, 640);
+      resized += g_timer_elapsed (timer, NULL);
+    }
+
+  g_print ("%6d children: %8.3fms per allocation after a child changed, "
+           "%8.3fms after the width changed\n", n,
+           changed * 1000 / n_iterations, resized * 1000 / n_iterations);
+
+  g_timer_destroy (timer);
+  clutter_actor_destroy (grid);
+  g_object_unref (grid);
+}
+
+int
+main (int argc, char **argv)
+{
+  gint n_iterations = 20;
+  gint i;
+
+  if (clutter_init (&argc, &argv) != CLUTTER_INIT_SUCCESS)
+    return 1;
+
+  if (argc > 1)
+    n_iterations = MAX (1, atoi (argv[1]));
+
+  for (i = 0; i < G_N_ELEMENTS (n_children); i++)
+    bench_grid (n_children[i], n_iterations);
+
+  return 0;
+}
@@ -0,0 +1,242 @@
+/*
+ * Copyright 2012 Intel Corporation.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU Lesser General Public License,
+ * version 2.1, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+ * Boston, MA 02111-1307, USA.
+ *
+ */
+
+/*
+ * Shows a grid of icons from an icon theme written to a temporary
+ * directory, and reports how long it took until the first frame was
+ * painted and until every icon had been loaded.
+ *
+ * Usage: test-icon-grid-bench [n-icons] [icon-size]
+ */
+
+#include <mx/mx.h>
+#include <stdlib.h>
+#include <glib/gstdio.h>
+#include <gdk-pixbuf/gdk-pixbuf.h>
+
+static gchar **filenames = NULL;
+static gint n_icons = 200;
+
+static gint64 start_time = 0;
+static gint64 first_frame_time = 0;
+static guint n_frames = 0;
+
+static gchar *
+create_theme (const gchar *dir,
+              gint         size)
+{
+  GdkPixbuf *pixbuf;
+  gchar *theme_dir, *icon_dir, *path, *index;
+  guchar *pixels;
+  gint i, x, y, rowstride;
+
+  theme_dir = g_build_filename (dir, "bench", NULL);
+  icon_dir = g_strdup_printf ("%s/%dx%d/apps", theme_dir, size, size);
+  g_mkdir_with_parents (icon_dir, 0755);
+
+  index = g_strdup_printf ("[Icon Theme]\nName=Bench\n"
+                           "Directories=%dx%d/apps\n\n"
+                           "[%dx%d/apps]\nSize=%d\nType=Fixed\n",
+                           size, size, size, size, size);
+  path = g_build_filename (theme_dir, "index.theme", NULL);
+  g_file_set_contents (path, index, -1, NULL);
+  g_free (index);
+  g_free (path);
+
+  pixbuf = gdk_pixbuf_new (GDK_COLORSPACE_RGB, TRUE, 8, size, size);
+  pixels = gdk_pixbuf_get_pixels (pixbuf);
+  rowstride = gdk_pixbuf_get_rowstride (pixbuf);
+
+  filenames = g_new0 (gchar *, n_icons + 1);
+
+  for (i = 0; i < n_icons; i++)
+    {
+      GError *error = NULL;
+      gchar *name;
+
+      for (y = 0; y < size; y++)
+        for (x = 0; x < size; x++)
+          {
+            guchar *pixel = pixels + y * rowstride + x * 4;
+
+            pixel[0] = x + i;
+            pixel[1] = y * i;
+            pixel[2] = (x ^ y) + i;
+            pixel[3] = 0xff;
+          }
+
+      name = g_strdup_printf ("bench-icon-%d.png", i);
+      filenames[i] = g_build_filename (icon_dir, name, NULL);
+      g_free (name);
+
+      if (!gdk_pixbuf_save (pixbuf, filenames[i], "png", &error, NULL))
+        {
+          g_warning ("Unable to save %s: %s", filenames[i], error->message);
+          g_clear_error (&error);
+        }
+    }
+
+  g_object_unref (pixbuf);
+  g_free (icon_dir);
+
+  return theme_dir;
+}
+
+static gboolean
+frame_cb (gpointer user_data)
+{
+  MxTextureCache *cache = mx_texture_cache_get_default ();
+  gint64 now = g_get_monotonic_time ();
+  gint i;
+
+  if (!start_time)
+    return TRUE;
+
+  n_frames ++;
+
+  if (!first_frame_time)
+    first_frame_time = now;
+
+  /* the icons take their textures as soon as they are in the cache, so the
+   * frame after the last one arrived is the first one with every icon */
+  for (i = 0; i < n_icons; i++)
+    if (!mx_texture_cache_contains (cache, filenames[i]))
+      return TRUE;
+
+  g_print ("%d icons: first frame after %.2fms, all icons loaded after "
+           "%.2fms (%u frames)\n", n_icons,
+           (first_frame_time - start_time) / 1000.0,
+           (now - start_time) / 1000.0, n_frames);
+
+  clutter_main_quit ();
+
+  return FALSE;
+}
+
+static void
+remove_dir (const gchar *path)
+{
+  const gchar *name;
+  GDir *dir;
+
+  dir = g_dir_open (path, 0, NULL);
+
+  if (dir)
+    {
+      while ((name = g_dir_read_name (dir)))
+        {
+          gchar *child = g_build_filename (path, name, NULL);
+
+          if (g_file_test (child, G_FILE_TEST_IS_DIR))
+            remove_dir (child);
+          else
+            g_unlink (child);
+
+          g_free (child);
+        }
+
+      g_dir_close (dir);
+    }
+
+  g_rmdir (path);
+}
+
+int
+main (int argc, char **argv)
+{
+  ClutterActor *stage, *scroll, *grid;
+  MxIconTheme *theme;
+  gint icon_size = 48;
+  GError *error = NULL;
+  gchar *dir, *cache_dir, *theme_dir;
+  GList *paths;
+  gint i;
+
+  /* keep the icon lookup cache out of the user's cache directory */
+  dir = g_dir_make_tmp ("mx-icon-grid-bench-XXXXXX", &error);
+  if (!dir)
+    {
+      g_warning ("Unable to create a temporary directory: %s",
+                 error->message);
+      g_error_free (error);
+      return 1;
+    }
+
+  cache_dir = g_build_filename (dir, "cache", NULL);
+  g_setenv ("XDG_CACHE_HOME", cache_dir, TRUE);
+
+  if (clutter_init (&argc, &argv) != CLUTTER_INIT_SUCCESS)
+    return 1;
+
+  if (argc > 1)
+    n_icons = atoi (argv[1]);
+  if (argc > 2)
+    icon_size = atoi (argv[2]);
+
+  theme_dir = create_theme (dir, icon_size);
+
+  theme = mx_icon_theme_get_default ();
+  paths = g_list_prepend (NULL, dir);
+  mx_icon_theme_set_search_paths (theme, paths);
+  mx_icon_theme_set_theme_name (theme, "bench");
+  g_list_free (paths);
+
+  stage = clutter_stage_new ();
+  clutter_actor_set_size (stage, 640, 480);
+  g_signal_connect (stage, "destroy", G_CALLBACK (clutter_main_quit), NULL);
+
+  scroll = mx_scroll_view_new ();
+  clutter_actor_set_size (scroll, 640, 480);
+  clutter_actor_add_child (stage, scroll);
+
+  grid = mx_grid_new ();
+  clutter_actor_add_child (scroll, grid);
+
+  clutter_actor_show (stage);
+
+  clutter_threads_add_repaint_func_full (CLUTTER_REPAINT_FLAGS_POST_PAINT,
+                                         frame_cb, NULL, NULL);
+
+  /* the icons are created in one go, as an application showing a list of
+   * applications would */
+  start_time = g_get_monotonic_time ();
+
+  for (i = 0; i < n_icons; i++)
+    {
+      ClutterActor *icon = mx_icon_new ();
+      gchar *name = g_strdup_printf ("bench-icon-%d", i);
+
+      mx_icon_set_icon_size (MX_ICON (icon), icon_size);
+      mx_icon_set_icon_name (MX_ICON (icon), name);
+      clutter_actor_add_child (grid, icon);
+
+      g_free (name);
+    }
+
+  clutter_main ();
+
+  remove_dir (dir);
+
+  g_strfreev (filenames);
+  g_free (theme_dir);
+  g_free (cache_dir);
+  g_free (dir);
+
+  return 0;
+}
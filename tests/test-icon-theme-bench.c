@@ -0,0 +1,232 @@
+/*
+ * Copyright 2012 Intel Corporation.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU Lesser General Public License,
+ * version 2.1, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+ * Boston, MA 02111-1307, USA.
+ *
+ */
+
+/*
+ * Writes an icon theme with a similar layout to the large desktop themes
+ * to a temporary directory and resolves a number of icon names with it,
+ * reporting how many names per second were resolved:
+ *
+ *  - with a new icon theme, when nothing has been looked up (a cold start)
+ *  - with another new icon theme, which reads the lookup cache written by
+ *    the first one, as a new process would (a warm start)
+ *  - with a copy of the theme that has an icon-theme.cache file, if
+ *    gtk-update-icon-cache is available
+ *
+ * One in ten of the names is not in the theme, so that the fallbacks of
+ * those names are looked up as well. The lookup cache is kept in the
+ * temporary directory, so the user's cache is not touched.
+ *
+ * Usage: test-icon-theme-bench [n-names]
+ */
+
+#include <mx/mx.h>
+#include <stdlib.h>
+#include <glib/gstdio.h>
+
+static const gint sizes[] = { 16, 22, 24, 32, 48, 64, 96, 128, 256 };
+static const gchar *contexts[] = { "actions", "apps", "devices",
+                                   "mimetypes", "places", "status" };
+
+static void
+create_theme (const gchar *dir,
+              const gchar *name,
+              gint         n_names)
+{
+  GString *index;
+  gchar *theme_dir, *path;
+  gint i, j;
+
+  theme_dir = g_build_filename (dir, name, NULL);
+  index = g_string_new ("[Icon Theme]\nName=Bench\nDirectories=");
+
+  for (i = 0; i < G_N_ELEMENTS (sizes); i++)
+    for (j = 0; j < G_N_ELEMENTS (contexts); j++)
+      g_string_append_printf (index, "%s%dx%d/%s",
+                              (i || j) ? "," : "",
+                              sizes[i], sizes[i], contexts[j]);
+  g_string_append (index, "\n");
+
+  for (i = 0; i < G_N_ELEMENTS (sizes); i++)
+    for (j = 0; j < G_N_ELEMENTS (contexts); j++)
+      {
+        g_string_append_printf (index,
+                                "\n[%dx%d/%s]\nSize=%d\nType=Fixed\n",
+                                sizes[i], sizes[i], contexts[j], sizes[i]);
+
+        path = g_strdup_printf ("%s/%dx%d/%s", theme_dir,
+                                sizes[i], sizes[i], contexts[j]);
+        g_mkdir_with_parents (path, 0755);
+        g_free (path);
+      }
+
+  path = g_build_filename (theme_dir, "index.theme", NULL);
+  g_file_set_contents (path, index->str, -1, NULL);
+  g_free (path);
+
+  /* each icon is in every size of one context. The files aren't loaded, so
+   * they don't need to be valid images */
+  for (i = 0; i < n_names; i++)
+    {
+      if (i % 10 == 9)
+        continue;
+
+      for (j = 0; j < G_N_ELEMENTS (sizes); j++)
+        {
+          path = g_strdup_printf ("%s/%dx%d/%s/bench-icon-%d.png", theme_dir,
+                                  sizes[j], sizes[j],
+                                  contexts[i % G_N_ELEMENTS (contexts)], i);
+          g_file_set_contents (path, "", 0, NULL);
+          g_free (path);
+        }
+    }
+
+  g_string_free (index, TRUE);
+  g_free (theme_dir);
+}
+
+static void
+resolve_names (const gchar *dir,
+               const gchar *theme_name,
+               gint         n_names,
+               const gchar *description)
+{
+  MxIconTheme *theme;
+  GList *paths;
+  GTimer *timer;
+  gdouble elapsed;
+  gint i, found = 0;
+
+  theme = mx_icon_theme_new ();
+  paths = g_list_prepend (NULL, (gpointer) dir);
+  mx_icon_theme_set_search_paths (theme, paths);
+  mx_icon_theme_set_theme_name (theme, theme_name);
+  g_list_free (paths);
+
+  timer = g_timer_new ();
+
+  for (i = 0; i < n_names; i++)
+    {
+      gchar *name = g_strdup_printf ("bench-icon-%d", i);
+
+      if (mx_icon_theme_has_icon (theme, name))
+        found ++;
+
+      g_free (name);
+    }
+
+  elapsed = g_timer_elapsed (timer, NULL);
+  g_timer_destroy (timer);
+
+  g_print ("%-24s %6d names (%d found) in %8.3fs: %10.1f names/sec\n",
+           description, n_names, found, elapsed,
+           (elapsed > 0) ? n_names / elapsed : 0);
+
+  g_object_unref (theme);
+}
+
+static void
+remove_dir (const gchar *path)
+{
+  const gchar *name;
+  GDir *dir;
+
+  dir = g_dir_open (path, 0, NULL);
+
+  if (dir)
+    {
+      while ((name = g_dir_read_name (dir)))
+        {
+          gchar *child = g_build_filename (path, name, NULL);
+
+          if (g_file_test (child, G_FILE_TEST_IS_DIR))
+            remove_dir (child);
+          else
+            g_unlink (child);
+
+          g_free (child);
+        }
+
+      g_dir_close (dir);
+    }
+
+  g_rmdir (path);
+}
+
+int
+main (int argc, char **argv)
+{
+  gint n_names = 500;
+  GError *error = NULL;
+  gchar *dir, *cache_dir, *program;
+
+  /* keep the lookup cache out of the user's cache directory. This has to
+   * be set before anything asks glib for the cache directory */
+  dir = g_dir_make_tmp ("mx-icon-theme-bench-XXXXXX", &error);
+  if (!dir)
+    {
+      g_warning ("Unable to create a temporary directory: %s",
+                 error->message);
+      g_error_free (error);
+      return 1;
+    }
+
+  cache_dir = g_build_filename (dir, "cache", NULL);
+  g_setenv ("XDG_CACHE_HOME", cache_dir, TRUE);
+
+  if (clutter_init (&argc, &argv) != CLUTTER_INIT_SUCCESS)
+    return 1;
+
+  if (argc > 1)
+    n_names = atoi (argv[1]);
+
+  create_theme (dir, "bench", n_names);
+
+  resolve_names (dir, "bench", n_names, "cold");
+  resolve_names (dir, "bench", n_names, "warm");
+
+  program = g_find_program_in_path ("gtk-update-icon-cache");
+  if (program)
+    {
+      gchar *theme_dir, *args[5];
+
+      create_theme (dir, "bench-cached", n_names);
+
+      theme_dir = g_build_filename (dir, "bench-cached", NULL);
+      args[0] = program;
+      args[1] = "--force";
+      args[2] = "--quiet";
+      args[3] = theme_dir;
+      args[4] = NULL;
+
+      if (g_spawn_sync (NULL, args, NULL, G_SPAWN_STDERR_TO_DEV_NULL,
+                        NULL, NULL, NULL, NULL, NULL, NULL))
+        resolve_names (dir, "bench-cached", n_names, "icon-theme.cache, cold");
+
+      g_free (theme_dir);
+      g_free (program);
+    }
+  else
+    g_print ("gtk-update-icon-cache not found, not testing icon-theme.cache\n");
+
+  remove_dir (dir);
+  g_free (cache_dir);
+  g_free (dir);
+
+  return 0;
+}
@@ -0,0 +1,207 @@
+/*
+ * Copyright 2012 Intel Corporation.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU Lesser General Public License,
+ * version 2.1, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+ * Boston, MA 02111-1307, USA.
+ *
+ */
+
+/*
+ * Writes a number of large JPEG images to a temporary directory and loads
+ * them as thumbnails with mx_image_set_from_file_at_size(), reporting how
+ * many thumbnails per second were loaded:
+ *
+ *  - without the disk cache, which decodes and scales every image
+ *  - with an empty disk cache (a cold start), which also stores them
+ *  - with the disk cache populated by the previous pass (a warm start)
+ *
+ * The disk cache is kept in the temporary directory, so the user's cache
+ * is not touched.
+ *
+ * Usage: test-image-cache-bench [n-images] [image-size] [thumbnail-size]
+ */
+
+#include <mx/mx.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glib/gstdio.h>
+#include <gdk-pixbuf/gdk-pixbuf.h>
+
+static gchar **
+create_images (const gchar *dir,
+               gint         n_images,
+               gint         size)
+{
+  GdkPixbuf *pixbuf;
+  gchar **filenames;
+  guchar *pixels;
+  gint i, x, y, rowstride;
+
+  pixbuf = gdk_pixbuf_new (GDK_COLORSPACE_RGB, FALSE, 8, size, size * 3 / 4);
+  pixels = gdk_pixbuf_get_pixels (pixbuf);
+  rowstride = gdk_pixbuf_get_rowstride (pixbuf);
+
+  filenames = g_new0 (gchar *, n_images + 1);
+
+  for (i = 0; i < n_images; i++)
+    {
+      GError *error = NULL;
+      gchar *name;
+
+      /* a different gradient for each image */
+      for (y = 0; y < gdk_pixbuf_get_height (pixbuf); y++)
+        for (x = 0; x < gdk_pixbuf_get_width (pixbuf); x++)
+          {
+            guchar *pixel = pixels + y * rowstride + x * 3;
+
+            pixel[0] = x + i;
+            pixel[1] = y * i;
+            pixel[2] = (x ^ y) + i;
+          }
+
+      name = g_strdup_printf ("image-%d.jpg", i);
+      filenames[i] = g_build_filename (dir, name, NULL);
+      g_free (name);
+
+      if (!gdk_pixbuf_save (pixbuf, filenames[i], "jpeg", &error,
+                            "quality", "90", NULL))
+        {
+          g_warning ("Unable to save %s: %s", filenames[i], error->message);
+          g_clear_error (&error);
+        }
+    }
+
+  g_object_unref (pixbuf);
+
+  return filenames;
+}
+
+static void
+load_images (ClutterActor  *image,
+             gchar        **filenames,
+             gint           thumbnail_size,
+             gboolean       use_disk_cache,
+             const gchar   *description)
+{
+  GTimer *timer;
+  gdouble elapsed;
+  gint i;
+
+  mx_image_set_use_disk_cache (MX_IMAGE (image), use_disk_cache);
+
+  timer = g_timer_new ();
+
+  for (i = 0; filenames[i]; i++)
+    {
+      GError *error = NULL;
+
+      if (!mx_image_set_from_file_at_size (MX_IMAGE (image), filenames[i],
+                                           thumbnail_size, thumbnail_size,
+                                           &error))
+        {
+          g_warning ("Unable to load %s: %s", filenames[i], error->message);
+          g_clear_error (&error);
+        }
+    }
+
+  elapsed = g_timer_elapsed (timer, NULL);
+  g_timer_destroy (timer);
+
+  g_print ("%-24s %6d images in %8.3fs: %10.1f images/sec\n",
+           description, i, elapsed, (elapsed > 0) ? i / elapsed : 0);
+}
+
+static void
+remove_dir (const gchar *path)
+{
+  const gchar *name;
+  GDir *dir;
+
+  dir = g_dir_open (path, 0, NULL);
+
+  if (dir)
+    {
+      while ((name = g_dir_read_name (dir)))
+        {
+          gchar *child = g_build_filename (path, name, NULL);
+
+          if (g_file_test (child, G_FILE_TEST_IS_DIR))
+            remove_dir (child);
+          else
+            g_unlink (child);
+
+          g_free (child);
+        }
+
+      g_dir_close (dir);
+    }
+
+  g_rmdir (path);
+}
+
+int
+main (int argc, char **argv)
+{
+  ClutterActor *image;
+  gchar *dir, *cache_dir, **filenames;
+  gint n_images = 200;
+  gint image_size = 1600;
+  gint thumbnail_size = 128;
+  GError *error = NULL;
+
+  /* keep the disk cache out of the user's cache directory. This has to be
+   * set before anything asks glib for the cache directory */
+  dir = g_dir_make_tmp ("mx-image-cache-bench-XXXXXX", &error);
+  if (!dir)
+    {
+      g_warning ("Unable to create a temporary directory: %s",
+                 error->message);
+      g_error_free (error);
+      return 1;
+    }
+
+  cache_dir = g_build_filename (dir, "cache", NULL);
+  g_setenv ("XDG_CACHE_HOME", cache_dir, TRUE);
+
+  if (clutter_init (&argc, &argv) != CLUTTER_INIT_SUCCESS)
+    return 1;
+
+  if (argc > 1)
+    n_images = atoi (argv[1]);
+  if (argc > 2)
+    image_size = atoi (argv[2]);
+  if (argc > 3)
+    thumbnail_size = atoi (argv[3]);
+
+  filenames = create_images (dir, n_images, image_size);
+
+  image = mx_image_new ();
+  g_object_ref_sink (image);
+  mx_image_set_transition_duration (MX_IMAGE (image), 0);
+
+  load_images (image, filenames, thumbnail_size, FALSE, "no disk cache");
+  load_images (image, filenames, thumbnail_size, TRUE, "disk cache, cold");
+  load_images (image, filenames, thumbnail_size, TRUE, "disk cache, warm");
+
+  clutter_actor_destroy (image);
+  g_object_unref (image);
+
+  remove_dir (dir);
+
+  g_strfreev (filenames);
+  g_free (cache_dir);
+  g_free (dir);
+
+  return 0;
+}
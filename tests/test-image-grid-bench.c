@@ -0,0 +1,274 @@
+/*
+ * Copyright 2012 Intel Corporation.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU Lesser General Public License,
+ * version 2.1, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+ * Boston, MA 02111-1307, USA.
+ *
+ */
+
+/*
+ * Loads a grid of images asynchronously while the stage is being redrawn
+ * continuously, and reports how long frames took while the images were
+ * loading. The images are written to a temporary directory first, and
+ * the stage is not synced to the vertical blank unless CLUTTER_VBLANK is
+ * set.
+ *
+ * Usage: test-image-grid-bench [n-images] [image-size] [tile-size]
+ */
+
+#include <mx/mx.h>
+#include <stdlib.h>
+#include <glib/gstdio.h>
+#include <gdk-pixbuf/gdk-pixbuf.h>
+
+static gchar **filenames = NULL;
+static gint n_images = 100;
+static gint n_finished = 0;
+static gint tile_size = 64;
+
+static gint64 start_time = 0;
+static gint64 last_frame_time = 0;
+static GArray *frame_times = NULL;
+
+static gchar **
+create_images (const gchar *dir,
+               gint         size)
+{
+  GdkPixbuf *pixbuf;
+  gchar **files;
+  guchar *pixels;
+  gint i, x, y, rowstride;
+
+  pixbuf = gdk_pixbuf_new (GDK_COLORSPACE_RGB, TRUE, 8, size, size * 3 / 4);
+  pixels = gdk_pixbuf_get_pixels (pixbuf);
+  rowstride = gdk_pixbuf_get_rowstride (pixbuf);
+
+  files = g_new0 (gchar *, n_images + 1);
+
+  for (i = 0; i < n_images; i++)
+    {
+      GError *error = NULL;
+      gchar *name;
+
+      for (y = 0; y < gdk_pixbuf_get_height (pixbuf); y++)
+        for (x = 0; x < gdk_pixbuf_get_width (pixbuf); x++)
+          {
+            guchar *pixel = pixels + y * rowstride + x * 4;
+
+            pixel[0] = x + i;
+            pixel[1] = y * i;
+            pixel[2] = (x ^ y) + i;
+            pixel[3] = 0x80 + (x & 0x7f);
+          }
+
+      name = g_strdup_printf ("image-%d.png", i);
+      files[i] = g_build_filename (dir, name, NULL);
+      g_free (name);
+
+      if (!gdk_pixbuf_save (pixbuf, files[i], "png", &error, NULL))
+        {
+          g_warning ("Unable to save %s: %s", files[i], error->message);
+          g_clear_error (&error);
+        }
+    }
+
+  g_object_unref (pixbuf);
+
+  return files;
+}
+
+static gint
+compare_times (gconstpointer a,
+               gconstpointer b)
+{
+  gint64 time_a = *(const gint64 *) a;
+  gint64 time_b = *(const gint64 *) b;
+
+  return (time_a < time_b) ? -1 : (time_a > time_b) ? 1 : 0;
+}
+
+static void
+report (void)
+{
+  gint64 total = 0, slow = 0;
+  guint i;
+
+  g_print ("%d images loaded in %.3fs\n", n_images,
+           (g_get_monotonic_time () - start_time) / 1000000.0);
+
+  if (frame_times->len == 0)
+    return;
+
+  for (i = 0; i < frame_times->len; i++)
+    {
+      gint64 time = g_array_index (frame_times, gint64, i);
+
+      total += time;
+      if (time > 1000000 / 60)
+        slow ++;
+    }
+
+  g_array_sort (frame_times, compare_times);
+
+  g_print ("%u frames: mean %.2fms, median %.2fms, 95th percentile %.2fms, "
+           "worst %.2fms, %" G_GINT64_FORMAT " longer than 16.7ms\n",
+           frame_times->len,
+           total / (gdouble) frame_times->len / 1000.0,
+           g_array_index (frame_times, gint64, frame_times->len / 2) / 1000.0,
+           g_array_index (frame_times, gint64,
+                          frame_times->len * 95 / 100) / 1000.0,
+           g_array_index (frame_times, gint64, frame_times->len - 1) / 1000.0,
+           slow);
+}
+
+static gboolean
+frame_cb (gpointer user_data)
+{
+  gint64 now = g_get_monotonic_time ();
+
+  if (start_time && last_frame_time)
+    {
+      gint64 frame_time = now - last_frame_time;
+      g_array_append_val (frame_times, frame_time);
+    }
+
+  last_frame_time = now;
+
+  return TRUE;
+}
+
+static void
+image_finished_cb (MxImage *image)
+{
+  if (++n_finished == n_images)
+    {
+      report ();
+      clutter_main_quit ();
+    }
+}
+
+static void
+image_load_error_cb (MxImage *image,
+                     GError  *error)
+{
+  g_warning ("Unable to load image: %s", error ? error->message : "unknown");
+  image_finished_cb (image);
+}
+
+static gboolean
+start_loading_cb (ClutterActor *grid)
+{
+  ClutterActorIter iter;
+  ClutterActor *child;
+  gint i = 0;
+
+  start_time = g_get_monotonic_time ();
+
+  clutter_actor_iter_init (&iter, grid);
+  while (clutter_actor_iter_next (&iter, &child))
+    mx_image_set_from_file_at_size (MX_IMAGE (child), filenames[i++],
+                                    tile_size, tile_size, NULL);
+
+  return FALSE;
+}
+
+int
+main (int argc, char **argv)
+{
+  ClutterActor *stage, *grid;
+  ClutterTimeline *timeline;
+  gint image_size = 1024;
+  GError *error = NULL;
+  gchar *dir;
+  gint i;
+
+  /* don't wait for the vertical blank, so that the frame times show how
+   * long uploading the images stalled the main loop */
+  g_setenv ("CLUTTER_VBLANK", "none", FALSE);
+
+  if (clutter_init (&argc, &argv) != CLUTTER_INIT_SUCCESS)
+    return 1;
+
+  if (argc > 1)
+    n_images = atoi (argv[1]);
+  if (argc > 2)
+    image_size = atoi (argv[2]);
+  if (argc > 3)
+    tile_size = atoi (argv[3]);
+
+  dir = g_dir_make_tmp ("mx-image-grid-bench-XXXXXX", &error);
+  if (!dir)
+    {
+      g_warning ("Unable to create a temporary directory: %s",
+                 error->message);
+      g_error_free (error);
+      return 1;
+    }
+
+  filenames = create_images (dir, image_size);
+  frame_times = g_array_new (FALSE, FALSE, sizeof (gint64));
+
+  stage = clutter_stage_new ();
+  clutter_actor_set_size (stage, 10 * tile_size, 10 * tile_size);
+  g_signal_connect (stage, "destroy", G_CALLBACK (clutter_main_quit), NULL);
+
+  grid = mx_grid_new ();
+  clutter_actor_set_width (grid, 10 * tile_size);
+  clutter_actor_add_child (stage, grid);
+
+  for (i = 0; i < n_images; i++)
+    {
+      ClutterActor *image = mx_image_new ();
+
+      mx_image_set_load_async (MX_IMAGE (image), TRUE);
+      mx_image_set_scale_mode (MX_IMAGE (image), MX_IMAGE_SCALE_CROP);
+      clutter_actor_set_size (image, tile_size, tile_size);
+
+      g_signal_connect (image, "image-loaded",
+                        G_CALLBACK (image_finished_cb), NULL);
+      g_signal_connect (image, "image-load-error",
+                        G_CALLBACK (image_load_error_cb), NULL);
+
+      clutter_actor_add_child (grid, image);
+    }
+
+  /* keep redrawing the stage, so that frame times are measured while the
+   * images load */
+  timeline = clutter_timeline_new (1000);
+  clutter_timeline_set_repeat_count (timeline, -1);
+  g_signal_connect_swapped (timeline, "new-frame",
+                            G_CALLBACK (clutter_actor_queue_redraw), stage);
+  clutter_timeline_start (timeline);
+
+  clutter_threads_add_repaint_func_full (CLUTTER_REPAINT_FLAGS_POST_PAINT,
+                                         frame_cb, NULL, NULL);
+
+  clutter_actor_show (stage);
+  clutter_threads_add_timeout (500, (GSourceFunc) start_loading_cb, grid);
+
+  clutter_main ();
+
+  clutter_timeline_stop (timeline);
+  g_object_unref (timeline);
+
+  for (i = 0; filenames[i]; i++)
+    g_unlink (filenames[i]);
+  g_rmdir (dir);
+
+  g_strfreev (filenames);
+  g_array_free (frame_times, TRUE);
+  g_free (dir);
+
+  return 0;
+}
@@ -0,0 +1,174 @@
+/*
+ * Copyright 2012 Intel Corporation.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU Lesser General Public License,
+ * version 2.1, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+ * Boston, MA 02111-1307, USA.
+ *
+ */
+
+/*
+ * Shows a list view of a large model in a scroll view, scrolls through it
+ * a little further every frame and reports how long it took to build the
+ * model and paint the first frame, the time between frames while
+ * scrolling, and how many children the view had.
+ *
+ * Usage: test-list-view-bench [n-rows] [virtualized]
+ *
+ * The view is virtualized unless the second argument is 0.
+ */
+
+#include <mx/mx.h>
+#include <stdlib.h>
+
+#define N_FRAMES 300
+
+static ClutterActor *view = NULL;
+static MxAdjustment *vadjustment = NULL;
+
+static gint64 start_time = 0;
+static gint64 first_frame_time = 0;
+static gint64 last_frame_time = 0;
+
+static gdouble frame_times[N_FRAMES];
+static guint n_frames = 0;
+
+static gint
+compare_doubles (gconstpointer a,
+                 gconstpointer b)
+{
+  gdouble da = *(const gdouble *) a, db = *(const gdouble *) b;
+
+  return (da > db) - (da < db);
+}
+
+static void
+report (void)
+{
+  gdouble total = 0;
+  guint i;
+
+  for (i = 0; i < n_frames; i++)
+    total += frame_times[i];
+
+  qsort (frame_times, n_frames, sizeof (gdouble), compare_doubles);
+
+  g_print ("first frame after %.2fms\n",
+           (first_frame_time - start_time) / 1000.0);
+  g_print ("%u frames while scrolling: mean %.2fms, median %.2fms, "
+           "95th percentile %.2fms, worst %.2fms\n", n_frames,
+           total / n_frames, frame_times[n_frames / 2],
+           frame_times[n_frames * 95 / 100], frame_times[n_frames - 1]);
+  g_print ("%d children\n", clutter_actor_get_n_children (view));
+}
+
+static gboolean
+frame_cb (gpointer user_data)
+{
+  gint64 now = g_get_monotonic_time ();
+  gdouble value, lower, upper, page_size;
+
+  if (!first_frame_time)
+    {
+      first_frame_time = last_frame_time = now;
+      mx_scrollable_get_adjustments (MX_SCROLLABLE (view), NULL,
+                                     &vadjustment);
+      return TRUE;
+    }
+
+  frame_times[n_frames++] = (now - last_frame_time) / 1000.0;
+  last_frame_time = now;
+
+  if (n_frames == N_FRAMES)
+    {
+      report ();
+      clutter_main_quit ();
+      return FALSE;
+    }
+
+  /* scroll a bit more than a page every frame, so that none of the rows
+   * on screen are the same as in the last frame */
+  mx_adjustment_get_values (vadjustment, &value, &lower, &upper, NULL, NULL,
+                            &page_size);
+  value += page_size * 1.5;
+  if (value > upper - page_size)
+    value = lower;
+  mx_adjustment_set_value (vadjustment, value);
+
+  return TRUE;
+}
+
+int
+main (int argc, char **argv)
+{
+  ClutterActor *stage, *scroll;
+  ClutterModel *model;
+  gboolean virtualized = TRUE;
+  gint n_rows = 100000;
+  gint64 model_time;
+  gint i;
+
+  if (clutter_init (&argc, &argv) != CLUTTER_INIT_SUCCESS)
+    return 1;
+
+  if (argc > 1)
+    n_rows = atoi (argv[1]);
+  if (argc > 2)
+    virtualized = atoi (argv[2]) != 0;
+
+  stage = clutter_stage_new ();
+  clutter_actor_set_size (stage, 480, 640);
+  g_signal_connect (stage, "destroy", G_CALLBACK (clutter_main_quit), NULL);
+
+  scroll = mx_scroll_view_new ();
+  clutter_actor_set_size (scroll, 480, 640);
+  clutter_actor_add_child (stage, scroll);
+
+  start_time = g_get_monotonic_time ();
+
+  model = clutter_list_model_new (1, G_TYPE_STRING, "text");
+  for (i = 0; i < n_rows; i++)
+    {
+      gchar *text = g_strdup_printf ("Row %d", i);
+
+      clutter_model_append (model, 0, text, -1);
+
+      g_free (text);
+    }
+
+  model_time = g_get_monotonic_time ();
+  g_print ("%d rows (%s): model built in %.2fms\n", n_rows,
+           virtualized ? "virtualized" : "not virtualized",
+           (model_time - start_time) / 1000.0);
+
+  view = mx_list_view_new ();
+  mx_list_view_set_virtualized (MX_LIST_VIEW (view), virtualized);
+  mx_list_view_set_item_type (MX_LIST_VIEW (view), MX_TYPE_LABEL);
+  mx_list_view_add_attribute (MX_LIST_VIEW (view), "text", 0);
+  mx_list_view_set_model (MX_LIST_VIEW (view), model);
+  clutter_actor_add_child (scroll, view);
+
+  clutter_actor_show (stage);
+
+  clutter_threads_add_repaint_func_full (CLUTTER_REPAINT_FLAGS_POST_PAINT,
+                                         frame_cb, NULL, NULL);
+
+  /* the first frame includes creating the view's children */
+  start_time = model_time;
+
+  clutter_main ();
+
+  g_object_unref (model);
+
+  return 0;
+}
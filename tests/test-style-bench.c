@@ -0,0 +1,242 @@
+/*
+ * Copyright 2012 Intel Corporation.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU Lesser General Public License,
+ * version 2.1, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+ * Boston, MA 02111-1307, USA.
+ *
+ */
+
+/*
+ * Styles a large number of widgets against the default theme, optionally
+ * with a large synthetic style sheet loaded on top, and reports how many
+ * style matches per second were performed.
+ *
+ * Every widget is given a unique name so that no two widgets can share a
+ * style cache entry, which means each widget is matched against the style
+ * sheet exactly once per pass.
+ *
+ * It then measures how long it takes to re-apply the cached style of every
+ * widget with mx_stylable_style_changed(), which is what happens whenever a
+ * widget is asked to update its style without its style having changed.
+ *
+ * Usage: test-style-bench [n-widgets] [n-synthetic-rules]
+ */
+
+#include <mx/mx.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define N_WIDGETS_PER_ROW 100
+
+static const gchar *classes[] = { "odd", "even", "header", "footer" };
+
+static gchar *
+create_synthetic_sheet (gint n_rules)
+{
+  GString *string;
+  gint i;
+
+  string = g_string_new (NULL);
+
+  for (i = 0; i < n_rules; i++)
+    {
+      switch (i % 5)
+        {
+        case 0:
+          g_string_append_printf (string, "#widget-%d { padding: %dpx; }\n",
+                                  i * 7, i % 10);
+          break;
+        case 1:
+          g_string_append_printf (string, ".synthetic-%d { color: #%06x; }\n",
+                                  i, i);
+          break;
+        case 2:
+          g_string_append_printf (string,
+                                  "MxButton.synthetic-%d:hover "
+                                  "{ background-color: #%06x; }\n", i, i);
+          break;
+        case 3:
+          g_string_append_printf (string,
+                                  "MxBoxLayout > MxLabel.synthetic-%d "
+                                  "{ font-size: %dpx; }\n", i, 8 + i % 8);
+          break;
+        case 4:
+          g_string_append_printf (string,
+                                  "MxBoxLayout.%s MxButton#widget-%d "
+                                  "{ spacing: %d; }\n",
+                                  classes[i % G_N_ELEMENTS (classes)],
+                                  i, i % 6);
+          break;
+        }
+    }
+
+  return g_string_free (string, FALSE);
+}
+
+static ClutterActor *
+create_widgets (gint n_widgets)
+{
+  ClutterActor *root, *row = NULL;
+  gint i;
+
+  root = mx_box_layout_new ();
+  mx_box_layout_set_orientation (MX_BOX_LAYOUT (root), MX_ORIENTATION_VERTICAL);
+
+  for (i = 0; i < n_widgets; i++)
+    {
+      ClutterActor *widget;
+      gchar *name;
+
+      if (i % N_WIDGETS_PER_ROW == 0)
+        {
+          row = mx_box_layout_new ();
+          mx_stylable_set_style_class (MX_STYLABLE (row),
+                                       classes[(i / N_WIDGETS_PER_ROW)
+                                               % G_N_ELEMENTS (classes)]);
+          clutter_actor_add_child (root, row);
+        }
+
+      if (i % 2)
+        widget = mx_button_new_with_label ("Button");
+      else
+        widget = mx_label_new_with_text ("Label");
+
+      name = g_strdup_printf ("widget-%d", i);
+      clutter_actor_set_name (widget, name);
+      g_free (name);
+
+      if (i % 3 == 0)
+        mx_stylable_style_pseudo_class_add (MX_STYLABLE (widget), "hover");
+
+      clutter_actor_add_child (row, widget);
+    }
+
+  return root;
+}
+
+static void
+style_widgets (ClutterActor *root,
+               const gchar  *description)
+{
+  ClutterActorIter row_iter, iter;
+  ClutterActor *row, *child;
+  GTimer *timer;
+  gint n_matches = 0;
+  gdouble elapsed;
+
+  timer = g_timer_new ();
+
+  clutter_actor_iter_init (&row_iter, root);
+  while (clutter_actor_iter_next (&row_iter, &row))
+    {
+      clutter_actor_iter_init (&iter, row);
+      while (clutter_actor_iter_next (&iter, &child))
+        {
+          ClutterColor *color = NULL;
+
+          mx_stylable_get (MX_STYLABLE (child),
+                           "background-color", &color,
+                           NULL);
+
+          if (color)
+            clutter_color_free (color);
+
+          n_matches++;
+        }
+    }
+
+  elapsed = g_timer_elapsed (timer, NULL);
+  g_timer_destroy (timer);
+
+  g_print ("%-32s %6d widgets in %8.3fs: %10.0f matches/sec\n",
+           description, n_matches, elapsed,
+           (elapsed > 0) ? n_matches / elapsed : 0);
+}
+
+static void
+restyle_widgets (ClutterActor *root,
+                 gint          n_iterations)
+{
+  ClutterActorIter row_iter, iter;
+  ClutterActor *row, *child;
+  GTimer *timer;
+  gint i, n_restyles = 0;
+  gdouble elapsed;
+
+  timer = g_timer_new ();
+
+  for (i = 0; i < n_iterations; i++)
+    {
+      clutter_actor_iter_init (&row_iter, root);
+      while (clutter_actor_iter_next (&row_iter, &row))
+        {
+          clutter_actor_iter_init (&iter, row);
+          while (clutter_actor_iter_next (&iter, &child))
+            {
+              mx_stylable_style_changed (MX_STYLABLE (child),
+                                         MX_STYLE_CHANGED_FORCE);
+              n_restyles++;
+            }
+        }
+    }
+
+  elapsed = g_timer_elapsed (timer, NULL);
+  g_timer_destroy (timer);
+
+  g_print ("%-32s %6d restyles in %7.3fs: %10.0f restyles/sec\n",
+           "style-changed, cached style", n_restyles, elapsed,
+           (elapsed > 0) ? n_restyles / elapsed : 0);
+}
+
+int
+main (int argc, char **argv)
+{
+  ClutterActor *root;
+  gint n_widgets = 10000;
+  gint n_rules = 2000;
+  gchar *data;
+  GError *error = NULL;
+
+  if (clutter_init (&argc, &argv) != CLUTTER_INIT_SUCCESS)
+    return 1;
+
+  if (argc > 1)
+    n_widgets = atoi (argv[1]);
+  if (argc > 2)
+    n_rules = atoi (argv[2]);
+
+  root = create_widgets (n_widgets);
+  g_object_ref_sink (root);
+
+  style_widgets (root, "default theme");
+  restyle_widgets (root, 10);
+
+  /* loading a new sheet bumps the style age, which invalidates the
+   * style cache of every widget */
+  data = create_synthetic_sheet (n_rules);
+  if (!mx_style_load_from_data (mx_style_get_default (), "synthetic.css",
+                                data, &error))
+    {
+      g_warning ("Unable to load synthetic style sheet: %s", error->message);
+      g_clear_error (&error);
+    }
+  g_free (data);
+
+  style_widgets (root, "default theme + synthetic rules");
+
+  clutter_actor_destroy (root);
+  g_object_unref (root);
+
+  return 0;
+}